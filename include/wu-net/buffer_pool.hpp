@@ -0,0 +1,184 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace net {
+
+class buffer_pool;
+
+// A block borrowed from a buffer_pool; returned to the pool of whichever
+// thread destroys it
+class pooled_buffer {
+public:
+  pooled_buffer() noexcept = default;
+
+  pooled_buffer(char *data, std::size_t size) noexcept
+      : data_(data), size_(size) {}
+
+  // No copy
+  pooled_buffer(const pooled_buffer &) = delete;
+  pooled_buffer &operator=(const pooled_buffer &) = delete;
+
+  // Move
+  pooled_buffer(pooled_buffer &&other) noexcept
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)) {}
+
+  pooled_buffer &operator=(pooled_buffer &&other) noexcept {
+    if (this != &other) {
+      reset();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+  }
+
+  // Destructor
+  ~pooled_buffer() { reset(); }
+
+  char *data() const noexcept { return data_; }
+
+  std::size_t size() const noexcept { return size_; }
+
+  explicit operator bool() const noexcept { return data_ != nullptr; }
+
+  // Give the block back to the pool
+  inline void reset() noexcept;
+
+private:
+  char *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+namespace detail {
+
+// Set once the calling thread's pool has been destroyed, so buffers freed
+// later during thread exit bypass it
+inline thread_local bool buffer_pool_destroyed = false;
+
+} // namespace detail
+
+// Thread-local cache of I/O buffers in power-of-two size classes.
+//
+// Blocks are only cached up to a per-class byte budget, so a burst of
+// large transfers doesn't pin memory forever. Larger requests than the
+// biggest class are allocated directly and freed on release.
+class buffer_pool {
+public:
+  static constexpr std::size_t min_block_size = 4096;
+  static constexpr std::size_t max_block_size = 256 * 1024;
+  static constexpr std::size_t cached_bytes_per_class = 1024 * 1024;
+
+  // No copy or move (one per thread)
+  buffer_pool(const buffer_pool &) = delete;
+  buffer_pool &operator=(const buffer_pool &) = delete;
+
+  // Destructor
+  ~buffer_pool() {
+    trim();
+    detail::buffer_pool_destroyed = true;
+  }
+
+  // The calling thread's pool; null while the thread is exiting
+  static buffer_pool *local() noexcept {
+    if (detail::buffer_pool_destroyed) {
+      return nullptr;
+    }
+    thread_local buffer_pool pool;
+    return &pool;
+  }
+
+  // Borrow a block of at least `size` bytes from the calling thread's pool
+  static pooled_buffer acquire(std::size_t size) {
+    std::size_t block = block_size(size);
+    if (buffer_pool *pool = local(); pool && block <= max_block_size) {
+      auto &cached = pool->free_[size_class(block)];
+      if (!cached.empty()) {
+        char *data = cached.back();
+        cached.pop_back();
+        pool->cached_bytes_ -= block;
+        return {data, block};
+      }
+    }
+    return {allocate(block), block};
+  }
+
+  // Return a block to the calling thread's pool, or free it if the pool
+  // already holds enough of that size
+  static void release(char *data, std::size_t size) noexcept {
+    buffer_pool *pool = local();
+    if (pool && size <= max_block_size &&
+        std::has_single_bit(size) && size >= min_block_size) {
+      auto &cached = pool->free_[size_class(size)];
+      if ((cached.size() + 1) * size <= cached_bytes_per_class) {
+        try {
+          cached.push_back(data);
+          pool->cached_bytes_ += size;
+          return;
+        } catch (...) {
+          // Fall through and free it
+        }
+      }
+    }
+    deallocate(data);
+  }
+
+  // Size of the block acquire(size) hands out
+  static constexpr std::size_t block_size(std::size_t size) noexcept {
+    return size <= min_block_size ? min_block_size : std::bit_ceil(size);
+  }
+
+  // Bytes sitting idle in this pool
+  std::size_t cached_bytes() const noexcept { return cached_bytes_; }
+
+  // Free every cached block
+  void trim() noexcept {
+    for (auto &cached : free_) {
+      for (char *data : cached) {
+        deallocate(data);
+      }
+      cached.clear();
+    }
+    cached_bytes_ = 0;
+  }
+
+private:
+  static constexpr std::size_t class_count =
+      std::countr_zero(max_block_size) - std::countr_zero(min_block_size) + 1;
+
+  // Blocks are cache-line aligned so neighbouring buffers never share a line
+  static constexpr std::align_val_t alignment{64};
+
+  buffer_pool() = default;
+
+  static std::size_t size_class(std::size_t block) noexcept {
+    return static_cast<std::size_t>(std::countr_zero(block) -
+                                    std::countr_zero(min_block_size));
+  }
+
+  static char *allocate(std::size_t size) {
+    return static_cast<char *>(::operator new(size, alignment));
+  }
+
+  static void deallocate(char *data) noexcept {
+    ::operator delete(data, alignment);
+  }
+
+  std::array<std::vector<char *>, class_count> free_;
+  std::size_t cached_bytes_ = 0;
+};
+
+inline void pooled_buffer::reset() noexcept {
+  if (data_) {
+    buffer_pool::release(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
+} // namespace net
@@ -0,0 +1,520 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "endpoint.hpp"
+#include "tcp_stream.hpp"
+
+namespace net {
+
+namespace detail {
+
+// Bounded lock-free multi-producer multi-consumer queue (Vyukov's array
+// queue). Every slot carries a sequence number that tells producers and
+// consumers whose turn it is, so neither side ever waits on the other.
+// Slots are rounded up to a power of two, but no more than `capacity`
+// items are held; a capacity of 0 holds none.
+template <typename T> class mpmc_ring {
+public:
+  explicit mpmc_ring(std::size_t capacity)
+      : capacity_(capacity),
+        mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+        slots_(std::make_unique<slot[]>(mask_ + 1)) {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // False if the ring is full
+  bool try_push(const T &value) noexcept {
+    std::size_t pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      slot &s = slots_[pos & mask_];
+      std::size_t seq = s.sequence.load(std::memory_order_acquire);
+      auto diff =
+          static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        // `head_` only grows, so a stale read can only refuse early
+        if (pos - head_.load(std::memory_order_acquire) >= capacity_) {
+          return false;
+        }
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          s.value = value;
+          s.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // False if the ring is empty
+  bool try_pop(T &value) noexcept {
+    std::size_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      slot &s = slots_[pos & mask_];
+      std::size_t seq = s.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(seq) -
+                  static_cast<std::intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          value = s.value;
+          s.sequence.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Approximate number of queued items
+  std::size_t size() const noexcept {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+  std::size_t capacity() const noexcept { return capacity_; }
+
+private:
+  struct slot {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  std::size_t capacity_;
+  std::size_t mask_;
+  std::unique_ptr<slot[]> slots_;
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+} // namespace detail
+
+// Settings for connection_pool
+struct connection_pool_options {
+  std::size_t max_idle_per_host = 64; // 0 = close connections on release
+  std::size_t max_connections_per_host = 0; // Idle plus checked out; 0 = any
+  std::chrono::milliseconds idle_timeout{30000};
+  int connect_timeout_ms = -1;
+  std::size_t max_hosts = 256; // Distinct host:port keys
+  std::chrono::milliseconds dns_ttl{60000}; // Re-resolve names after this
+};
+
+class connection_pool;
+
+// A connection checked out of a connection_pool. Destroying it hands the
+// connection back for reuse, unless it was discarded or is no longer in a
+// clean state (closed, failed, or holding unread input).
+class pooled_connection {
+public:
+  pooled_connection() = default;
+
+  // No copy
+  pooled_connection(const pooled_connection &) = delete;
+  pooled_connection &operator=(const pooled_connection &) = delete;
+
+  // Move
+  pooled_connection(pooled_connection &&other) noexcept
+      : pool_(std::exchange(other.pool_, nullptr)),
+        host_(std::exchange(other.host_, nullptr)),
+        stream_(std::move(other.stream_)), reused_(other.reused_) {}
+
+  pooled_connection &operator=(pooled_connection &&other) noexcept {
+    if (this != &other) {
+      release();
+      pool_ = std::exchange(other.pool_, nullptr);
+      host_ = std::exchange(other.host_, nullptr);
+      stream_ = std::move(other.stream_);
+      reused_ = other.reused_;
+    }
+    return *this;
+  }
+
+  // Destructor
+  ~pooled_connection() { release(); }
+
+  tcp_stream &operator*() noexcept { return stream_; }
+  tcp_stream *operator->() noexcept { return &stream_; }
+
+  // True if the connection was idle in the pool rather than newly opened.
+  // A request that fails on a reused connection is worth one retry, since
+  // the peer may have closed it just after it passed the health check.
+  bool reused() const noexcept { return reused_; }
+
+  // Close the connection instead of returning it, e.g. after a protocol
+  // error or when the peer asked for the connection to be closed
+  void discard() noexcept { stream_.setstate(std::ios::badbit); }
+
+  // Return the connection to the pool now
+  inline void release();
+
+private:
+  friend class connection_pool;
+
+  pooled_connection(connection_pool *pool, void *host, tcp_stream stream,
+                    bool reused) noexcept
+      : pool_(pool), host_(host), stream_(std::move(stream)), reused_(reused) {}
+
+  connection_pool *pool_ = nullptr;
+  void *host_ = nullptr;
+  tcp_stream stream_;
+  bool reused_ = false;
+};
+
+// Keeps outbound connections warm for reuse, keyed by "host:port".
+//
+// Each host has a lock-free ring of idle sockets, so threads check
+// connections out and back in without taking a lock; the host table itself
+// is an insert-only open-addressing array of atomic pointers. Addresses are
+// resolved per host and cached for dns_ttl, and connections are opened
+// directly to the cached sockaddrs; a failed lookup isn't cached, and a
+// host whose every cached address refuses is looked up again at once. Idle
+// connections are checked before reuse with a non-blocking MSG_PEEK, which
+// exposes a peer that has closed (EOF), reset or sent something unexpected, and
+// are closed once they have been idle for idle_timeout. The pool must outlive
+// the connections it hands out.
+class connection_pool {
+public:
+  explicit connection_pool(connection_pool_options options = {})
+      : options_(options),
+        mask_(std::bit_ceil(std::max<std::size_t>(options.max_hosts, 1)) - 1),
+        hosts_(std::make_unique<std::atomic<host *>[]>(mask_ + 1)) {}
+
+  // No copy or move (connections point back to the pool)
+  connection_pool(const connection_pool &) = delete;
+  connection_pool &operator=(const connection_pool &) = delete;
+
+  // Destructor
+  ~connection_pool() {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      if (host *h = hosts_[i].load(std::memory_order_acquire)) {
+        idle_entry entry;
+        while (h->idle.try_pop(entry)) {
+          ::close(entry.fd);
+        }
+        delete h;
+      }
+    }
+  }
+
+  // Check out a connection to `address`: an idle one that passes the
+  // health check if there is one, otherwise a new one
+  std::expected<pooled_connection, std::error_code>
+  acquire(std::string_view address) {
+    host *h = find(address);
+    if (!h) {
+      return std::unexpected(make_error_code(tcp_error::pool_exhausted));
+    }
+
+    idle_entry entry;
+    while (h->idle.try_pop(entry)) {
+      if (expired(entry, now()) || !healthy(entry.fd)) {
+        ::close(entry.fd);
+        h->live.fetch_sub(1, std::memory_order_relaxed);
+        continue;
+      }
+      return pooled_connection(this, h, tcp_stream(entry.fd), true);
+    }
+
+    // Reserve a place under the per-host cap before connecting
+    std::size_t live = h->live.load(std::memory_order_relaxed);
+    do {
+      if (options_.max_connections_per_host != 0 &&
+          live >= options_.max_connections_per_host) {
+        return std::unexpected(make_error_code(tcp_error::pool_exhausted));
+      }
+    } while (!h->live.compare_exchange_weak(live, live + 1,
+                                            std::memory_order_relaxed));
+
+    auto fd = open(*h);
+    if (!fd) {
+      h->live.fetch_sub(1, std::memory_order_relaxed);
+      return std::unexpected(fd.error());
+    }
+    return pooled_connection(this, h, tcp_stream(*fd), false);
+  }
+
+  // Close idle connections that have outlived idle_timeout; returns how
+  // many were closed. Expired connections are also dropped lazily by
+  // acquire(), so calling this is only needed to release them sooner.
+  std::size_t evict_idle() {
+    std::size_t evicted = 0;
+    auto current = now();
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      host *h = hosts_[i].load(std::memory_order_acquire);
+      if (!h) {
+        continue;
+      }
+
+      // One pass over what is queued now; survivors go to the back
+      for (std::size_t n = h->idle.size(); n > 0; --n) {
+        idle_entry entry;
+        if (!h->idle.try_pop(entry)) {
+          break;
+        }
+        if (expired(entry, current) || !h->idle.try_push(entry)) {
+          ::close(entry.fd);
+          h->live.fetch_sub(1, std::memory_order_relaxed);
+          ++evicted;
+        }
+      }
+    }
+    return evicted;
+  }
+
+  // Idle connections to `address`
+  std::size_t idle_count(std::string_view address) const {
+    const host *h = lookup(address);
+    return h ? h->idle.size() : 0;
+  }
+
+  // Open connections to `address`, idle or checked out
+  std::size_t connection_count(std::string_view address) const {
+    const host *h = lookup(address);
+    return h ? h->live.load(std::memory_order_relaxed) : 0;
+  }
+
+private:
+  friend class pooled_connection;
+
+  struct idle_entry {
+    int fd = -1;
+    std::int64_t since = 0; // steady_clock nanoseconds
+  };
+
+  struct resolved_address {
+    int family;
+    int socktype;
+    int protocol;
+    sockaddr_storage address;
+    socklen_t length;
+  };
+
+  struct host {
+    host(std::string_view address, std::size_t max_idle)
+        : address(address), idle(max_idle) {}
+
+    std::string address;
+    detail::mpmc_ring<idle_entry> idle;
+    std::atomic<std::size_t> live{0};
+    std::mutex mutex; // Guards the fields below
+    bool numeric = false; // Never looked up, so never stale
+    std::optional<std::int64_t> resolved_at; // steady_clock nanoseconds
+    std::vector<resolved_address> addresses;
+  };
+
+  static std::int64_t now() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  bool expired(const idle_entry &entry, std::int64_t current) const noexcept {
+    return current - entry.since >
+           std::chrono::nanoseconds(options_.idle_timeout).count();
+  }
+
+  // An idle connection must have nothing to read: EOF means the peer
+  // closed it, and data means a stray response nobody will consume
+  static bool healthy(int fd) noexcept {
+    char byte;
+    ssize_t n;
+    do {
+      n = ::recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    } while (n < 0 && errno == EINTR);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+
+  const host *lookup(std::string_view address) const noexcept {
+    std::size_t i = std::hash<std::string_view>{}(address) & mask_;
+    for (std::size_t probes = 0; probes <= mask_; ++probes) {
+      host *h = hosts_[i].load(std::memory_order_acquire);
+      if (!h) {
+        return nullptr;
+      }
+      if (h->address == address) {
+        return h;
+      }
+      i = (i + 1) & mask_;
+    }
+    return nullptr;
+  }
+
+  // Find or insert the host for `address`; null if the table is full
+  host *find(std::string_view address) {
+    std::size_t i = std::hash<std::string_view>{}(address) & mask_;
+    std::unique_ptr<host> created;
+    for (std::size_t probes = 0; probes <= mask_; ++probes) {
+      host *h = hosts_[i].load(std::memory_order_acquire);
+      if (!h) {
+        if (!created) {
+          created = std::make_unique<host>(address, options_.max_idle_per_host);
+        }
+        if (hosts_[i].compare_exchange_strong(h, created.get(),
+                                              std::memory_order_acq_rel)) {
+          return created.release();
+        }
+        // Lost the race for this slot; h is the winner
+      }
+      if (h->address == address) {
+        return h;
+      }
+      i = (i + 1) & mask_;
+    }
+    return nullptr;
+  }
+
+  // Look up `h`'s addresses again; empty if the lookup failed
+  static std::vector<resolved_address> resolve(const host &h) {
+    std::vector<resolved_address> addresses;
+    auto parts = detail::split_host_port(h.address);
+    if (!parts) {
+      return addresses;
+    }
+
+    std::string name(parts->first);
+    std::string port(parts->second);
+    addrinfo hints = {}, *results = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(name.c_str(), port.c_str(), &hints, &results) != 0) {
+      return addresses;
+    }
+
+    for (addrinfo *ai = results; ai != nullptr; ai = ai->ai_next) {
+      resolved_address resolved{ai->ai_family, ai->ai_socktype,
+                                ai->ai_protocol, {}, ai->ai_addrlen};
+      std::memcpy(&resolved.address, ai->ai_addr, ai->ai_addrlen);
+      addresses.push_back(resolved);
+    }
+    freeaddrinfo(results);
+    return addresses;
+  }
+
+  // The addresses to try for `h`, resolving them if there are none yet,
+  // they are older than dns_ttl, or `refresh` is set. `fresh` tells
+  // whether looking them up again could change them: not if they just
+  // were, nor for numeric addresses, which are parsed once.
+  std::vector<resolved_address> addresses(host &h, bool refresh,
+                                          bool &fresh) {
+    std::lock_guard lock(h.mutex);
+    fresh = true;
+    if (h.numeric) {
+      return h.addresses;
+    }
+    if (!h.resolved_at) {
+      if (auto target = endpoint::from_str(h.address)) {
+        resolved_address resolved{target->family(), SOCK_STREAM, 0, {}, 0};
+        resolved.length = target->to_sockaddr(resolved.address);
+        h.addresses.push_back(resolved);
+        h.numeric = true;
+        return h.addresses;
+      }
+    }
+
+    auto current = now();
+    if (refresh || !h.resolved_at ||
+        current - *h.resolved_at >
+            std::chrono::nanoseconds(options_.dns_ttl).count()) {
+      h.addresses = resolve(h);
+      h.resolved_at.reset();
+      if (!h.addresses.empty()) {
+        h.resolved_at = current;
+      }
+    } else {
+      fresh = false;
+    }
+    return h.addresses;
+  }
+
+  // Connect to the first of `h`'s addresses that answers. If none does
+  // and they came from the cache, the name may have moved: look it up
+  // again and try once more.
+  std::expected<int, std::error_code> open(host &h) {
+    bool fresh = false;
+    for (bool refresh : {false, true}) {
+      auto candidates = addresses(h, refresh, fresh);
+      if (candidates.empty()) {
+        return std::unexpected(make_error_code(
+            !detail::split_host_port(h.address)
+                ? tcp_error::invalid_address_format
+                : tcp_error::connection_failed));
+      }
+
+      for (const resolved_address &a : candidates) {
+        int fd = detail::connect_socket(
+            a.family, a.socktype, a.protocol,
+            reinterpret_cast<const sockaddr *>(&a.address), a.length,
+            options_.connect_timeout_ms);
+        if (fd >= 0) {
+          return fd;
+        }
+      }
+      if (fresh) {
+        break;
+      }
+    }
+    return std::unexpected(make_error_code(tcp_error::connection_failed));
+  }
+
+  // Take a connection back from a pooled_connection
+  void release(host &h, tcp_stream &stream) {
+    if (stream.is_open()) {
+      stream.flush();
+      if (stream.good() && stream.rdbuf()->in_avail() <= 0) {
+        int fd = stream.release();
+        if (h.idle.try_push({fd, now()})) {
+          return;
+        }
+        ::close(fd); // Enough idle connections already
+      } else {
+        stream.close();
+      }
+    }
+    h.live.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  connection_pool_options options_;
+  std::size_t mask_;
+  std::unique_ptr<std::atomic<host *>[]> hosts_;
+};
+
+inline void pooled_connection::release() {
+  if (pool_) {
+    pool_->release(*static_cast<connection_pool::host *>(host_), stream_);
+    pool_ = nullptr;
+    host_ = nullptr;
+  }
+}
+
+} // namespace net
@@ -0,0 +1,941 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "event_loop.hpp"
+#include "ipv4_address.hpp"
+
+namespace net {
+
+// Reasons a name could not be resolved
+enum class dns_error {
+  bad_name = 1,
+  not_found,
+  server_failure,
+  refused,
+  timeout,
+  bad_response,
+  no_nameservers
+};
+
+class dns_error_category : public std::error_category {
+public:
+  const char *name() const noexcept override { return "dns"; }
+
+  std::string message(int ev) const override {
+    switch (static_cast<dns_error>(ev)) {
+    case dns_error::bad_name:
+      return "Invalid host name";
+    case dns_error::not_found:
+      return "Host not found";
+    case dns_error::server_failure:
+      return "Name server failure";
+    case dns_error::refused:
+      return "Query refused by name server";
+    case dns_error::timeout:
+      return "Name server did not answer";
+    case dns_error::bad_response:
+      return "Malformed DNS response";
+    case dns_error::no_nameservers:
+      return "No name servers configured";
+    default:
+      return "Unknown dns error";
+    }
+  }
+};
+
+inline const std::error_category &dns_category() noexcept {
+  static const dns_error_category instance;
+  return instance;
+}
+
+inline std::error_code make_error_code(dns_error e) noexcept {
+  return {static_cast<int>(e), dns_category()};
+}
+
+// Settings for dns_resolver
+struct dns_resolver_options {
+  std::string resolv_conf = "/etc/resolv.conf";
+  std::string hosts = "/etc/hosts";
+  // "ip" or "ip:port"; replaces the nameservers from resolv_conf if set
+  std::vector<std::string> nameservers;
+  // Per attempt, and attempts per server; resolv.conf options override them
+  std::chrono::milliseconds timeout{5000};
+  int attempts = 2;
+  std::chrono::seconds min_ttl{0};
+  std::chrono::seconds max_ttl{3600};
+  std::chrono::seconds negative_ttl{5}; // For names that do not exist
+  // How long past its TTL an answer is still served while it is refreshed
+  std::chrono::seconds max_stale{30};
+  std::size_t max_entries = 4096;
+};
+
+namespace detail {
+
+// Lowercase a host name and drop one trailing dot; nullopt unless it is a
+// valid sequence of 1-63 byte labels, at most 253 bytes in all
+inline std::optional<std::string> normalize_dns_name(std::string_view name) {
+  if (!name.empty() && name.back() == '.') {
+    name.remove_suffix(1);
+  }
+  if (name.empty() || name.size() > 253) {
+    return std::nullopt;
+  }
+
+  std::string normalized(name);
+  std::size_t label = 0;
+  for (char &c : normalized) {
+    if (c == '.') {
+      if (label == 0) {
+        return std::nullopt;
+      }
+      label = 0;
+      continue;
+    }
+    bool valid = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                 c == '-' || c == '_';
+    if (c >= 'A' && c <= 'Z') {
+      c = static_cast<char>(c - 'A' + 'a');
+    } else if (!valid) {
+      return std::nullopt;
+    }
+    if (++label > 63) {
+      return std::nullopt;
+    }
+  }
+  return label > 0 ? std::optional(std::move(normalized)) : std::nullopt;
+}
+
+// Parse "ip" or "ip:port" into a socket address
+inline std::optional<sockaddr_in> parse_nameserver(std::string_view text,
+                                                   std::uint16_t port = 53) {
+  std::size_t colon = text.find(':');
+  if (colon != std::string_view::npos) {
+    auto port_text = text.substr(colon + 1);
+    auto [end, ec] = std::from_chars(
+        port_text.data(), port_text.data() + port_text.size(), port);
+    if (ec != std::errc{} || end != port_text.data() + port_text.size()) {
+      return std::nullopt;
+    }
+    text = text.substr(0, colon);
+  }
+
+  auto ip = ipv4_address::from_str(text);
+  if (!ip) {
+    return std::nullopt;
+  }
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  std::memcpy(&address.sin_addr, ip->octets().data(), 4);
+  return address;
+}
+
+// Split a line into whitespace separated fields, stopping at a comment
+inline std::vector<std::string_view> config_fields(std::string_view line) {
+  std::vector<std::string_view> fields;
+  line = line.substr(0, line.find_first_of("#;"));
+  std::size_t pos = 0;
+  while (pos < line.size()) {
+    std::size_t begin = line.find_first_not_of(" \t\r", pos);
+    if (begin == std::string_view::npos) {
+      break;
+    }
+    std::size_t end = line.find_first_of(" \t\r", begin);
+    if (end == std::string_view::npos) {
+      end = line.size();
+    }
+    fields.push_back(line.substr(begin, end - begin));
+    pos = end;
+  }
+  return fields;
+}
+
+inline std::string read_file(const std::string &path) {
+  std::ifstream file(path);
+  std::ostringstream text;
+  text << file.rdbuf();
+  return std::move(text).str();
+}
+
+// Wire format (RFC 1035)
+inline constexpr std::uint16_t dns_type_a = 1;
+inline constexpr std::uint16_t dns_class_in = 1;
+inline constexpr std::size_t dns_header_size = 12;
+inline constexpr std::size_t dns_max_udp_size = 512;
+inline constexpr std::uint16_t dns_flag_response = 0x8000;
+inline constexpr std::uint16_t dns_flag_truncated = 0x0200;
+
+inline std::uint16_t read_u16(std::span<const std::uint8_t> data,
+                              std::size_t pos) noexcept {
+  return static_cast<std::uint16_t>(data[pos] << 8 | data[pos + 1]);
+}
+
+// A recursive query for the A records of a normalized name
+inline std::size_t encode_dns_query(std::uint16_t id, std::string_view name,
+                                    std::span<std::uint8_t> out) noexcept {
+  std::uint8_t *p = out.data();
+  const std::array<std::uint8_t, dns_header_size> header = {
+      static_cast<std::uint8_t>(id >> 8), static_cast<std::uint8_t>(id),
+      0x01, 0x00, // RD
+      0, 1,       // QDCOUNT
+      0, 0, 0, 0, 0, 0};
+  p = std::copy(header.begin(), header.end(), p);
+
+  while (!name.empty()) {
+    std::size_t dot = std::min(name.find('.'), name.size());
+    *p++ = static_cast<std::uint8_t>(dot);
+    p = std::copy(name.begin(), name.begin() + dot, p);
+    name.remove_prefix(std::min(dot + 1, name.size()));
+  }
+  *p++ = 0;
+
+  const std::array<std::uint8_t, 4> question = {0, dns_type_a, 0,
+                                                dns_class_in};
+  p = std::copy(question.begin(), question.end(), p);
+  return static_cast<std::size_t>(p - out.data());
+}
+
+// Read a possibly compressed name starting at `pos`, advancing `pos` past
+// it. The name is lowercased into `out` if given.
+inline bool read_dns_name(std::span<const std::uint8_t> data, std::size_t &pos,
+                          std::string *out) {
+  std::size_t cursor = pos;
+  bool jumped = false;
+  for (int jumps = 0; jumps < 64;) {
+    if (cursor >= data.size()) {
+      return false;
+    }
+    std::uint8_t length = data[cursor];
+    if ((length & 0xc0) == 0xc0) {
+      if (cursor + 1 >= data.size()) {
+        return false;
+      }
+      if (!jumped) {
+        pos = cursor + 2;
+        jumped = true;
+      }
+      cursor = read_u16(data, cursor) & 0x3fff;
+      ++jumps;
+      continue;
+    }
+    if (length & 0xc0) {
+      return false; // Reserved label types
+    }
+
+    ++cursor;
+    if (length == 0) {
+      if (!jumped) {
+        pos = cursor;
+      }
+      return true;
+    }
+    if (cursor + length > data.size()) {
+      return false;
+    }
+    if (out) {
+      if (!out->empty()) {
+        out->push_back('.');
+      }
+      for (std::size_t i = 0; i < length; ++i) {
+        char c = static_cast<char>(data[cursor + i]);
+        out->push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c);
+      }
+    }
+    cursor += length;
+  }
+  return false; // Pointer loop
+}
+
+struct dns_answer {
+  std::vector<ipv4_address> addresses;
+  std::uint32_t ttl = 0;
+};
+
+// Check that `data` answers query `id` for `name` and collect its A
+// records. An error other than bad_response is the server's answer.
+inline std::expected<dns_answer, std::error_code>
+parse_dns_response(std::span<const std::uint8_t> data, std::uint16_t id,
+                   std::string_view name) {
+  auto bad = std::unexpected(make_error_code(dns_error::bad_response));
+  if (data.size() < dns_header_size || read_u16(data, 0) != id) {
+    return bad;
+  }
+
+  std::uint16_t flags = read_u16(data, 2);
+  if (!(flags & dns_flag_response) || read_u16(data, 4) != 1) {
+    return bad; // Not a response, or not to a single question
+  }
+
+  std::size_t pos = dns_header_size;
+  std::string question;
+  if (!read_dns_name(data, pos, &question) || question != name ||
+      pos + 4 > data.size() || read_u16(data, pos) != dns_type_a ||
+      read_u16(data, pos + 2) != dns_class_in) {
+    return bad;
+  }
+  pos += 4;
+
+  switch (flags & 0x0f) {
+  case 0:
+    break;
+  case 2:
+    return std::unexpected(make_error_code(dns_error::server_failure));
+  case 3:
+    return std::unexpected(make_error_code(dns_error::not_found));
+  case 5:
+    return std::unexpected(make_error_code(dns_error::refused));
+  default:
+    return std::unexpected(make_error_code(dns_error::server_failure));
+  }
+
+  // The answer section holds the CNAME chain followed by the A records of
+  // its target; a recursive server has already followed it for us
+  dns_answer answer;
+  answer.ttl = UINT32_MAX;
+  std::uint16_t count = read_u16(data, 6);
+  for (std::uint16_t i = 0; i < count; ++i) {
+    if (!read_dns_name(data, pos, nullptr) || pos + 10 > data.size()) {
+      return bad;
+    }
+    std::uint16_t type = read_u16(data, pos);
+    std::uint16_t rclass = read_u16(data, pos + 2);
+    std::uint32_t ttl = static_cast<std::uint32_t>(read_u16(data, pos + 4))
+                            << 16 |
+                        read_u16(data, pos + 6);
+    std::uint16_t length = read_u16(data, pos + 8);
+    pos += 10;
+    if (pos + length > data.size()) {
+      return bad;
+    }
+
+    answer.ttl = std::min(answer.ttl, ttl);
+    if (type == dns_type_a && rclass == dns_class_in && length == 4) {
+      answer.addresses.emplace_back(data[pos], data[pos + 1], data[pos + 2],
+                                    data[pos + 3]);
+    }
+    pos += length;
+  }
+
+  if (answer.addresses.empty()) {
+    return std::unexpected(make_error_code(dns_error::not_found)); // NODATA
+  }
+  return answer;
+}
+
+} // namespace detail
+
+class dns_resolver;
+
+// Awaitable result of dns_resolver::resolve()
+class dns_lookup {
+public:
+  using result_type = std::expected<std::vector<ipv4_address>, std::error_code>;
+
+  bool await_ready() const noexcept { return done_; }
+
+  inline bool await_suspend(std::coroutine_handle<> handle);
+
+  result_type await_resume() { return std::move(result_); }
+
+private:
+  friend class dns_resolver;
+
+  dns_lookup(dns_resolver *resolver, std::string name) noexcept
+      : resolver_(resolver), name_(std::move(name)) {}
+
+  void complete(result_type result) {
+    result_ = std::move(result);
+    done_ = true;
+  }
+
+  dns_resolver *resolver_;
+  std::string name_;
+  result_type result_;
+  bool done_ = false;
+  std::coroutine_handle<> waiter_;
+};
+
+// Non-blocking stub resolver for IPv4 addresses, bound to one event loop.
+//
+// Names are looked up in the hosts file first, then sent as recursive UDP
+// queries to the nameservers from resolv.conf, rotating through them on
+// timeout; a truncated answer is asked for again over TCP. Answers are
+// cached for their TTL (negative answers for negative_ttl); concurrent
+// lookups of a name share one query, and an expired answer keeps being
+// served for up to max_stale while a single background query refreshes
+// it. Names are used as given: resolv.conf search domains are not applied.
+//
+// Each query has an id from getrandom(2) and a socket of its own, so its
+// source port is a fresh one the kernel picks at random: a forged answer
+// has to guess both (RFC 5452).
+//
+// A resolver must only be used from its loop's thread, and must outlive
+// the lookups awaiting it.
+class dns_resolver {
+public:
+  explicit dns_resolver(event_loop &loop, dns_resolver_options options = {})
+      : loop_(loop), options_(std::move(options)) {
+    if (!options_.hosts.empty()) {
+      load_hosts(detail::read_file(options_.hosts));
+    }
+
+    if (options_.nameservers.empty()) {
+      if (!options_.resolv_conf.empty()) {
+        load_resolv_conf(detail::read_file(options_.resolv_conf));
+      }
+    } else {
+      for (const std::string &text : options_.nameservers) {
+        if (auto address = detail::parse_nameserver(text)) {
+          nameservers_.push_back(*address);
+        }
+      }
+    }
+  }
+
+  // No copy or move (the loop and pending lookups point at the resolver)
+  dns_resolver(const dns_resolver &) = delete;
+  dns_resolver &operator=(const dns_resolver &) = delete;
+
+  // Destructor
+  ~dns_resolver() {
+    for (auto &[id, name] : inflight_) {
+      pending_query &q = cache_.at(name).query;
+      loop_.cancel_timer(q.timer);
+
+      // Lookups still waiting finish with an error on the next iteration
+      for (dns_lookup *lookup : q.waiters) {
+        lookup->complete(std::unexpected(
+            std::make_error_code(std::errc::operation_canceled)));
+        loop_.post([handle = lookup->waiter_] { handle.resume(); });
+      }
+      close_sockets(q);
+    }
+  }
+
+  // Look up the IPv4 addresses of `name`. Numeric addresses, hosts file
+  // entries and fresh cache entries complete without suspending.
+  dns_lookup resolve(std::string_view name) {
+    if (auto ip = ipv4_address::from_str(name)) {
+      dns_lookup lookup(this, {});
+      lookup.complete(std::vector{*ip});
+      return lookup;
+    }
+
+    auto normalized = detail::normalize_dns_name(name);
+    if (!normalized) {
+      dns_lookup lookup(this, {});
+      lookup.complete(std::unexpected(make_error_code(dns_error::bad_name)));
+      return lookup;
+    }
+
+    dns_lookup lookup(this, std::move(*normalized));
+    if (auto it = hosts_.find(lookup.name_); it != hosts_.end()) {
+      lookup.complete(it->second);
+      return lookup;
+    }
+
+    auto it = cache_.find(lookup.name_);
+    if (it == cache_.end() || !it->second.answered) {
+      return lookup; // Not known yet
+    }
+
+    entry &e = it->second;
+    auto now = event_loop::clock::now();
+    if (now < e.expires) {
+      lookup.complete(e.result);
+    } else if (e.result && now < e.expires + options_.max_stale) {
+      lookup.complete(e.result);
+      if (!e.query.active) {
+        start(it->first, e); // Refresh in the background
+      }
+    }
+    return lookup;
+  }
+
+  // Nameservers queries are sent to, in order
+  const std::vector<sockaddr_in> &nameservers() const noexcept {
+    return nameservers_;
+  }
+
+  // Names with a cached answer or a query in flight
+  std::size_t cache_size() const noexcept { return cache_.size(); }
+
+  // Forget every cached answer (queries in flight still complete)
+  void clear_cache() {
+    std::erase_if(cache_, [](const auto &item) {
+      return !item.second.query.active;
+    });
+    for (auto &[name, e] : cache_) {
+      e.answered = false;
+    }
+  }
+
+private:
+  friend class dns_lookup;
+
+  struct pending_query {
+    bool active = false;
+    std::uint16_t id = 0;
+    int attempt = 0;
+    event_loop::timer_id timer = 0;
+    std::vector<dns_lookup *> waiters;
+    int fd = -1;     // UDP socket of this query alone
+    int tcp_fd = -1; // After a truncated answer
+    // The length-prefixed query going out over TCP, then the answer coming
+    // in, and how much of either has been done
+    std::vector<std::uint8_t> tcp_buffer;
+    std::size_t tcp_sent = 0;
+    bool tcp_reading = false;
+  };
+
+  struct entry {
+    bool answered = false;
+    dns_lookup::result_type result;
+    event_loop::clock::time_point expires;
+    pending_query query;
+  };
+
+  void load_hosts(std::string_view text) {
+    while (!text.empty()) {
+      std::size_t end = std::min(text.find('\n'), text.size());
+      auto fields = detail::config_fields(text.substr(0, end));
+      text.remove_prefix(std::min(end + 1, text.size()));
+
+      std::optional<ipv4_address> ip;
+      if (fields.size() < 2 || !(ip = ipv4_address::from_str(fields[0]))) {
+        continue; // IPv6 entries are skipped
+      }
+      for (std::size_t i = 1; i < fields.size(); ++i) {
+        if (auto name = detail::normalize_dns_name(fields[i])) {
+          hosts_[std::move(*name)].push_back(*ip);
+        }
+      }
+    }
+  }
+
+  void load_resolv_conf(std::string_view text) {
+    while (!text.empty()) {
+      std::size_t end = std::min(text.find('\n'), text.size());
+      auto fields = detail::config_fields(text.substr(0, end));
+      text.remove_prefix(std::min(end + 1, text.size()));
+
+      if (fields.size() >= 2 && fields[0] == "nameserver") {
+        if (auto address = detail::parse_nameserver(fields[1])) {
+          nameservers_.push_back(*address);
+        }
+      } else if (!fields.empty() && fields[0] == "options") {
+        for (std::size_t i = 1; i < fields.size(); ++i) {
+          int value = 0;
+          auto option = fields[i];
+          std::size_t colon = option.find(':');
+          if (colon == std::string_view::npos ||
+              std::from_chars(option.data() + colon + 1,
+                              option.data() + option.size(), value)
+                      .ec != std::errc{} ||
+              value <= 0) {
+            continue;
+          }
+          if (option.substr(0, colon) == "timeout") {
+            options_.timeout = std::chrono::seconds(value);
+          } else if (option.substr(0, colon) == "attempts") {
+            options_.attempts = value;
+          }
+        }
+      }
+    }
+  }
+
+  // Park `lookup` until the query for its name completes; false if it
+  // completed without waiting
+  bool wait(dns_lookup &lookup) {
+    auto it = cache_.find(lookup.name_);
+    if (it == cache_.end()) {
+      make_room();
+      it = cache_.try_emplace(lookup.name_).first;
+    }
+    entry &e = it->second;
+    if (!e.query.active) {
+      if (auto error = start(it->first, e)) {
+        lookup.complete(std::unexpected(error));
+        if (!e.answered) {
+          cache_.erase(it);
+        }
+        return false;
+      }
+    }
+    e.query.waiters.push_back(&lookup);
+    return true;
+  }
+
+  // Send the first query for `name`
+  std::error_code start(const std::string &name, entry &e) {
+    if (nameservers_.empty()) {
+      return make_error_code(dns_error::no_nameservers);
+    }
+
+    std::uint16_t id;
+    do {
+      id = random_id();
+    } while (inflight_.contains(id));
+
+    e.query.id = id;
+    if (auto error = open(e.query)) {
+      return error;
+    }
+    inflight_.emplace(id, name);
+    e.query.active = true;
+    e.query.attempt = 0;
+    send(name, e.query);
+    return {};
+  }
+
+  // (Re)send the current attempt over UDP and arm its timeout
+  void send(const std::string &name, pending_query &q) {
+    close_tcp(q);
+    std::array<std::uint8_t, detail::dns_max_udp_size> packet;
+    std::size_t size = detail::encode_dns_query(q.id, name, packet);
+
+    // A failed send is handled like a lost packet, by the timeout
+    ::sendto(q.fd, packet.data(), size, MSG_NOSIGNAL,
+             reinterpret_cast<const sockaddr *>(&server(q)),
+             sizeof(sockaddr_in));
+
+    q.timer = loop_.add_timer(options_.timeout,
+                              [this, id = q.id] { on_timeout(id); });
+  }
+
+  // Ask the server again over TCP, under a fresh timeout
+  void send_tcp(const std::string &name, pending_query &q) {
+    loop_.cancel_timer(q.timer);
+    q.timer = loop_.add_timer(options_.timeout,
+                              [this, id = q.id] { on_timeout(id); });
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      return; // Left to the timeout
+    }
+    if ((::connect(fd, reinterpret_cast<const sockaddr *>(&server(q)),
+                   sizeof(sockaddr_in)) < 0 &&
+         errno != EINPROGRESS) ||
+        !loop_.add(fd, io_event::readable | io_event::writable,
+                   [this, id = q.id](io_event) { receive_tcp(id); })) {
+      ::close(fd);
+      return;
+    }
+
+    q.tcp_fd = fd;
+    q.tcp_buffer.assign(2 + detail::dns_max_udp_size, 0);
+    std::size_t size = detail::encode_dns_query(
+        q.id, name, std::span(q.tcp_buffer).subspan(2));
+    q.tcp_buffer[0] = static_cast<std::uint8_t>(size >> 8);
+    q.tcp_buffer[1] = static_cast<std::uint8_t>(size);
+    q.tcp_buffer.resize(2 + size);
+    q.tcp_sent = 0;
+    q.tcp_reading = false;
+  }
+
+  // The nameserver of the current attempt
+  const sockaddr_in &server(const pending_query &q) const noexcept {
+    return nameservers_[static_cast<std::size_t>(q.attempt) %
+                        nameservers_.size()];
+  }
+
+  // Give the query its own UDP socket; its first send binds it to a port
+  // the kernel picks at random
+  std::error_code open(pending_query &q) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      return {errno, std::system_category()};
+    }
+    if (!loop_.add(fd, io_event::readable,
+                   [this, id = q.id](io_event) { receive(id); })) {
+      ::close(fd);
+      return std::make_error_code(std::errc::bad_file_descriptor);
+    }
+    q.fd = fd;
+    return {};
+  }
+
+  void close_tcp(pending_query &q) {
+    if (q.tcp_fd >= 0) {
+      loop_.remove(q.tcp_fd);
+      ::close(q.tcp_fd);
+      q.tcp_fd = -1;
+    }
+    q.tcp_buffer = {};
+  }
+
+  void close_sockets(pending_query &q) {
+    close_tcp(q);
+    if (q.fd >= 0) {
+      loop_.remove(q.fd);
+      ::close(q.fd);
+      q.fd = -1;
+    }
+  }
+
+  // Query ids from getrandom(2), fetched a batch at a time
+  std::uint16_t random_id() {
+    if (ids_used_ == ids_.size()) {
+      if (::getrandom(ids_.data(), sizeof(ids_), 0) !=
+          static_cast<ssize_t>(sizeof(ids_))) {
+        std::random_device device;
+        for (std::uint16_t &id : ids_) {
+          id = static_cast<std::uint16_t>(device());
+        }
+      }
+      ids_used_ = 0;
+    }
+    return ids_[ids_used_++];
+  }
+
+  bool from_nameserver(const sockaddr_in &source) const noexcept {
+    return std::ranges::any_of(nameservers_, [&](const sockaddr_in &server) {
+      return server.sin_addr.s_addr == source.sin_addr.s_addr &&
+             server.sin_port == source.sin_port;
+    });
+  }
+
+  // Drain the socket of query `id` (edge-triggered) until it is answered
+  void receive(std::uint16_t id) {
+    std::array<std::uint8_t, 4096> packet;
+    for (;;) {
+      auto inflight = inflight_.find(id);
+      if (inflight == inflight_.end()) {
+        return;
+      }
+      pending_query &q = cache_.at(inflight->second).query;
+      if (q.tcp_fd >= 0) {
+        return; // Already asking over TCP
+      }
+
+      sockaddr_in source = {};
+      socklen_t length = sizeof(source);
+      ssize_t size = ::recvfrom(q.fd, packet.data(), packet.size(), 0,
+                                reinterpret_cast<sockaddr *>(&source), &length);
+      if (size < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return; // EAGAIN, or an ICMP error the timeout takes care of
+      }
+      std::span<const std::uint8_t> data(packet.data(),
+                                         static_cast<std::size_t>(size));
+      if (data.size() < detail::dns_header_size || !from_nameserver(source) ||
+          detail::read_u16(data, 0) != id) {
+        continue;
+      }
+
+      std::uint16_t flags = detail::read_u16(data, 2);
+      if ((flags & detail::dns_flag_response) &&
+          (flags & detail::dns_flag_truncated)) {
+        send_tcp(inflight->second, q);
+        return;
+      }
+      if (answer(inflight, data)) {
+        return;
+      }
+    }
+  }
+
+  // Write the query, then read the answer over the query's TCP connection
+  void receive_tcp(std::uint16_t id) {
+    auto inflight = inflight_.find(id);
+    if (inflight == inflight_.end()) {
+      return;
+    }
+    pending_query &q = cache_.at(inflight->second).query;
+
+    // A connection that fails is left to the timeout, like a lost packet
+    while (!q.tcp_reading) {
+      ssize_t n = ::send(q.tcp_fd, q.tcp_buffer.data() + q.tcp_sent,
+                         q.tcp_buffer.size() - q.tcp_sent, MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          close_tcp(q);
+        }
+        return;
+      }
+      q.tcp_sent += static_cast<std::size_t>(n);
+      if (q.tcp_sent == q.tcp_buffer.size()) {
+        q.tcp_buffer.clear(); // Now the answer
+        q.tcp_reading = true;
+      }
+    }
+
+    std::array<std::uint8_t, 4096> chunk;
+    for (;;) {
+      ssize_t n = ::recv(q.tcp_fd, chunk.data(), chunk.size(), 0);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          close_tcp(q);
+        }
+        return;
+      }
+      if (n == 0) {
+        close_tcp(q); // Closed before the whole answer came
+        return;
+      }
+      q.tcp_buffer.insert(q.tcp_buffer.end(), chunk.begin(),
+                          chunk.begin() + n);
+
+      std::span<const std::uint8_t> data(q.tcp_buffer);
+      if (data.size() >= 2 &&
+          data.size() >= 2 + std::size_t{detail::read_u16(data, 0)}) {
+        if (!answer(inflight, data.subspan(2, detail::read_u16(data, 0)))) {
+          close_tcp(q);
+        }
+        return;
+      }
+    }
+  }
+
+  // Complete the query in `inflight` with the answer in `data`; false if
+  // `data` is no answer to it
+  bool answer(std::unordered_map<std::uint16_t, std::string>::iterator inflight,
+              std::span<const std::uint8_t> data) {
+    auto answer = detail::parse_dns_response(data, inflight->first,
+                                             inflight->second);
+    if (!answer &&
+        answer.error() == make_error_code(dns_error::bad_response)) {
+      return false; // Not our answer; keep waiting for the real one
+    }
+
+    std::string name = std::move(inflight->second);
+    inflight_.erase(inflight);
+    entry &e = cache_.at(name);
+    loop_.cancel_timer(e.query.timer);
+    close_sockets(e.query);
+
+    auto now = event_loop::clock::now();
+    e.answered = true;
+    if (answer) {
+      auto ttl = std::clamp(std::chrono::seconds(answer->ttl),
+                            options_.min_ttl, options_.max_ttl);
+      e.result = std::move(answer->addresses);
+      e.expires = now + ttl;
+    } else {
+      e.result = std::unexpected(answer.error());
+      e.expires = now + options_.negative_ttl;
+    }
+    finish(take_waiters(e), e.result);
+    return true;
+  }
+
+  void on_timeout(std::uint16_t id) {
+    auto inflight = inflight_.find(id);
+    if (inflight == inflight_.end()) {
+      return;
+    }
+
+    entry &e = cache_.at(inflight->second);
+    int attempts = std::max(options_.attempts, 1) *
+                   static_cast<int>(nameservers_.size());
+    if (++e.query.attempt < attempts) {
+      send(inflight->second, e.query);
+      return;
+    }
+
+    // Out of attempts. A stale answer stays usable until max_stale runs out.
+    close_sockets(e.query);
+    auto waiters = take_waiters(e);
+    if (!e.answered) {
+      cache_.erase(inflight->second);
+    }
+    inflight_.erase(inflight);
+    finish(std::move(waiters),
+           std::unexpected(make_error_code(dns_error::timeout)));
+  }
+
+  // End the query of `e`, returning the lookups that waited for it
+  static std::vector<dns_lookup *> take_waiters(entry &e) {
+    e.query.active = false;
+    return std::exchange(e.query.waiters, {});
+  }
+
+  // Complete and resume `waiters`. They are resumed last, since they may
+  // start new lookups that change the cache.
+  static void finish(std::vector<dns_lookup *> waiters,
+                     const dns_lookup::result_type &result) {
+    for (dns_lookup *lookup : waiters) {
+      lookup->complete(result);
+    }
+    for (dns_lookup *lookup : waiters) {
+      lookup->waiter_.resume();
+    }
+  }
+
+  // Leave room for one more entry within max_entries, dropping answers
+  // past their stale window first. Called before inserting, so nothing
+  // the caller holds can be erased.
+  void make_room() {
+    if (cache_.size() < options_.max_entries) {
+      return;
+    }
+
+    auto now = event_loop::clock::now();
+    std::erase_if(cache_, [&](const auto &item) {
+      const entry &e = item.second;
+      return !e.query.active && e.expires + options_.max_stale <= now;
+    });
+
+    for (auto it = cache_.begin();
+         cache_.size() >= options_.max_entries && it != cache_.end();) {
+      if (it->second.query.active) {
+        ++it;
+      } else {
+        it = cache_.erase(it);
+      }
+    }
+  }
+
+  event_loop &loop_;
+  dns_resolver_options options_;
+  std::vector<sockaddr_in> nameservers_;
+  std::unordered_map<std::string, std::vector<ipv4_address>> hosts_;
+  std::unordered_map<std::string, entry> cache_;
+  std::unordered_map<std::uint16_t, std::string> inflight_; // By query id
+  std::array<std::uint16_t, 32> ids_{};
+  std::size_t ids_used_ = ids_.size();
+};
+
+inline bool dns_lookup::await_suspend(std::coroutine_handle<> handle) {
+  waiter_ = handle;
+  return resolver_->wait(*this);
+}
+
+} // namespace net
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <variant>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "ipv4_address.hpp"
+#include "ipv6_address.hpp"
+
+namespace net {
+
+namespace detail {
+
+// Split "host:port" or "[v6]:port" into host and port text. The host keeps
+// no brackets; an unbracketed host with more than one ':' is rejected as
+// ambiguous.
+inline std::optional<std::pair<std::string_view, std::string_view>>
+split_host_port(std::string_view address) noexcept {
+  if (!address.empty() && address.front() == '[') {
+    std::size_t close = address.find(']');
+    if (close == std::string_view::npos || close + 1 >= address.size() ||
+        address[close + 1] != ':') {
+      return std::nullopt;
+    }
+    return std::pair{address.substr(1, close - 1), address.substr(close + 2)};
+  }
+
+  std::size_t colon = address.find(':');
+  if (colon == std::string_view::npos ||
+      address.find(':', colon + 1) != std::string_view::npos) {
+    return std::nullopt;
+  }
+  return std::pair{address.substr(0, colon), address.substr(colon + 1)};
+}
+
+inline std::optional<std::uint16_t> parse_port(std::string_view text) noexcept {
+  std::uint16_t port = 0;
+  const char *end = text.data() + text.size();
+  auto [ptr, ec] = std::from_chars(text.data(), end, port);
+  if (ec != std::errc{} || ptr != end || text.size() > 5) {
+    return std::nullopt;
+  }
+  return port;
+}
+
+} // namespace detail
+
+// An IPv4 or IPv6 address with a port. Converts to and from the sockaddr
+// structures the socket calls take without going through getaddrinfo or
+// getnameinfo, and without allocating.
+class endpoint {
+public:
+  // Longest text ("[ffff:...:ffff]:65535")
+  static constexpr std::size_t max_string_size =
+      ipv6_address::max_string_size + 8;
+
+  // 0.0.0.0:0
+  constexpr endpoint() = default;
+
+  constexpr endpoint(ipv4_address address, std::uint16_t port)
+      : _address(address), _port(port) {}
+
+  constexpr endpoint(ipv6_address address, std::uint16_t port)
+      : _address(address), _port(port) {}
+
+  constexpr bool operator==(const endpoint &) const = default;
+
+  constexpr bool is_v4() const noexcept { return _address.index() == 0; }
+  constexpr bool is_v6() const noexcept { return _address.index() == 1; }
+
+  // AF_INET or AF_INET6
+  constexpr int family() const noexcept { return is_v4() ? AF_INET : AF_INET6; }
+
+  constexpr std::optional<ipv4_address> v4() const noexcept {
+    if (auto address = std::get_if<ipv4_address>(&_address)) {
+      return *address;
+    }
+    return std::nullopt;
+  }
+
+  constexpr std::optional<ipv6_address> v6() const noexcept {
+    if (auto address = std::get_if<ipv6_address>(&_address)) {
+      return *address;
+    }
+    return std::nullopt;
+  }
+
+  constexpr std::uint16_t port() const noexcept { return _port; }
+
+  constexpr void set_port(std::uint16_t port) noexcept { _port = port; }
+
+  // Fill `storage` and return the length to pass to bind()/connect()
+  socklen_t to_sockaddr(sockaddr_storage &storage) const noexcept {
+    std::memset(&storage, 0, sizeof(storage));
+    if (auto address = std::get_if<ipv4_address>(&_address)) {
+      auto &in = reinterpret_cast<sockaddr_in &>(storage);
+      in.sin_family = AF_INET;
+      in.sin_port = htons(_port);
+      in.sin_addr.s_addr = htonl(address->to_uint32());
+      return sizeof(sockaddr_in);
+    }
+
+    auto &in6 = reinterpret_cast<sockaddr_in6 &>(storage);
+    in6.sin6_family = AF_INET6;
+    in6.sin6_port = htons(_port);
+    std::memcpy(&in6.sin6_addr, std::get<ipv6_address>(_address).bytes().data(),
+                16);
+    return sizeof(sockaddr_in6);
+  }
+
+  // From a sockaddr_in or sockaddr_in6 (e.g. filled by getsockname() or
+  // accept()); nullopt for other families or a short length
+  static std::optional<endpoint> from_sockaddr(const sockaddr *address,
+                                               socklen_t length) noexcept {
+    if (address == nullptr) {
+      return std::nullopt;
+    }
+    if (address->sa_family == AF_INET && length >= sizeof(sockaddr_in)) {
+      sockaddr_in in;
+      std::memcpy(&in, address, sizeof(in));
+      return endpoint(ipv4_address::from_uint32(ntohl(in.sin_addr.s_addr)),
+                      ntohs(in.sin_port));
+    }
+    if (address->sa_family == AF_INET6 && length >= sizeof(sockaddr_in6)) {
+      sockaddr_in6 in6;
+      std::memcpy(&in6, address, sizeof(in6));
+      std::array<std::uint8_t, 16> bytes;
+      std::memcpy(bytes.data(), &in6.sin6_addr, 16);
+      return endpoint(ipv6_address(bytes), ntohs(in6.sin6_port));
+    }
+    return std::nullopt;
+  }
+
+  std::string to_string() const {
+    char buffer[max_string_size];
+    return std::string(buffer, to_chars(buffer, buffer + sizeof(buffer)).ptr);
+  }
+
+  // "a.b.c.d:port" or "[v6]:port"
+  std::to_chars_result to_chars(char *first, char *last) const noexcept {
+    char buffer[max_string_size];
+    char *p = buffer;
+    char *end = buffer + sizeof(buffer);
+    if (auto address = std::get_if<ipv4_address>(&_address)) {
+      p = address->to_chars(p, end).ptr;
+    } else {
+      *p++ = '[';
+      p = std::get<ipv6_address>(_address).to_chars(p, end).ptr;
+      *p++ = ']';
+    }
+    *p++ = ':';
+    p = std::to_chars(p, end, _port).ptr;
+
+    if (last - first < p - buffer) {
+      return {last, std::errc::value_too_large};
+    }
+    return {std::copy(buffer, p, first), std::errc{}};
+  }
+
+  // Parse a numeric "a.b.c.d:port" or "[v6]:port"; host names are not
+  // resolved
+  static std::optional<endpoint> from_str(std::string_view text) {
+    auto parts = detail::split_host_port(text);
+    if (!parts) {
+      return std::nullopt;
+    }
+    auto port = detail::parse_port(parts->second);
+    if (!port) {
+      return std::nullopt;
+    }
+
+    bool bracketed = text.front() == '[';
+    if (!bracketed) {
+      if (auto address = ipv4_address::from_str(parts->first)) {
+        return endpoint(*address, *port);
+      }
+    } else if (auto address = ipv6_address::from_str(parts->first)) {
+      return endpoint(*address, *port);
+    }
+    return std::nullopt;
+  }
+
+private:
+  std::variant<ipv4_address, ipv6_address> _address;
+  std::uint16_t _port = 0;
+};
+
+} // namespace net
+
+template <> struct std::formatter<net::endpoint> {
+  constexpr auto parse(std::format_parse_context &ctx) { return ctx.begin(); }
+
+  auto format(const net::endpoint &ep, std::format_context &ctx) const {
+    char buffer[net::endpoint::max_string_size];
+    auto result = ep.to_chars(buffer, buffer + sizeof(buffer));
+    return std::copy(buffer, result.ptr, ctx.out());
+  }
+};
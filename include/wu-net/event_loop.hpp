@@ -0,0 +1,869 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "io_operation.hpp"
+#include "mpsc_queue.hpp"
+#include "task.hpp"
+#include "timer_wheel.hpp"
+
+#ifdef WU_NET_IO_URING
+#include "io_uring.hpp"
+#endif
+
+namespace net {
+
+class event_loop;
+
+namespace detail {
+class post_op;
+
+// Which loop each descriptor is registered with, for closing a socket
+// outside its loop's callbacks. Descriptor numbers are process-wide, so
+// one table serves every loop; it grows in fixed chunks that are never
+// freed or moved, which lets any thread read it without a lock.
+class fd_owner_table {
+public:
+  fd_owner_table() = default;
+  fd_owner_table(const fd_owner_table &) = delete;
+  fd_owner_table &operator=(const fd_owner_table &) = delete;
+
+  ~fd_owner_table() {
+    for (auto &chunk : chunks_) {
+      delete[] chunk.load(std::memory_order_relaxed);
+    }
+  }
+
+  event_loop *get(int fd) const noexcept {
+    std::atomic<event_loop *> *slot = find(fd);
+    return slot ? slot->load(std::memory_order_acquire) : nullptr;
+  }
+
+  // Descriptors past the table's range go untracked
+  void set(int fd, event_loop *loop) {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= chunk_size * chunk_count) {
+      return;
+    }
+    auto &chunk = chunks_[static_cast<std::size_t>(fd) / chunk_size];
+    std::atomic<event_loop *> *slots = chunk.load(std::memory_order_acquire);
+    if (slots == nullptr) {
+      auto *fresh = new std::atomic<event_loop *>[chunk_size]();
+      if (chunk.compare_exchange_strong(slots, fresh,
+                                        std::memory_order_acq_rel)) {
+        slots = fresh;
+      } else {
+        delete[] fresh; // Another thread got there first
+      }
+    }
+    slots[static_cast<std::size_t>(fd) % chunk_size].store(
+        loop, std::memory_order_release);
+  }
+
+  // Forget `fd` if `loop` is still its owner
+  void clear(int fd, event_loop *loop) noexcept {
+    if (std::atomic<event_loop *> *slot = find(fd)) {
+      slot->compare_exchange_strong(loop, nullptr, std::memory_order_acq_rel);
+    }
+  }
+
+private:
+  static constexpr std::size_t chunk_size = 4096;
+  static constexpr std::size_t chunk_count = 1024;
+
+  std::atomic<event_loop *> *find(int fd) const noexcept {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= chunk_size * chunk_count) {
+      return nullptr;
+    }
+    std::atomic<event_loop *> *slots =
+        chunks_[static_cast<std::size_t>(fd) / chunk_size].load(
+            std::memory_order_acquire);
+    return slots ? &slots[static_cast<std::size_t>(fd) % chunk_size]
+                 : nullptr;
+  }
+
+  std::array<std::atomic<std::atomic<event_loop *> *>, chunk_count> chunks_{};
+};
+
+inline fd_owner_table &fd_owners() noexcept {
+  static fd_owner_table table;
+  return table;
+}
+} // namespace detail
+
+// Anything that exposes its file descriptor (tcp_stream, tcp_listener, ...)
+template <typename T>
+concept native_handle_source = requires(const T &t) {
+  { t.native_handle() } -> std::convertible_to<int>;
+};
+
+// Single-threaded reactor backed by edge-triggered epoll.
+//
+// File descriptors are registered together with a callback that receives the
+// readiness flags. Because notifications are edge-triggered, a callback must
+// drain the descriptor (read/accept/write until EAGAIN) before returning,
+// otherwise it will not be notified again until new data arrives. Sockets
+// registered with the loop should be put in non-blocking mode.
+//
+// Coroutines can instead park an io_operation on a descriptor with wait();
+// the loop then registers the descriptor for both directions on first use.
+//
+// Timers run a function once after a delay. They live in a hierarchical
+// timer_wheel with millisecond ticks, so arming, canceling and pushing back
+// a deadline are O(1) however many connections hold timeouts, and they
+// fire after the I/O dispatched in the same iteration.
+//
+// A loop is driven by one thread, but post() and spawn() may be called from
+// any thread: work from other threads goes through a lock-free queue and
+// an eventfd wakes the loop, once however many posts arrive before it gets
+// to them. Handing a socket to another thread's loop is a post() of a
+// function that owns it.
+//
+// When built with WU_NET_IO_URING, enable_io_uring() switches the loop to an
+// io_uring backend: coroutine socket operations become io_uring submissions
+// and the loop blocks in io_uring_enter instead of epoll_wait.
+class event_loop {
+public:
+  using handler = std::move_only_function<void(io_event)>;
+  using clock = std::chrono::steady_clock;
+  using timer_id = timer_wheel::timer_id;
+
+  // Default constructor (closed loop, see create())
+  event_loop() : epoll_fd_(-1) {}
+
+  // No copy
+  event_loop(const event_loop &) = delete;
+  event_loop &operator=(const event_loop &) = delete;
+
+  // Move (only while the loop is not running)
+  event_loop(event_loop &&other) noexcept
+      : epoll_fd_(std::exchange(other.epoll_fd_, -1)),
+        stopped_(other.stopped_), active_(std::exchange(other.active_, 0)),
+        registrations_(std::move(other.registrations_)),
+        retired_(std::move(other.retired_)),
+        events_(std::move(other.events_)), posted_(std::move(other.posted_)),
+        mailbox_(std::move(other.mailbox_)), timers_(std::move(other.timers_))
+#ifdef WU_NET_IO_URING
+        ,
+        uring_(std::move(other.uring_))
+#endif
+  {
+    adopt_registrations();
+  }
+
+  event_loop &operator=(event_loop &&other) noexcept {
+    if (this != &other) {
+      close();
+      epoll_fd_ = std::exchange(other.epoll_fd_, -1);
+      stopped_ = other.stopped_;
+      active_ = std::exchange(other.active_, 0);
+      registrations_ = std::move(other.registrations_);
+      retired_ = std::move(other.retired_);
+      events_ = std::move(other.events_);
+      posted_ = std::move(other.posted_);
+      mailbox_ = std::move(other.mailbox_);
+      timers_ = std::move(other.timers_);
+#ifdef WU_NET_IO_URING
+      uring_ = std::move(other.uring_);
+#endif
+      adopt_registrations();
+    }
+    return *this;
+  }
+
+  // Destructor
+  ~event_loop() { close(); }
+
+  // Check if the loop owns an epoll instance
+  bool is_open() const noexcept { return epoll_fd_ >= 0; }
+
+  // Close the epoll instance and drop all registrations
+  void close() {
+#ifdef WU_NET_IO_URING
+    uring_.reset();
+#endif
+    if (is_open()) {
+      ::close(epoll_fd_);
+      epoll_fd_ = -1;
+    }
+    for (const auto &reg : registrations_) {
+      if (reg) {
+        detail::fd_owners().clear(reg->fd, this);
+      }
+    }
+    registrations_.clear();
+    retired_.clear();
+    posted_.clear();
+    mailbox_.reset();
+    timers_.clear();
+    active_ = 0;
+  }
+
+  // Get the epoll file descriptor
+  int native_handle() const noexcept { return epoll_fd_; }
+
+  // Number of registered file descriptors
+  std::size_t size() const noexcept { return active_; }
+
+  // Register a file descriptor; `interest` is combined with EPOLLET
+  bool add(int fd, io_event interest, handler on_event) {
+    if (!is_open() || fd < 0) {
+      return false;
+    }
+
+    if (static_cast<std::size_t>(fd) >= registrations_.size()) {
+      registrations_.resize(static_cast<std::size_t>(fd) + 1);
+    }
+
+    if (registrations_[fd]) {
+      return false; // Already registered
+    }
+
+    auto reg = std::make_unique<registration>();
+    reg->fd = fd;
+    reg->interest = interest;
+    reg->on_event = std::move(on_event);
+
+    struct epoll_event ev = {};
+    ev.events = static_cast<std::uint32_t>(interest) | EPOLLET;
+    ev.data.ptr = reg.get();
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      return false;
+    }
+
+    registrations_[fd] = std::move(reg);
+    ++active_;
+    detail::fd_owners().set(fd, this);
+    return true;
+  }
+
+  template <native_handle_source Socket>
+  bool add(const Socket &socket, io_event interest, handler on_event) {
+    return add(socket.native_handle(), interest, std::move(on_event));
+  }
+
+  // Change the readiness flags a registered descriptor is interested in
+  bool modify(int fd, io_event interest) {
+    registration *reg = find(fd);
+    if (reg == nullptr) {
+      return false;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = static_cast<std::uint32_t>(interest) | EPOLLET;
+    ev.data.ptr = reg;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
+      return false;
+    }
+
+    reg->interest = interest;
+    return true;
+  }
+
+  template <native_handle_source Socket>
+  bool modify(const Socket &socket, io_event interest) {
+    return modify(socket.native_handle(), interest);
+  }
+
+  // Unregister a descriptor. Safe to call from inside its own callback; the
+  // callback object is kept alive until the current dispatch round finishes.
+  bool remove(int fd) {
+#ifdef WU_NET_IO_URING
+    if (uring_) {
+      uring_->cancel(fd);
+    }
+#endif
+
+    registration *reg = find(fd);
+    if (reg == nullptr) {
+      return false;
+    }
+
+    // The descriptor may already be closed, in which case the kernel has
+    // dropped it from the interest list on its own
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    detail::fd_owners().clear(fd, this);
+
+    reg->fd = -1;
+    cancel(reg->reader);
+    cancel(reg->writer);
+    retired_.push_back(std::move(registrations_[fd]));
+    --active_;
+    return true;
+  }
+
+  template <native_handle_source Socket> bool remove(const Socket &socket) {
+    return remove(socket.native_handle());
+  }
+
+  // The loop `fd` is registered with, if any
+  static event_loop *owner(int fd) noexcept {
+    return detail::fd_owners().get(fd);
+  }
+
+  // Unregister `fd` from the loop it was registered with, and cancel what
+  // is parked on it, before the descriptor is closed. Unlike remove() on
+  // current(), this also works outside that loop's callbacks, e.g. for a
+  // socket closed after run() returned; it must still be called on the
+  // loop's thread. Without a registration, the current loop is asked
+  // instead, to cancel its io_uring operations on `fd`.
+  static void detach(int fd) {
+    event_loop *loop = owner(fd);
+    if (loop == nullptr) {
+      loop = current_;
+    }
+    if (loop != nullptr) {
+      loop->remove(fd);
+    }
+  }
+
+  // Park an operation until op.fd is ready in `direction` (readable or
+  // writable). Only one operation per direction may wait on a descriptor.
+  bool wait(io_operation &op, io_event direction) {
+    registration *reg = find(op.fd);
+    if (reg == nullptr) {
+      if (!add(op.fd,
+               io_event::readable | io_event::writable | io_event::hangup,
+               nullptr)) {
+        return false;
+      }
+      reg = find(op.fd);
+    } else if (!has_event(reg->interest, direction) &&
+               !modify(op.fd, reg->interest | direction)) {
+      return false;
+    }
+
+    io_operation *&slot =
+        direction == io_event::writable ? reg->writer : reg->reader;
+    if (slot != nullptr) {
+      return false;
+    }
+
+    slot = &op;
+    return true;
+  }
+
+  // Start a task on this loop; it begins running on the next iteration.
+  // Thread-safe, and fails like post().
+  bool spawn(task<void> t) {
+    return post([t = std::move(t)]() mutable { net::spawn(std::move(t)); });
+  }
+
+  // Queue a function to run on the loop's next iteration. Thread-safe:
+  // from a thread other than the one running the loop, the function goes
+  // through the lock-free mailbox and wakes the loop if it is waiting.
+  // Off the loop's thread, a closed or moved-from loop has no mailbox;
+  // then `fn` is dropped and false returned.
+  bool post(std::move_only_function<void()> fn) {
+    if (current_ == this) {
+      posted_.push_back(std::move(fn));
+      return true;
+    }
+    if (!mailbox_) {
+      return false;
+    }
+
+    mailbox_->queue.push(std::move(fn));
+    wake();
+    return true;
+  }
+
+  // Continue the awaiting coroutine on this loop's thread, e.g. to come
+  // back from an executor
+  detail::post_op schedule() noexcept;
+
+  // Make a run_once() blocked on another thread return. Wakeups coalesce:
+  // until the loop drains its mailbox, further calls do not touch the
+  // eventfd.
+  void wake() noexcept {
+    if (mailbox_ &&
+        !mailbox_->notified.exchange(true, std::memory_order_acq_rel)) {
+      std::uint64_t one = 1;
+      [[maybe_unused]] auto n = ::write(mailbox_->fd, &one, sizeof(one));
+    }
+  }
+
+  // Run `fn` on the loop once `delay` has passed (rounded up to the next
+  // millisecond tick). Ids of fired or canceled timers are never valid
+  // again.
+  timer_id add_timer(clock::duration delay,
+                     std::move_only_function<void()> fn) {
+    return timers_.add(clock::now() + delay, std::move(fn));
+  }
+
+  // Cancel a timer that has not fired yet
+  bool cancel_timer(timer_id id) { return timers_.cancel(id); }
+
+  // Move a pending timer so it fires `delay` from now. Pushing a timeout
+  // back (on every read, say) is a single store.
+  bool reschedule_timer(timer_id id, clock::duration delay) {
+    return timers_.reschedule(id, clock::now() + delay);
+  }
+
+  // Number of pending timers
+  std::size_t timer_count() const noexcept { return timers_.size(); }
+
+  // Wait for events (up to timeout_ms, -1 for infinite) and dispatch them.
+  // Returns the number of callbacks run.
+  std::size_t run_once(int timeout_ms = -1) {
+    if (!is_open()) {
+      return 0;
+    }
+
+    scope_guard guard(this);
+
+    std::size_t dispatched = run_posted();
+    if (dispatched > 0 || stopped_) {
+      timeout_ms = 0;
+    }
+    timeout_ms = timer_timeout(timeout_ms);
+
+#ifdef WU_NET_IO_URING
+    if (uring_) {
+      // Submit, wait and resume completed operations in one io_uring_enter;
+      // epoll is only consulted when its descriptor reports events
+      dispatched += uring_->run_once(timeout_ms);
+      if (!uring_->take_watch_ready()) {
+        return dispatched + run_timers();
+      }
+      timeout_ms = 0;
+    }
+#endif
+
+    if (events_.empty()) {
+      events_.resize(default_max_events);
+    }
+
+    int count = epoll_wait(epoll_fd_, events_.data(),
+                           static_cast<int>(events_.size()), timeout_ms);
+    if (count < 0) {
+      return dispatched + run_timers(); // EINTR or a closed loop
+    }
+
+    bool woken = false;
+    for (int i = 0; i < count; ++i) {
+      auto *reg = static_cast<registration *>(events_[i].data.ptr);
+      if (reg == nullptr) {
+        woken = true; // The mailbox eventfd
+        continue;
+      }
+      if (reg->fd < 0) {
+        continue; // Removed earlier in this round
+      }
+      auto events = static_cast<io_event>(events_[i].events);
+      if (reg->on_event) {
+        reg->on_event(events);
+        ++dispatched;
+      }
+
+      constexpr io_event failed = io_event::hangup | io_event::error;
+      if (reg->fd >= 0 && reg->reader &&
+          has_event(events, io_event::readable | failed)) {
+        dispatched += resume(reg->reader);
+      }
+      if (reg->fd >= 0 && reg->writer &&
+          has_event(events, io_event::writable | failed)) {
+        dispatched += resume(reg->writer);
+      }
+    }
+
+    // Grow the event buffer if the kernel filled it completely
+    if (static_cast<std::size_t>(count) == events_.size()) {
+      events_.resize(events_.size() * 2);
+#ifdef WU_NET_IO_URING
+      if (uring_) {
+        uring_->set_watch_ready(); // Collect the rest next iteration
+      }
+#endif
+    }
+
+    retired_.clear();
+    if (woken && mailbox_) {
+      mailbox_->clear_eventfd();
+      dispatched += run_mailbox();
+    }
+    return dispatched + run_timers();
+  }
+
+  // Run until stop() is called or there is nothing left to wait for
+  void run() {
+    stopped_ = false;
+    while (!stopped_ && has_work()) {
+      run_once();
+    }
+  }
+
+  // Make run() return after the current iteration (same thread only; from
+  // another thread, post() a function that calls it)
+  void stop() noexcept { stopped_ = true; }
+
+  bool stopped() const noexcept { return stopped_; }
+
+  // The loop currently dispatching on this thread, if any
+  static event_loop *current() noexcept { return current_; }
+
+#ifdef WU_NET_IO_URING
+  // Switch coroutine socket operations to io_uring. Returns false (and keeps
+  // using epoll) if the kernel does not support the required features.
+  bool enable_io_uring(const io_uring_options &options = {}) {
+    if (!is_open()) {
+      return false;
+    }
+
+    uring_ = io_uring_backend::create(options);
+    if (!uring_) {
+      return false;
+    }
+
+    uring_->watch(epoll_fd_);
+    return true;
+  }
+
+  // The io_uring backend, or nullptr when running on plain epoll
+  io_uring_backend *uring() const noexcept { return uring_.get(); }
+#endif
+
+  // Static factory method
+  static std::optional<event_loop> create(std::size_t max_events = 256) {
+    event_loop loop;
+    loop.epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (!loop.is_open()) {
+      return std::nullopt;
+    }
+
+    loop.events_.resize(max_events > 0 ? max_events : default_max_events);
+
+    // The eventfd is registered without a registration; a null data.ptr
+    // marks its events
+    auto box = std::make_unique<mailbox>();
+    box->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = nullptr;
+    if (box->fd < 0 ||
+        epoll_ctl(loop.epoll_fd_, EPOLL_CTL_ADD, box->fd, &ev) < 0) {
+      return std::nullopt;
+    }
+    loop.mailbox_ = std::move(box);
+    return loop;
+  }
+
+private:
+  static constexpr std::size_t default_max_events = 256;
+
+  struct registration {
+    int fd = -1;
+    io_event interest = io_event::none;
+    handler on_event;
+    io_operation *reader = nullptr;
+    io_operation *writer = nullptr;
+  };
+
+  // Functions posted from other threads. On the heap because the queue
+  // must not move when the loop does; producers still find it through the
+  // loop, so a loop must not be moved while other threads post to it.
+  struct mailbox {
+    mpsc_queue<std::move_only_function<void()>> queue;
+    std::atomic<bool> notified{false}; // Set until the loop drains the queue
+    int fd = -1;                       // eventfd
+
+    mailbox() = default;
+    mailbox(const mailbox &) = delete;
+    mailbox &operator=(const mailbox &) = delete;
+
+    ~mailbox() {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+
+    void clear_eventfd() noexcept {
+      std::uint64_t count;
+      [[maybe_unused]] auto n = ::read(fd, &count, sizeof(count));
+    }
+  };
+
+  // Makes current() return this loop while it dispatches
+  struct scope_guard {
+    event_loop *previous;
+    explicit scope_guard(event_loop *loop)
+        : previous(std::exchange(current_, loop)) {}
+    ~scope_guard() { current_ = previous; }
+  };
+
+  bool has_work() const noexcept {
+#ifdef WU_NET_IO_URING
+    if (uring_ && uring_->pending() > 0) {
+      return true;
+    }
+#endif
+    return active_ > 0 || !posted_.empty() || !timers_.empty() ||
+           (mailbox_ && mailbox_->notified.load(std::memory_order_acquire));
+  }
+
+  registration *find(int fd) const noexcept {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= registrations_.size()) {
+      return nullptr;
+    }
+    return registrations_[fd].get();
+  }
+
+  // Retry a parked operation; resume its coroutine once it completes
+  static std::size_t resume(io_operation *&slot) {
+    io_operation *op = slot;
+    if (!op->perform()) {
+      return 0;
+    }
+
+    slot = nullptr;
+    op->waiter.resume();
+    return 1;
+  }
+
+  // Complete a parked operation whose descriptor is going away
+  void cancel(io_operation *&slot) {
+    if (slot == nullptr) {
+      return;
+    }
+
+    io_operation *op = std::exchange(slot, nullptr);
+    op->fd = -1;
+    post([op] {
+      op->perform();
+      op->waiter.resume();
+    });
+  }
+
+  // Shorten a poll timeout so it ends no later than the next timer tick
+  int timer_timeout(int timeout_ms) {
+    if (timeout_ms == 0) {
+      return timeout_ms;
+    }
+    auto deadline = timers_.next_deadline();
+    if (!deadline) {
+      return timeout_ms;
+    }
+
+    auto remaining = *deadline - clock::now();
+    if (remaining <= clock::duration{}) {
+      return 0;
+    }
+
+    // Round up, so the loop never wakes just before the deadline
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+    if (timeout_ms < 0 || ms < timeout_ms) {
+      return static_cast<int>(std::min<decltype(ms)>(ms, 1 << 30));
+    }
+    return timeout_ms;
+  }
+
+  // Run every timer that is due
+  std::size_t run_timers() {
+    if (timers_.empty()) {
+      return 0;
+    }
+    return timers_.advance(clock::now());
+  }
+
+  std::size_t run_posted() {
+    std::size_t count = run_mailbox();
+    if (posted_.empty()) {
+      return count;
+    }
+
+    // Functions posted while running are picked up next iteration
+    std::vector<std::move_only_function<void()>> batch;
+    batch.swap(posted_);
+    for (auto &fn : batch) {
+      fn();
+    }
+    return count + batch.size();
+  }
+
+  // Point the descriptors registered here at this loop, after a move
+  void adopt_registrations() {
+    for (const auto &reg : registrations_) {
+      if (reg) {
+        detail::fd_owners().set(reg->fd, this);
+      }
+    }
+  }
+
+  // Run what other threads posted
+  std::size_t run_mailbox() {
+    // Clearing the flag first means a post that lands after the queue
+    // looks empty will write the eventfd again
+    if (!mailbox_ ||
+        !mailbox_->notified.exchange(false, std::memory_order_acq_rel)) {
+      return 0;
+    }
+
+    // A function may close() the loop, taking the mailbox with it
+    std::size_t count = 0;
+    while (mailbox_) {
+      auto fn = mailbox_->queue.pop();
+      if (!fn) {
+        break;
+      }
+      (*fn)();
+      ++count;
+    }
+    return count;
+  }
+
+  int epoll_fd_;
+  bool stopped_ = false;
+  std::size_t active_ = 0;
+  std::vector<std::unique_ptr<registration>> registrations_; // Indexed by fd
+  std::vector<std::unique_ptr<registration>> retired_;
+  std::vector<struct epoll_event> events_;
+  std::vector<std::move_only_function<void()>> posted_;
+  std::unique_ptr<mailbox> mailbox_;
+  timer_wheel timers_;
+#ifdef WU_NET_IO_URING
+  std::unique_ptr<io_uring_backend> uring_;
+#endif
+
+  static inline thread_local event_loop *current_ = nullptr;
+};
+
+// Awaitable base for io_operations. The operation is attempted immediately;
+// if it would block, the coroutine is parked on the current thread's event
+// loop, or, when no loop is running on this thread, the thread blocks in
+// poll() until the descriptor is ready.
+template <typename Result, io_event Direction>
+class io_awaitable : public io_operation {
+public:
+  bool await_ready() noexcept {
+    if (done_) {
+      return true;
+    }
+
+#ifdef WU_NET_IO_URING
+    // Go straight to the ring instead of trying the syscall first
+    if (event_loop *loop = event_loop::current(); loop && loop->uring()) {
+      return false;
+    }
+#endif
+
+    return perform();
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle) noexcept {
+    waiter = handle;
+
+    if (event_loop *loop = event_loop::current()) {
+#ifdef WU_NET_IO_URING
+      if (loop->uring() != nullptr && submit(*loop->uring())) {
+        return !done_; // Already complete if it finished synchronously
+      }
+#endif
+      if (loop->wait(*this, Direction)) {
+        return true;
+      }
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = Direction == io_event::writable ? POLLOUT : POLLIN;
+    do {
+      pfd.revents = 0;
+      poll(&pfd, 1, -1);
+    } while (!perform());
+
+    return false;
+  }
+
+  Result await_resume() { return std::move(result_); }
+
+protected:
+  explicit io_awaitable(int socket_fd) noexcept { fd = socket_fd; }
+
+  // Complete without touching the descriptor
+  void complete(Result result) {
+    result_ = std::move(result);
+    done_ = true;
+  }
+
+  Result result_{};
+  bool done_ = false;
+};
+
+namespace detail {
+
+// Resumes its coroutine from a loop timer
+class sleep_op {
+public:
+  explicit sleep_op(event_loop::clock::duration delay) noexcept
+      : delay_(delay) {}
+
+  bool await_ready() const noexcept {
+    return delay_ <= event_loop::clock::duration{};
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    if (event_loop *loop = event_loop::current()) {
+      loop->add_timer(delay_, [handle] { handle.resume(); });
+      return true;
+    }
+    std::this_thread::sleep_for(delay_);
+    return false;
+  }
+
+  void await_resume() const noexcept {}
+
+private:
+  event_loop::clock::duration delay_;
+};
+
+// Resumes its coroutine from a posted function, or at once if the loop
+// has no mailbox to take it
+class post_op {
+public:
+  explicit post_op(event_loop &loop) noexcept : loop_(loop) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    return loop_.post([handle] { handle.resume(); });
+  }
+
+  void await_resume() const noexcept {}
+
+private:
+  event_loop &loop_;
+};
+
+} // namespace detail
+
+inline detail::post_op event_loop::schedule() noexcept {
+  return detail::post_op(*this);
+}
+
+// Suspend the calling coroutine for `delay` without blocking the current
+// thread's event loop; with no loop running, the thread sleeps instead
+inline detail::sleep_op sleep_for(event_loop::clock::duration delay) noexcept {
+  return detail::sleep_op(delay);
+}
+
+} // namespace net
@@ -0,0 +1,577 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "event_loop.hpp"
+#include "task.hpp"
+
+namespace net {
+
+class executor;
+
+namespace detail {
+
+// A unit of work on an executor. Jobs are intrusive so that moving a
+// coroutine onto the pool allocates nothing: the awaiter is the job.
+struct executor_job {
+  void (*execute)(executor_job *) = nullptr;
+  std::atomic<executor_job *> next{nullptr}; // In a job_inbox
+};
+
+// Spin-wait hint to the CPU
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// Chase-Lev work-stealing deque (with the memory orderings from Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models"). The owning
+// thread pushes and pops at the bottom like a stack, which keeps recently
+// spawned work hot in its cache; other threads steal the oldest item from
+// the top. Only a pop racing a steal for the last item needs a CAS.
+//
+// The ring grows when full. Old rings stay allocated until the deque is
+// destroyed, since a thief may still be reading one.
+template <typename T> class chase_lev_deque {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  explicit chase_lev_deque(std::size_t capacity = 256) {
+    std::size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    rings_.push_back(std::make_unique<ring>(size));
+    ring_.store(rings_.back().get(), std::memory_order_relaxed);
+  }
+
+  chase_lev_deque(const chase_lev_deque &) = delete;
+  chase_lev_deque &operator=(const chase_lev_deque &) = delete;
+
+  // Owner only
+  void push(T value) {
+    std::int64_t b = bottom_.load(std::memory_order_relaxed);
+    std::int64_t t = top_.load(std::memory_order_acquire);
+    ring *r = ring_.load(std::memory_order_relaxed);
+    if (b - t >= r->capacity) {
+      r = grow(r, t, b);
+    }
+    r->put(b, value);
+    // A release store rather than the paper's release fence and relaxed
+    // store: the same code on x86, and visible to ThreadSanitizer
+    bottom_.store(b + 1, std::memory_order_release);
+  }
+
+  // Owner only: the newest item
+  std::optional<T> pop() {
+    std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    ring *r = ring_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed); // Was empty
+      return std::nullopt;
+    }
+
+    std::optional<T> value = r->get(b);
+    if (t == b) {
+      // The last item: whoever moves top first gets it
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        value.reset();
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return value;
+  }
+
+  // Any thread: the oldest item. Also nullopt when another thief won the
+  // race for it.
+  std::optional<T> steal() {
+    std::int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return std::nullopt;
+    }
+
+    ring *r = ring_.load(std::memory_order_acquire);
+    T value = r->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  // Any thread; exact only when the deque is not being changed
+  bool empty() const noexcept {
+    std::int64_t b = bottom_.load(std::memory_order_seq_cst);
+    std::int64_t t = top_.load(std::memory_order_seq_cst);
+    return b <= t;
+  }
+
+private:
+  struct ring {
+    explicit ring(std::size_t size)
+        : capacity(static_cast<std::int64_t>(size)),
+          slots(std::make_unique<std::atomic<T>[]>(size)) {}
+
+    T get(std::int64_t i) const noexcept {
+      return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+
+    void put(std::int64_t i, T value) noexcept {
+      slots[i & (capacity - 1)].store(value, std::memory_order_relaxed);
+    }
+
+    std::int64_t capacity;
+    std::unique_ptr<std::atomic<T>[]> slots;
+  };
+
+  ring *grow(ring *old, std::int64_t t, std::int64_t b) {
+    auto bigger = std::make_unique<ring>(old->capacity * 2);
+    for (std::int64_t i = t; i < b; ++i) {
+      bigger->put(i, old->get(i));
+    }
+    ring *r = bigger.get();
+    rings_.push_back(std::move(bigger));
+    ring_.store(r, std::memory_order_release);
+    return r;
+  }
+
+  alignas(64) std::atomic<std::int64_t> top_{0}; // Thieves
+  alignas(64) std::atomic<std::int64_t> bottom_{0};
+  std::atomic<ring *> ring_;
+  std::vector<std::unique_ptr<ring>> rings_; // Current one last; owner only
+};
+
+// Jobs submitted to a worker from outside the pool: Vyukov's intrusive
+// MPSC queue (as in mpsc_queue), threaded through the jobs themselves, so
+// pushing allocates nothing and never waits. The single consumer is
+// whichever worker claims the inbox, so an idle worker can empty the inbox
+// of one that is busy; a worker that fails to claim one moves on.
+class job_inbox {
+public:
+  job_inbox() noexcept : head_(&stub_), tail_(&stub_) {}
+
+  job_inbox(const job_inbox &) = delete;
+  job_inbox &operator=(const job_inbox &) = delete;
+
+  // Any thread
+  void push(executor_job *job) noexcept {
+    job->next.store(nullptr, std::memory_order_relaxed);
+    link(job);
+  }
+
+  // Become the consumer; false if another worker is
+  bool try_claim() noexcept {
+    return !claimed_.exchange(true, std::memory_order_acquire);
+  }
+
+  void release() noexcept { claimed_.store(false, std::memory_order_release); }
+
+  // Claimant only: the oldest job, or null if none is fully pushed
+  executor_job *pop() noexcept {
+    executor_job *tail = tail_;
+    executor_job *next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) {
+      return nullptr; // A push is between its exchange and its link
+    }
+
+    stub_.next.store(nullptr, std::memory_order_relaxed);
+    link(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+private:
+  void link(executor_job *job) noexcept {
+    executor_job *previous = head_.exchange(job, std::memory_order_acq_rel);
+    previous->next.store(job, std::memory_order_release);
+  }
+
+  alignas(64) std::atomic<executor_job *> head_; // Producers
+  alignas(64) executor_job *tail_;               // Claimant
+  std::atomic<bool> claimed_{false};
+  executor_job stub_;
+};
+
+// Resumes the awaiting coroutine on an executor thread
+class schedule_op : public executor_job {
+public:
+  explicit schedule_op(executor &pool) noexcept : pool_(pool) {
+    execute = [](executor_job *job) {
+      static_cast<schedule_op *>(job)->handle_.resume();
+    };
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  inline void await_suspend(std::coroutine_handle<> handle);
+
+  void await_resume() const noexcept {}
+
+private:
+  executor &pool_;
+  std::coroutine_handle<> handle_;
+};
+
+// Runs a function on an executor thread, then resumes the awaiting
+// coroutine where it was: on its event loop through post(), or on the pool
+// thread if it was not running on a loop
+template <typename F> class run_op : public executor_job {
+public:
+  using result_type = std::invoke_result_t<F &>;
+
+  run_op(executor &pool, F fn) : pool_(pool), fn_(std::move(fn)) {
+    execute = [](executor_job *job) { static_cast<run_op *>(job)->run(); };
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle);
+
+  result_type await_resume() {
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+    if constexpr (!std::is_void_v<result_type>) {
+      return std::move(*result_);
+    }
+  }
+
+private:
+  struct empty {};
+  using storage =
+      std::conditional_t<std::is_void_v<result_type>, empty,
+                         std::optional<result_type>>;
+
+  void run() {
+    try {
+      if constexpr (std::is_void_v<result_type>) {
+        fn_();
+      } else {
+        result_.emplace(fn_());
+      }
+    } catch (...) {
+      exception_ = std::current_exception();
+    }
+
+    // Nothing of this awaiter may be touched once the coroutine can run.
+    // A loop that can no longer take posts leaves it to this thread.
+    std::coroutine_handle<> handle = handle_;
+    event_loop *loop = loop_;
+    if (loop == nullptr || !loop->post([handle] { handle.resume(); })) {
+      handle.resume();
+    }
+  }
+
+  executor &pool_;
+  F fn_;
+  [[no_unique_address]] storage result_;
+  std::exception_ptr exception_;
+  std::coroutine_handle<> handle_;
+  event_loop *loop_ = nullptr;
+};
+
+} // namespace detail
+
+// Settings for executor
+struct executor_options {
+  unsigned threads = 0; // Worker count; 0 means one per available CPU
+  // How long an idle worker keeps looking for work before it sleeps. Longer
+  // spins pick up new work sooner at the cost of burning CPU; zero sleeps
+  // at once.
+  std::chrono::nanoseconds spin = std::chrono::microseconds(50);
+};
+
+// Work-stealing thread pool for CPU-bound work that would stall an event
+// loop (compression, serialization, ...). Each worker owns a Chase-Lev
+// deque and a lock-free inbox: work submitted from a worker goes on its
+// own deque, work from any other thread into the workers' inboxes in
+// turn, and idle workers steal from the others' deques and inboxes before
+// sleeping. Submitting takes no lock and allocates nothing.
+//
+// Coroutines hop on and off the pool with co_await:
+//
+//   auto compressed = co_await pool.run([&] { return deflate(body); });
+//
+// runs the function on a worker and resumes the caller back on its event
+// loop, while
+//
+//   co_await pool.schedule();
+//
+// moves the rest of the coroutine onto a worker; `co_await loop.schedule()`
+// brings it back.
+//
+// The destructor runs everything already submitted, then joins.
+class executor {
+public:
+  explicit executor(executor_options options = {})
+      : spin_(options.spin) {
+    unsigned count = options.threads;
+    if (count == 0) {
+      count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+      workers_.push_back(std::make_unique<worker>());
+    }
+    for (unsigned i = 0; i < count; ++i) {
+      workers_[i]->thread = std::thread([this, i] { work(i); });
+    }
+  }
+
+  // No copy or move (workers refer back to the executor)
+  executor(const executor &) = delete;
+  executor &operator=(const executor &) = delete;
+
+  ~executor() {
+    stopping_.store(true, std::memory_order_seq_cst);
+    signal_.fetch_add(1, std::memory_order_seq_cst);
+    signal_.notify_all();
+    for (auto &w : workers_) {
+      if (w->thread.joinable()) {
+        w->thread.join();
+      }
+    }
+  }
+
+  // Number of worker threads
+  std::size_t size() const noexcept { return workers_.size(); }
+
+  // Continue the awaiting coroutine on a worker thread
+  detail::schedule_op schedule() noexcept { return detail::schedule_op(*this); }
+
+  // Run `fn` on a worker and resume with its result (or exception) on the
+  // event loop the coroutine was running on
+  template <typename F> detail::run_op<F> run(F fn) {
+    return detail::run_op<F>(*this, std::move(fn));
+  }
+
+  // Queue a function to run on a worker
+  void post(std::move_only_function<void()> fn) {
+    struct function_job : detail::executor_job {
+      std::move_only_function<void()> fn;
+    };
+
+    auto *job = new function_job;
+    job->fn = std::move(fn);
+    job->execute = [](detail::executor_job *j) {
+      std::unique_ptr<function_job> owned(static_cast<function_job *>(j));
+      owned->fn();
+    };
+    submit(job);
+  }
+
+  // Start a task on a worker
+  void spawn(task<void> t) {
+    post([t = std::move(t)]() mutable { net::spawn(std::move(t)); });
+  }
+
+  // The executor whose worker is the calling thread, if any
+  static executor *current() noexcept { return current_.pool; }
+
+  // Queue a job; from one of this pool's workers, it goes on that worker's
+  // own deque, from other threads into the next worker's inbox
+  void submit(detail::executor_job *job) {
+    if (current_.pool == this) {
+      workers_[current_.index]->jobs.push(job);
+    } else {
+      // Counted first, so a worker about to park sees it coming
+      injected_count_.fetch_add(1, std::memory_order_seq_cst);
+      workers_[next_inbox_++ % workers_.size()]->inbox.push(job);
+    }
+    notify();
+  }
+
+private:
+  struct worker {
+    detail::chase_lev_deque<detail::executor_job *> jobs;
+    detail::job_inbox inbox; // From non-worker threads
+    std::thread thread;
+  };
+
+  struct worker_id {
+    executor *pool = nullptr;
+    std::size_t index = 0;
+  };
+
+  // Wake a sleeping worker, if there is one
+  void notify() {
+    // Pairs with the fence in park(): either this sees the sleeper, or the
+    // sleeper sees the new job
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+      signal_.fetch_add(1, std::memory_order_seq_cst);
+      signal_.notify_one();
+    }
+  }
+
+  void work(std::size_t index) {
+    current_ = {this, index};
+    std::uint64_t seed = index * 0x9e3779b97f4a7c15ull + 1;
+
+    for (;;) {
+      detail::executor_job *job = find_job(index, seed);
+      if (job == nullptr && spin_ > std::chrono::nanoseconds::zero()) {
+        auto until = std::chrono::steady_clock::now() + spin_;
+        do {
+          detail::cpu_relax();
+          job = find_job(index, seed);
+        } while (job == nullptr && std::chrono::steady_clock::now() < until);
+      }
+
+      if (job != nullptr) {
+        job->execute(job);
+        continue;
+      }
+      if (stopping_.load(std::memory_order_acquire) && !has_work()) {
+        return;
+      }
+      park();
+    }
+  }
+
+  // Own deque first (newest, cache-warm work), then the own inbox, then
+  // the oldest work of the other workers starting at a random one, and
+  // last their inboxes
+  detail::executor_job *find_job(std::size_t index, std::uint64_t &seed) {
+    if (auto job = workers_[index]->jobs.pop()) {
+      return *job;
+    }
+
+    bool injected = injected_count_.load(std::memory_order_relaxed) > 0;
+    if (injected) {
+      if (detail::executor_job *job = take_injected(index)) {
+        return job;
+      }
+    }
+
+    std::size_t count = workers_.size();
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    std::size_t start = static_cast<std::size_t>(seed % count);
+    for (std::size_t i = 0; i < count; ++i) {
+      std::size_t victim = (start + i) % count;
+      if (victim == index) {
+        continue;
+      }
+      if (auto job = workers_[victim]->jobs.steal()) {
+        return *job;
+      }
+    }
+
+    for (std::size_t i = 0; injected && i < count; ++i) {
+      std::size_t victim = (start + i) % count;
+      if (victim == index) {
+        continue;
+      }
+      if (detail::executor_job *job = take_injected(victim)) {
+        return job;
+      }
+    }
+    return nullptr;
+  }
+
+  // The oldest job in the inbox of worker `index`, unless another worker
+  // is taking from it
+  detail::executor_job *take_injected(std::size_t index) {
+    detail::job_inbox &inbox = workers_[index]->inbox;
+    if (!inbox.try_claim()) {
+      return nullptr;
+    }
+    detail::executor_job *job = inbox.pop();
+    inbox.release();
+    if (job != nullptr) {
+      injected_count_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+  }
+
+  bool has_work() const noexcept {
+    if (injected_count_.load(std::memory_order_seq_cst) > 0) {
+      return true;
+    }
+    for (const auto &w : workers_) {
+      if (!w->jobs.empty()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void park() {
+    std::uint64_t seen = signal_.load(std::memory_order_seq_cst);
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!has_work() && !stopping_.load(std::memory_order_seq_cst)) {
+      signal_.wait(seen, std::memory_order_seq_cst);
+    }
+    sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  std::chrono::nanoseconds spin_;
+  std::vector<std::unique_ptr<worker>> workers_;
+
+  std::atomic<std::size_t> injected_count_{0}; // Jobs in inboxes
+
+  std::atomic<bool> stopping_{false};
+  std::atomic<std::uint32_t> sleepers_{0};
+  std::atomic<std::uint64_t> signal_{0}; // Bumped to wake sleepers
+
+  static inline thread_local worker_id current_{nullptr, 0};
+  static inline thread_local std::size_t next_inbox_ = 0; // Non-workers
+};
+
+inline void detail::schedule_op::await_suspend(std::coroutine_handle<> handle) {
+  handle_ = handle;
+  pool_.submit(this);
+}
+
+template <typename F>
+void detail::run_op<F>::await_suspend(std::coroutine_handle<> handle) {
+  handle_ = handle;
+  loop_ = event_loop::current();
+  pool_.submit(this);
+}
+
+} // namespace net
@@ -0,0 +1,752 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "http_request.hpp"
+
+namespace net {
+
+// HTTP/2 error codes (RFC 9113 section 7). The values are the ones sent in
+// RST_STREAM and GOAWAY frames; HPACK failures are compression_error.
+enum class http2_error : std::uint32_t {
+  no_error = 0,
+  protocol_error,
+  internal_error,
+  flow_control_error,
+  settings_timeout,
+  stream_closed,
+  frame_size_error,
+  refused_stream,
+  cancel,
+  compression_error,
+  connect_error,
+  enhance_your_calm,
+  inadequate_security,
+  http_1_1_required
+};
+
+class http2_error_category : public std::error_category {
+public:
+  const char *name() const noexcept override { return "http2"; }
+
+  std::string message(int ev) const override {
+    switch (static_cast<http2_error>(ev)) {
+    case http2_error::no_error:
+      return "No error";
+    case http2_error::protocol_error:
+      return "Protocol error";
+    case http2_error::internal_error:
+      return "Internal error";
+    case http2_error::flow_control_error:
+      return "Flow control limits exceeded";
+    case http2_error::settings_timeout:
+      return "Settings not acknowledged";
+    case http2_error::stream_closed:
+      return "Frame received for closed stream";
+    case http2_error::frame_size_error:
+      return "Frame size incorrect";
+    case http2_error::refused_stream:
+      return "Stream not processed";
+    case http2_error::cancel:
+      return "Stream cancelled";
+    case http2_error::compression_error:
+      return "Compression state not updated";
+    case http2_error::connect_error:
+      return "TCP connection error for CONNECT method";
+    case http2_error::enhance_your_calm:
+      return "Processing capacity exceeded";
+    case http2_error::inadequate_security:
+      return "Negotiated TLS parameters not acceptable";
+    case http2_error::http_1_1_required:
+      return "Use HTTP/1.1 for the request";
+    default:
+      return "Unknown http2 error";
+    }
+  }
+};
+
+inline const std::error_category &http2_category() noexcept {
+  static const http2_error_category instance;
+  return instance;
+}
+
+inline std::error_code make_error_code(http2_error e) noexcept {
+  return {static_cast<int>(e), http2_category()};
+}
+
+namespace detail {
+
+// RFC 7541 Appendix A; index 1 is the first entry
+inline constexpr std::array<http_header, 61> hpack_static_table{{
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+}};
+
+// Bits in the Huffman code of each octet and of EOS (256), RFC 7541
+// Appendix B. The code is canonical (codes of one length count up in
+// symbol order), so the lengths are enough to rebuild it.
+inline constexpr std::array<std::uint8_t, 257> huffman_lengths{
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6,  10, 10, 12, 13, 6,  8,  11, 10, 10, 8,  11, 8,  6,  6,  6,
+    5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8,  15, 6,  12, 10,
+    13, 6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+    7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8,  13, 19, 13, 14, 6,
+    15, 5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+    6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7,  15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+inline constexpr auto huffman_codes = [] {
+  std::array<std::uint32_t, 257> codes{};
+  std::uint32_t code = 0;
+  for (unsigned length = 1; length <= 30; ++length) {
+    for (std::size_t symbol = 0; symbol < codes.size(); ++symbol) {
+      if (huffman_lengths[symbol] == length) {
+        codes[symbol] = code++;
+      }
+    }
+    code <<= 1;
+  }
+  return codes;
+}();
+
+// Octets needed to Huffman-code `text`
+constexpr std::size_t huffman_size(std::string_view text) noexcept {
+  std::size_t bits = 0;
+  for (char c : text) {
+    bits += huffman_lengths[static_cast<unsigned char>(c)];
+  }
+  return (bits + 7) / 8;
+}
+
+// Append the Huffman coding of `text`, padded with the start of EOS
+inline void huffman_encode(std::string_view text, std::string &out) {
+  std::uint64_t pending = 0; // Bits not yet written, right-aligned
+  unsigned count = 0;
+  for (char c : text) {
+    auto symbol = static_cast<unsigned char>(c);
+    pending = (pending << huffman_lengths[symbol]) | huffman_codes[symbol];
+    count += huffman_lengths[symbol];
+    while (count >= 8) {
+      count -= 8;
+      out.push_back(static_cast<char>(pending >> count));
+    }
+  }
+  if (count > 0) {
+    out.push_back(static_cast<char>((pending << (8 - count)) |
+                                    (0xffu >> count)));
+  }
+}
+
+// Huffman decoding four bits at a time. States are the internal nodes of
+// the code tree; each (state, nibble) entry says where the nibble leads,
+// whether it completed a symbol (codes are at least five bits, so at most
+// one per nibble), and whether stopping there leaves valid padding: fewer
+// than eight 1 bits, the prefix of EOS.
+struct huffman_step {
+  std::uint8_t state;
+  std::uint8_t symbol;
+  std::uint8_t flags;
+
+  static constexpr std::uint8_t emit = 1;
+  static constexpr std::uint8_t accept = 2;
+  static constexpr std::uint8_t fail = 4; // EOS inside the string
+};
+
+// Built at compile time, so decoding never waits on a first-use guard
+inline constexpr auto huffman_steps = [] {
+  // Children are internal node indices, or ~symbol for leaves
+  std::array<std::array<int, 2>, 256> children{};
+  std::array<std::uint8_t, 256> depth{};
+  std::array<bool, 256> all_ones{};
+  all_ones[0] = true;
+  int nodes = 1;
+  for (int symbol = 0; symbol < 257; ++symbol) {
+    int node = 0;
+    for (int bit = huffman_lengths[symbol] - 1; bit >= 0; --bit) {
+      int branch = (huffman_codes[symbol] >> bit) & 1;
+      if (bit == 0) {
+        children[node][branch] = ~symbol;
+      } else {
+        if (children[node][branch] == 0) {
+          children[node][branch] = nodes;
+          depth[nodes] = static_cast<std::uint8_t>(depth[node] + 1);
+          all_ones[nodes] = all_ones[node] && branch == 1;
+          ++nodes;
+        }
+        node = children[node][branch];
+      }
+    }
+  }
+
+  std::array<huffman_step, 256 * 16> table{};
+  for (int state = 0; state < 256; ++state) {
+    for (int nibble = 0; nibble < 16; ++nibble) {
+      huffman_step &step = table[state * 16 + nibble];
+      int node = state;
+      for (int bit = 3; bit >= 0; --bit) {
+        int next = children[node][(nibble >> bit) & 1];
+        if (next < 0) {
+          if (~next == 256) {
+            step.flags |= huffman_step::fail;
+          }
+          step.symbol = static_cast<std::uint8_t>(~next);
+          step.flags |= huffman_step::emit;
+          node = 0;
+        } else {
+          node = next;
+        }
+      }
+      step.state = static_cast<std::uint8_t>(node);
+      if (all_ones[node] && depth[node] < 8) {
+        step.flags |= huffman_step::accept;
+      }
+    }
+  }
+  return table;
+}();
+
+// Append the decoding of `data` to `out`; false if it is not a valid
+// Huffman string
+inline bool huffman_decode(std::span<const std::uint8_t> data,
+                           std::string &out) {
+  std::uint8_t state = 0;
+  bool accept = true;
+  for (std::uint8_t byte : data) {
+    for (int nibble : {byte >> 4, byte & 0xf}) {
+      const huffman_step &step = huffman_steps[state * 16 + nibble];
+      if (step.flags & huffman_step::fail) {
+        return false;
+      }
+      if (step.flags & huffman_step::emit) {
+        out.push_back(static_cast<char>(step.symbol));
+      }
+      state = step.state;
+      accept = step.flags & huffman_step::accept;
+    }
+  }
+  return accept;
+}
+
+// Append an integer with an N-bit prefix (RFC 7541 5.1); `first` holds the
+// bits above the prefix
+inline void hpack_put_integer(std::string &out, std::uint8_t first,
+                              unsigned prefix_bits, std::uint64_t value) {
+  std::uint64_t limit = (1u << prefix_bits) - 1;
+  if (value < limit) {
+    out.push_back(static_cast<char>(first | value));
+    return;
+  }
+  out.push_back(static_cast<char>(first | limit));
+  value -= limit;
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+// Read an integer with an N-bit prefix; values over 2^32 are rejected
+inline bool hpack_get_integer(const std::uint8_t *&p, const std::uint8_t *end,
+                              unsigned prefix_bits, std::uint64_t &value) {
+  if (p == end) {
+    return false;
+  }
+  std::uint64_t limit = (1u << prefix_bits) - 1;
+  value = *p++ & limit;
+  if (value < limit) {
+    return true;
+  }
+  for (unsigned shift = 0; p != end && shift <= 28; shift += 7) {
+    std::uint8_t byte = *p++;
+    value += static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value <= 0xffffffffu;
+    }
+  }
+  return false;
+}
+
+// Append a string literal, Huffman-coded when that is shorter
+inline void hpack_put_string(std::string &out, std::string_view text) {
+  std::size_t coded = huffman_size(text);
+  if (coded < text.size()) {
+    hpack_put_integer(out, 0x80, 7, coded);
+    huffman_encode(text, out);
+  } else {
+    hpack_put_integer(out, 0, 7, text.size());
+    out.append(text);
+  }
+}
+
+// HPACK dynamic table. Entry bytes live in a ring buffer sized for the
+// largest table allowed, so inserting and evicting never allocate; an
+// entry may wrap around the end of the ring, so it is read in up to two
+// pieces.
+class hpack_table {
+public:
+  // Every entry costs 32 octets on top of its name and value
+  static constexpr std::size_t entry_overhead = 32;
+
+  explicit hpack_table(std::size_t capacity)
+      : _bytes(capacity), _entries(capacity / entry_overhead + 1),
+        _capacity(capacity), _max_size(capacity) {}
+
+  std::size_t count() const noexcept { return _count; }
+
+  // Current size as RFC 7541 counts it
+  std::size_t size() const noexcept { return _size; }
+
+  std::size_t max_size() const noexcept { return _max_size; }
+
+  // Largest max_size() allowed
+  std::size_t capacity() const noexcept { return _capacity; }
+
+  void set_max_size(std::size_t max_size) noexcept {
+    _max_size = std::min(max_size, _capacity);
+    evict(0);
+  }
+
+  void insert(std::string_view name, std::string_view value) noexcept {
+    std::size_t cost = name.size() + value.size() + entry_overhead;
+    if (cost > _max_size) {
+      _count = 0; // An entry too large for the table empties it
+      _size = 0;
+      return;
+    }
+    evict(cost);
+
+    auto offset = static_cast<std::uint32_t>(_write);
+    write(name);
+    write(value);
+    _entries[(_first + _count) % _entries.size()] = {
+        offset, static_cast<std::uint32_t>(name.size()),
+        static_cast<std::uint32_t>(value.size())};
+    ++_count;
+    _size += cost;
+  }
+
+  // Call f with the pieces of the name or value of entry `index` (0 is the
+  // newest)
+  template <typename F> void visit(std::size_t index, bool value, F &&f) const {
+    const entry &e = _entries[(_first + _count - 1 - index) % _entries.size()];
+    std::size_t start = (e.offset + (value ? e.name_length : 0)) % _capacity;
+    std::size_t length = value ? e.value_length : e.name_length;
+    std::size_t head = std::min(length, _capacity - start);
+    f(std::string_view(_bytes.data() + start, head));
+    if (head < length) {
+      f(std::string_view(_bytes.data(), length - head));
+    }
+  }
+
+  bool equals(std::size_t index, bool value, std::string_view text) const {
+    bool same = true;
+    std::size_t at = 0;
+    std::size_t length = 0;
+    visit(index, value,
+          [&](std::string_view piece) { length += piece.size(); });
+    if (length != text.size()) {
+      return false;
+    }
+    visit(index, value, [&](std::string_view piece) {
+      same = same && text.substr(at, piece.size()) == piece;
+      at += piece.size();
+    });
+    return same;
+  }
+
+  void append(std::size_t index, bool value, std::string &out) const {
+    visit(index, value, [&](std::string_view piece) { out.append(piece); });
+  }
+
+private:
+  struct entry {
+    std::uint32_t offset;
+    std::uint32_t name_length;
+    std::uint32_t value_length;
+  };
+
+  // Drop the oldest entries until `room` more octets fit
+  void evict(std::size_t room) noexcept {
+    while (_count > 0 && _size + room > _max_size) {
+      const entry &e = _entries[_first];
+      _size -= e.name_length + e.value_length + entry_overhead;
+      _first = (_first + 1) % _entries.size();
+      --_count;
+    }
+  }
+
+  void write(std::string_view text) noexcept {
+    std::size_t head = std::min(text.size(), _capacity - _write);
+    std::copy_n(text.data(), head, _bytes.data() + _write);
+    std::copy_n(text.data() + head, text.size() - head, _bytes.data());
+    _write = (_write + text.size()) % _capacity;
+  }
+
+  std::vector<char> _bytes;
+  std::vector<entry> _entries;
+  std::size_t _capacity;
+  std::size_t _max_size;
+  std::size_t _first = 0; // Oldest entry
+  std::size_t _count = 0;
+  std::size_t _size = 0;
+  std::size_t _write = 0; // Where the next entry's bytes go
+};
+
+} // namespace detail
+
+// Decoded header fields of one or more header blocks. Names and values are
+// copied into a single arena string that keeps its capacity across
+// clear(), so a connection stops allocating once it has seen its largest
+// header set. Fields are stored as offsets and turned into views on
+// access; the views are invalidated by the next decode.
+class hpack_header_list {
+public:
+  std::size_t size() const noexcept { return _fields.size(); }
+
+  bool empty() const noexcept { return _fields.empty(); }
+
+  http_header operator[](std::size_t i) const noexcept {
+    const field &f = _fields[i];
+    return {std::string_view(_arena).substr(f.name, f.name_length),
+            std::string_view(_arena).substr(f.value, f.value_length)};
+  }
+
+  void clear() noexcept {
+    _arena.clear();
+    _fields.clear();
+  }
+
+  // Drop fields from `count` on, e.g. a block that failed to decode
+  void truncate(std::size_t count) noexcept {
+    if (count < _fields.size()) {
+      _arena.resize(_fields[count].name);
+      _fields.resize(count);
+    }
+  }
+
+private:
+  friend class hpack_decoder;
+
+  struct field {
+    std::uint32_t name;
+    std::uint32_t name_length;
+    std::uint32_t value;
+    std::uint32_t value_length;
+  };
+
+  std::string _arena;
+  std::vector<field> _fields;
+};
+
+// HPACK (RFC 7541) decoder for the header blocks of one connection
+class hpack_decoder {
+public:
+  // `max_table_size` is the largest table the peer may ask for. The table
+  // starts at the protocol's initial 4096 octets, or less if that's less.
+  explicit hpack_decoder(std::size_t max_table_size = 4096)
+      : _table(max_table_size), _limit(max_table_size) {
+    _table.set_max_size(std::min<std::size_t>(max_table_size, 4096));
+  }
+
+  // The peer acknowledged a SETTINGS_HEADER_TABLE_SIZE of `size`: larger
+  // size updates fail from now on, and if the table is larger the next
+  // block must start with an update that shrinks it (RFC 7541 4.2)
+  void set_max_table_size(std::size_t size) noexcept {
+    _limit = std::min(size, _table.capacity());
+    _update_required = _table.max_size() > _limit;
+  }
+
+  // Decode a complete header block, appending its fields to `out`. Returns
+  // the size of the decoded list as SETTINGS_MAX_HEADER_LIST_SIZE counts
+  // it. Decoding stops as soon as that size passes `max_list_size`, since
+  // a small block of indexed references can expand a thousandfold. Any
+  // error is a connection error (compression_error): the dynamic table is
+  // out of step with the peer's from then on.
+  std::expected<std::size_t, std::error_code>
+  decode(std::span<const std::byte> block, hpack_header_list &out,
+         std::size_t max_list_size = SIZE_MAX) {
+    const auto *p = reinterpret_cast<const std::uint8_t *>(block.data());
+    const auto *end = p + block.size();
+    std::size_t first = out._fields.size();
+    std::size_t list_size = 0;
+    bool fields_seen = false;
+
+    auto fail = [&] {
+      out.truncate(first);
+      return std::unexpected(make_error_code(http2_error::compression_error));
+    };
+
+    while (p != end) {
+      std::uint8_t byte = *p;
+      std::uint64_t index;
+
+      if ((byte & 0xe0) == 0x20) {
+        // Table size update, only before the first field
+        if (fields_seen || !detail::hpack_get_integer(p, end, 5, index) ||
+            index > _limit) {
+          return fail();
+        }
+        _table.set_max_size(index);
+        _update_required = false;
+        continue;
+      }
+      if (_update_required) {
+        return fail();
+      }
+
+      // Indexed field (1), or a literal with incremental indexing (01),
+      // without indexing (0000) or never indexed (0001)
+      bool indexed = byte & 0x80;
+      bool indexing = !indexed && (byte & 0x40);
+      unsigned prefix_bits = indexed ? 7 : indexing ? 6 : 4;
+      if (!detail::hpack_get_integer(p, end, prefix_bits, index)) {
+        return fail();
+      }
+
+      std::string &arena = out._arena;
+      hpack_header_list::field f;
+      f.name = static_cast<std::uint32_t>(arena.size());
+      if (index == 0 && !indexed ? !read_string(p, end, arena)
+                                 : !copy_entry(index, false, arena)) {
+        return fail();
+      }
+      f.value = static_cast<std::uint32_t>(arena.size());
+      f.name_length = f.value - f.name;
+      if (indexed ? !copy_entry(index, true, arena)
+                  : !read_string(p, end, arena)) {
+        return fail();
+      }
+      f.value_length = static_cast<std::uint32_t>(arena.size()) - f.value;
+      out._fields.push_back(f);
+
+      if (indexing) {
+        http_header field = out[out._fields.size() - 1];
+        _table.insert(field.name, field.value);
+      }
+
+      fields_seen = true;
+      list_size += f.name_length + f.value_length +
+                   detail::hpack_table::entry_overhead;
+      if (list_size > max_list_size) {
+        return fail();
+      }
+    }
+    return list_size;
+  }
+
+  const detail::hpack_table &table() const noexcept { return _table; }
+
+private:
+  // Append the name or value of entry `index` (1-based, static entries
+  // first) to `arena`
+  bool copy_entry(std::uint64_t index, bool value, std::string &arena) const {
+    std::size_t static_size = detail::hpack_static_table.size();
+    if (index == 0) {
+      return false;
+    }
+    if (index <= static_size) {
+      const http_header &entry = detail::hpack_static_table[index - 1];
+      arena.append(value ? entry.value : entry.name);
+      return true;
+    }
+    if (index - static_size > _table.count()) {
+      return false;
+    }
+    _table.append(index - static_size - 1, value, arena);
+    return true;
+  }
+
+  // Append a string literal, decoding it if it is Huffman-coded
+  static bool read_string(const std::uint8_t *&p, const std::uint8_t *end,
+                          std::string &arena) {
+    if (p == end) {
+      return false;
+    }
+    bool huffman = *p & 0x80;
+    std::uint64_t length;
+    if (!detail::hpack_get_integer(p, end, 7, length) ||
+        length > static_cast<std::size_t>(end - p)) {
+      return false;
+    }
+
+    std::span<const std::uint8_t> data(p, length);
+    p += length;
+    if (huffman) {
+      return detail::huffman_decode(data, arena);
+    }
+    arena.append(reinterpret_cast<const char *>(data.data()), data.size());
+    return true;
+  }
+
+  detail::hpack_table _table;
+  std::size_t _limit;            // Largest size update allowed
+  bool _update_required = false; // Next block must shrink the table
+};
+
+// HPACK encoder for the header blocks of one connection. Fields found in
+// the static or dynamic table are sent as a single index; other fields are
+// added to the dynamic table so that repeats (content-type, server, ...)
+// shrink to one octet, except credentials and values too large to be worth
+// keeping, which are sent as never-indexed literals.
+class hpack_encoder {
+public:
+  // `max_table_size` caps the dynamic table whatever the peer allows. The
+  // table starts at the protocol's 4096 until the peer's setting arrives.
+  explicit hpack_encoder(std::size_t max_table_size = 4096)
+      : _table(max_table_size) {
+    _table.set_max_size(std::min<std::size_t>(max_table_size, 4096));
+  }
+
+  // Apply the peer's SETTINGS_HEADER_TABLE_SIZE; the next block starts
+  // with a size update
+  void set_max_table_size(std::size_t size) {
+    _table.set_max_size(size);
+    _size_update = true;
+  }
+
+  // Must be called before the first field of every header block
+  void begin_block(std::string &out) {
+    if (_size_update) {
+      detail::hpack_put_integer(out, 0x20, 5, _table.max_size());
+      _size_update = false;
+    }
+  }
+
+  // Append one field; `name` must be lowercase
+  void encode(std::string_view name, std::string_view value,
+              std::string &out) {
+    std::size_t name_index = 0;
+    std::size_t static_size = detail::hpack_static_table.size();
+    for (std::size_t i = 0; i < static_size; ++i) {
+      const http_header &entry = detail::hpack_static_table[i];
+      if (entry.name.size() != name.size() || entry.name != name) {
+        continue;
+      }
+      if (entry.value == value) {
+        detail::hpack_put_integer(out, 0x80, 7, i + 1);
+        return;
+      }
+      if (name_index == 0) {
+        name_index = i + 1;
+      }
+    }
+
+    for (std::size_t i = 0; i < _table.count(); ++i) {
+      if (_table.equals(i, false, name)) {
+        if (_table.equals(i, true, value)) {
+          detail::hpack_put_integer(out, 0x80, 7, static_size + i + 1);
+          return;
+        }
+        if (name_index == 0) {
+          name_index = static_size + i + 1;
+        }
+      }
+    }
+
+    bool sensitive = name == "authorization" || name == "cookie" ||
+                     name == "set-cookie" || name == "proxy-authorization";
+    bool indexing = !sensitive &&
+                    name.size() + value.size() +
+                            detail::hpack_table::entry_overhead <=
+                        _table.max_size() / 2;
+    if (indexing) {
+      detail::hpack_put_integer(out, 0x40, 6, name_index);
+    } else {
+      detail::hpack_put_integer(out, sensitive ? 0x10 : 0x00, 4, name_index);
+    }
+    if (name_index == 0) {
+      detail::hpack_put_string(out, name);
+    }
+    detail::hpack_put_string(out, value);
+
+    if (indexing) {
+      _table.insert(name, value);
+    }
+  }
+
+  const detail::hpack_table &table() const noexcept { return _table; }
+
+private:
+  detail::hpack_table _table;
+  bool _size_update = false;
+};
+
+} // namespace net
@@ -0,0 +1,1098 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "hpack.hpp"
+#include "http_parser.hpp"
+#include "http_request.hpp"
+#include "http_response.hpp"
+
+namespace net {
+
+enum class http2_frame_type : std::uint8_t {
+  data = 0x0,
+  headers = 0x1,
+  priority = 0x2,
+  rst_stream = 0x3,
+  settings = 0x4,
+  push_promise = 0x5,
+  ping = 0x6,
+  goaway = 0x7,
+  window_update = 0x8,
+  continuation = 0x9
+};
+
+// Frame flags; each only means something on some frame types
+struct http2_flags {
+  static constexpr std::uint8_t end_stream = 0x01;  // DATA, HEADERS
+  static constexpr std::uint8_t ack = 0x01;         // SETTINGS, PING
+  static constexpr std::uint8_t end_headers = 0x04; // HEADERS, CONTINUATION
+  static constexpr std::uint8_t padded = 0x08;      // DATA, HEADERS
+  static constexpr std::uint8_t priority = 0x20;    // HEADERS
+};
+
+enum class http2_setting : std::uint16_t {
+  header_table_size = 0x1,
+  enable_push = 0x2,
+  max_concurrent_streams = 0x3,
+  initial_window_size = 0x4,
+  max_frame_size = 0x5,
+  max_header_list_size = 0x6
+};
+
+// What a client sends first on a connection that speaks HTTP/2
+inline constexpr std::string_view http2_preface =
+    "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+// The nine octets in front of every frame
+struct http2_frame_header {
+  static constexpr std::size_t size = 9;
+
+  std::uint32_t length = 0; // 24 bits
+  http2_frame_type type = http2_frame_type::data;
+  std::uint8_t flags = 0;
+  std::uint32_t stream_id = 0; // 31 bits; the reserved bit is dropped
+
+  static http2_frame_header parse(const char *p) noexcept {
+    auto octet = [p](int i) { return static_cast<std::uint8_t>(p[i]); };
+    http2_frame_header header;
+    header.length = std::uint32_t{octet(0)} << 16 | octet(1) << 8 | octet(2);
+    header.type = static_cast<http2_frame_type>(octet(3));
+    header.flags = octet(4);
+    header.stream_id = (std::uint32_t{octet(5)} << 24 | octet(6) << 16 |
+                        octet(7) << 8 | octet(8)) &
+                       0x7fffffff;
+    return header;
+  }
+
+  void serialize(char *out) const noexcept {
+    out[0] = static_cast<char>(length >> 16);
+    out[1] = static_cast<char>(length >> 8);
+    out[2] = static_cast<char>(length);
+    out[3] = static_cast<char>(type);
+    out[4] = static_cast<char>(flags);
+    out[5] = static_cast<char>(stream_id >> 24 & 0x7f);
+    out[6] = static_cast<char>(stream_id >> 16);
+    out[7] = static_cast<char>(stream_id >> 8);
+    out[8] = static_cast<char>(stream_id);
+  }
+};
+
+// Settings for the server side of HTTP/2 connections
+struct http2_options {
+  std::uint32_t max_concurrent_streams = 256;
+  // Receive windows for each stream and for the whole connection
+  std::uint32_t initial_window_size = 1 << 20;
+  std::uint32_t connection_window_size = 1 << 24;
+  std::uint32_t max_frame_size = 16384; // Largest frame accepted
+  std::uint32_t max_header_list_size = 65536;
+  std::uint32_t header_table_size = 4096; // HPACK table, each direction
+  std::size_t max_write_size = 1 << 20;   // DATA octets per flush()
+};
+
+namespace detail {
+
+inline std::uint32_t get_u32(const char *p) noexcept {
+  auto octet = [p](int i) {
+    return std::uint32_t{static_cast<std::uint8_t>(p[i])};
+  };
+  return octet(0) << 24 | octet(1) << 16 | octet(2) << 8 | octet(3);
+}
+
+inline void put_u32(std::string &out, std::uint32_t value) {
+  out.push_back(static_cast<char>(value >> 24));
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+// Decode base64url without padding, as HTTP2-Settings is sent
+inline bool base64url_decode(std::string_view text, std::string &out) {
+  std::uint32_t bits = 0;
+  int count = 0;
+  for (char c : text) {
+    int digit = c >= 'A' && c <= 'Z'   ? c - 'A'
+                : c >= 'a' && c <= 'z' ? c - 'a' + 26
+                : c >= '0' && c <= '9' ? c - '0' + 52
+                : c == '-'             ? 62
+                : c == '_'             ? 63
+                                       : -1;
+    if (digit < 0) {
+      return c == '=';
+    }
+    bits = bits << 6 | static_cast<std::uint32_t>(digit);
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      out.push_back(static_cast<char>(bits >> count));
+    }
+  }
+  return count < 6;
+}
+
+} // namespace detail
+
+// Server side of one HTTP/2 connection (RFC 9113), without the I/O: bytes
+// read from the socket go into receive(), which answers every complete
+// request through the handler, and flush() hands back iovecs to write.
+//
+// Header blocks are decoded into one arena shared by the connection's
+// streams, which is reset whenever no stream still needs its fields, so
+// steady traffic decodes headers without allocating. Request bodies are
+// buffered per stream and the handler runs once a request has ended.
+//
+// Response bodies are sent as DATA frames straight from the response,
+// within the peer's connection and stream windows. Streams with data to
+// send share the connection by weighted fair queuing on their PRIORITY
+// weight: each frame advances its stream's virtual time by length / weight
+// and the stream furthest behind goes next. Dependencies are parsed but not
+// followed (RFC 9113 deprecates the dependency tree).
+//
+// The iovecs from flush() point into the connection and its streams, so
+// receive() must not be called until written() has been.
+class http2_connection {
+public:
+  using handler = std::function<void(const http_request &, http_response &)>;
+
+  // `on_request` must outlive the connection
+  explicit http2_connection(const handler &on_request,
+                            http2_options options = {},
+                            std::size_t max_body_size = 1 << 20)
+      : _handler(&on_request), _options(options),
+        _max_body_size(max_body_size),
+        _decoder(std::max<std::size_t>(options.header_table_size, 4096)),
+        _encoder(options.header_table_size) {
+    // The server preface, then the rest of the connection window
+    std::string payload;
+    auto setting = [&](http2_setting id, std::uint32_t value) {
+      payload.push_back(0);
+      payload.push_back(static_cast<char>(id));
+      detail::put_u32(payload, value);
+    };
+    setting(http2_setting::header_table_size, _options.header_table_size);
+    setting(http2_setting::max_concurrent_streams,
+            _options.max_concurrent_streams);
+    setting(http2_setting::initial_window_size, _options.initial_window_size);
+    setting(http2_setting::max_frame_size, _options.max_frame_size);
+    setting(http2_setting::max_header_list_size,
+            _options.max_header_list_size);
+    put_frame(http2_frame_type::settings, 0, 0, payload);
+
+    _recv_window = std::max<std::int64_t>(_options.connection_window_size,
+                                          default_window);
+    if (_recv_window > default_window) {
+      put_window_update(0, static_cast<std::uint32_t>(_recv_window -
+                                                      default_window));
+    }
+  }
+
+  http2_connection(const http2_connection &) = delete;
+  http2_connection &operator=(const http2_connection &) = delete;
+
+  // Take over an HTTP/1.1 request that asked for "Upgrade: h2c": apply its
+  // HTTP2-Settings and answer it as stream 1. False if the settings are
+  // malformed.
+  bool upgrade(const http_request &request, std::string_view settings) {
+    std::string decoded;
+    if (!detail::base64url_decode(settings, decoded) ||
+        apply_settings(decoded) != http2_error::no_error) {
+      return false;
+    }
+
+    _last_stream_id = 1;
+    stream &s = open_stream(1, default_weight);
+    s.request_done = true;
+    _request = request;
+    _request._version = http_version::HTTP_2_0;
+    respond(s, _request);
+    return true;
+  }
+
+  // Process every complete frame in `data`; returns how many octets were
+  // used. The rest is an incomplete frame to pass in again with more data.
+  std::size_t receive(std::span<const char> data) {
+    std::size_t used = 0;
+    if (!_preface_received) {
+      std::size_t n = std::min(data.size(), http2_preface.size());
+      if (std::string_view(data.data(), n) != http2_preface.substr(0, n)) {
+        connection_error(http2_error::protocol_error);
+        return data.size();
+      }
+      if (n < http2_preface.size()) {
+        return 0;
+      }
+      _preface_received = true;
+      used = n;
+    }
+
+    while (!_closing && data.size() - used >= http2_frame_header::size) {
+      auto header = http2_frame_header::parse(data.data() + used);
+      if (header.length > _options.max_frame_size) {
+        connection_error(http2_error::frame_size_error);
+        break;
+      }
+      if (data.size() - used - http2_frame_header::size < header.length) {
+        break;
+      }
+      used += http2_frame_header::size;
+      on_frame(header, {data.data() + used, header.length});
+      used += header.length;
+    }
+    return _closing ? data.size() : used;
+  }
+
+  // Append iovecs for everything ready to send to `out`, scheduling DATA
+  // frames as the flow control windows allow. False if there is nothing.
+  bool flush(std::vector<iovec> &out) {
+    std::size_t budget = _options.max_write_size;
+    while (!_closing && budget > 0 && _send_window > 0 && !_ready.empty()) {
+      std::pop_heap(_ready.begin(), _ready.end(), std::greater<>{});
+      std::uint32_t id = _ready.back().second;
+      _ready.pop_back();
+
+      auto it = _streams.find(id);
+      if (it == _streams.end() || !it->second.queued) {
+        continue; // Reset while it was queued
+      }
+      stream &s = it->second;
+      if (s.send_window <= 0) {
+        s.queued = false; // Queued again by its next WINDOW_UPDATE
+        continue;
+      }
+
+      std::size_t n = std::min({s.pending.size(),
+                                std::size_t{_peer_max_frame_size},
+                                static_cast<std::size_t>(s.send_window),
+                                static_cast<std::size_t>(_send_window),
+                                budget});
+      bool last = n == s.pending.size();
+      put_frame_header(n, http2_frame_type::data,
+                       last ? http2_flags::end_stream : 0, id);
+      _segments.push_back({s.pending.data(), 0, n});
+      s.pending.remove_prefix(n);
+      s.send_window -= static_cast<std::int64_t>(n);
+      _send_window -= static_cast<std::int64_t>(n);
+      budget -= n;
+
+      _virtual_time = s.virtual_time;
+      s.virtual_time += n * max_weight / s.weight;
+      if (last) {
+        s.queued = false;
+        _finished.push_back(id);
+      } else {
+        _ready.emplace_back(s.virtual_time, id);
+        std::push_heap(_ready.begin(), _ready.end(), std::greater<>{});
+      }
+    }
+
+    for (const segment &seg : _segments) {
+      const char *p = seg.data != nullptr ? seg.data : _out.data() + seg.offset;
+      out.push_back({const_cast<char *>(p), seg.length});
+    }
+    return !_segments.empty();
+  }
+
+  // The iovecs from the last flush() have been written
+  void written() {
+    _out.clear();
+    _segments.clear();
+    for (std::uint32_t id : _finished) {
+      close_stream(id);
+    }
+    _finished.clear();
+    if (_closing) {
+      _done = true;
+    }
+  }
+
+  // Whether the connection should be closed: a GOAWAY has been sent, or
+  // the peer sent one and every stream has finished
+  bool closed() const noexcept {
+    return _done ||
+           (_goaway_received && _streams.empty() && _segments.empty());
+  }
+
+  std::size_t open_streams() const noexcept { return _streams.size(); }
+
+private:
+  static constexpr std::int64_t default_window = 65535;
+  static constexpr std::int64_t max_window = 0x7fffffff;
+  static constexpr std::uint16_t default_weight = 16;
+  static constexpr std::uint16_t max_weight = 256;
+
+  struct stream {
+    std::uint32_t id = 0;
+    bool request_done = false; // END_STREAM received
+    bool holds_fields = false; // Fields in _fields are still needed
+    std::size_t first_field = 0;
+    std::size_t field_count = 0;
+    std::string body;
+    std::int64_t recv_window = 0;
+    std::uint32_t recv_consumed = 0; // Not yet returned by WINDOW_UPDATE
+    std::int64_t send_window = 0;
+    std::uint16_t weight = default_weight;
+    std::uint64_t virtual_time = 0;
+    bool queued = false; // In _ready
+    http_response response;
+    std::string_view pending; // Body left to send
+  };
+
+  // Output is one byte string plus views of response bodies; a segment
+  // with null `data` is a range of _out
+  struct segment {
+    const char *data;
+    std::size_t offset;
+    std::size_t length;
+  };
+
+  void on_frame(const http2_frame_header &header, std::string_view payload) {
+    if (_continuation_id != 0 &&
+        (header.type != http2_frame_type::continuation ||
+         header.stream_id != _continuation_id)) {
+      connection_error(http2_error::protocol_error);
+      return;
+    }
+
+    switch (header.type) {
+    case http2_frame_type::data:
+      on_data(header, payload);
+      break;
+    case http2_frame_type::headers:
+      on_headers(header, payload);
+      break;
+    case http2_frame_type::continuation:
+      on_continuation(header, payload);
+      break;
+    case http2_frame_type::priority:
+      on_priority(header, payload);
+      break;
+    case http2_frame_type::rst_stream:
+      on_rst_stream(header, payload);
+      break;
+    case http2_frame_type::settings:
+      on_settings(header, payload);
+      break;
+    case http2_frame_type::ping:
+      on_ping(header, payload);
+      break;
+    case http2_frame_type::goaway:
+      if (header.stream_id != 0) {
+        connection_error(http2_error::protocol_error);
+      } else if (payload.size() < 8) {
+        connection_error(http2_error::frame_size_error);
+      } else {
+        _goaway_received = true;
+      }
+      break;
+    case http2_frame_type::window_update:
+      on_window_update(header, payload);
+      break;
+    case http2_frame_type::push_promise:
+      connection_error(http2_error::protocol_error); // Clients can't push
+      break;
+    default:
+      break; // Unknown frame types are ignored
+    }
+  }
+
+  // Strip the pad length and padding; false if they don't fit
+  static bool unpad(const http2_frame_header &header,
+                    std::string_view &payload) noexcept {
+    if (!(header.flags & http2_flags::padded)) {
+      return true;
+    }
+    if (payload.empty()) {
+      return false;
+    }
+    std::size_t padding = static_cast<std::uint8_t>(payload[0]);
+    payload.remove_prefix(1);
+    if (padding > payload.size()) {
+      return false;
+    }
+    payload.remove_suffix(padding);
+    return true;
+  }
+
+  void on_data(const http2_frame_header &header, std::string_view payload) {
+    if (header.stream_id == 0) {
+      connection_error(http2_error::protocol_error);
+      return;
+    }
+    std::int64_t flow = payload.size();
+    if (!unpad(header, payload)) {
+      connection_error(http2_error::protocol_error);
+      return;
+    }
+    if (flow > _recv_window) {
+      connection_error(http2_error::flow_control_error);
+      return;
+    }
+    _recv_window -= flow;
+    _recv_consumed += static_cast<std::uint32_t>(flow);
+    if (_recv_consumed >= _options.connection_window_size / 2) {
+      put_window_update(0, _recv_consumed);
+      _recv_window += _recv_consumed;
+      _recv_consumed = 0;
+    }
+
+    auto it = _streams.find(header.stream_id);
+    if (it == _streams.end()) {
+      if (header.stream_id > _last_stream_id) {
+        connection_error(http2_error::protocol_error); // Idle stream
+      }
+      return; // Already reset; frames may still be in flight
+    }
+    stream &s = it->second;
+    if (s.request_done) {
+      stream_error(s.id, http2_error::stream_closed);
+      return;
+    }
+    if (flow > s.recv_window) {
+      stream_error(s.id, http2_error::flow_control_error);
+      return;
+    }
+    s.recv_window -= flow;
+
+    if (s.body.size() + payload.size() > _max_body_size) {
+      // Answer now and stop the client sending the rest
+      s.request_done = true;
+      release_fields(s);
+      s.response.clear();
+      s.response.set_status(413);
+      std::uint32_t id = s.id;
+      send_response(s, false);
+      put_rst_stream(id, http2_error::no_error);
+      return;
+    }
+    s.body.append(payload);
+
+    if (header.flags & http2_flags::end_stream) {
+      s.request_done = true;
+      dispatch(s);
+      return;
+    }
+    s.recv_consumed += static_cast<std::uint32_t>(flow);
+    if (s.recv_consumed >= _options.initial_window_size / 2) {
+      put_window_update(s.id, s.recv_consumed);
+      s.recv_window += s.recv_consumed;
+      s.recv_consumed = 0;
+    }
+  }
+
+  void on_headers(const http2_frame_header &header, std::string_view payload) {
+    if (header.stream_id == 0 || !unpad(header, payload)) {
+      connection_error(http2_error::protocol_error);
+      return;
+    }
+
+    std::uint16_t weight = default_weight;
+    bool self_dependent = false;
+    if (header.flags & http2_flags::priority) {
+      if (payload.size() < 5) {
+        connection_error(http2_error::protocol_error);
+        return;
+      }
+      self_dependent =
+          (detail::get_u32(payload.data()) & 0x7fffffff) == header.stream_id;
+      weight = static_cast<std::uint16_t>(
+          static_cast<std::uint8_t>(payload[4]) + 1);
+      payload.remove_prefix(5);
+    }
+
+    if (header.flags & http2_flags::end_headers) {
+      on_header_block(header.stream_id, header.flags, weight, self_dependent,
+                      payload);
+      return;
+    }
+    _continuation_id = header.stream_id;
+    _continuation_flags = header.flags;
+    _continuation_weight = weight;
+    _continuation_self_dependent = self_dependent;
+    _header_block.assign(payload);
+  }
+
+  void on_continuation(const http2_frame_header &header,
+                       std::string_view payload) {
+    if (_continuation_id == 0) {
+      connection_error(http2_error::protocol_error);
+      return;
+    }
+    _header_block.append(payload);
+    if (_header_block.size() > _options.max_header_list_size) {
+      connection_error(http2_error::enhance_your_calm);
+      return;
+    }
+    if (header.flags & http2_flags::end_headers) {
+      std::uint32_t id = std::exchange(_continuation_id, 0);
+      on_header_block(id, _continuation_flags, _continuation_weight,
+                      _continuation_self_dependent, _header_block);
+    }
+  }
+
+  // A complete header block: a new request, or trailers
+  void on_header_block(std::uint32_t id, std::uint8_t flags,
+                       std::uint16_t weight, bool self_dependent,
+                       std::string_view block) {
+    auto bytes = std::as_bytes(std::span(block.data(), block.size()));
+    bool end_stream = flags & http2_flags::end_stream;
+
+    // Blocks that are not kept still update the decoder's table
+    auto discard = [&] {
+      _discarded.clear();
+      if (!_decoder.decode(bytes, _discarded,
+                           _options.max_header_list_size)) {
+        connection_error(http2_error::compression_error);
+        return false;
+      }
+      return true;
+    };
+
+    auto it = _streams.find(id);
+    if (it != _streams.end()) {
+      stream &s = it->second;
+      if (!discard()) {
+        return;
+      }
+      if (s.request_done) {
+        stream_error(id, http2_error::stream_closed);
+      } else if (!end_stream) {
+        stream_error(id, http2_error::protocol_error);
+      } else {
+        s.request_done = true; // Trailers, which are dropped
+        dispatch(s);
+      }
+      return;
+    }
+
+    if (id <= _last_stream_id) {
+      discard(); // Reset by us while the client was still sending
+      return;
+    }
+    if (id % 2 == 0) {
+      connection_error(http2_error::protocol_error);
+      return;
+    }
+    _last_stream_id = id;
+
+    if (self_dependent || _streams.size() >= _options.max_concurrent_streams) {
+      if (discard()) {
+        put_rst_stream(id, self_dependent ? http2_error::protocol_error
+                                          : http2_error::refused_stream);
+      }
+      return;
+    }
+
+    // Stopping early leaves the dynamic table behind the peer's, so a list
+    // over the advertised limit ends the connection rather than the stream
+    std::size_t first = _fields.size();
+    auto list_size =
+        _decoder.decode(bytes, _fields, _options.max_header_list_size);
+    if (!list_size) {
+      connection_error(http2_error::compression_error);
+      return;
+    }
+
+    stream &s = open_stream(id, weight);
+    s.holds_fields = true;
+    ++_field_holders;
+    s.first_field = first;
+    s.field_count = _fields.size() - first;
+
+    if (end_stream) {
+      s.request_done = true;
+      dispatch(s);
+    }
+  }
+
+  void on_priority(const http2_frame_header &header,
+                   std::string_view payload) {
+    if (header.stream_id == 0) {
+      connection_error(http2_error::protocol_error);
+      return;
+    }
+    if (payload.size() != 5) {
+      stream_error(header.stream_id, http2_error::frame_size_error);
+      return;
+    }
+    if ((detail::get_u32(payload.data()) & 0x7fffffff) == header.stream_id) {
+      stream_error(header.stream_id, http2_error::protocol_error);
+      return;
+    }
+    if (auto it = _streams.find(header.stream_id); it != _streams.end()) {
+      it->second.weight = static_cast<std::uint16_t>(
+          static_cast<std::uint8_t>(payload[4]) + 1);
+    }
+  }
+
+  void on_rst_stream(const http2_frame_header &header,
+                     std::string_view payload) {
+    if (payload.size() != 4) {
+      connection_error(http2_error::frame_size_error);
+    } else if (header.stream_id == 0 || header.stream_id > _last_stream_id) {
+      connection_error(http2_error::protocol_error);
+    } else {
+      close_stream(header.stream_id);
+    }
+  }
+
+  void on_settings(const http2_frame_header &header,
+                   std::string_view payload) {
+    if (header.stream_id != 0) {
+      connection_error(http2_error::protocol_error);
+      return;
+    }
+    if (header.flags & http2_flags::ack) {
+      if (!payload.empty()) {
+        connection_error(http2_error::frame_size_error);
+        return;
+      }
+      // Until now the peer could use the default table size
+      _decoder.set_max_table_size(_options.header_table_size);
+      return;
+    }
+    if (payload.size() % 6 != 0) {
+      connection_error(http2_error::frame_size_error);
+      return;
+    }
+    if (auto error = apply_settings(payload);
+        error != http2_error::no_error) {
+      connection_error(error);
+      return;
+    }
+    put_frame(http2_frame_type::settings, http2_flags::ack, 0, {});
+  }
+
+  http2_error apply_settings(std::string_view payload) {
+    if (payload.size() % 6 != 0) {
+      return http2_error::frame_size_error;
+    }
+    for (std::size_t i = 0; i < payload.size(); i += 6) {
+      auto id = static_cast<http2_setting>(
+          static_cast<std::uint8_t>(payload[i]) << 8 |
+          static_cast<std::uint8_t>(payload[i + 1]));
+      std::uint32_t value = detail::get_u32(payload.data() + i + 2);
+
+      switch (id) {
+      case http2_setting::header_table_size:
+        _encoder.set_max_table_size(
+            std::min(value, _options.header_table_size));
+        break;
+      case http2_setting::enable_push:
+        if (value > 1) {
+          return http2_error::protocol_error;
+        }
+        break;
+      case http2_setting::initial_window_size: {
+        if (value > max_window) {
+          return http2_error::flow_control_error;
+        }
+        // Applies to the windows of open streams too
+        std::int64_t delta = std::int64_t{value} - _peer_initial_window;
+        _peer_initial_window = value;
+        for (auto &[id, s] : _streams) {
+          s.send_window += delta;
+          if (s.send_window > max_window) {
+            return http2_error::flow_control_error;
+          }
+          schedule(s);
+        }
+        break;
+      }
+      case http2_setting::max_frame_size:
+        if (value < 16384 || value > 0xffffff) {
+          return http2_error::protocol_error;
+        }
+        _peer_max_frame_size = value;
+        break;
+      default:
+        break; // Nothing to do for the rest, or unknown
+      }
+    }
+    return http2_error::no_error;
+  }
+
+  void on_ping(const http2_frame_header &header, std::string_view payload) {
+    if (header.stream_id != 0) {
+      connection_error(http2_error::protocol_error);
+    } else if (payload.size() != 8) {
+      connection_error(http2_error::frame_size_error);
+    } else if (!(header.flags & http2_flags::ack)) {
+      put_frame(http2_frame_type::ping, http2_flags::ack, 0, payload);
+    }
+  }
+
+  void on_window_update(const http2_frame_header &header,
+                        std::string_view payload) {
+    if (payload.size() != 4) {
+      connection_error(http2_error::frame_size_error);
+      return;
+    }
+    std::int64_t increment = detail::get_u32(payload.data()) & 0x7fffffff;
+
+    if (header.stream_id == 0) {
+      if (increment == 0) {
+        connection_error(http2_error::protocol_error);
+      } else if ((_send_window += increment) > max_window) {
+        connection_error(http2_error::flow_control_error);
+      }
+      return;
+    }
+
+    auto it = _streams.find(header.stream_id);
+    if (it == _streams.end()) {
+      if (header.stream_id > _last_stream_id) {
+        connection_error(http2_error::protocol_error);
+      }
+      return;
+    }
+    stream &s = it->second;
+    if (increment == 0) {
+      stream_error(s.id, http2_error::protocol_error);
+    } else if ((s.send_window += increment) > max_window) {
+      stream_error(s.id, http2_error::flow_control_error);
+    } else {
+      schedule(s);
+    }
+  }
+
+  stream &open_stream(std::uint32_t id, std::uint16_t weight) {
+    stream &s = _streams[id];
+    s.id = id;
+    s.weight = weight;
+    // Until the client acknowledges our SETTINGS it may assume the default
+    s.recv_window =
+        std::max<std::int64_t>(_options.initial_window_size, default_window);
+    s.send_window = _peer_initial_window;
+    return s;
+  }
+
+  void release_fields(stream &s) noexcept {
+    if (s.holds_fields) {
+      s.holds_fields = false;
+      if (--_field_holders == 0) {
+        _fields.clear();
+      }
+    }
+  }
+
+  void close_stream(std::uint32_t id) {
+    if (auto it = _streams.find(id); it != _streams.end()) {
+      release_fields(it->second);
+      _streams.erase(it);
+    }
+  }
+
+  // The request on `s` has ended: run the handler on it
+  void dispatch(stream &s) {
+    int status = fill_request(s);
+    release_fields(s);
+    if (status < 0) {
+      stream_error(s.id, http2_error::protocol_error);
+      return;
+    }
+    if (status > 0) {
+      s.response.set_status(status);
+      send_response(s, false);
+      return;
+    }
+    respond(s, _request);
+  }
+
+  void respond(stream &s, const http_request &request) {
+    try {
+      (*_handler)(request, s.response);
+    } catch (...) {
+      s.response.clear();
+      s.response.set_status(500);
+    }
+    send_response(s, request.method() != http_method::HEAD);
+  }
+
+  // Build _request from the fields and body of `s`. Returns 0, a status to
+  // answer with instead of running the handler, or -1 if the request is
+  // malformed.
+  int fill_request(stream &s) {
+    http_request &request = _request;
+    request._version = http_version::HTTP_2_0;
+    request._target = {};
+    request._host = {};
+    request.clear_headers();
+    request._keep_alive = true;
+    request._content_length.reset();
+    request._chunked = false;
+    request._head_size = 0;
+    request._body = s.body;
+
+    std::string_view method;
+    std::string_view scheme;
+    std::string_view authority;
+    bool regular_seen = false;
+    int status = 0;
+
+    for (std::size_t i = 0; i < s.field_count; ++i) {
+      http_header field = _fields[s.first_field + i];
+      std::string_view name = field.name;
+
+      if (name.starts_with(':')) {
+        std::string_view *slot = name == ":method"      ? &method
+                                 : name == ":scheme"    ? &scheme
+                                 : name == ":path"      ? &request._target
+                                 : name == ":authority" ? &authority
+                                                        : nullptr;
+        if (regular_seen || slot == nullptr || !slot->empty()) {
+          return -1;
+        }
+        *slot = field.value;
+        continue;
+      }
+
+      regular_seen = true;
+      auto id = detail::find_http_field(name);
+      if (std::any_of(name.begin(), name.end(),
+                      [](char c) { return c >= 'A' && c <= 'Z'; }) ||
+          id == http_field::connection || id == http_field::keep_alive ||
+          id == http_field::transfer_encoding || id == http_field::upgrade ||
+          name == "proxy-connection" ||
+          (id == http_field::te && field.value != "trailers")) {
+        return -1;
+      }
+      if (id == http_field::content_length) {
+        auto length = detail::parse_length(field.value);
+        if (!length || (request._content_length &&
+                        *request._content_length != *length)) {
+          return -1;
+        }
+        request._content_length = length;
+      } else if (id == http_field::host && request._host.empty()) {
+        request._host = field.value;
+      }
+
+      if (request._header_count == http_request::max_headers) {
+        status = 431;
+      } else {
+        request.add_header(field);
+      }
+    }
+
+    auto parsed = detail::parse_method(method);
+    if (method.empty() ||
+        (parsed != http_method::CONNECT &&
+         (scheme.empty() || request._target.empty())) ||
+        (request._content_length &&
+         *request._content_length != s.body.size())) {
+      return -1;
+    }
+    if (!parsed) {
+      return 501;
+    }
+    request._method = *parsed;
+    if (!authority.empty()) {
+      request._host = authority;
+    }
+    if (request._method == http_method::CONNECT) {
+      request._target = authority;
+    }
+    return status;
+  }
+
+  // Send the response on `s` as HEADERS and CONTINUATION frames, then queue
+  // its body for DATA frames. Streams without a body are closed here.
+  void send_response(stream &s, bool include_body) {
+    http_response &response = s.response;
+    std::string_view body = response.body();
+    bool end_stream = !include_body || body.empty();
+
+    _block.clear();
+    _encoder.begin_block(_block);
+    int status = response.status();
+    if (status < 100 || status > 599) {
+      status = 500;
+    }
+    char number[20];
+    auto end = std::to_chars(number, number + 3, status).ptr;
+    _encoder.encode(":status", {number, end}, _block);
+
+    // Fields are kept as HTTP/1 lines; names go out in lowercase, and
+    // fields that only mean something to HTTP/1 connections are dropped
+    std::string_view fields = response.fields();
+    while (!fields.empty()) {
+      std::size_t line_end = fields.find("\r\n");
+      std::string_view line = fields.substr(0, line_end);
+      fields.remove_prefix(std::min(fields.size(), line_end + 2));
+      std::size_t colon = line.find(':');
+      if (colon == std::string_view::npos) {
+        continue;
+      }
+      std::string_view value = line.substr(colon + 1);
+      while (!value.empty() && value.front() == ' ') {
+        value.remove_prefix(1);
+      }
+
+      _name.assign(line.substr(0, colon));
+      for (char &c : _name) {
+        if (c >= 'A' && c <= 'Z') {
+          c = static_cast<char>(c | 0x20);
+        }
+      }
+      if (_name == "connection" || _name == "keep-alive" ||
+          _name == "proxy-connection" || _name == "transfer-encoding" ||
+          _name == "upgrade") {
+        continue;
+      }
+      _encoder.encode(_name, value, _block);
+    }
+
+    _encoder.encode("date", detail::http_date(), _block);
+    end = std::to_chars(number, number + sizeof(number), body.size()).ptr;
+    _encoder.encode("content-length", {number, end}, _block);
+
+    // Split at the peer's frame size
+    std::string_view block = _block;
+    auto type = http2_frame_type::headers;
+    std::uint8_t flags = end_stream ? http2_flags::end_stream : 0;
+    do {
+      std::string_view part = block.substr(0, _peer_max_frame_size);
+      block.remove_prefix(part.size());
+      if (block.empty()) {
+        flags |= http2_flags::end_headers;
+      }
+      put_frame(type, flags, s.id, part);
+      type = http2_frame_type::continuation;
+      flags = 0;
+    } while (!block.empty());
+
+    if (end_stream) {
+      close_stream(s.id);
+      return;
+    }
+    s.pending = body;
+    schedule(s);
+  }
+
+  // Queue `s` for DATA frames if it has something to send and room to
+  // send it
+  void schedule(stream &s) {
+    if (s.queued || s.pending.empty() || s.send_window <= 0) {
+      return;
+    }
+    // A stream that was idle starts level with the others
+    s.virtual_time = std::max(s.virtual_time, _virtual_time);
+    s.queued = true;
+    _ready.emplace_back(s.virtual_time, s.id);
+    std::push_heap(_ready.begin(), _ready.end(), std::greater<>{});
+  }
+
+  void stream_error(std::uint32_t id, http2_error error) {
+    put_rst_stream(id, error);
+    close_stream(id);
+  }
+
+  // Send GOAWAY and stop processing; the connection closes once it has
+  // been written
+  void connection_error(http2_error error) {
+    if (_closing) {
+      return;
+    }
+    std::string payload;
+    detail::put_u32(payload, _last_stream_id);
+    detail::put_u32(payload, static_cast<std::uint32_t>(error));
+    put_frame(http2_frame_type::goaway, 0, 0, payload);
+    _closing = true;
+  }
+
+  void put_rst_stream(std::uint32_t id, http2_error error) {
+    std::string payload;
+    detail::put_u32(payload, static_cast<std::uint32_t>(error));
+    put_frame(http2_frame_type::rst_stream, 0, id, payload);
+  }
+
+  void put_window_update(std::uint32_t id, std::uint32_t increment) {
+    std::string payload;
+    detail::put_u32(payload, increment);
+    put_frame(http2_frame_type::window_update, 0, id, payload);
+  }
+
+  void put_frame_header(std::size_t length, http2_frame_type type,
+                        std::uint8_t flags, std::uint32_t id) {
+    http2_frame_header header{static_cast<std::uint32_t>(length), type, flags,
+                              id};
+    std::size_t at = _out.size();
+    _out.resize(at + http2_frame_header::size);
+    header.serialize(_out.data() + at);
+    own(at, http2_frame_header::size);
+  }
+
+  void put_frame(http2_frame_type type, std::uint8_t flags, std::uint32_t id,
+                 std::string_view payload) {
+    put_frame_header(payload.size(), type, flags, id);
+    std::size_t at = _out.size();
+    _out.append(payload);
+    own(at, payload.size());
+  }
+
+  // Add a range of _out to the output, merged with the one before it
+  void own(std::size_t offset, std::size_t length) {
+    if (!_segments.empty() && _segments.back().data == nullptr &&
+        _segments.back().offset + _segments.back().length == offset) {
+      _segments.back().length += length;
+    } else if (length > 0) {
+      _segments.push_back({nullptr, offset, length});
+    }
+  }
+
+  const handler *_handler;
+  http2_options _options;
+  std::size_t _max_body_size;
+
+  hpack_decoder _decoder;
+  hpack_encoder _encoder;
+  hpack_header_list _fields;    // Request fields of every stream
+  hpack_header_list _discarded; // Trailers and refused requests
+  std::size_t _field_holders = 0;
+  http_request _request;
+
+  std::unordered_map<std::uint32_t, stream> _streams;
+  std::uint32_t _last_stream_id = 0;
+  bool _preface_received = false;
+  bool _goaway_received = false;
+  bool _closing = false; // GOAWAY queued
+  bool _done = false;    // ... and written
+
+  // Header block split over CONTINUATION frames
+  std::uint32_t _continuation_id = 0;
+  std::uint8_t _continuation_flags = 0;
+  std::uint16_t _continuation_weight = default_weight;
+  bool _continuation_self_dependent = false;
+  std::string _header_block;
+
+  // Flow control
+  std::int64_t _recv_window = default_window;
+  std::uint32_t _recv_consumed = 0;
+  std::int64_t _send_window = default_window;
+  std::int64_t _peer_initial_window = default_window;
+  std::uint32_t _peer_max_frame_size = 16384;
+
+  // Streams with DATA to send, by virtual time
+  std::vector<std::pair<std::uint64_t, std::uint32_t>> _ready;
+  std::uint64_t _virtual_time = 0;
+  std::vector<std::uint32_t> _finished; // Sent; closed by written()
+
+  std::string _out;
+  std::vector<segment> _segments;
+  std::string _block; // Response header block being encoded
+  std::string _name;
+};
+
+} // namespace net
@@ -0,0 +1,606 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "event_loop.hpp"
+#include "http_parser.hpp"
+#include "http_request.hpp"
+#include "http_response.hpp"
+#include "task.hpp"
+#include "tcp_stream.hpp"
+
+namespace net {
+
+// Incremental decoder for the chunked transfer coding (RFC 9112 7.1).
+//
+// Decoding is done in place: chunk data is moved down over the framing in
+// front of it, so the data decoded so far is one contiguous run no matter
+// how the body was split into chunks or reads, and nothing is allocated.
+// Chunk extensions are skipped and trailer fields are discarded.
+class http_chunked_decoder {
+public:
+  // Longest chunk size line (with extensions) or trailer line
+  static constexpr std::size_t max_line_size = 4096;
+
+  // Decode `size` octets at `in`, writing chunk data to `out`, which may be
+  // `in` itself or anywhere before it in the same buffer. Adds the data
+  // written to `produced` and returns how many input octets were used:
+  // all of them, unless the body ended before the input did.
+  std::expected<std::size_t, std::error_code>
+  decode(const char *in, std::size_t size, char *out, std::size_t &produced) {
+    const char *p = in;
+    const char *end = in + size;
+
+    while (p != end && _state != state::done) {
+      char c = *p;
+      switch (_state) {
+      case state::size:
+        if (int digit = hex_digit(c); digit >= 0) {
+          if (_digits++ == 15) {
+            return fail(); // Would overflow
+          }
+          _remaining = _remaining << 4 | static_cast<std::uint64_t>(digit);
+        } else if (_digits == 0) {
+          return fail();
+        } else if (c == ';' || c == ' ' || c == '\t') {
+          _state = state::extension;
+        } else if (!line_end(c)) {
+          return fail();
+        }
+        break;
+
+      case state::extension:
+        if (!line_end(c) && ++_line > max_line_size) {
+          return fail();
+        }
+        break;
+
+      case state::size_lf:
+        if (c != '\n') {
+          return fail();
+        }
+        start_line();
+        _state = _remaining == 0 ? state::trailer : state::data;
+        break;
+
+      case state::data: {
+        std::size_t n = static_cast<std::size_t>(
+            std::min<std::uint64_t>(_remaining, end - p));
+        std::memmove(out + produced, p, n);
+        produced += n;
+        _remaining -= n;
+        p += n;
+        if (_remaining == 0) {
+          _state = state::data_cr;
+        }
+        continue;
+      }
+
+      case state::data_cr:
+        if (c == '\r') {
+          _state = state::data_lf;
+        } else if (c == '\n') {
+          _state = state::size;
+        } else {
+          return fail();
+        }
+        break;
+
+      case state::data_lf:
+        if (c != '\n') {
+          return fail();
+        }
+        _state = state::size;
+        break;
+
+      case state::trailer:
+        // A blank line ends the body; anything else is a trailer field
+        if (c == '\r' && _line == 0) {
+          _state = state::trailer_lf;
+        } else if (c == '\n') {
+          if (_line == 0) {
+            _state = state::done;
+          }
+          _line = 0;
+        } else if (++_line > max_line_size) {
+          return fail();
+        }
+        break;
+
+      case state::trailer_lf:
+        if (c != '\n') {
+          return fail();
+        }
+        _state = state::done;
+        break;
+
+      case state::done:
+        break;
+      }
+      ++p;
+    }
+    return static_cast<std::size_t>(p - in);
+  }
+
+  // Whether the last chunk and its trailers have been decoded
+  bool done() const noexcept { return _state == state::done; }
+
+  void reset() noexcept { *this = {}; }
+
+private:
+  enum class state : std::uint8_t {
+    size,
+    extension,
+    size_lf,
+    data,
+    data_cr,
+    data_lf,
+    trailer,
+    trailer_lf,
+    done
+  };
+
+  static int hex_digit(char c) noexcept {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+    c = static_cast<char>(c | 0x20);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+  }
+
+  // End of a size line: CRLF, or a bare LF as http_parser accepts
+  bool line_end(char c) noexcept {
+    if (c == '\r') {
+      _state = state::size_lf;
+      return true;
+    }
+    if (c == '\n') {
+      start_line();
+      _state = _remaining == 0 ? state::trailer : state::data;
+      return true;
+    }
+    return false;
+  }
+
+  void start_line() noexcept {
+    _line = 0;
+    _digits = 0;
+  }
+
+  std::unexpected<std::error_code> fail() noexcept {
+    return std::unexpected(make_error_code(http_error::bad_chunk));
+  }
+
+  state _state = state::size;
+  std::uint64_t _remaining = 0; // Size, then what is left, of this chunk
+  unsigned _digits = 0;
+  std::size_t _line = 0;
+};
+
+namespace detail {
+
+// "<size in hex>\r\n" in front of a chunk
+inline std::string_view chunk_header(std::size_t size,
+                                     std::array<char, 20> &out) noexcept {
+  char *p = std::to_chars(out.data(), out.data() + 16, size, 16).ptr;
+  *p++ = '\r';
+  *p++ = '\n';
+  return {out.data(), static_cast<std::size_t>(p - out.data())};
+}
+
+// Interim response for a client waiting to send its body
+inline constexpr std::string_view continue_response =
+    "HTTP/1.1 100 Continue\r\n\r\n";
+
+// Whether the client waits for continue_response before sending the body
+// (RFC 9110 10.1.1); HTTP/1.0 clients don't know to
+inline bool expects_continue(const http_request &request) noexcept {
+  auto expect = request.header(http_field::expect);
+  return request.version() != http_version::HTTP_1_0 && expect &&
+         iequals(*expect, "100-continue");
+}
+
+// Shuts a connection's socket down when it fires, which fails the read or
+// write the connection is waiting on
+class connection_deadline {
+public:
+  explicit connection_deadline(int fd) noexcept
+      : _loop(event_loop::current()), _fd(fd) {}
+
+  connection_deadline(const connection_deadline &) = delete;
+  connection_deadline &operator=(const connection_deadline &) = delete;
+
+  ~connection_deadline() {
+    if (_loop != nullptr && _timer != 0) {
+      _loop->cancel_timer(_timer);
+    }
+  }
+
+  // Fire `timeout` from now, replacing the previous deadline
+  void expires_after(std::chrono::milliseconds timeout) {
+    if (_loop == nullptr) {
+      return;
+    }
+    if (timeout <= std::chrono::milliseconds::zero()) {
+      _loop->cancel_timer(std::exchange(_timer, 0));
+    } else if (_timer == 0 || !_loop->reschedule_timer(_timer, timeout)) {
+      _timer = _loop->add_timer(timeout,
+                                [fd = _fd] { ::shutdown(fd, SHUT_RDWR); });
+    }
+  }
+
+private:
+  event_loop *_loop;
+  int _fd;
+  event_loop::timer_id _timer = 0;
+};
+
+} // namespace detail
+
+// Request body of a streaming handler (see http_server), read as it
+// arrives. Each read() returns the next run of body data as a view into the
+// connection's receive buffer that is valid until the next read(); chunked
+// bodies are decoded in place. The socket is only read when the handler
+// asks for more, so a handler that consumes slowly holds the client back
+// through TCP flow control instead of the body piling up in memory.
+class http_body_reader {
+public:
+  using result_type = std::expected<std::span<const char>, std::error_code>;
+
+  // Awaitable returned by read(). Completes without suspending while data
+  // is buffered or the socket has more, so a handler looping over a fast
+  // upload doesn't nest a coroutine per read.
+  class read_op {
+  public:
+    bool await_ready() { return _reader->poll(_result); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) {
+      _wait = _reader->wait(_result);
+      return std::move(_wait).operator co_await().await_suspend(handle);
+    }
+
+    result_type await_resume() { return std::move(_result); }
+
+  private:
+    friend class http_body_reader;
+
+    explicit read_op(http_body_reader &reader) noexcept : _reader(&reader) {}
+
+    http_body_reader *_reader;
+    result_type _result;
+    task<void> _wait;
+  };
+
+  http_body_reader(const http_body_reader &) = delete;
+  http_body_reader &operator=(const http_body_reader &) = delete;
+
+  // The next part of the body; empty once all of it has been read
+  read_op read() noexcept { return read_op(*this); }
+
+  // Whether the whole body has been read
+  bool done() const noexcept { return _done; }
+
+  // Body octets read so far
+  std::size_t size() const noexcept { return _size; }
+
+private:
+  friend class http_server;
+
+  // The body starts at `begin` in `buffer` and may run past `end`. `begin`
+  // is also where the request head ends, so reads go no lower than that;
+  // each must finish within `timeout`.
+  http_body_reader(tcp_stream &client, detail::connection_deadline &deadline,
+                   std::chrono::milliseconds timeout,
+                   std::vector<char> &buffer, std::size_t &begin,
+                   std::size_t &end, const http_request &request)
+      : _client(&client), _deadline(&deadline), _timeout(timeout),
+        _buffer(&buffer), _begin(&begin), _end(&end), _floor(begin),
+        _chunked(request.chunked()),
+        _remaining(request.content_length().value_or(0)) {
+    _done = !_chunked && _remaining == 0;
+    _expect_continue = !_done && detail::expects_continue(request);
+  }
+
+  // Produce the next result from what is buffered. False once the buffer
+  // is used up, which also rewinds it to just behind the request head,
+  // since the handler's request still points into that.
+  bool take(result_type &result) {
+    if (_done) {
+      result = std::span<const char>{};
+      return true;
+    }
+
+    std::size_t available = *_end - *_begin;
+    char *start = _buffer->data() + *_begin;
+    if (available > 0 && !_chunked) {
+      std::size_t n = static_cast<std::size_t>(
+          std::min<std::uint64_t>(available, _remaining));
+      *_begin += n;
+      _remaining -= n;
+      _done = _remaining == 0;
+      _size += n;
+      result = std::span<const char>(start, n);
+      return true;
+    }
+    if (available > 0) {
+      std::size_t produced = 0;
+      auto used = _decoder.decode(start, available, start, produced);
+      if (!used) {
+        result = std::unexpected(used.error());
+        return true;
+      }
+      *_begin += *used;
+      _done = _decoder.done();
+      _size += produced;
+      if (produced > 0 || _done) {
+        result = std::span<const char>(start, produced);
+        return true;
+      }
+      // Only framing was buffered, and all of it was used
+    }
+
+    *_begin = *_end = _floor;
+    return false;
+  }
+
+  std::span<std::byte> space() noexcept {
+    return std::as_writable_bytes(std::span(*_buffer).subspan(*_end));
+  }
+
+  // Account for a socket read; false, with `result` set, if it failed
+  bool received(std::expected<std::size_t, std::error_code> n,
+                result_type &result) {
+    if (!n) {
+      result = std::unexpected(n.error());
+      return false;
+    }
+    if (*n == 0) {
+      result =
+          std::unexpected(std::make_error_code(std::errc::connection_reset));
+      return false;
+    }
+    *_end += *n;
+    return true;
+  }
+
+  // read() without suspending: true if `result` is set
+  bool poll(result_type &result) {
+    for (;;) {
+      if (take(result)) {
+        return true;
+      }
+      if (_expect_continue) {
+        return false;
+      }
+      auto op = _client->async_read_some(space());
+      if (!op.await_ready()) {
+        return false;
+      }
+      if (!received(op.await_resume(), result)) {
+        return true;
+      }
+    }
+  }
+
+  // read() once the socket has to be waited on
+  task<void> wait(result_type &result) {
+    for (;;) {
+      if (take(result)) {
+        co_return;
+      }
+
+      if (_expect_continue) {
+        _expect_continue = false;
+        auto sent = co_await _client->async_write(std::as_bytes(std::span(
+            detail::continue_response.data(),
+            detail::continue_response.size())));
+        if (!sent) {
+          result = std::unexpected(sent.error());
+          co_return;
+        }
+      }
+
+      _deadline->expires_after(_timeout);
+      auto n = co_await _client->async_read_some(space());
+      _deadline->expires_after(std::chrono::milliseconds::zero());
+      if (!received(n, result)) {
+        co_return;
+      }
+    }
+  }
+
+  tcp_stream *_client;
+  detail::connection_deadline *_deadline;
+  std::chrono::milliseconds _timeout;
+  std::vector<char> *_buffer;
+  std::size_t *_begin;
+  std::size_t *_end;
+  std::size_t _floor;
+  bool _chunked;
+  bool _done = false;
+  bool _expect_continue = false;
+  std::uint64_t _remaining; // Content-Length bodies
+  http_chunked_decoder _decoder;
+  std::size_t _size = 0;
+};
+
+// Response of a streaming handler. Either fill in response() and return,
+// and the server sends it as it would any other, or call start() to send
+// its status and fields and then stream the body with write() and
+// finish(). Each write() is a single writev that completes once the socket
+// has taken all of it, so a producer can't run ahead of a slow client.
+class http_body_writer {
+public:
+  using result_type = std::expected<void, std::error_code>;
+
+  // Awaitable returned by start(), write() and finish(); like the writev
+  // it wraps, it completes without suspending if the socket takes it all
+  class send_op {
+  public:
+    bool await_ready() { return !_op || _op->await_ready(); }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      _writer->_deadline->expires_after(_writer->_timeout);
+      _armed = true;
+      return _op->await_suspend(handle);
+    }
+
+    result_type await_resume() {
+      if (!_op) {
+        return _result;
+      }
+      if (_armed) {
+        _writer->_deadline->expires_after(std::chrono::milliseconds::zero());
+      }
+      auto sent = _op->await_resume();
+      if (!sent) {
+        _writer->_failed = true;
+        return std::unexpected(sent.error());
+      }
+      return {};
+    }
+
+  private:
+    friend class http_body_writer;
+
+    // Send the writer's iovecs
+    explicit send_op(http_body_writer &writer) : _writer(&writer) {
+      _op.emplace(writer._client->async_writev(writer._iov));
+    }
+
+    // Nothing to send
+    send_op(http_body_writer &writer, result_type result) noexcept
+        : _writer(&writer), _result(result) {}
+
+    http_body_writer *_writer;
+    std::optional<detail::writev_op> _op;
+    result_type _result;
+    bool _armed = false;
+  };
+
+  http_body_writer(const http_body_writer &) = delete;
+  http_body_writer &operator=(const http_body_writer &) = delete;
+
+  http_response &response() noexcept { return *_response; }
+
+  // Send the status line and fields of response(). With a length, the
+  // body is framed by Content-Length and must be exactly that long;
+  // without one it is sent chunked, or to an HTTP/1.0 client as is, ended
+  // by closing the connection.
+  send_op start(std::optional<std::size_t> content_length = std::nullopt) {
+    _iov.clear();
+    begin(content_length);
+    return send_op(*this);
+  }
+
+  // Send the next part of the body; a chunk of its own when chunked.
+  // Writing before start() starts a body of unknown length.
+  send_op write(std::span<const char> data) {
+    bool starting = !_started;
+    _iov.clear();
+    if (starting) {
+      begin(std::nullopt);
+    }
+    if (_length && _written + data.size() > *_length) {
+      return fail();
+    }
+    _written += data.size();
+    if (_head_only || data.empty()) {
+      return starting ? send_op(*this) : send_op(*this, {});
+    }
+
+    if (_chunked) {
+      push(detail::chunk_header(data.size(), _chunk_header));
+    }
+    push({data.data(), data.size()});
+    if (_chunked) {
+      push("\r\n");
+    }
+    return send_op(*this);
+  }
+
+  // End the body: the last chunk when chunked; with a Content-Length,
+  // fails if less than that was written
+  send_op finish() {
+    _finished = true;
+    if (_length && _written != *_length) {
+      return fail();
+    }
+    if (!_chunked || _head_only) {
+      return send_op(*this, {});
+    }
+    _iov.clear();
+    push("0\r\n\r\n");
+    return send_op(*this);
+  }
+
+  bool started() const noexcept { return _started; }
+
+  bool finished() const noexcept { return _finished; }
+
+  // Body octets written so far
+  std::size_t size() const noexcept { return _written; }
+
+private:
+  friend class http_server;
+
+  // Each write must finish within `timeout`
+  http_body_writer(tcp_stream &client, detail::connection_deadline &deadline,
+                   std::chrono::milliseconds timeout, http_response &response,
+                   bool head_only)
+      : _client(&client), _deadline(&deadline), _timeout(timeout),
+        _response(&response), _head_only(head_only) {}
+
+  // Queue the head for a body of `content_length`
+  void begin(std::optional<std::size_t> content_length) {
+    _started = true;
+    _head_only = _head_only || _response->bodiless();
+    _length = content_length;
+    _chunked = !content_length &&
+               _response->version() != http_version::HTTP_1_0;
+    _response->serialize_head(_iov, detail::http_date(), content_length);
+  }
+
+  void push(std::string_view data) {
+    _iov.push_back({const_cast<char *>(data.data()), data.size()});
+  }
+
+  // The body doesn't match the Content-Length given to start()
+  send_op fail() {
+    _failed = true;
+    return send_op(*this,
+                   std::unexpected(make_error_code(std::errc::message_size)));
+  }
+
+  tcp_stream *_client;
+  detail::connection_deadline *_deadline;
+  std::chrono::milliseconds _timeout;
+  http_response *_response;
+  bool _head_only;
+  bool _started = false;
+  bool _finished = false;
+  bool _failed = false; // The connection can't be reused
+  bool _chunked = false;
+  std::optional<std::size_t> _length;
+  std::size_t _written = 0;
+  std::vector<iovec> _iov;
+  std::array<char, 20> _chunk_header{};
+};
+
+} // namespace net
@@ -0,0 +1,505 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+#include "http_request.hpp"
+
+namespace net {
+
+// Reasons a request is rejected; all of them warrant a 4xx response
+enum class http_error {
+  bad_request_line = 1,
+  unsupported_method,
+  unsupported_version,
+  bad_header,
+  too_many_headers,
+  head_too_large,
+  missing_host,
+  bad_content_length,
+  bad_transfer_encoding,
+  bad_chunk,
+  body_too_large
+};
+
+class http_error_category : public std::error_category {
+public:
+  const char *name() const noexcept override { return "http"; }
+
+  std::string message(int ev) const override {
+    switch (static_cast<http_error>(ev)) {
+    case http_error::bad_request_line:
+      return "Malformed request line";
+    case http_error::unsupported_method:
+      return "Unsupported request method";
+    case http_error::unsupported_version:
+      return "Unsupported HTTP version";
+    case http_error::bad_header:
+      return "Malformed header field";
+    case http_error::too_many_headers:
+      return "Too many header fields";
+    case http_error::head_too_large:
+      return "Request head too large";
+    case http_error::missing_host:
+      return "Missing Host header";
+    case http_error::bad_content_length:
+      return "Invalid Content-Length";
+    case http_error::bad_transfer_encoding:
+      return "Invalid Transfer-Encoding";
+    case http_error::bad_chunk:
+      return "Malformed chunked body";
+    case http_error::body_too_large:
+      return "Request body too large";
+    default:
+      return "Unknown http error";
+    }
+  }
+};
+
+inline const std::error_category &http_category() noexcept {
+  static const http_error_category instance;
+  return instance;
+}
+
+inline std::error_code make_error_code(http_error e) noexcept {
+  return {static_cast<int>(e), http_category()};
+}
+
+namespace detail {
+
+// RFC 9110 token characters (method and header names)
+inline constexpr auto token_chars = [] {
+  std::array<bool, 256> table{};
+  for (int c = '0'; c <= '9'; ++c) {
+    table[c] = true;
+  }
+  for (int c = 'a'; c <= 'z'; ++c) {
+    table[c] = true;
+    table[c - 'a' + 'A'] = true;
+  }
+  for (char c : std::string_view("!#$%&'*+-.^_`|~")) {
+    table[static_cast<unsigned char>(c)] = true;
+  }
+  return table;
+}();
+
+// Request target: visible ASCII and obs-text, no spaces
+constexpr bool is_target_char(unsigned char c) noexcept {
+  return c > 0x20 && c != 0x7f;
+}
+
+// Field value: anything but control characters other than tab
+constexpr bool is_value_char(unsigned char c) noexcept {
+  return c >= 0x20 ? c != 0x7f : c == '\t';
+}
+
+#ifdef __SSE4_2__
+// First byte of a 16 byte block inside any of the [lo, hi] pairs in
+// `ranges`, or 16 if none is
+inline int find_in_ranges(const char *p, __m128i ranges,
+                          int ranges_size) noexcept {
+  __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  return _mm_cmpestri(ranges, ranges_size, block, 16,
+                      _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES |
+                          _SIDD_LEAST_SIGNIFICANT);
+}
+#endif
+
+// First byte in [p, end) that is not a token character
+inline const char *scan_token(const char *p, const char *end) noexcept {
+#ifdef __SSE4_2__
+  // Non-token ranges, except that "{|}~" and DEL are lumped together; a
+  // hit on '|' or '~' is rechecked below
+  const __m128i ranges =
+      _mm_setr_epi8('\x00', ' ', '"', '"', '(', ')', ',', ',', '/', '/', ':',
+                    '@', '[', ']', '{', '\xff');
+  while (end - p >= 16) {
+    int i = find_in_ranges(p, ranges, 16);
+    p += i;
+    if (i == 16) {
+      continue;
+    }
+    if (!token_chars[static_cast<unsigned char>(*p)]) {
+      return p;
+    }
+    ++p;
+  }
+#endif
+  while (p != end && token_chars[static_cast<unsigned char>(*p)]) {
+    ++p;
+  }
+  return p;
+}
+
+// First byte in [p, end) that cannot appear in a request target
+inline const char *scan_target(const char *p, const char *end) noexcept {
+#if defined(__AVX2__)
+  const __m256i space = _mm256_set1_epi8(0x20);
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  while (end - p >= 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i low = _mm256_cmpeq_epi8(_mm256_max_epu8(block, space), space);
+    __m256i stop = _mm256_or_si256(low, _mm256_cmpeq_epi8(block, del));
+    if (auto mask = static_cast<unsigned>(_mm256_movemask_epi8(stop))) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+#elif defined(__SSE4_2__)
+  const __m128i ranges = _mm_setr_epi8('\x00', ' ', '\x7f', '\x7f', 0, 0, 0, 0,
+                                       0, 0, 0, 0, 0, 0, 0, 0);
+  while (end - p >= 16) {
+    int i = find_in_ranges(p, ranges, 4);
+    if (i != 16) {
+      return p + i;
+    }
+    p += 16;
+  }
+#endif
+  while (p != end && is_target_char(static_cast<unsigned char>(*p))) {
+    ++p;
+  }
+  return p;
+}
+
+// First byte in [p, end) that cannot appear in a field value; for a well
+// formed line that is the CR or LF ending it
+inline const char *scan_value(const char *p, const char *end) noexcept {
+#if defined(__AVX2__)
+  const __m256i unit_separator = _mm256_set1_epi8(0x1f);
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  while (end - p >= 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i control = _mm256_cmpeq_epi8(
+        _mm256_max_epu8(block, unit_separator), unit_separator);
+    control = _mm256_andnot_si256(_mm256_cmpeq_epi8(block, tab), control);
+    __m256i stop = _mm256_or_si256(control, _mm256_cmpeq_epi8(block, del));
+    if (auto mask = static_cast<unsigned>(_mm256_movemask_epi8(stop))) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+#elif defined(__SSE4_2__)
+  const __m128i ranges = _mm_setr_epi8('\x00', '\x08', '\x0a', '\x1f', '\x7f',
+                                       '\x7f', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  while (end - p >= 16) {
+    int i = find_in_ranges(p, ranges, 6);
+    if (i != 16) {
+      return p + i;
+    }
+    p += 16;
+  }
+#endif
+  while (p != end && is_value_char(static_cast<unsigned char>(*p))) {
+    ++p;
+  }
+  return p;
+}
+
+// Skip a CRLF or bare LF at p
+inline bool consume_line_end(const char *&p, const char *end) noexcept {
+  if (p != end && *p == '\r') {
+    ++p;
+  }
+  if (p == end || *p != '\n') {
+    return false;
+  }
+  ++p;
+  return true;
+}
+
+// Call f with each trimmed element of a comma-separated list
+template <typename F> void for_each_element(std::string_view list, F &&f) {
+  while (!list.empty()) {
+    std::size_t comma = list.find(',');
+    std::string_view element = list.substr(0, comma);
+    while (!element.empty() &&
+           (element.front() == ' ' || element.front() == '\t')) {
+      element.remove_prefix(1);
+    }
+    while (!element.empty() &&
+           (element.back() == ' ' || element.back() == '\t')) {
+      element.remove_suffix(1);
+    }
+    if (!element.empty()) {
+      f(element);
+    }
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    list.remove_prefix(comma + 1);
+  }
+}
+
+inline std::optional<http_method> parse_method(std::string_view name) noexcept {
+  switch (name.size()) {
+  case 3:
+    if (name == "GET") return http_method::GET;
+    if (name == "PUT") return http_method::PUT;
+    break;
+  case 4:
+    if (name == "POST") return http_method::POST;
+    if (name == "HEAD") return http_method::HEAD;
+    break;
+  case 5:
+    if (name == "PATCH") return http_method::PATCH;
+    if (name == "TRACE") return http_method::TRACE;
+    break;
+  case 6:
+    if (name == "DELETE") return http_method::DELETE;
+    break;
+  case 7:
+    if (name == "OPTIONS") return http_method::OPTIONS;
+    if (name == "CONNECT") return http_method::CONNECT;
+    break;
+  }
+  return std::nullopt;
+}
+
+inline std::optional<std::size_t>
+parse_length(std::string_view digits) noexcept {
+  if (digits.empty()) {
+    return std::nullopt;
+  }
+  std::size_t value = 0;
+  for (char c : digits) {
+    if (c < '0' || c > '9' || value > (SIZE_MAX - 9) / 10) {
+      return std::nullopt;
+    }
+    value = value * 10 + static_cast<std::size_t>(c - '0');
+  }
+  return value;
+}
+
+} // namespace detail
+
+// Incremental HTTP/1.1 request head parser.
+//
+// Call parse() with everything received so far for the current request,
+// each time more arrives. The parser remembers how far it has looked for
+// the blank line ending the head, so bytes are only scanned once no matter
+// how the head is split across reads, and the buffer may be reallocated
+// between calls as long as its contents are kept. Once the head is complete
+// it is parsed in a single pass into an http_request whose fields are views
+// into the buffer; nothing is copied or allocated.
+class http_parser {
+public:
+  static constexpr std::size_t default_max_head_size = 8192;
+
+  explicit http_parser(std::size_t max_head_size = default_max_head_size)
+      : _max_head_size(max_head_size) {}
+
+  // Returns the size of the request head once it is complete (the body, or
+  // the next pipelined request, starts there), 0 if more data is needed, or
+  // an http_error. The parser resets itself after a result other than 0.
+  std::expected<std::size_t, std::error_code> parse(std::string_view buffer,
+                                                    http_request &request) {
+    std::size_t head_size = find_head_end(buffer);
+    if (head_size == 0) {
+      if (buffer.size() > _max_head_size) {
+        reset();
+        return std::unexpected(make_error_code(http_error::head_too_large));
+      }
+      return 0;
+    }
+
+    reset();
+    if (head_size > _max_head_size) {
+      return std::unexpected(make_error_code(http_error::head_too_large));
+    }
+
+    if (auto error = parse_head(buffer.substr(0, head_size), request)) {
+      return std::unexpected(make_error_code(*error));
+    }
+
+    request._head_size = head_size;
+    return head_size;
+  }
+
+  // Forget a partially scanned head
+  void reset() noexcept {
+    _scanned = 0;
+    _line_start = 0;
+    _seen_line = false;
+  }
+
+private:
+  // Length of the head up to and including its blank line, or 0
+  std::size_t find_head_end(std::string_view buffer) noexcept {
+    while (_scanned < buffer.size()) {
+      std::size_t newline = buffer.find('\n', _scanned);
+      if (newline == std::string_view::npos) {
+        _scanned = buffer.size();
+        break;
+      }
+
+      std::size_t length = newline - _line_start;
+      bool blank = length == 0 || (length == 1 && buffer[_line_start] == '\r');
+      if (blank && _seen_line) {
+        return newline + 1;
+      }
+
+      // Blank lines before the request line are ignored (RFC 9112 2.2)
+      _seen_line = _seen_line || !blank;
+      _line_start = _scanned = newline + 1;
+    }
+    return 0;
+  }
+
+  static std::optional<http_error> parse_head(std::string_view head,
+                                              http_request &request) noexcept {
+    const char *p = head.data();
+    const char *end = p + head.size();
+    while (p != end && (*p == '\r' || *p == '\n')) {
+      ++p;
+    }
+
+    // Request line: method SP request-target SP HTTP-version
+    const char *method = p;
+    p = detail::scan_token(p, end);
+    if (p == method || *p != ' ') {
+      return http_error::bad_request_line;
+    }
+    auto parsed_method =
+        detail::parse_method({method, static_cast<std::size_t>(p - method)});
+    if (!parsed_method) {
+      return http_error::unsupported_method;
+    }
+
+    const char *target = ++p;
+    p = detail::scan_target(p, end);
+    if (p == target || *p != ' ') {
+      return http_error::bad_request_line;
+    }
+    std::string_view target_view(target, static_cast<std::size_t>(p - target));
+
+    ++p;
+    if (end - p < 8 || std::string_view(p, 5) != "HTTP/") {
+      return http_error::bad_request_line;
+    }
+    if (std::string_view(p + 5, 2) != "1." || (p[7] != '0' && p[7] != '1')) {
+      return http_error::unsupported_version;
+    }
+    http_version version =
+        p[7] == '1' ? http_version::HTTP_1_1 : http_version::HTTP_1_0;
+    p += 8;
+    if (!detail::consume_line_end(p, end)) {
+      return http_error::bad_request_line;
+    }
+
+    request._method = *parsed_method;
+    request._target = target_view;
+    request._version = version;
+    request._host = {};
+    request.clear_headers();
+    request._content_length.reset();
+    request._chunked = false;
+    request._body = {};
+
+    bool has_host = false;
+    bool close = false;
+    bool keep_alive = false;
+    bool has_transfer_encoding = false;
+
+    // Header fields until the blank line
+    for (;;) {
+      if (*p == '\r' || *p == '\n') {
+        if (!detail::consume_line_end(p, end) || p != end) {
+          return http_error::bad_header;
+        }
+        break;
+      }
+
+      // Leading whitespace would be obs-fold, which we don't accept
+      const char *name = p;
+      p = detail::scan_token(p, end);
+      if (p == name || *p != ':') {
+        return http_error::bad_header;
+      }
+      std::string_view name_view(name, static_cast<std::size_t>(p - name));
+
+      ++p;
+      while (*p == ' ' || *p == '\t') {
+        ++p;
+      }
+      const char *value = p;
+      p = detail::scan_value(p, end);
+      const char *value_end = p;
+      while (value_end != value &&
+             (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+        --value_end;
+      }
+      if (!detail::consume_line_end(p, end)) {
+        return http_error::bad_header;
+      }
+      std::string_view value_view(value,
+                                  static_cast<std::size_t>(value_end - value));
+
+      if (request._header_count == http_request::max_headers) {
+        return http_error::too_many_headers;
+      }
+      auto field = request.add_header({name_view, value_view});
+
+      // Fields that affect framing and connection handling
+      if (field == http_field::host) {
+        if (has_host) {
+          return http_error::bad_header;
+        }
+        has_host = true;
+        request._host = value_view;
+      } else if (field == http_field::content_length) {
+        auto length = detail::parse_length(value_view);
+        if (!length || (request._content_length &&
+                        *request._content_length != *length)) {
+          return http_error::bad_content_length;
+        }
+        request._content_length = length;
+      } else if (field == http_field::transfer_encoding) {
+        // Only the final coding decides framing, and it must be chunked
+        std::string_view last;
+        detail::for_each_element(
+            value_view, [&](std::string_view coding) { last = coding; });
+        if (!detail::iequals(last, "chunked")) {
+          return http_error::bad_transfer_encoding;
+        }
+        has_transfer_encoding = true;
+        request._chunked = true;
+      } else if (field == http_field::connection) {
+        detail::for_each_element(value_view, [&](std::string_view option) {
+          close = close || detail::iequals(option, "close");
+          keep_alive = keep_alive || detail::iequals(option, "keep-alive");
+        });
+      }
+    }
+
+    // Ambiguous framing is how requests get smuggled; refuse it
+    if (has_transfer_encoding && request._content_length) {
+      return http_error::bad_transfer_encoding;
+    }
+    if (version == http_version::HTTP_1_1 && !has_host) {
+      return http_error::missing_host;
+    }
+
+    request._keep_alive =
+        !close && (version == http_version::HTTP_1_1 || keep_alive);
+    return std::nullopt;
+  }
+
+  std::size_t _max_head_size;
+  std::size_t _scanned = 0;
+  std::size_t _line_start = 0;
+  bool _seen_line = false;
+};
+
+} // namespace net
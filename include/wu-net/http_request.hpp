@@ -1,9 +1,11 @@
 #pragma once
 
-#include <string>
-#include <unordered_map>
-#include <chrono>
-#include <memory>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
 
 namespace net {
 enum class http_method {
@@ -13,7 +15,9 @@ enum class http_method {
   DELETE,
   HEAD,
   OPTIONS,
-  PATCH
+  PATCH,
+  CONNECT,
+  TRACE
 };
 
 enum class http_version {
@@ -22,18 +26,325 @@ enum class http_version {
   HTTP_2_0
 };
 
+// Method name as it appears on the request line
+constexpr std::string_view to_string(http_method method) noexcept {
+  switch (method) {
+  case http_method::GET:
+    return "GET";
+  case http_method::POST:
+    return "POST";
+  case http_method::PUT:
+    return "PUT";
+  case http_method::DELETE:
+    return "DELETE";
+  case http_method::HEAD:
+    return "HEAD";
+  case http_method::OPTIONS:
+    return "OPTIONS";
+  case http_method::PATCH:
+    return "PATCH";
+  case http_method::CONNECT:
+    return "CONNECT";
+  case http_method::TRACE:
+    return "TRACE";
+  }
+  return {};
+}
+
+// Version as it appears on the request and status lines
+constexpr std::string_view to_string(http_version version) noexcept {
+  switch (version) {
+  case http_version::HTTP_1_0:
+    return "HTTP/1.0";
+  case http_version::HTTP_1_1:
+    return "HTTP/1.1";
+  case http_version::HTTP_2_0:
+    return "HTTP/2";
+  }
+  return {};
+}
+
+// A single header field; both views point into the receive buffer
+struct http_header {
+  std::string_view name;
+  std::string_view value;
+};
+
+// Header fields that http_request indexes as it is parsed, so looking one
+// up is O(1): the standard request fields, and those that proxies and gRPC
+// send on most requests
+enum class http_field : std::uint8_t {
+  accept,
+  accept_charset,
+  accept_encoding,
+  accept_language,
+  authorization,
+  cache_control,
+  connection,
+  content_encoding,
+  content_length,
+  content_type,
+  cookie,
+  date,
+  expect,
+  forwarded,
+  grpc_accept_encoding,
+  grpc_encoding,
+  grpc_timeout,
+  host,
+  http2_settings,
+  if_match,
+  if_modified_since,
+  if_none_match,
+  if_range,
+  if_unmodified_since,
+  keep_alive,
+  origin,
+  pragma,
+  proxy_authorization,
+  range,
+  referer,
+  te,
+  trailer,
+  transfer_encoding,
+  upgrade,
+  user_agent,
+  via,
+  x_forwarded_for,
+  x_forwarded_host,
+  x_forwarded_proto,
+  x_real_ip,
+  x_request_id
+};
+
+namespace detail {
+
+// Lowercase names, in http_field order
+inline constexpr std::array<std::string_view, 41> http_field_names{{
+    "accept",
+    "accept-charset",
+    "accept-encoding",
+    "accept-language",
+    "authorization",
+    "cache-control",
+    "connection",
+    "content-encoding",
+    "content-length",
+    "content-type",
+    "cookie",
+    "date",
+    "expect",
+    "forwarded",
+    "grpc-accept-encoding",
+    "grpc-encoding",
+    "grpc-timeout",
+    "host",
+    "http2-settings",
+    "if-match",
+    "if-modified-since",
+    "if-none-match",
+    "if-range",
+    "if-unmodified-since",
+    "keep-alive",
+    "origin",
+    "pragma",
+    "proxy-authorization",
+    "range",
+    "referer",
+    "te",
+    "trailer",
+    "transfer-encoding",
+    "upgrade",
+    "user-agent",
+    "via",
+    "x-forwarded-for",
+    "x-forwarded-host",
+    "x-forwarded-proto",
+    "x-real-ip",
+    "x-request-id",
+}};
+
+// FNV-1a over the name with letters folded to lowercase (`| 0x20` also
+// folds some punctuation, which is fine: a slot is only a candidate until
+// the name is compared). The top byte picks one of 256 slots.
+constexpr std::size_t http_field_hash(std::string_view name,
+                                      std::uint32_t seed) noexcept {
+  std::uint32_t h = seed ^ static_cast<std::uint32_t>(name.size());
+  for (char c : name) {
+    h = (h ^ static_cast<std::uint8_t>(c | 0x20)) * 0x01000193;
+  }
+  return h >> 24;
+}
+
+// A perfect hash of http_field_names, found at compile time by trying seeds
+// until no two names share a slot. Slots hold the field plus one.
+struct http_field_table {
+  std::uint32_t seed = 0;
+  std::array<std::uint8_t, 256> slots{};
+};
+
+inline constexpr http_field_table http_fields = [] {
+  http_field_table table;
+  for (std::uint32_t seed = 1;; ++seed) {
+    table.slots.fill(0);
+    bool collision = false;
+    for (std::size_t i = 0; i < http_field_names.size() && !collision; ++i) {
+      std::uint8_t &slot = table.slots[http_field_hash(http_field_names[i],
+                                                       seed)];
+      collision = slot != 0;
+      slot = static_cast<std::uint8_t>(i + 1);
+    }
+    if (!collision) {
+      table.seed = seed;
+      return table;
+    }
+  }
+}();
+
+// ASCII case-insensitive comparison, as used for header names and tokens
+constexpr bool iequals(std::string_view a, std::string_view b) noexcept {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  auto lower = [](char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c;
+  };
+  for (std::size_t i = 0; i < a.size(); ++i) {
+    if (lower(a[i]) != lower(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The well-known field with this (case-insensitive) name, if it is one
+constexpr std::optional<http_field>
+find_http_field(std::string_view name) noexcept {
+  std::uint8_t slot =
+      http_fields.slots[http_field_hash(name, http_fields.seed)];
+  if (slot == 0 || !iequals(name, http_field_names[slot - 1])) {
+    return std::nullopt;
+  }
+  return static_cast<http_field>(slot - 1);
+}
+
+} // namespace detail
+
+// Lowercase name of a well-known field
+constexpr std::string_view to_string(http_field field) noexcept {
+  return detail::http_field_names[static_cast<std::size_t>(field)];
+}
+
+// Parsed HTTP request head. Filled in by http_parser without allocating:
+// the target and header views refer to the buffer that was parsed, so the
+// request is only valid while that buffer is unchanged.
+//
+// Headers are kept in arrival order in a fixed array. Alongside it, each
+// http_field has a one-octet slot holding the position of its first
+// occurrence, filled in as headers are added, so looking up a well-known
+// name costs a hash and one comparison. Other names are found by a scan.
 class http_request {
 public:
-  
+  // Most headers kept per request; more fails the parse
+  static constexpr std::size_t max_headers = 64;
+  static_assert(max_headers < 256, "slots are one octet");
+
+  http_method method() const noexcept { return _method; }
+
+  // Request target as sent (origin-form path and query, absolute-form URL,
+  // authority for CONNECT, or "*")
+  std::string_view target() const noexcept { return _target; }
+
+  // Target without the query string
+  std::string_view path() const noexcept {
+    return _target.substr(0, _target.find('?'));
+  }
+
+  http_version version() const noexcept { return _version; }
+
+  // Value of the Host header, empty if there was none
+  std::string_view host() const noexcept { return _host; }
+
+  std::span<const http_header> headers() const noexcept {
+    return {_headers.data(), _header_count};
+  }
+
+  // First header with a well-known name
+  std::optional<std::string_view> header(http_field field) const noexcept {
+    std::uint8_t slot = _fields[static_cast<std::size_t>(field)];
+    if (slot == 0) {
+      return std::nullopt;
+    }
+    return _headers[slot - 1].value;
+  }
+
+  // First header with the given (case-insensitive) name
+  std::optional<std::string_view> header(std::string_view name) const noexcept {
+    if (auto field = detail::find_http_field(name)) {
+      return header(*field);
+    }
+    for (const auto &h : headers()) {
+      if (detail::iequals(h.name, name)) {
+        return h.value;
+      }
+    }
+    return std::nullopt;
+  }
+
+  // Whether the connection stays open after this request, from the version
+  // and the Connection header
+  bool keep_alive() const noexcept { return _keep_alive; }
+
+  // Declared body length, if the request has a Content-Length
+  std::optional<std::size_t> content_length() const noexcept {
+    return _content_length;
+  }
+
+  // Whether the body uses chunked transfer coding
+  bool chunked() const noexcept { return _chunked; }
+
+  // Bytes taken by the request line and headers, including the blank line
+  std::size_t head_size() const noexcept { return _head_size; }
+
+  // Request body, once the server has received all of it
+  std::string_view body() const noexcept { return _body; }
+
 private:
-  http_method _method;
-  std::string _url;
-  http_version _version;
-  std::string _host;
-  int _port;
-  std::unordered_map<std::string, std::string> _headers;
-  std::shared_ptr<std::istream> _body;
-  bool _keep_alive;
-  std::chrono::milliseconds _timeout;
+  friend class http_parser;
+  friend class http_server;
+  friend class http2_connection;
+
+  void clear_headers() noexcept {
+    _header_count = 0;
+    _fields.fill(0);
+  }
+
+  // Append a header (there must be room) and index it if its name is
+  // well-known; returns which field it is
+  std::optional<http_field> add_header(http_header h) noexcept {
+    _headers[_header_count++] = h;
+    auto field = detail::find_http_field(h.name);
+    if (field) {
+      std::uint8_t &slot = _fields[static_cast<std::size_t>(*field)];
+      if (slot == 0) {
+        slot = static_cast<std::uint8_t>(_header_count);
+      }
+    }
+    return field;
+  }
+
+  http_method _method = http_method::GET;
+  std::string_view _target;
+  http_version _version = http_version::HTTP_1_1;
+  std::string_view _host;
+  std::array<http_header, max_headers> _headers;
+  std::size_t _header_count = 0;
+  // Index + 1 into _headers of each well-known field's first occurrence
+  std::array<std::uint8_t, detail::http_field_names.size()> _fields{};
+  bool _keep_alive = true;
+  std::optional<std::size_t> _content_length;
+  bool _chunked = false;
+  std::size_t _head_size = 0;
+  std::string_view _body;
 };
 } // namespace net
\ No newline at end of file
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "http_request.hpp"
+
+namespace net {
+
+// Standard reason phrase for a status code, empty if there is none
+constexpr std::string_view reason_phrase(int status) noexcept {
+  switch (status) {
+  case 100: return "Continue";
+  case 101: return "Switching Protocols";
+  case 200: return "OK";
+  case 201: return "Created";
+  case 202: return "Accepted";
+  case 204: return "No Content";
+  case 206: return "Partial Content";
+  case 301: return "Moved Permanently";
+  case 302: return "Found";
+  case 303: return "See Other";
+  case 304: return "Not Modified";
+  case 307: return "Temporary Redirect";
+  case 308: return "Permanent Redirect";
+  case 400: return "Bad Request";
+  case 401: return "Unauthorized";
+  case 403: return "Forbidden";
+  case 404: return "Not Found";
+  case 405: return "Method Not Allowed";
+  case 408: return "Request Timeout";
+  case 409: return "Conflict";
+  case 411: return "Length Required";
+  case 413: return "Content Too Large";
+  case 414: return "URI Too Long";
+  case 415: return "Unsupported Media Type";
+  case 426: return "Upgrade Required";
+  case 429: return "Too Many Requests";
+  case 431: return "Request Header Fields Too Large";
+  case 500: return "Internal Server Error";
+  case 501: return "Not Implemented";
+  case 502: return "Bad Gateway";
+  case 503: return "Service Unavailable";
+  case 504: return "Gateway Timeout";
+  case 505: return "HTTP Version Not Supported";
+  default: return {};
+  }
+}
+
+namespace detail {
+
+// "HTTP/1.1 <code> <reason>\r\n" for every code from 100 to 599, built once
+inline std::string_view status_line(int status) {
+  static const auto lines = [] {
+    std::array<std::string, 500> table;
+    for (int code = 100; code < 600; ++code) {
+      std::string &line = table[code - 100];
+      line = "HTTP/1.1 " + std::to_string(code) + ' ';
+      line += reason_phrase(code);
+      line += "\r\n";
+    }
+    return table;
+  }();
+
+  if (status < 100 || status > 599) {
+    status = 500;
+  }
+  return lines[status - 100];
+}
+
+// Current time as an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT"),
+// formatted at most once per second per thread
+inline std::string_view http_date() {
+  thread_local std::time_t formatted = -1;
+  thread_local std::array<char, 32> text{};
+  thread_local std::size_t size = 0;
+
+  std::time_t now = std::time(nullptr);
+  if (now != formatted) {
+    std::tm utc;
+    gmtime_r(&now, &utc);
+    size = std::strftime(text.data(), text.size(), "%a, %d %b %Y %H:%M:%S GMT",
+                         &utc);
+    formatted = now;
+  }
+  return {text.data(), size};
+}
+
+} // namespace detail
+
+// HTTP/1.1 response built by a handler and written by http_server.
+//
+// Serialization does not concatenate: the status line comes from a static
+// table, headers are kept as one preformatted block, Date, Content-Length
+// and Connection are rendered into a small inline array, and the body is
+// referenced as is. All of them go out as separate iovecs of one writev.
+//
+// The status line always says HTTP/1.1, as RFC 9112 asks of a 1.1 server
+// whatever the request's version; set_version() only changes how the
+// response is framed for the client.
+class http_response {
+public:
+  explicit http_response(int status = 200) : _status(status) {}
+
+  int status() const noexcept { return _status; }
+
+  void set_status(int status) noexcept { _status = status; }
+
+  // Add a header field. Date and Content-Length are generated and should
+  // not be added.
+  void add_header(std::string_view name, std::string_view value) {
+    _fields.append(name).append(": ").append(value).append("\r\n");
+  }
+
+  // Header fields added so far, formatted as they will be sent
+  std::string_view fields() const noexcept { return _fields; }
+
+  // Take ownership of the body
+  void set_body(std::string body) {
+    _body = std::move(body);
+    _owns_body = true;
+  }
+
+  // Send memory owned elsewhere (static content, or part of the request)
+  // as the body; it must stay valid until the response has been written
+  void set_body_view(std::string_view body) noexcept {
+    _body.clear();
+    _body_view = body;
+    _owns_body = false;
+  }
+
+  std::string_view body() const noexcept {
+    return _owns_body ? std::string_view(_body) : _body_view;
+  }
+
+  // Whether the connection stays open after this response
+  bool keep_alive() const noexcept { return _keep_alive; }
+
+  void set_keep_alive(bool keep_alive) noexcept { _keep_alive = keep_alive; }
+
+  // Version of the request being answered. An HTTP/1.0 client only keeps
+  // the connection open if told so with Connection: keep-alive.
+  void set_version(http_version version) noexcept { _version = version; }
+
+  http_version version() const noexcept { return _version; }
+
+  // 1xx, 204 and 304 responses never have a body (RFC 9110 6.4.1)
+  bool bodiless() const noexcept {
+    return _status < 200 || _status == 204 || _status == 304;
+  }
+
+  // Reset to an empty 200 response, keeping allocated capacity
+  void clear() noexcept {
+    _status = 200;
+    _fields.clear();
+    _body.clear();
+    _body_view = {};
+    _owns_body = false;
+    _keep_alive = true;
+    _version = http_version::HTTP_1_1;
+  }
+
+  // Append iovecs for the whole response to `out`. They point into this
+  // response, which must not change until they are written. The body is
+  // left out (but still counted) for replies to HEAD, and dropped from
+  // bodiless() responses.
+  void serialize(std::vector<iovec> &out, std::string_view date,
+                 bool include_body = true) {
+    std::string_view content = body();
+    serialize_head(out, date, content.size());
+    if (include_body && !bodiless()) {
+      push(out, content);
+    }
+  }
+
+  // Append iovecs for the status line and headers only, for a body that is
+  // streamed after them: framed by Content-Length when its length is
+  // known, chunked otherwise. HTTP/1.0 has no chunked coding, so there an
+  // unknown length is ended by closing the connection instead. bodiless()
+  // responses get no framing.
+  void serialize_head(std::vector<iovec> &out, std::string_view date,
+                      std::optional<std::size_t> content_length) {
+    std::string_view line = detail::status_line(_status);
+
+    char *p = _generated.data();
+    p = append(p, "Date: ");
+    p = append(p, date);
+    if (bodiless()) {
+      // No framing
+    } else if (content_length) {
+      p = append(p, "\r\nContent-Length: ");
+      p = std::to_chars(p, _generated.data() + _generated.size(),
+                        *content_length)
+              .ptr;
+    } else if (_version == http_version::HTTP_1_0) {
+      _keep_alive = false;
+    } else {
+      p = append(p, "\r\nTransfer-Encoding: chunked");
+    }
+    if (!_keep_alive) {
+      p = append(p, "\r\nConnection: close");
+    } else if (_version == http_version::HTTP_1_0) {
+      p = append(p, "\r\nConnection: keep-alive");
+    }
+    p = append(p, "\r\n\r\n");
+    std::string_view generated(_generated.data(),
+                               static_cast<std::size_t>(p - _generated.data()));
+
+    push(out, line);
+    push(out, _fields);
+    push(out, generated);
+  }
+
+private:
+  static char *append(char *p, std::string_view text) noexcept {
+    std::memcpy(p, text.data(), text.size());
+    return p + text.size();
+  }
+
+  static void push(std::vector<iovec> &out, std::string_view data) {
+    if (!data.empty()) {
+      out.push_back({const_cast<char *>(data.data()), data.size()});
+    }
+  }
+
+  int _status;
+  std::string _fields;
+  std::string _body;
+  std::string_view _body_view;
+  bool _owns_body = false;
+  bool _keep_alive = true;
+  http_version _version = http_version::HTTP_1_1;
+  std::array<char, 128> _generated{};
+};
+
+} // namespace net
@@ -0,0 +1,351 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "http_request.hpp"
+
+namespace net {
+
+// Reasons a route is rejected by http_router::insert()
+enum class http_route_error {
+  bad_pattern = 1,
+  duplicate_route,
+  too_many_params
+};
+
+class http_route_error_category : public std::error_category {
+public:
+  const char *name() const noexcept override { return "http_route"; }
+
+  std::string message(int ev) const override {
+    switch (static_cast<http_route_error>(ev)) {
+    case http_route_error::bad_pattern:
+      return "Malformed route pattern";
+    case http_route_error::duplicate_route:
+      return "Route already exists";
+    case http_route_error::too_many_params:
+      return "Too many route parameters";
+    default:
+      return "Unknown http_route error";
+    }
+  }
+};
+
+inline const std::error_category &http_route_category() noexcept {
+  static const http_route_error_category instance;
+  return instance;
+}
+
+inline std::error_code make_error_code(http_route_error e) noexcept {
+  return {static_cast<int>(e), http_route_category()};
+}
+
+struct http_route_param {
+  std::string_view name;
+  std::string_view value; // Raw, not percent-decoded
+};
+
+// Parameters captured by a match, in the order they appear in the pattern.
+// Fixed capacity, so matching never allocates; values point into the path
+// that was matched and names into the router.
+class http_route_params {
+public:
+  static constexpr std::size_t max_params = 16;
+
+  // Value of the parameter called `name`
+  std::optional<std::string_view> get(std::string_view name) const noexcept {
+    for (std::size_t i = 0; i < _size; ++i) {
+      if (_params[i].name == name) {
+        return _params[i].value;
+      }
+    }
+    return std::nullopt;
+  }
+
+  const http_route_param &operator[](std::size_t i) const noexcept {
+    return _params[i];
+  }
+
+  std::size_t size() const noexcept { return _size; }
+
+  bool empty() const noexcept { return _size == 0; }
+
+  const http_route_param *begin() const noexcept { return _params.data(); }
+
+  const http_route_param *end() const noexcept {
+    return _params.data() + _size;
+  }
+
+private:
+  template <typename T> friend class http_router;
+
+  std::array<http_route_param, max_params> _params{};
+  std::size_t _size = 0;
+};
+
+// Maps a method and path to a value (usually a handler) through one
+// compressed radix tree per method.
+//
+// Patterns are paths whose segments are either literal, ":name" to match
+// any one non-empty segment, or, as the last segment only, "*name" to
+// match the rest of the path including further slashes (the name may be
+// left out). Literal text wins over a parameter, and a parameter over a
+// wildcard; when the preferred branch fails further down, matching backs
+// up and tries the next one, so "/a/:x/c" still matches "/a/b/c" next to
+// "/a/b/d".
+//
+// A lookup walks shared prefixes a node at a time instead of testing
+// every route, so its cost grows with the length of the path rather than
+// the number of routes, and it allocates nothing. Insert every route
+// before serving: names in captured parameters point into the router and
+// insert() may move them, and lookups must not race with inserts.
+template <typename T> class http_router {
+public:
+  http_router() : _nodes(method_count) {}
+
+  // Add a route; fails on a malformed or duplicate pattern
+  std::expected<void, std::error_code>
+  insert(http_method method, std::string_view pattern, T value) {
+    std::vector<std::string> names;
+    if (!parse(pattern, names)) {
+      return fail(http_route_error::bad_pattern);
+    }
+    if (names.size() > http_route_params::max_params) {
+      return fail(http_route_error::too_many_params);
+    }
+
+    std::uint32_t n = static_cast<std::uint32_t>(method);
+    std::string_view rest = pattern;
+    while (!rest.empty()) {
+      if (rest.front() == ':') {
+        std::size_t end = std::min(rest.find('/'), rest.size());
+        if (_nodes[n].param == none) {
+          _nodes[n].param = add_node(0, 0);
+        }
+        n = _nodes[n].param;
+        rest.remove_prefix(end);
+      } else if (rest.front() == '*') {
+        break;
+      } else {
+        std::size_t end = literal_size(rest);
+        n = insert_literal(n, rest.substr(0, end));
+        rest.remove_prefix(end);
+      }
+    }
+
+    std::uint32_t &slot = rest.empty() ? _nodes[n].route : _nodes[n].wildcard;
+    if (slot != none) {
+      return fail(http_route_error::duplicate_route);
+    }
+    slot = static_cast<std::uint32_t>(_routes.size());
+    _routes.push_back({std::move(value), std::move(names)});
+    return {};
+  }
+
+  // Value of the route matching `path`, or null; `params` receives what
+  // the route's parameters captured
+  const T *match(http_method method, std::string_view path,
+                 http_route_params &params) const noexcept {
+    params._size = 0;
+    std::uint32_t r = find(static_cast<std::uint32_t>(method), path, params);
+    if (r == none) {
+      return nullptr;
+    }
+    const route &found = _routes[r];
+    for (std::size_t i = 0; i < params._size; ++i) {
+      params._params[i].name = found.names[i];
+    }
+    return &found.value;
+  }
+
+  // match() on a request's method and path (without the query)
+  const T *match(const http_request &request,
+                 http_route_params &params) const noexcept {
+    return match(request.method(), request.path(), params);
+  }
+
+  // Whether any method has a route matching `path`, e.g. to tell a 405
+  // from a 404
+  bool matches_any(std::string_view path) const noexcept {
+    http_route_params params;
+    for (std::uint32_t m = 0; m < method_count; ++m) {
+      if (find(m, path, params) != none) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Number of routes
+  std::size_t size() const noexcept { return _routes.size(); }
+
+  // Number of tree nodes, for sizing
+  std::size_t node_count() const noexcept { return _nodes.size(); }
+
+private:
+  static constexpr std::uint32_t none = UINT32_MAX;
+  static constexpr std::uint32_t method_count =
+      static_cast<std::uint32_t>(http_method::TRACE) + 1;
+
+  struct node {
+    std::uint32_t label = 0; // Literal text this node consumes, in _labels
+    std::uint32_t label_size = 0;
+    std::string first; // First octet of each child's label
+    std::vector<std::uint32_t> children;
+    std::uint32_t param = none;    // Child matching a ":name" segment
+    std::uint32_t route = none;    // Route ending here
+    std::uint32_t wildcard = none; // "*name" route ending here
+  };
+
+  struct route {
+    T value;
+    std::vector<std::string> names;
+  };
+
+  static std::unexpected<std::error_code> fail(http_route_error e) {
+    return std::unexpected(make_error_code(e));
+  }
+
+  // Check `pattern` and collect its parameter names
+  static bool parse(std::string_view pattern, std::vector<std::string> &names) {
+    if (pattern.empty() || pattern.front() != '/') {
+      return false;
+    }
+    for (std::size_t at = 1; at <= pattern.size();) {
+      std::size_t end = std::min(pattern.find('/', at), pattern.size());
+      std::string_view segment = pattern.substr(at, end - at);
+      if (!segment.empty() && segment.front() == ':') {
+        if (segment.size() == 1) {
+          return false;
+        }
+        names.emplace_back(segment.substr(1));
+      } else if (!segment.empty() && segment.front() == '*') {
+        if (end != pattern.size()) {
+          return false;
+        }
+        names.emplace_back(segment.substr(1));
+      }
+      at = end + 1;
+    }
+    return true;
+  }
+
+  // Length of the literal text at the front of `pattern`: up to the start
+  // of the next parameter or wildcard segment
+  static std::size_t literal_size(std::string_view pattern) noexcept {
+    for (std::size_t i = 0; i + 1 < pattern.size(); ++i) {
+      if (pattern[i] == '/' &&
+          (pattern[i + 1] == ':' || pattern[i + 1] == '*')) {
+        return i + 1;
+      }
+    }
+    return pattern.size();
+  }
+
+  std::uint32_t add_node(std::uint32_t label, std::uint32_t size) {
+    _nodes.push_back({});
+    _nodes.back().label = label;
+    _nodes.back().label_size = size;
+    return static_cast<std::uint32_t>(_nodes.size() - 1);
+  }
+
+  // Walk or extend the literal edges below `n` by `text`, splitting an
+  // edge where `text` leaves it; returns the node `text` ends at
+  std::uint32_t insert_literal(std::uint32_t n, std::string_view text) {
+    while (!text.empty()) {
+      std::size_t i = _nodes[n].first.find(text.front());
+      if (i == std::string::npos) {
+        std::uint32_t child =
+            add_node(static_cast<std::uint32_t>(_labels.size()),
+                     static_cast<std::uint32_t>(text.size()));
+        _labels.append(text);
+        _nodes[n].first.push_back(text.front());
+        _nodes[n].children.push_back(child);
+        return child;
+      }
+
+      std::uint32_t child = _nodes[n].children[i];
+      std::string_view label = label_of(_nodes[child]);
+      std::size_t common = 0;
+      while (common < label.size() && common < text.size() &&
+             label[common] == text[common]) {
+        ++common;
+      }
+
+      if (common < label.size()) {
+        // Put a node for the shared part between `n` and the child
+        std::uint32_t middle = add_node(_nodes[child].label,
+                                        static_cast<std::uint32_t>(common));
+        _nodes[child].label += static_cast<std::uint32_t>(common);
+        _nodes[child].label_size -= static_cast<std::uint32_t>(common);
+        _nodes[middle].first.push_back(label[common]);
+        _nodes[middle].children.push_back(child);
+        _nodes[n].children[i] = middle;
+        child = middle;
+      }
+      n = child;
+      text.remove_prefix(common);
+    }
+    return n;
+  }
+
+  std::string_view label_of(const node &n) const noexcept {
+    return std::string_view(_labels).substr(n.label, n.label_size);
+  }
+
+  // Route matching `path` below `n`, whose label has been consumed
+  std::uint32_t find(std::uint32_t n, std::string_view path,
+                     http_route_params &params) const noexcept {
+    const node &current = _nodes[n];
+    if (path.empty() && current.route != none) {
+      return current.route;
+    }
+
+    if (!path.empty()) {
+      if (std::size_t i = current.first.find(path.front());
+          i != std::string::npos) {
+        std::uint32_t child = current.children[i];
+        std::string_view label = label_of(_nodes[child]);
+        if (path.starts_with(label)) {
+          std::uint32_t r = find(child, path.substr(label.size()), params);
+          if (r != none) {
+            return r;
+          }
+        }
+      }
+
+      if (current.param != none) {
+        std::size_t end = std::min(path.find('/'), path.size());
+        if (end > 0) {
+          params._params[params._size++].value = path.substr(0, end);
+          std::uint32_t r = find(current.param, path.substr(end), params);
+          if (r != none) {
+            return r;
+          }
+          --params._size;
+        }
+      }
+    }
+
+    if (current.wildcard != none) {
+      params._params[params._size++].value = path;
+      return current.wildcard;
+    }
+    return none;
+  }
+
+  std::vector<node> _nodes; // The first method_count are the roots
+  std::string _labels;      // Edge text of every node, back to back
+  std::vector<route> _routes;
+};
+
+} // namespace net
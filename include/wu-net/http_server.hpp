@@ -0,0 +1,531 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "event_loop.hpp"
+#include "http2.hpp"
+#include "http_body.hpp"
+#include "http_parser.hpp"
+#include "http_request.hpp"
+#include "http_response.hpp"
+#include "server.hpp"
+#include "task.hpp"
+#include "tcp_stream.hpp"
+
+namespace net {
+
+// Settings for http_server
+struct http_server_options {
+  server_options server;
+  std::size_t max_head_size = http_parser::default_max_head_size;
+  std::size_t max_body_size = 1 << 20;
+  std::size_t max_pipeline = 32; // Responses coalesced into one writev
+  std::size_t buffer_size = 16384;
+  // Longest wait for the next request on an open connection, and for the
+  // rest of a request once its first bytes have arrived; zero disables
+  std::chrono::milliseconds idle_timeout{60000};
+  std::chrono::milliseconds request_timeout{30000};
+  // Accept HTTP/2 over cleartext, by prior knowledge or "Upgrade: h2c"
+  bool h2c = true;
+  http2_options http2;
+};
+
+// HTTP/1.1 server on the thread-per-core server runtime.
+//
+// Connections are persistent unless either side asks otherwise. Every
+// complete request already in the receive buffer is handled before the
+// connection writes, so a batch of pipelined requests gets all of its
+// responses in a single writev. Requests and responses are parsed and
+// written in place; a connection allocates nothing per request once its
+// buffers have grown to fit the traffic.
+//
+// Connections that sit idle for idle_timeout, or take longer than
+// request_timeout to send one request, are shut down. Each connection has
+// one loop timer that is pushed back as it reads, so timeouts cost O(1)
+// per read.
+//
+// With h2c enabled, a connection that opens with the HTTP/2 preface, or an
+// HTTP/1.1 request without a body that asks for "Upgrade: h2c", switches
+// to HTTP/2 (see http2_connection) for the rest of the connection, and the
+// same handler answers every stream.
+//
+// Request bodies are received whole before the handler runs, and chunked
+// ones are decoded in place in the receive buffer. For bodies too large to
+// hold, start the server with a streaming handler instead: a coroutine
+// that reads the body with an http_body_reader as it arrives and may
+// stream its response through an http_body_writer. Connections served that
+// way handle one request at a time and stay on HTTP/1.1.
+//
+// Handlers run on the connection's worker thread and must not block.
+class http_server {
+public:
+  using handler = std::function<void(const http_request &, http_response &)>;
+  using streaming_handler = std::function<task<void>(
+      const http_request &, http_body_reader &, http_body_writer &)>;
+
+  explicit http_server(http_server_options options = {})
+      : _options(std::move(options)), _server(_options.server) {}
+
+  // Start serving; false if the address could not be bound
+  bool start(handler on_request) {
+    if (!on_request) {
+      return false;
+    }
+    _handler = std::move(on_request);
+    return _server.start(
+        [this](tcp_stream client) { return serve(std::move(client)); });
+  }
+
+  bool start(streaming_handler on_request) {
+    if (!on_request) {
+      return false;
+    }
+    _streaming_handler = std::move(on_request);
+    return _server.start([this](tcp_stream client) {
+      return serve_streaming(std::move(client));
+    });
+  }
+
+  // Stop accepting and let open connections finish
+  void stop() noexcept { _server.stop(); }
+
+  // Block until every worker has exited
+  void wait() { _server.wait(); }
+
+  std::size_t active_connections() const noexcept {
+    return _server.active_connections();
+  }
+
+  std::optional<std::string> local_address() const {
+    return _server.local_address();
+  }
+
+private:
+  // Status for a request the server rejected
+  static int error_status(std::error_code error) noexcept {
+    switch (static_cast<http_error>(error.value())) {
+    case http_error::unsupported_method:
+      return 501;
+    case http_error::unsupported_version:
+      return 505;
+    case http_error::too_many_headers:
+    case http_error::head_too_large:
+      return 431;
+    case http_error::body_too_large:
+      return 413;
+    default:
+      return 400;
+    }
+  }
+
+  // Handle one connection until it closes
+  task<void> serve(tcp_stream client) {
+    client.set_nodelay(true);
+    detail::connection_deadline timeout(client.native_handle());
+    bool request_started = false; // request_timeout is running
+
+    std::vector<char> buffer(_options.buffer_size);
+    std::size_t begin = 0; // Start of the first unhandled request
+    std::size_t end = 0;   // End of received data
+
+    http_parser parser(_options.max_head_size);
+    http_request request;
+    // A chunked body is decoded in place behind its head over as many
+    // rounds as it takes to arrive; offsets are from the end of the head
+    http_chunked_decoder chunked;
+    std::size_t chunk_in = 0;  // Where undecoded input starts
+    std::size_t chunk_out = 0; // Body data decoded so far
+    std::vector<http_response> responses(std::max<std::size_t>(
+        _options.max_pipeline, 1));
+    std::vector<iovec> iov;
+    bool open = true;
+    bool first = true; // Nothing received yet that isn't the h2 preface
+    bool http2 = false;
+    bool continued = false; // 100 Continue sent for the request at begin
+
+    while (open) {
+      // Handle every complete request that is already buffered
+      std::size_t count = 0;
+      bool deferred = false; // An upgrade waits for earlier responses
+      bool awaiting_body = false; // The next request's head is here
+      std::string_view date = detail::http_date();
+      iov.clear();
+
+      while (open && count < responses.size()) {
+        std::string_view pending(buffer.data() + begin, end - begin);
+        http_response &response = responses[count];
+        response.clear();
+
+        if (first && _options.h2c) {
+          std::size_t n = std::min(pending.size(), http2_preface.size());
+          if (pending.substr(0, n) == http2_preface.substr(0, n)) {
+            http2 = n == http2_preface.size();
+            break; // Prior knowledge, or need more data to tell
+          }
+        }
+        first = false;
+
+        auto head = parser.parse(pending, request);
+        if (head && *head == 0) {
+          break; // Need more data
+        }
+
+        // The body, or an error to answer with instead of the handler
+        std::error_code error;
+        std::string_view body;
+        std::size_t length = 0; // The body as sent
+
+        if (!head) {
+          error = head.error();
+        } else if (request.chunked()) {
+          char *start = buffer.data() + begin + *head;
+          auto used = chunked.decode(start + chunk_in,
+                                     pending.size() - *head - chunk_in, start,
+                                     chunk_out);
+          if (!used) {
+            error = used.error();
+          } else if (chunk_out > _options.max_body_size) {
+            error = make_error_code(http_error::body_too_large);
+          } else if (!chunked.done()) {
+            // Body still arriving; the head is parsed again later. Drop the
+            // framing decoded so far, so chunk extensions and trailers
+            // can't grow the buffer past the decoded body.
+            chunk_in += *used;
+            char *tail = start + chunk_in;
+            std::memmove(start + chunk_out, tail,
+                         buffer.data() + end - tail);
+            end -= chunk_in - chunk_out;
+            chunk_in = chunk_out;
+            awaiting_body = true;
+            break;
+          }
+          body = {start, chunk_out};
+          length = chunk_in + used.value_or(0);
+          chunked.reset();
+          chunk_in = chunk_out = 0;
+        } else if (request.content_length().value_or(0) >
+                   _options.max_body_size) {
+          error = make_error_code(http_error::body_too_large);
+        } else {
+          length = request.content_length().value_or(0);
+          if (pending.size() - *head < length) {
+            awaiting_body = true;
+            break; // Body still arriving; the head is parsed again later
+          }
+          body = pending.substr(*head, length);
+        }
+
+        if (error) {
+          response.set_status(error_status(error));
+          response.set_keep_alive(false);
+        } else {
+          if (length == 0 && wants_h2c(request)) {
+            if (count > 0) {
+              deferred = true;
+              break;
+            }
+            begin += *head;
+            co_await serve_http2(client, timeout, buffer, begin, end,
+                                 &request);
+            co_return;
+          }
+
+          request._body = body;
+          begin += *head + length;
+
+          try {
+            _handler(request, response);
+          } catch (...) {
+            response.clear();
+            response.set_status(500);
+            response.set_keep_alive(false);
+          }
+
+          if (!request.keep_alive()) {
+            response.set_keep_alive(false);
+          }
+        }
+
+        bool include_body = !head || request.method() != http_method::HEAD;
+        if (head) {
+          response.set_version(request.version());
+        }
+        response.serialize(iov, date, include_body);
+        open = response.keep_alive();
+        continued = false;
+        ++count;
+      }
+
+      // The client may be holding its body back until told to go on
+      if (awaiting_body && !continued && detail::expects_continue(request)) {
+        continued = true;
+        iov.push_back({const_cast<char *>(detail::continue_response.data()),
+                       detail::continue_response.size()});
+      }
+
+      if (!iov.empty()) {
+        if (count > 0) {
+          // A client that stops reading its responses counts as idle
+          timeout.expires_after(_options.idle_timeout);
+          request_started = false;
+        }
+        if (!co_await client.async_writev(iov)) {
+          co_return;
+        }
+        if (count > 0 && open && (count == responses.size() || deferred)) {
+          continue; // The batch was capped; more may be buffered
+        }
+      }
+
+      if (!open) {
+        break;
+      }
+      if (http2) {
+        co_await serve_http2(client, timeout, buffer, begin, end, nullptr);
+        co_return;
+      }
+
+      // Move the unhandled tail to the front, and grow if a single request
+      // fills the buffer
+      if (begin > 0) {
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+      }
+      if (end == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+      }
+
+      if (end == 0) {
+        timeout.expires_after(_options.idle_timeout);
+      } else if (!request_started) {
+        timeout.expires_after(_options.request_timeout);
+        request_started = true;
+      }
+
+      auto received = co_await client.async_read_some(
+          std::as_writable_bytes(std::span(buffer).subspan(end)));
+      if (!received || *received == 0) {
+        co_return;
+      }
+      end += *received;
+    }
+
+    // Let the client read the final response before the socket closes
+    ::shutdown(client.native_handle(), SHUT_WR);
+  }
+
+  // Handle one connection for a streaming handler, a request at a time
+  task<void> serve_streaming(tcp_stream client) {
+    client.set_nodelay(true);
+    detail::connection_deadline timeout(client.native_handle());
+    bool request_started = false;
+
+    std::vector<char> buffer(_options.buffer_size);
+    std::size_t begin = 0;
+    std::size_t end = 0;
+
+    http_parser parser(_options.max_head_size);
+    http_request request;
+    http_response response;
+    std::vector<iovec> iov;
+
+    for (;;) {
+      // The head goes at the front, leaving the rest of the buffer for the
+      // body
+      if (begin > 0) {
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+      }
+
+      auto head = parser.parse({buffer.data(), end}, request);
+      if (head && *head == buffer.size()) {
+        // Leave the body reader room behind a head that fills the buffer,
+        // then parse again, since the request points into it
+        buffer.resize(buffer.size() * 2);
+        head = parser.parse({buffer.data(), end}, request);
+      }
+      if (head && *head == 0) {
+        if (end == buffer.size()) {
+          buffer.resize(buffer.size() * 2);
+        }
+        if (end == 0) {
+          timeout.expires_after(_options.idle_timeout);
+        } else if (!request_started) {
+          timeout.expires_after(_options.request_timeout);
+          request_started = true;
+        }
+        auto received = co_await client.async_read_some(
+            std::as_writable_bytes(std::span(buffer).subspan(end)));
+        if (!received || *received == 0) {
+          co_return;
+        }
+        end += *received;
+        continue;
+      }
+
+      // The reader and writer keep their own deadlines while the handler
+      // runs
+      timeout.expires_after(std::chrono::milliseconds::zero());
+      request_started = false;
+      response.clear();
+      iov.clear();
+
+      if (!head) {
+        response.set_status(error_status(head.error()));
+        response.set_keep_alive(false);
+        response.serialize(iov, detail::http_date());
+      } else {
+        begin = *head;
+        response.set_version(request.version());
+        bool head_only = request.method() == http_method::HEAD;
+        http_body_reader body(client, timeout, _options.request_timeout,
+                              buffer, begin, end, request);
+        http_body_writer writer(client, timeout, _options.idle_timeout,
+                                response, head_only);
+        response.set_keep_alive(request.keep_alive());
+
+        bool failed = false;
+        try {
+          co_await _streaming_handler(request, body, writer);
+        } catch (...) {
+          failed = true;
+        }
+
+        if (writer.started()) {
+          if (!failed && !writer.finished()) {
+            auto finished = co_await writer.finish();
+            failed = !finished;
+          }
+          if (failed || writer._failed || !body.done() ||
+              !response.keep_alive()) {
+            break;
+          }
+          continue;
+        }
+
+        if (failed) {
+          response.clear();
+          response.set_status(500);
+          response.set_keep_alive(false);
+          response.set_version(request.version());
+        }
+        // An unread body would be taken for the next request
+        if (!body.done() || !request.keep_alive()) {
+          response.set_keep_alive(false);
+        }
+        response.serialize(iov, detail::http_date(), !head_only);
+      }
+
+      timeout.expires_after(_options.idle_timeout);
+      if (!co_await client.async_writev(iov)) {
+        co_return;
+      }
+      if (!response.keep_alive()) {
+        break;
+      }
+    }
+
+    ::shutdown(client.native_handle(), SHUT_WR);
+  }
+
+  // An HTTP/1.1 request asking to continue as h2c
+  bool wants_h2c(const http_request &request) const noexcept {
+    if (!_options.h2c || request.version() != http_version::HTTP_1_1 ||
+        !request.header(http_field::http2_settings)) {
+      return false;
+    }
+    bool h2c = false;
+    detail::for_each_element(request.header(http_field::upgrade).value_or(""),
+                             [&](std::string_view protocol) {
+                               h2c = h2c || protocol == "h2c";
+                             });
+    return h2c;
+  }
+
+  // Serve the rest of a connection as HTTP/2, starting with the buffered
+  // data in [begin, end). `upgrade` is the request that asked for h2c, if
+  // the connection did not start with the preface.
+  task<void> serve_http2(tcp_stream &client,
+                         detail::connection_deadline &timeout,
+                         std::vector<char> &buffer, std::size_t begin,
+                         std::size_t end, const http_request *upgrade) {
+    static constexpr std::string_view switching =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Connection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+
+    http2_connection connection(_handler, _options.http2,
+                                _options.max_body_size);
+    std::vector<iovec> iov;
+    if (upgrade != nullptr) {
+      if (!connection.upgrade(*upgrade,
+                              upgrade->header(http_field::http2_settings)
+                                  .value())) {
+        co_return;
+      }
+      iov.push_back({const_cast<char *>(switching.data()), switching.size()});
+    }
+
+    for (;;) {
+      begin += connection.receive(
+          std::span(buffer.data() + begin, end - begin));
+
+      while (connection.flush(iov)) {
+        timeout.expires_after(_options.idle_timeout);
+        if (!co_await client.async_writev(iov)) {
+          co_return;
+        }
+        connection.written();
+        iov.clear();
+      }
+      if (connection.closed()) {
+        break;
+      }
+
+      // Keep the partial frame, and grow to fit a frame larger than the
+      // buffer
+      if (begin > 0) {
+        std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+      }
+      if (end == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+      }
+
+      // Streams waiting on the client are held to request_timeout
+      timeout.expires_after(connection.open_streams() > 0 || end > 0
+                                ? _options.request_timeout
+                                : _options.idle_timeout);
+      auto received = co_await client.async_read_some(
+          std::as_writable_bytes(std::span(buffer).subspan(end)));
+      if (!received || *received == 0) {
+        co_return;
+      }
+      end += *received;
+    }
+
+    ::shutdown(client.native_handle(), SHUT_WR);
+  }
+
+  http_server_options _options;
+  handler _handler;
+  streaming_handler _streaming_handler;
+  server _server;
+};
+
+} // namespace net
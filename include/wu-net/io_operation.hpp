@@ -0,0 +1,72 @@
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+
+#include <sys/epoll.h>
+
+namespace net {
+
+#ifdef WU_NET_IO_URING
+class io_uring_backend;
+#endif
+
+// Readiness flags reported to (and requested from) the event loop
+enum class io_event : std::uint32_t {
+  none = 0,
+  readable = EPOLLIN,
+  writable = EPOLLOUT,
+  hangup = EPOLLRDHUP | EPOLLHUP,
+  error = EPOLLERR
+};
+
+constexpr io_event operator|(io_event a, io_event b) noexcept {
+  return static_cast<io_event>(static_cast<std::uint32_t>(a) |
+                               static_cast<std::uint32_t>(b));
+}
+
+constexpr io_event operator&(io_event a, io_event b) noexcept {
+  return static_cast<io_event>(static_cast<std::uint32_t>(a) &
+                               static_cast<std::uint32_t>(b));
+}
+
+constexpr io_event &operator|=(io_event &a, io_event b) noexcept {
+  return a = a | b;
+}
+
+// True if any of the flags in `b` are set in `a`
+constexpr bool has_event(io_event a, io_event b) noexcept {
+  return (a & b) != io_event::none;
+}
+
+// An I/O operation that can be parked on a descriptor until it is ready.
+// perform() attempts the operation and returns false while it would block;
+// it is called again each time the loop sees the descriptor become ready.
+// A descriptor removed from the loop while the operation is parked has its
+// `fd` set to -1 before perform() is called one last time, which must then
+// complete with an error.
+//
+// When the loop runs with the io_uring backend, operations that implement
+// submit() are handed to the kernel instead and finish in on_completion().
+struct io_operation {
+  int fd = -1;
+  std::coroutine_handle<> waiter;
+
+  virtual bool perform() noexcept = 0;
+
+#ifdef WU_NET_IO_URING
+  // Start the operation as an io_uring submission instead of waiting for
+  // readiness. Returns false if the operation has no io_uring form.
+  virtual bool submit(io_uring_backend &) noexcept { return false; }
+
+  // Deliver an io_uring completion (`result` is a syscall-style return value
+  // or -errno). Returns false if the operation queued another submission and
+  // is still pending.
+  virtual bool on_completion(int, std::uint32_t) noexcept { return true; }
+#endif
+
+protected:
+  ~io_operation() = default;
+};
+
+} // namespace net
@@ -0,0 +1,603 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "io_operation.hpp"
+
+namespace net {
+
+class io_uring_backend;
+
+// Receive buffer picked by the kernel from the backend's provided-buffer
+// ring. The buffer goes back to the ring when this is destroyed.
+class uring_buffer {
+public:
+  uring_buffer() = default;
+
+  uring_buffer(io_uring_backend *backend, std::uint16_t id,
+               std::span<const std::byte> data) noexcept
+      : backend_(backend), id_(id), data_(data) {}
+
+  // No copy
+  uring_buffer(const uring_buffer &) = delete;
+  uring_buffer &operator=(const uring_buffer &) = delete;
+
+  // Move
+  uring_buffer(uring_buffer &&other) noexcept
+      : backend_(std::exchange(other.backend_, nullptr)), id_(other.id_),
+        data_(std::exchange(other.data_, {})) {}
+
+  uring_buffer &operator=(uring_buffer &&other) noexcept {
+    if (this != &other) {
+      release();
+      backend_ = std::exchange(other.backend_, nullptr);
+      id_ = other.id_;
+      data_ = std::exchange(other.data_, {});
+    }
+    return *this;
+  }
+
+  // Destructor
+  ~uring_buffer() { release(); }
+
+  std::span<const std::byte> data() const noexcept { return data_; }
+
+  std::size_t size() const noexcept { return data_.size(); }
+
+  bool empty() const noexcept { return data_.empty(); }
+
+  // Give the buffer back to the kernel early
+  inline void release() noexcept;
+
+private:
+  io_uring_backend *backend_ = nullptr;
+  std::uint16_t id_ = 0;
+  std::span<const std::byte> data_;
+};
+
+// io_uring backend settings
+struct io_uring_options {
+  unsigned entries = 256;          // Submission queue depth
+  unsigned buffer_count = 256;     // Provided receive buffers (power of two)
+  std::size_t buffer_size = 4096;  // Bytes per provided buffer
+};
+
+// Completion-based I/O for event_loop, talking to the kernel through the raw
+// io_uring syscalls (no liburing dependency).
+//
+// Submissions queued while the loop dispatches are sent in one io_uring_enter
+// at the top of the next iteration, which also waits for completions. Accepts
+// use a single multishot request per listener, and async_receive() reads land
+// in buffers the kernel picks from a registered buffer ring, so idle
+// connections do not pin a receive buffer. The loop's epoll instance is
+// watched through a multishot poll, so readiness-based callbacks keep working
+// alongside it.
+class io_uring_backend {
+public:
+  // No copy or move (the kernel holds pointers into this object)
+  io_uring_backend(const io_uring_backend &) = delete;
+  io_uring_backend &operator=(const io_uring_backend &) = delete;
+
+  ~io_uring_backend() {
+    for (auto &[fd, queue] : accept_queues_) {
+      for (int client : queue->ready) {
+        ::close(client);
+      }
+    }
+    for (auto &queue : retired_accepts_) {
+      for (int client : queue->ready) {
+        ::close(client);
+      }
+    }
+
+    if (buffer_ring_ != nullptr) {
+      munmap(buffer_ring_, buffer_ring_size_);
+    }
+    if (sqes_ != nullptr) {
+      munmap(sqes_, params_.sq_entries * sizeof(io_uring_sqe));
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != nullptr) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+      ::close(ring_fd_);
+    }
+  }
+
+  // Get the io_uring file descriptor
+  int native_handle() const noexcept { return ring_fd_; }
+
+  // Number of operations the kernel has not completed yet
+  std::size_t pending() const noexcept { return pending_; }
+
+  // Queue a submission on behalf of `op`; the result is delivered to
+  // op.on_completion(). The caller fills in the opcode and arguments.
+  io_uring_sqe *prepare(io_operation &op) noexcept {
+    io_uring_sqe *sqe = next_sqe();
+    sqe->fd = op.fd;
+    sqe->user_data = reinterpret_cast<std::uintptr_t>(&op) | tag_operation;
+    track(op.fd, 1);
+    ++pending_;
+    return sqe;
+  }
+
+  // Queue a receive into a kernel-selected buffer from the buffer ring
+  void receive(io_operation &op) noexcept {
+    io_uring_sqe *sqe = prepare(op);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buffer_group;
+    sqe->len = static_cast<std::uint32_t>(buffer_size_);
+  }
+
+  // Accept through the listener's multishot accept request. Completes `op`
+  // immediately (and returns false) if a connection is already queued.
+  bool accept(io_operation &op) noexcept {
+    auto &queue = accept_queues_[op.fd];
+    if (!queue) {
+      queue = std::make_unique<accept_queue>();
+      queue->fd = op.fd;
+    }
+
+    if (!queue->ready.empty()) {
+      int client = queue->ready.front();
+      queue->ready.pop_front();
+      op.on_completion(client, 0);
+      return false;
+    }
+
+    queue->waiter = &op;
+    ++pending_;
+    if (!queue->armed) {
+      arm(*queue);
+    }
+    return true;
+  }
+
+  // Cancel everything in flight on `fd`; called before it is closed
+  void cancel(int fd) noexcept {
+    if (auto it = accept_queues_.find(fd); it != accept_queues_.end()) {
+      auto queue = std::move(it->second);
+      accept_queues_.erase(it);
+
+      for (int client : queue->ready) {
+        ::close(client);
+      }
+      queue->ready.clear();
+      queue->closed = true;
+
+      if (io_operation *op = std::exchange(queue->waiter, nullptr)) {
+        --pending_;
+        op->on_completion(-ECANCELED, 0);
+        canceled_.push_back(op);
+      }
+
+      if (queue->armed) {
+        io_uring_sqe *sqe = next_sqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<std::uintptr_t>(queue.get()) | tag_accept;
+        sqe->user_data = tag_ignore;
+        retired_accepts_.push_back(std::move(queue));
+      }
+    }
+
+    if (fd >= 0 && static_cast<std::size_t>(fd) < in_flight_.size() &&
+        in_flight_[fd] > 0) {
+      io_uring_sqe *sqe = next_sqe();
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = fd;
+      sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+      sqe->user_data = tag_ignore;
+    }
+
+    // The descriptor number may be reused as soon as it is closed, so the
+    // cancellation has to reach the kernel now
+    enter(0, 0, nullptr);
+  }
+
+  // Watch a descriptor (the loop's epoll instance) for readability
+  void watch(int fd) noexcept {
+    watched_fd_ = fd;
+    io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = tag_watch;
+  }
+
+  // True (once) if the watched descriptor became readable
+  bool take_watch_ready() noexcept {
+    return std::exchange(watch_ready_, false);
+  }
+
+  // Remember that the watched descriptor still has events to collect
+  void set_watch_ready() noexcept { watch_ready_ = true; }
+
+  // Submit queued entries, wait up to timeout_ms (-1 for infinite) for a
+  // completion, and dispatch everything that completed. Returns the number
+  // of operations resumed.
+  std::size_t run_once(int timeout_ms) {
+    std::size_t resumed = 0;
+
+    // Operations canceled from cancel() resume outside of the caller
+    while (!canceled_.empty()) {
+      std::vector<io_operation *> batch;
+      batch.swap(canceled_);
+      for (io_operation *op : batch) {
+        op->waiter.resume();
+        ++resumed;
+      }
+    }
+
+    if (resumed > 0 || watch_ready_ || cq_ready() > 0) {
+      timeout_ms = 0;
+    }
+
+    if (timeout_ms == 0) {
+      enter(0, 0, nullptr);
+    } else if (timeout_ms < 0) {
+      enter(1, IORING_ENTER_GETEVENTS, nullptr);
+    } else {
+      struct __kernel_timespec ts;
+      ts.tv_sec = timeout_ms / 1000;
+      ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+      enter(1, IORING_ENTER_GETEVENTS, &ts);
+    }
+
+    return resumed + reap();
+  }
+
+  // Return a provided buffer to the ring
+  void recycle(std::uint16_t id) noexcept {
+    auto &entry = buffer_ring_[buffer_tail_ & (buffer_count_ - 1)];
+    entry.addr = reinterpret_cast<std::uintptr_t>(buffer_memory_.data() +
+                                                  id * buffer_size_);
+    entry.len = static_cast<std::uint32_t>(buffer_size_);
+    entry.bid = id;
+    ++buffer_tail_;
+
+    // The ring tail overlays the first entry's reserved field
+    std::atomic_ref(buffer_ring_[0].resv)
+        .store(buffer_tail_, std::memory_order_release);
+  }
+
+  // Wrap a completed buffer-select receive in a lease
+  uring_buffer lease(int result, std::uint32_t flags) noexcept {
+    if (!(flags & IORING_CQE_F_BUFFER)) {
+      return {};
+    }
+
+    auto id = static_cast<std::uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+    std::size_t size = result > 0 ? static_cast<std::size_t>(result) : 0;
+    return uring_buffer(
+        this, id,
+        std::span<const std::byte>(buffer_memory_.data() + id * buffer_size_,
+                                   size));
+  }
+
+  // Static factory method; returns nullptr if io_uring is unavailable
+  static std::unique_ptr<io_uring_backend>
+  create(const io_uring_options &options = {}) {
+    unsigned count = options.buffer_count;
+    if (count == 0 || count > 32768 || (count & (count - 1)) != 0 ||
+        options.buffer_size == 0) {
+      return nullptr;
+    }
+
+    std::unique_ptr<io_uring_backend> backend(new io_uring_backend());
+    if (!backend->setup(options.entries) ||
+        !backend->setup_buffers(count, options.buffer_size)) {
+      return nullptr;
+    }
+
+    return backend;
+  }
+
+private:
+  static constexpr std::uint64_t tag_operation = 0;
+  static constexpr std::uint64_t tag_accept = 1;
+  static constexpr std::uint64_t tag_watch = 2;
+  static constexpr std::uint64_t tag_ignore = 3;
+  static constexpr std::uint64_t tag_mask = 3;
+  static constexpr std::uint16_t buffer_group = 0;
+
+  // State of one listener's multishot accept
+  struct accept_queue {
+    int fd = -1;
+    bool armed = false;
+    bool closed = false;
+    io_operation *waiter = nullptr;
+    std::deque<int> ready; // Accepted while nobody was waiting
+  };
+
+  io_uring_backend() = default;
+
+  bool setup(unsigned entries) {
+    params_ = {};
+    params_.flags = IORING_SETUP_COOP_TASKRUN;
+    ring_fd_ = static_cast<int>(
+        syscall(__NR_io_uring_setup, entries, &params_));
+    if (ring_fd_ < 0 && errno == EINVAL) {
+      params_ = {}; // Kernel predates COOP_TASKRUN
+      ring_fd_ = static_cast<int>(
+          syscall(__NR_io_uring_setup, entries, &params_));
+    }
+    if (ring_fd_ < 0 || !(params_.features & IORING_FEAT_EXT_ARG)) {
+      return false;
+    }
+
+    sq_ring_size_ =
+        params_.sq_off.array + params_.sq_entries * sizeof(std::uint32_t);
+    cq_ring_size_ =
+        params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params_.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == nullptr) {
+      return false;
+    }
+    cq_ring_ = single_mmap ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+    sqes_ = static_cast<io_uring_sqe *>(
+        map(params_.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+    if (cq_ring_ == nullptr || sqes_ == nullptr) {
+      return false;
+    }
+
+    auto *sq = static_cast<char *>(sq_ring_);
+    sq_head_ = reinterpret_cast<std::uint32_t *>(sq + params_.sq_off.head);
+    sq_tail_ = reinterpret_cast<std::uint32_t *>(sq + params_.sq_off.tail);
+    sq_mask_ =
+        *reinterpret_cast<std::uint32_t *>(sq + params_.sq_off.ring_mask);
+
+    // Submission slots map one-to-one onto SQEs
+    auto *array = reinterpret_cast<std::uint32_t *>(sq + params_.sq_off.array);
+    for (unsigned i = 0; i < params_.sq_entries; ++i) {
+      array[i] = i;
+    }
+
+    auto *cq = static_cast<char *>(cq_ring_);
+    cq_head_ = reinterpret_cast<std::uint32_t *>(cq + params_.cq_off.head);
+    cq_tail_ = reinterpret_cast<std::uint32_t *>(cq + params_.cq_off.tail);
+    cq_mask_ =
+        *reinterpret_cast<std::uint32_t *>(cq + params_.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params_.cq_off.cqes);
+
+    sq_local_tail_ = *sq_tail_;
+    return true;
+  }
+
+  bool setup_buffers(unsigned count, std::size_t size) {
+    buffer_count_ = count;
+    buffer_size_ = size;
+    buffer_memory_.resize(count * size);
+
+    buffer_ring_size_ = count * sizeof(io_uring_buf);
+    void *ring = mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring == MAP_FAILED) {
+      return false;
+    }
+    // io_uring_buf_ring's flexible array member is laid out differently
+    // when compiled as C++, so the ring is addressed as plain entries
+    buffer_ring_ = static_cast<io_uring_buf *>(ring);
+
+    struct io_uring_buf_reg reg = {};
+    reg.ring_addr = reinterpret_cast<std::uintptr_t>(ring);
+    reg.ring_entries = count;
+    reg.bgid = buffer_group;
+    if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING,
+                &reg, 1) < 0) {
+      return false;
+    }
+
+    for (unsigned id = 0; id < count; ++id) {
+      recycle(static_cast<std::uint16_t>(id));
+    }
+    return true;
+  }
+
+  void *map(std::size_t size, std::uint64_t offset) {
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd_,
+                     static_cast<off_t>(offset));
+    return ptr == MAP_FAILED ? nullptr : ptr;
+  }
+
+  io_uring_sqe *next_sqe() noexcept {
+    // Submission queue full: flush it to the kernel first
+    while (sq_local_tail_ -
+               std::atomic_ref(*sq_head_).load(std::memory_order_acquire) >=
+           params_.sq_entries) {
+      enter(0, 0, nullptr);
+    }
+
+    io_uring_sqe *sqe = &sqes_[sq_local_tail_ & sq_mask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sq_local_tail_;
+    return sqe;
+  }
+
+  // Publish queued submissions and optionally wait for completions
+  void enter(unsigned wait_nr, unsigned flags,
+             struct __kernel_timespec *timeout) noexcept {
+    std::uint32_t tail = sq_local_tail_;
+    std::atomic_ref(*sq_tail_).store(tail, std::memory_order_release);
+    unsigned to_submit =
+        tail - std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+
+    if (to_submit == 0 && wait_nr == 0) {
+      return;
+    }
+
+    struct io_uring_getevents_arg arg = {};
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<std::uintptr_t>(timeout);
+
+    long res;
+    do {
+      res = syscall(__NR_io_uring_enter, ring_fd_, to_submit, wait_nr,
+                    flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    } while (res < 0 && errno == EINTR && wait_nr == 0);
+  }
+
+  unsigned cq_ready() const noexcept {
+    return std::atomic_ref(*cq_tail_).load(std::memory_order_acquire) -
+           *cq_head_;
+  }
+
+  void arm(accept_queue &queue) noexcept {
+    io_uring_sqe *sqe = next_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = queue.fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = reinterpret_cast<std::uintptr_t>(&queue) | tag_accept;
+    queue.armed = true;
+  }
+
+  void track(int fd, int delta) noexcept {
+    if (fd < 0) {
+      return;
+    }
+    if (static_cast<std::size_t>(fd) >= in_flight_.size()) {
+      in_flight_.resize(static_cast<std::size_t>(fd) + 1);
+    }
+    in_flight_[fd] += delta;
+  }
+
+  std::size_t reap() {
+    std::size_t resumed = 0;
+    std::uint32_t head = *cq_head_;
+
+    while (head != std::atomic_ref(*cq_tail_).load(std::memory_order_acquire)) {
+      io_uring_cqe cqe = cqes_[head & cq_mask_];
+      ++head;
+      std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+
+      std::uint64_t tag = cqe.user_data & tag_mask;
+      void *ptr = reinterpret_cast<void *>(cqe.user_data & ~tag_mask);
+
+      if (tag == tag_operation) {
+        auto *op = static_cast<io_operation *>(ptr);
+        track(op->fd, -1);
+        --pending_;
+        if (op->on_completion(cqe.res, cqe.flags)) {
+          op->waiter.resume();
+          ++resumed;
+        }
+      } else if (tag == tag_accept) {
+        resumed += on_accept(*static_cast<accept_queue *>(ptr), cqe);
+      } else if (tag == tag_watch) {
+        watch_ready_ = true;
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+          watch(watched_fd_);
+        }
+      }
+    }
+
+    return resumed;
+  }
+
+  std::size_t on_accept(accept_queue &queue, const io_uring_cqe &cqe) {
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+      queue.armed = false;
+    }
+
+    if (queue.closed) {
+      if (cqe.res >= 0) {
+        ::close(cqe.res);
+      }
+      if (!queue.armed) {
+        std::erase_if(retired_accepts_,
+                      [&](const auto &q) { return q.get() == &queue; });
+      }
+      return 0;
+    }
+
+    std::size_t resumed = 0;
+    if (io_operation *op = queue.waiter) {
+      // Errors end the multishot request and are reported to the waiter
+      queue.waiter = nullptr;
+      --pending_;
+      op->on_completion(cqe.res, 0);
+      op->waiter.resume();
+      resumed = 1;
+    } else if (cqe.res >= 0) {
+      queue.ready.push_back(cqe.res);
+    }
+
+    if (!queue.armed && queue.waiter != nullptr) {
+      arm(queue);
+    }
+    return resumed;
+  }
+
+  int ring_fd_ = -1;
+  struct io_uring_params params_ = {};
+
+  void *sq_ring_ = nullptr;
+  void *cq_ring_ = nullptr;
+  std::size_t sq_ring_size_ = 0;
+  std::size_t cq_ring_size_ = 0;
+  io_uring_sqe *sqes_ = nullptr;
+  io_uring_cqe *cqes_ = nullptr;
+  std::uint32_t *sq_head_ = nullptr;
+  std::uint32_t *sq_tail_ = nullptr;
+  std::uint32_t *cq_head_ = nullptr;
+  std::uint32_t *cq_tail_ = nullptr;
+  std::uint32_t sq_mask_ = 0;
+  std::uint32_t cq_mask_ = 0;
+  std::uint32_t sq_local_tail_ = 0;
+
+  io_uring_buf *buffer_ring_ = nullptr;
+  std::size_t buffer_ring_size_ = 0;
+  std::vector<std::byte> buffer_memory_;
+  unsigned buffer_count_ = 0;
+  std::size_t buffer_size_ = 0;
+  std::uint16_t buffer_tail_ = 0;
+
+  std::size_t pending_ = 0;
+  std::vector<std::uint32_t> in_flight_; // Indexed by fd
+  std::unordered_map<int, std::unique_ptr<accept_queue>> accept_queues_;
+  std::vector<std::unique_ptr<accept_queue>> retired_accepts_;
+  std::vector<io_operation *> canceled_;
+
+  int watched_fd_ = -1;
+  bool watch_ready_ = false;
+};
+
+inline void uring_buffer::release() noexcept {
+  if (backend_ != nullptr) {
+    std::exchange(backend_, nullptr)->recycle(id_);
+    data_ = {};
+  }
+}
+
+} // namespace net
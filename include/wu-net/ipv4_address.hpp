@@ -1,16 +1,222 @@
 #pragma once
 
 #include <array>
+#include <bit>
+#include <charconv>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <format>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <system_error>
 
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+#if defined(__SSE4_1__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 namespace net {
+
+namespace detail {
+
+// Decimal text of every octet value followed by a '.', so an address is
+// written with four fixed-size copies
+struct ipv4_octet_text {
+  std::array<char, 4> chars;
+  std::uint8_t size; // Digits, not counting the '.'
+};
+
+inline constexpr auto ipv4_octet_texts = [] {
+  std::array<ipv4_octet_text, 256> table{};
+  for (int value = 0; value < 256; ++value) {
+    auto &entry = table[value];
+    int size = value >= 100 ? 3 : value >= 10 ? 2 : 1;
+    for (int i = size - 1, v = value; i >= 0; --i, v /= 10) {
+      entry.chars[i] = static_cast<char>('0' + v % 10);
+    }
+    entry.chars[size] = '.';
+    entry.size = static_cast<std::uint8_t>(size);
+  }
+  return table;
+}();
+
+// Write the dotted quad at `out`, which needs 16 bytes of room even though
+// at most 15 are used; returns the end of the text
+inline char *write_ipv4(const std::array<std::uint8_t, 4> &octets,
+                        char *out) noexcept {
+  for (std::uint8_t octet : octets) {
+    const auto &text = ipv4_octet_texts[octet];
+    std::memcpy(out, text.chars.data(), 4);
+    out += text.size + 1;
+  }
+  return out - 1;
+}
+
+// Parse a dotted quad of four 1-3 digit decimal octets, each at most 255
+inline bool parse_ipv4_scalar(const char *text, std::size_t size,
+                              std::array<std::uint8_t, 4> &octets) noexcept {
+  const char *p = text;
+  const char *end = text + size;
+  for (std::size_t i = 0; i < 4; ++i) {
+    unsigned value = 0;
+    int digits = 0;
+    while (p < end && digits < 3 && *p >= '0' && *p <= '9') {
+      value = value * 10 + static_cast<unsigned>(*p - '0');
+      ++p;
+      ++digits;
+    }
+    if (digits == 0 || value > 255) {
+      return false;
+    }
+    octets[i] = static_cast<std::uint8_t>(value);
+
+    if (i < 3) {
+      if (p == end || *p != '.') {
+        return false;
+      }
+      ++p;
+    }
+  }
+  return p == end;
+}
+
+#if defined(__SSE4_1__) && defined(__x86_64__)
+
+// pshufb masks for every combination of octet lengths (3^4), indexed by
+// (l0-1)*27 + (l1-1)*9 + (l2-1)*3 + (l3-1). Each octet's digits land right
+// aligned in its own 32-bit lane as {0, hundreds, tens, ones}.
+inline constexpr auto ipv4_shuffles = [] {
+  std::array<std::array<std::uint8_t, 16>, 81> table{};
+  for (int combination = 0; combination < 81; ++combination) {
+    const int lengths[4] = {combination / 27 + 1, combination / 9 % 3 + 1,
+                            combination / 3 % 3 + 1, combination % 3 + 1};
+    auto &shuffle = table[combination];
+    int start = 0;
+    for (int i = 0; i < 4; ++i) {
+      int length = lengths[i];
+      auto at = [](int index) { return static_cast<std::uint8_t>(index); };
+      shuffle[4 * i] = 0x80;
+      shuffle[4 * i + 1] = length == 3 ? at(start) : 0x80;
+      shuffle[4 * i + 2] = length >= 2 ? at(start + length - 2) : 0x80;
+      shuffle[4 * i + 3] = at(start + length - 1);
+      start += length + 1;
+    }
+  }
+  return table;
+}();
+
+// pshufb masks moving a vector up by 0-8 bytes, zero filling
+inline constexpr auto ipv4_shifts = [] {
+  std::array<std::array<std::uint8_t, 16>, 9> table{};
+  for (int shift = 0; shift <= 8; ++shift) {
+    for (int i = 0; i < 16; ++i) {
+      table[shift][i] =
+          static_cast<std::uint8_t>(i >= shift ? i - shift : 0x80);
+    }
+  }
+  return table;
+}();
+
+// The `size` (7-15) bytes at `text` in the low lanes of a vector, zero
+// filled, read as two overlapping loads so nothing past the end is touched
+inline __m128i load_ipv4_text(const char *text, std::size_t size) noexcept {
+  __m128i low, high;
+  std::size_t shift;
+  if (size >= 8) {
+    std::uint64_t first, last;
+    std::memcpy(&first, text, 8);
+    std::memcpy(&last, text + size - 8, 8);
+    low = _mm_cvtsi64_si128(static_cast<long long>(first));
+    high = _mm_cvtsi64_si128(static_cast<long long>(last));
+    shift = size - 8;
+  } else {
+    std::uint32_t first, last;
+    std::memcpy(&first, text, 4);
+    std::memcpy(&last, text + size - 4, 4);
+    low = _mm_cvtsi32_si128(static_cast<int>(first));
+    high = _mm_cvtsi32_si128(static_cast<int>(last));
+    shift = size - 4;
+  }
+  __m128i mask = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(ipv4_shifts[shift].data()));
+  return _mm_or_si128(low, _mm_shuffle_epi8(high, mask));
+}
+
+// Same rules as parse_ipv4_scalar, checking and converting all 16 bytes
+// at once: the dot positions select a shuffle that lines the digits up,
+// and two multiply-adds turn them into the four octet values
+inline bool parse_ipv4_sse(const char *text, std::size_t size,
+                           std::array<std::uint8_t, 4> &octets) noexcept {
+  if (size < 7 || size > 15) {
+    return false;
+  }
+
+  __m128i input = load_ipv4_text(text, size);
+  __m128i digits = _mm_sub_epi8(input, _mm_set1_epi8('0'));
+
+  unsigned used = (1u << size) - 1;
+  unsigned dots = static_cast<unsigned>(_mm_movemask_epi8(
+                      _mm_cmpeq_epi8(input, _mm_set1_epi8('.')))) &
+                  used;
+  unsigned numeric = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+      _mm_min_epu8(digits, _mm_set1_epi8(9)), digits)));
+  if (((numeric | dots) & used) != used || std::popcount(dots) != 3) {
+    return false;
+  }
+
+  unsigned first = static_cast<unsigned>(std::countr_zero(dots));
+  dots &= dots - 1;
+  unsigned second = static_cast<unsigned>(std::countr_zero(dots));
+  dots &= dots - 1;
+  unsigned third = static_cast<unsigned>(std::countr_zero(dots));
+  unsigned lengths[4] = {first, second - first - 1, third - second - 1,
+                         static_cast<unsigned>(size) - third - 1};
+  unsigned combination = 0;
+  for (unsigned length : lengths) {
+    if (length - 1 > 2) {
+      return false; // Empty, or longer than three digits
+    }
+    combination = combination * 3 + (length - 1);
+  }
+
+  __m128i shuffle = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(ipv4_shuffles[combination].data()));
+  __m128i aligned = _mm_shuffle_epi8(digits, shuffle);
+  __m128i pairs = _mm_maddubs_epi16(
+      aligned, _mm_setr_epi8(0, 100, 10, 1, 0, 100, 10, 1, 0, 100, 10, 1, 0,
+                             100, 10, 1));
+  __m128i values = _mm_madd_epi16(pairs, _mm_set1_epi16(1));
+  if (_mm_movemask_epi8(_mm_cmpgt_epi32(values, _mm_set1_epi32(255)))) {
+    return false;
+  }
+
+  __m128i packed = _mm_packus_epi16(_mm_packus_epi32(values, values),
+                                    _mm_setzero_si128());
+  std::uint32_t word = static_cast<std::uint32_t>(_mm_cvtsi128_si32(packed));
+  std::memcpy(octets.data(), &word, 4);
+  return true;
+}
+
+#endif
+
+inline bool parse_ipv4(const char *text, std::size_t size,
+                       std::array<std::uint8_t, 4> &octets) noexcept {
+#if defined(__SSE4_1__) && defined(__x86_64__)
+  return parse_ipv4_sse(text, size, octets);
+#else
+  return parse_ipv4_scalar(text, size, octets);
+#endif
+}
+
+} // namespace detail
+
 class ipv4_address {
 public:
   constexpr ipv4_address() : _octets({0, 0, 0, 0}) {}
@@ -30,61 +236,88 @@ public:
 
   ipv4_address &operator=(ipv4_address &&) = default;
 
+  constexpr bool operator==(const ipv4_address &) const = default;
+
+  // Longest dotted quad ("255.255.255.255")
+  static constexpr std::size_t max_string_size = 15;
+
   std::string to_string() const {
-    return std::format("{}.{}.{}.{}", _octets[0], _octets[1], _octets[2],
-                       _octets[3]);
+    char buffer[16];
+    return std::string(buffer, detail::write_ipv4(_octets, buffer));
+  }
+
+  // Write the dotted quad to [first, last) without allocating, in the
+  // manner of std::to_chars
+  std::to_chars_result to_chars(char *first, char *last) const noexcept {
+    if (last - first >= 16) {
+      return {detail::write_ipv4(_octets, first), std::errc{}};
+    }
+
+    char buffer[16];
+    char *end = detail::write_ipv4(_octets, buffer);
+    if (last - first < end - buffer) {
+      return {last, std::errc::value_too_large};
+    }
+    return {std::copy(buffer, end, first), std::errc{}};
   }
 
   const std::array<std::uint8_t, 4> &octets() const { return _octets; }
 
+  // The address as a host byte order integer (127.0.0.1 is 0x7f000001)
+  constexpr std::uint32_t to_uint32() const noexcept {
+    return std::uint32_t{_octets[0]} << 24 | std::uint32_t{_octets[1]} << 16 |
+           std::uint32_t{_octets[2]} << 8 | _octets[3];
+  }
+
+  static constexpr ipv4_address from_uint32(std::uint32_t value) noexcept {
+    return ipv4_address(static_cast<std::uint8_t>(value >> 24),
+                        static_cast<std::uint8_t>(value >> 16),
+                        static_cast<std::uint8_t>(value >> 8),
+                        static_cast<std::uint8_t>(value));
+  }
+
   template <std::ranges::contiguous_range Range>
     requires std::is_same_v<std::ranges::range_value_t<Range>, char>
   static std::optional<ipv4_address> from_str(const Range &str) {
     const char *start = std::ranges::data(str);
-    const char *end = start + std::ranges::size(str);
+    std::size_t size = std::ranges::size(str);
 
-    if (start < end && *(end - 1) == '\0') {
-      --end;
+    if (size > 0 && start[size - 1] == '\0') {
+      --size;
     }
 
-    // Empty string check
-    if (start == end) {
+    std::array<std::uint8_t, 4> octets;
+    if (!detail::parse_ipv4(start, size, octets)) {
       return std::nullopt;
     }
+    return ipv4_address(octets);
+  }
 
-    std::array<std::uint8_t, 4> octets{};
-    const char *current = start;
-
-    for (size_t i = 0; i < 4; ++i) {
-      // Check if we have data for this octet
-      if (current >= end) {
-        return std::nullopt;
-      }
-
-      // Parse the octet
-      unsigned int value = 0;
-      auto result = std::from_chars(current, end, value);
-
-      if (result.ec != std::errc{} || value > 255) {
-        return std::nullopt;
-      }
-
-      octets[i] = static_cast<std::uint8_t>(value);
-      current = result.ptr;
-
-      if (i < 3) {
-        if (current >= end || *current != '.') {
-          return std::nullopt;
-        }
-        ++current;
+  // Parse input[i] into output[i] until an entry fails to parse or output
+  // is full; returns how many were parsed
+  static std::size_t parse_many(std::span<const std::string_view> input,
+                                std::span<ipv4_address> output) noexcept {
+    std::size_t count = std::min(input.size(), output.size());
+    for (std::size_t i = 0; i < count; ++i) {
+      if (!detail::parse_ipv4(input[i].data(), input[i].size(),
+                              output[i]._octets)) {
+        return i;
       }
     }
+    return count;
+  }
 
-    if (current != end) {
-      return std::nullopt;
+  // Append every address to `out`, each followed by `separator`
+  static void format_many(std::span<const ipv4_address> addresses,
+                          std::string &out, char separator = '\n') {
+    std::size_t size = out.size();
+    out.resize(size + addresses.size() * (max_string_size + 1) + 1);
+    char *p = out.data() + size;
+    for (const ipv4_address &address : addresses) {
+      p = detail::write_ipv4(address._octets, p);
+      *p++ = separator;
     }
-
-    return ipv4_address(octets);
+    out.resize(static_cast<std::size_t>(p - out.data()));
   }
 
   static std::optional<ipv4_address> resolve_host(std::string_view hostname) {
@@ -142,8 +375,8 @@ template <> struct std::formatter<net::ipv4_address> {
   constexpr auto parse(std::format_parse_context &ctx) { return ctx.begin(); }
 
   auto format(const net::ipv4_address &addr, std::format_context &ctx) const {
-    const auto &octets = addr.octets();
-    return std::format_to(ctx.out(), "{}.{}.{}.{}", octets[0], octets[1],
-                          octets[2], octets[3]);
+    char buffer[16];
+    auto result = addr.to_chars(buffer, buffer + sizeof(buffer));
+    return std::copy(buffer, result.ptr, ctx.out());
   }
 };
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "ipv4_address.hpp"
+
+namespace net {
+
+// An IPv4 prefix in CIDR notation ("10.0.0.0/8"). Host bits are always
+// cleared, so equal networks compare equal however they were written.
+class ipv4_network {
+public:
+  // Longest text ("255.255.255.255/32")
+  static constexpr std::size_t max_string_size =
+      ipv4_address::max_string_size + 3;
+
+  // 0.0.0.0/0, which contains every address
+  constexpr ipv4_network() = default;
+
+  // Prefix lengths above 32 are treated as 32
+  constexpr ipv4_network(ipv4_address address, std::uint8_t prefix_length)
+      : _prefix_length(std::min<std::uint8_t>(prefix_length, 32)) {
+    _address = ipv4_address::from_uint32(address.to_uint32() & mask());
+  }
+
+  constexpr bool operator==(const ipv4_network &) const = default;
+
+  // The network address (host bits cleared)
+  constexpr ipv4_address address() const noexcept { return _address; }
+
+  constexpr std::uint8_t prefix_length() const noexcept {
+    return _prefix_length;
+  }
+
+  constexpr ipv4_address netmask() const noexcept {
+    return ipv4_address::from_uint32(mask());
+  }
+
+  // Lowest and highest address in the network
+  constexpr ipv4_address first() const noexcept { return _address; }
+
+  constexpr ipv4_address last() const noexcept {
+    return ipv4_address::from_uint32(_address.to_uint32() | ~mask());
+  }
+
+  constexpr bool contains(ipv4_address address) const noexcept {
+    return (address.to_uint32() & mask()) == _address.to_uint32();
+  }
+
+  // True if `other` lies entirely inside this network
+  constexpr bool contains(const ipv4_network &other) const noexcept {
+    return other._prefix_length >= _prefix_length && contains(other._address);
+  }
+
+  std::string to_string() const {
+    char buffer[max_string_size];
+    return std::string(buffer, to_chars(buffer, buffer + sizeof(buffer)).ptr);
+  }
+
+  std::to_chars_result to_chars(char *first, char *last) const noexcept {
+    auto result = _address.to_chars(first, last);
+    if (result.ec != std::errc{} || result.ptr == last) {
+      return {last, std::errc::value_too_large};
+    }
+    *result.ptr++ = '/';
+    return std::to_chars(result.ptr, last, _prefix_length);
+  }
+
+  // Parse "a.b.c.d/n"; a bare address is a /32. Host bits may be set and
+  // are cleared.
+  static std::optional<ipv4_network> from_str(std::string_view text) {
+    std::size_t slash = text.find('/');
+    auto address = ipv4_address::from_str(text.substr(0, slash));
+    if (!address) {
+      return std::nullopt;
+    }
+    if (slash == std::string_view::npos) {
+      return ipv4_network(*address, 32);
+    }
+
+    unsigned length = 0;
+    const char *begin = text.data() + slash + 1;
+    const char *end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(begin, end, length);
+    if (ec != std::errc{} || ptr != end || ptr - begin > 2 || length > 32) {
+      return std::nullopt;
+    }
+    return ipv4_network(*address, static_cast<std::uint8_t>(length));
+  }
+
+private:
+  static constexpr std::uint32_t mask_for(unsigned length) noexcept {
+    return length == 0 ? 0 : ~std::uint32_t{0} << (32 - length);
+  }
+
+  constexpr std::uint32_t mask() const noexcept {
+    return mask_for(_prefix_length);
+  }
+
+  ipv4_address _address;
+  std::uint8_t _prefix_length = 0;
+};
+
+} // namespace net
+
+template <> struct std::formatter<net::ipv4_network> {
+  constexpr auto parse(std::format_parse_context &ctx) { return ctx.begin(); }
+
+  auto format(const net::ipv4_network &network,
+              std::format_context &ctx) const {
+    char buffer[net::ipv4_network::max_string_size];
+    auto result = network.to_chars(buffer, buffer + sizeof(buffer));
+    return std::copy(buffer, result.ptr, ctx.out());
+  }
+};
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ipv4_address.hpp"
+#include "ipv4_network.hpp"
+
+namespace net {
+
+// Longest-prefix-match table mapping IPv4 networks to values (DIR-24-8).
+//
+// A flat array indexed by the top 24 bits of an address answers every
+// prefix up to /24 in one load. Slots covered by a longer prefix point to
+// a 256-entry group indexed by the last octet instead, so no lookup takes
+// more than two dependent loads before reaching its value. The array
+// alone is 64 MiB; groups are only allocated for /25-/32 prefixes.
+//
+// Lookups never lock and may run on any number of threads while one
+// writer at a time (serialized internally) inserts and erases. Entries
+// are rewritten in place with release stores, so a concurrent lookup sees
+// either the old or the new answer for an address. Groups and values
+// replaced by an update are retired rather than freed, because a lookup
+// that started before the update may still read them; call reclaim() once
+// every such lookup has finished (e.g. when all workers have passed a
+// quiescent point) to make their memory reusable.
+template <typename T> class ipv4_prefix_table {
+public:
+  ipv4_prefix_table()
+      : _level24(std::make_unique<std::atomic<entry>[]>(level24_size)),
+        _groups(std::make_unique<std::unique_ptr<group_chunk>[]>(
+            max_ids / groups_per_chunk)),
+        _values(std::make_unique<std::unique_ptr<std::optional<T>[]>[]>(
+            max_ids / values_per_chunk)) {}
+
+  // No copy or move (readers hold pointers into the table)
+  ipv4_prefix_table(const ipv4_prefix_table &) = delete;
+  ipv4_prefix_table &operator=(const ipv4_prefix_table &) = delete;
+
+  // Value of the longest prefix containing `address`, or null. The pointer
+  // stays valid until the prefix is replaced or erased and reclaim() runs.
+  const T *lookup(ipv4_address address) const noexcept {
+    std::uint32_t bits = address.to_uint32();
+    entry e = _level24[bits >> 8].load(std::memory_order_acquire);
+    if (e & extended) {
+      e = group(e & payload_mask)[bits & 0xff].load(std::memory_order_acquire);
+    }
+    return value(e);
+  }
+
+  // lookup() for every address, prefetching ahead to overlap the cache
+  // misses of neighbouring lookups; results[i] answers addresses[i]
+  void lookup_many(std::span<const ipv4_address> addresses,
+                   std::span<const T *> results) const noexcept {
+    constexpr std::size_t distance = 8;
+    std::size_t count = std::min(addresses.size(), results.size());
+    for (std::size_t i = 0; i < count; ++i) {
+      if (i + distance < count) {
+        __builtin_prefetch(
+            &_level24[addresses[i + distance].to_uint32() >> 8]);
+      }
+      results[i] = lookup(addresses[i]);
+    }
+  }
+
+  // Value stored for exactly `network`, or null
+  const T *find(const ipv4_network &network) const {
+    std::lock_guard lock(_mutex);
+    auto &prefixes = _prefixes[network.prefix_length()];
+    auto it = prefixes.find(network.address().to_uint32());
+    return it == prefixes.end() ? nullptr : &*slot(it->second);
+  }
+
+  // Add `network`, or replace its value. False if the table has run out of
+  // value or group slots (2^24 of each).
+  bool insert(const ipv4_network &network, T value) {
+    std::lock_guard lock(_mutex);
+    auto id = allocate_value(std::move(value));
+    if (!id) {
+      return false;
+    }
+
+    unsigned depth = network.prefix_length();
+    auto [it, inserted] =
+        _prefixes[depth].try_emplace(network.address().to_uint32(), *id);
+    if (!inserted) {
+      _retired_values.push_back(std::exchange(it->second, *id));
+    }
+
+    bool assigned =
+        assign(network, make_entry(*id, depth),
+               [depth](entry e) { return entry_depth(e) <= depth; });
+    if (!assigned) {
+      // No group for a /25-/32 prefix; leave the table as it was
+      if (inserted) {
+        _prefixes[depth].erase(it);
+      } else {
+        it->second = _retired_values.back();
+        _retired_values.pop_back();
+      }
+      slot(*id).reset(); // Never published
+      _free_values.push_back(*id);
+      return false;
+    }
+    return true;
+  }
+
+  // Remove `network`; addresses it covered fall back to the next shorter
+  // prefix containing them
+  bool erase(const ipv4_network &network) {
+    std::lock_guard lock(_mutex);
+    unsigned depth = network.prefix_length();
+    std::uint32_t bits = network.address().to_uint32();
+    auto it = _prefixes[depth].find(bits);
+    if (it == _prefixes[depth].end()) {
+      return false;
+    }
+    _retired_values.push_back(it->second);
+    _prefixes[depth].erase(it);
+
+    entry replacement = 0;
+    for (unsigned shorter = depth; shorter-- > 0;) {
+      std::uint32_t covering = ipv4_network(network.address(),
+                                            static_cast<std::uint8_t>(shorter))
+                                   .address()
+                                   .to_uint32();
+      if (auto parent = _prefixes[shorter].find(covering);
+          parent != _prefixes[shorter].end()) {
+        replacement = make_entry(parent->second, shorter);
+        break;
+      }
+    }
+
+    assign(network, replacement,
+           [depth](entry e) { return entry_depth(e) == depth; });
+    return true;
+  }
+
+  // Number of prefixes
+  std::size_t size() const {
+    std::lock_guard lock(_mutex);
+    std::size_t total = 0;
+    for (const auto &prefixes : _prefixes) {
+      total += prefixes.size();
+    }
+    return total;
+  }
+
+  // Groups in use for /25-/32 prefixes
+  std::size_t group_count() const {
+    std::lock_guard lock(_mutex);
+    return _group_count - _free_groups.size() - _retired_groups.size();
+  }
+
+  // Make retired groups and values reusable. Only call this when no lookup
+  // that started before the last insert() or erase() is still running.
+  void reclaim() {
+    std::lock_guard lock(_mutex);
+    for (std::uint32_t id : _retired_values) {
+      slot(id).reset();
+      _free_values.push_back(id);
+    }
+    _retired_values.clear();
+    _free_groups.insert(_free_groups.end(), _retired_groups.begin(),
+                        _retired_groups.end());
+    _retired_groups.clear();
+  }
+
+private:
+  // Entry layout: the top bit marks a level-24 entry that points to a
+  // group; otherwise bits 24-29 hold the prefix length and the low 24 bits
+  // a value id (0 for no match)
+  using entry = std::uint32_t;
+  static constexpr entry extended = entry{1} << 31;
+  static constexpr entry payload_mask = (entry{1} << 24) - 1;
+
+  static constexpr std::size_t level24_size = std::size_t{1} << 24;
+  static constexpr std::size_t group_size = 256;
+  static constexpr std::size_t groups_per_chunk = 256;
+  static constexpr std::size_t values_per_chunk = 4096;
+  static constexpr std::size_t max_ids = std::size_t{1} << 24;
+
+  struct group_chunk {
+    std::array<std::atomic<entry>, group_size * groups_per_chunk> entries{};
+  };
+
+  static constexpr entry make_entry(std::uint32_t id, unsigned depth) noexcept {
+    return entry{depth} << 24 | id;
+  }
+
+  static constexpr unsigned entry_depth(entry e) noexcept {
+    return (e >> 24) & 0x3f;
+  }
+
+  std::atomic<entry> *group(std::uint32_t index) const noexcept {
+    return &_groups[index / groups_per_chunk]
+                ->entries[(index % groups_per_chunk) * group_size];
+  }
+
+  std::optional<T> &slot(std::uint32_t id) const noexcept {
+    return _values[id / values_per_chunk][id % values_per_chunk];
+  }
+
+  const T *value(entry e) const noexcept {
+    std::uint32_t id = e & payload_mask;
+    return id == 0 ? nullptr : &*slot(id);
+  }
+
+  // Chunks are allocated on demand and never move, so readers can follow
+  // an id without synchronizing with allocation
+  std::optional<std::uint32_t> allocate_value(T value) {
+    std::uint32_t id;
+    if (!_free_values.empty()) {
+      id = _free_values.back();
+      _free_values.pop_back();
+    } else {
+      if (_value_count + 1 >= max_ids) {
+        return std::nullopt;
+      }
+      id = static_cast<std::uint32_t>(++_value_count); // 0 means no value
+      auto &chunk = _values[id / values_per_chunk];
+      if (!chunk) {
+        chunk = std::make_unique<std::optional<T>[]>(values_per_chunk);
+      }
+    }
+    slot(id).emplace(std::move(value));
+    return id;
+  }
+
+  // A group whose entries all start as `fill`
+  std::optional<std::uint32_t> allocate_group(entry fill) {
+    std::uint32_t index;
+    if (!_free_groups.empty()) {
+      index = _free_groups.back();
+      _free_groups.pop_back();
+    } else {
+      if (_group_count >= max_ids) {
+        return std::nullopt;
+      }
+      index = static_cast<std::uint32_t>(_group_count++);
+      auto &chunk = _groups[index / groups_per_chunk];
+      if (!chunk) {
+        chunk = std::make_unique<group_chunk>();
+      }
+    }
+
+    std::atomic<entry> *entries = group(index);
+    for (std::size_t i = 0; i < group_size; ++i) {
+      entries[i].store(fill, std::memory_order_relaxed);
+    }
+    return index;
+  }
+
+  // Set every entry under `network` that `replace` selects to `to`. Longer
+  // prefixes nested inside keep their entries because their depth is
+  // greater. False if a group was needed and none was available.
+  template <typename Predicate>
+  bool assign(const ipv4_network &network, entry to, Predicate replace) {
+    std::uint32_t bits = network.address().to_uint32();
+    unsigned depth = network.prefix_length();
+
+    if (depth <= 24) {
+      std::size_t first = bits >> 8;
+      std::size_t last = first + (std::size_t{1} << (24 - depth));
+      for (std::size_t i = first; i < last; ++i) {
+        entry e = _level24[i].load(std::memory_order_relaxed);
+        if (e & extended) {
+          assign_group(i, e & payload_mask, 0, group_size, to, replace);
+        } else if (replace(e)) {
+          _level24[i].store(to, std::memory_order_release);
+        }
+      }
+      return true;
+    }
+
+    std::size_t i = bits >> 8;
+    entry e = _level24[i].load(std::memory_order_relaxed);
+    if (!(e & extended)) {
+      auto index = allocate_group(e);
+      if (!index) {
+        return false;
+      }
+      // The group is filled before it is published
+      e = extended | *index;
+      _level24[i].store(e, std::memory_order_release);
+    }
+
+    std::size_t first = bits & 0xff;
+    assign_group(i, e & payload_mask, first,
+                 first + (std::size_t{1} << (32 - depth)), to, replace);
+    return true;
+  }
+
+  // assign() within one group, folding the group back into its level-24
+  // entry once no prefix longer than /24 remains in it
+  template <typename Predicate>
+  void assign_group(std::size_t level24_index, std::uint32_t index,
+                    std::size_t first, std::size_t last, entry to,
+                    Predicate replace) {
+    std::atomic<entry> *entries = group(index);
+    for (std::size_t j = first; j < last; ++j) {
+      if (replace(entries[j].load(std::memory_order_relaxed))) {
+        entries[j].store(to, std::memory_order_release);
+      }
+    }
+
+    entry common = entries[0].load(std::memory_order_relaxed);
+    if (entry_depth(common) > 24) {
+      return;
+    }
+    for (std::size_t j = 1; j < group_size; ++j) {
+      if (entries[j].load(std::memory_order_relaxed) != common) {
+        return;
+      }
+    }
+    _level24[level24_index].store(common, std::memory_order_release);
+    _retired_groups.push_back(index);
+  }
+
+  std::unique_ptr<std::atomic<entry>[]> _level24;
+  std::unique_ptr<std::unique_ptr<group_chunk>[]> _groups;
+  std::unique_ptr<std::unique_ptr<std::optional<T>[]>[]> _values;
+
+  // Writer state
+  mutable std::mutex _mutex;
+  std::array<std::unordered_map<std::uint32_t, std::uint32_t>, 33> _prefixes;
+  std::size_t _value_count = 0;
+  std::size_t _group_count = 0;
+  std::vector<std::uint32_t> _free_values, _retired_values;
+  std::vector<std::uint32_t> _free_groups, _retired_groups;
+};
+
+} // namespace net
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "ipv4_address.hpp"
+
+namespace net {
+
+namespace detail {
+
+// Value of a hex digit, or -1
+inline constexpr auto hex_values = [] {
+  std::array<std::int8_t, 256> table{};
+  table.fill(-1);
+  for (int c = '0'; c <= '9'; ++c) {
+    table[c] = static_cast<std::int8_t>(c - '0');
+  }
+  for (int c = 'a'; c <= 'f'; ++c) {
+    table[c] = static_cast<std::int8_t>(c - 'a' + 10);
+    table[c - 'a' + 'A'] = static_cast<std::int8_t>(c - 'a' + 10);
+  }
+  return table;
+}();
+
+// Write a group as lowercase hex without leading zeros
+inline char *write_ipv6_group(std::uint16_t group, char *out) noexcept {
+  constexpr char digits[] = "0123456789abcdef";
+  int nibbles = group == 0 ? 1 : (std::bit_width(group) + 3) / 4;
+  for (int i = nibbles - 1; i >= 0; --i) {
+    *out++ = digits[(group >> (4 * i)) & 0xf];
+  }
+  return out;
+}
+
+} // namespace detail
+
+// 128-bit IPv6 address. Parses every RFC 4291 text form (including "::"
+// compression and a dotted IPv4 tail) and formats the RFC 5952 canonical
+// form. Zone ids ("%eth0") are not supported.
+class ipv6_address {
+public:
+  // Longest canonical text (eight full groups)
+  static constexpr std::size_t max_string_size = 39;
+
+  constexpr ipv6_address() : _bytes{} {}
+
+  constexpr ipv6_address(const std::array<std::uint8_t, 16> &bytes)
+      : _bytes(bytes) {}
+
+  // From eight 16-bit groups, most significant first
+  constexpr ipv6_address(const std::array<std::uint16_t, 8> &groups)
+      : _bytes{} {
+    for (std::size_t i = 0; i < 8; ++i) {
+      _bytes[2 * i] = static_cast<std::uint8_t>(groups[i] >> 8);
+      _bytes[2 * i + 1] = static_cast<std::uint8_t>(groups[i]);
+    }
+  }
+
+  constexpr bool operator==(const ipv6_address &) const = default;
+
+  const std::array<std::uint8_t, 16> &bytes() const noexcept {
+    return _bytes;
+  }
+
+  constexpr std::uint16_t group(std::size_t index) const noexcept {
+    return static_cast<std::uint16_t>(_bytes[2 * index] << 8 |
+                                      _bytes[2 * index + 1]);
+  }
+
+  // ::ffff:a.b.c.d, the form IPv4 peers take on a dual-stack socket
+  constexpr bool is_v4_mapped() const noexcept {
+    for (std::size_t i = 0; i < 10; ++i) {
+      if (_bytes[i] != 0) {
+        return false;
+      }
+    }
+    return _bytes[10] == 0xff && _bytes[11] == 0xff;
+  }
+
+  static constexpr ipv6_address v4_mapped(ipv4_address address) noexcept {
+    std::array<std::uint8_t, 16> bytes{};
+    bytes[10] = bytes[11] = 0xff;
+    std::uint32_t bits = address.to_uint32();
+    for (std::size_t i = 0; i < 4; ++i) {
+      bytes[12 + i] = static_cast<std::uint8_t>(bits >> (24 - 8 * i));
+    }
+    return ipv6_address(bytes);
+  }
+
+  // The IPv4 address inside a v4-mapped address
+  constexpr std::optional<ipv4_address> to_v4() const noexcept {
+    if (!is_v4_mapped()) {
+      return std::nullopt;
+    }
+    return ipv4_address(_bytes[12], _bytes[13], _bytes[14], _bytes[15]);
+  }
+
+  std::string to_string() const {
+    char buffer[max_string_size];
+    return std::string(buffer, to_chars(buffer, buffer + sizeof(buffer)).ptr);
+  }
+
+  // Write the RFC 5952 form: lowercase, no leading zeros, the longest run
+  // of two or more zero groups (the first, on a tie) written as "::", and
+  // v4-mapped addresses with a dotted tail
+  std::to_chars_result to_chars(char *first, char *last) const noexcept {
+    char buffer[max_string_size + 16];
+    char *p = buffer;
+
+    if (is_v4_mapped()) {
+      p = std::copy_n("::ffff:", 7, p);
+      p = ipv4_address(_bytes[12], _bytes[13], _bytes[14], _bytes[15])
+              .to_chars(p, buffer + sizeof(buffer))
+              .ptr;
+    } else {
+      std::size_t run_start = 8, run_length = 1;
+      for (std::size_t i = 0; i < 8;) {
+        if (group(i) != 0) {
+          ++i;
+          continue;
+        }
+        std::size_t j = i;
+        while (j < 8 && group(j) == 0) {
+          ++j;
+        }
+        if (j - i > run_length) {
+          run_start = i;
+          run_length = j - i;
+        }
+        i = j;
+      }
+
+      for (std::size_t i = 0; i < 8; ++i) {
+        if (i == run_start) {
+          *p++ = ':';
+          *p++ = ':';
+          i += run_length - 1;
+          continue;
+        }
+        if (i > 0 && i != run_start + run_length) {
+          *p++ = ':';
+        }
+        p = detail::write_ipv6_group(group(i), p);
+      }
+    }
+
+    if (last - first < p - buffer) {
+      return {last, std::errc::value_too_large};
+    }
+    return {std::copy(buffer, p, first), std::errc{}};
+  }
+
+  static std::optional<ipv6_address> from_str(std::string_view text) {
+    if (!text.empty() && text.back() == '\0') {
+      text.remove_suffix(1);
+    }
+
+    std::array<std::uint16_t, 8> groups{};
+    std::size_t count = 0;
+    int gap = -1; // Group index where "::" was, if anywhere
+    const char *p = text.data();
+    const char *end = p + text.size();
+
+    if (p == end) {
+      return std::nullopt;
+    }
+    if (*p == ':') {
+      if (end - p < 2 || p[1] != ':') {
+        return std::nullopt;
+      }
+      gap = 0;
+      p += 2;
+    }
+
+    while (p < end) {
+      if (count == 8) {
+        return std::nullopt;
+      }
+
+      const char *start = p;
+      unsigned value = 0;
+      int digits = 0;
+      for (; p < end && digits < 5; ++p, ++digits) {
+        int digit = detail::hex_values[static_cast<unsigned char>(*p)];
+        if (digit < 0) {
+          break;
+        }
+        value = value << 4 | static_cast<unsigned>(digit);
+      }
+
+      // A dotted IPv4 tail fills the last two groups
+      if (p < end && *p == '.') {
+        std::array<std::uint8_t, 4> octets;
+        if (count > 6 || !detail::parse_ipv4(
+                             start, static_cast<std::size_t>(end - start),
+                             octets)) {
+          return std::nullopt;
+        }
+        groups[count++] =
+            static_cast<std::uint16_t>(octets[0] << 8 | octets[1]);
+        groups[count++] =
+            static_cast<std::uint16_t>(octets[2] << 8 | octets[3]);
+        p = end;
+        break;
+      }
+
+      if (digits == 0 || digits > 4) {
+        return std::nullopt;
+      }
+      groups[count++] = static_cast<std::uint16_t>(value);
+
+      if (p == end) {
+        break;
+      }
+      if (*p++ != ':' || p == end) {
+        return std::nullopt; // Bad separator, or a trailing single ':'
+      }
+      if (*p == ':') {
+        if (gap >= 0) {
+          return std::nullopt; // A second "::"
+        }
+        gap = static_cast<int>(count);
+        ++p;
+      }
+    }
+
+    if (gap >= 0) {
+      if (count > 7) {
+        return std::nullopt; // "::" must stand for at least one group
+      }
+      auto first = groups.begin() + gap;
+      std::copy_backward(first, groups.begin() + count, groups.end());
+      std::fill_n(first, 8 - count, 0);
+    } else if (count != 8) {
+      return std::nullopt;
+    }
+    return ipv6_address(groups);
+  }
+
+  static const ipv6_address loopback; // ::1
+  static const ipv6_address any;      // ::
+
+private:
+  std::array<std::uint8_t, 16> _bytes;
+};
+
+inline const ipv6_address ipv6_address::loopback =
+    ipv6_address(std::array<std::uint16_t, 8>{0, 0, 0, 0, 0, 0, 0, 1});
+inline const ipv6_address ipv6_address::any = ipv6_address();
+
+} // namespace net
+
+template <> struct std::formatter<net::ipv6_address> {
+  constexpr auto parse(std::format_parse_context &ctx) { return ctx.begin(); }
+
+  auto format(const net::ipv6_address &addr, std::format_context &ctx) const {
+    char buffer[net::ipv6_address::max_string_size];
+    auto result = addr.to_chars(buffer, buffer + sizeof(buffer));
+    return std::copy(buffer, result.ptr, ctx.out());
+  }
+};
@@ -0,0 +1,490 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+// Opt-in instrumentation of tcp_streambuf and the listeners, turned on by
+// defining WU_NET_METRICS (the CMake option of the same name). When it is
+// off, the recorders below are empty types with empty inline members, so
+// the hooks compile to nothing and add no bytes to the objects that hold
+// them.
+namespace net::metrics {
+
+#ifdef WU_NET_METRICS
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+// Library-wide counters, kept per thread and summed by take_snapshot()
+enum class counter : std::size_t {
+  stream_reads,        // read() calls by tcp_streambuf
+  stream_read_bytes,   // Bytes they returned
+  stream_writes,       // write() calls by tcp_streambuf
+  stream_write_bytes,  // Bytes they took
+  stream_short_writes, // Writes that took less than they were offered
+  stream_would_block,  // Reads and writes that hit EAGAIN
+  stream_errors,       // Reads and writes that failed otherwise
+  stream_flushes,      // Flushes with data to send
+  accepts,             // Connections accepted
+  accept_failures,     // accept() calls that failed (EAGAIN excluded)
+};
+
+inline constexpr std::size_t counter_count = 10;
+
+// Library-wide latency histograms, in nanoseconds
+enum class timing : std::size_t {
+  stream_read,  // One read() by tcp_streambuf
+  stream_flush, // A flush, from the first write() to the last
+};
+
+inline constexpr std::size_t timing_count = 2;
+
+// Log-linear histogram in the style of HdrHistogram: values below 16 have
+// their own buckets, and every power of two above that is split into 16,
+// so any recorded value is known to within 1/16 (about 6%). Values up to
+// 2^40 (18 minutes in nanoseconds) are tracked; larger ones land in the
+// last bucket. Recording is a relaxed atomic add and safe from any thread.
+class histogram {
+public:
+  static constexpr unsigned sub_bits = 4;
+  static constexpr unsigned max_bits = 40;
+  static constexpr std::size_t bucket_count =
+      (max_bits - sub_bits + 1) << sub_bits;
+
+  struct snapshot {
+    std::array<std::uint64_t, bucket_count> buckets{};
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+
+    void merge(const snapshot &other) noexcept {
+      for (std::size_t i = 0; i < bucket_count; ++i) {
+        buckets[i] += other.buckets[i];
+      }
+      count += other.count;
+      sum += other.sum;
+    }
+
+    // Recorded values strictly below `bound`, to within a bucket
+    std::uint64_t count_below(std::uint64_t bound) const noexcept {
+      std::uint64_t below = 0;
+      for (std::size_t i = 0; i < bucket_count && lower_bound(i) < bound;
+           ++i) {
+        below += buckets[i];
+      }
+      return below;
+    }
+
+    // Smallest value at least `fraction` (0 to 1) of the recorded values
+    // are at or below, reported as the upper end of its bucket
+    std::uint64_t percentile(double fraction) const noexcept {
+      if (count == 0) {
+        return 0;
+      }
+      auto rank = static_cast<std::uint64_t>(fraction * count);
+      rank = std::max<std::uint64_t>(rank, 1);
+      std::uint64_t seen = 0;
+      for (std::size_t i = 0; i < bucket_count; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+          return i + 1 < bucket_count ? lower_bound(i + 1) - 1
+                                      : lower_bound(i);
+        }
+      }
+      return lower_bound(bucket_count - 1);
+    }
+  };
+
+  void record(std::uint64_t value) noexcept {
+    buckets_[index_of(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  snapshot read() const noexcept {
+    snapshot s;
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+      s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+      s.count += s.buckets[i];
+    }
+    s.sum = sum_.load(std::memory_order_relaxed);
+    return s;
+  }
+
+  static constexpr std::size_t index_of(std::uint64_t value) noexcept {
+    constexpr std::uint64_t sub_count = std::uint64_t{1} << sub_bits;
+    if (value < sub_count) {
+      return static_cast<std::size_t>(value);
+    }
+    unsigned exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+    if (exponent >= max_bits) {
+      return bucket_count - 1;
+    }
+    unsigned shift = exponent - sub_bits;
+    return ((exponent - sub_bits + 1) << sub_bits) +
+           static_cast<std::size_t>((value >> shift) - sub_count);
+  }
+
+  // Smallest value that falls in bucket `index`
+  static constexpr std::uint64_t lower_bound(std::size_t index) noexcept {
+    constexpr std::size_t sub_count = std::size_t{1} << sub_bits;
+    if (index < sub_count) {
+      return index;
+    }
+    unsigned shift = static_cast<unsigned>(index >> sub_bits) - 1;
+    return (sub_count + (index & (sub_count - 1))) << shift;
+  }
+
+private:
+  std::array<std::atomic<std::uint64_t>, bucket_count> buckets_{};
+  std::atomic<std::uint64_t> sum_{0};
+};
+
+// Totals of every thread's counters and timings
+struct snapshot {
+  std::array<std::uint64_t, counter_count> counters{};
+  std::array<histogram::snapshot, timing_count> timings{};
+
+  std::uint64_t operator[](counter c) const noexcept {
+    return counters[static_cast<std::size_t>(c)];
+  }
+
+  const histogram::snapshot &operator[](timing t) const noexcept {
+    return timings[static_cast<std::size_t>(t)];
+  }
+
+  // Prometheus text exposition format (version 0.0.4). Counters become
+  // `<prefix>_<name>_total`; timings become histograms in seconds with
+  // power-of-two buckets from about 1us to 17s.
+  std::string to_prometheus(std::string_view prefix = "wu_net") const;
+};
+
+namespace detail {
+
+struct counter_info {
+  std::string_view name;
+  std::string_view help;
+};
+
+inline constexpr std::array<counter_info, counter_count> counter_names{{
+    {"stream_reads", "read() calls made by tcp_streambuf"},
+    {"stream_read_bytes", "Bytes read by tcp_streambuf"},
+    {"stream_writes", "write() calls made by tcp_streambuf"},
+    {"stream_write_bytes", "Bytes written by tcp_streambuf"},
+    {"stream_short_writes", "Writes that sent less than offered"},
+    {"stream_would_block", "Stream reads and writes that hit EAGAIN"},
+    {"stream_errors", "Stream reads and writes that failed"},
+    {"stream_flushes", "tcp_streambuf flushes with data to send"},
+    {"accepts", "Connections accepted"},
+    {"accept_failures", "accept() calls that failed"},
+}};
+
+inline constexpr std::array<counter_info, timing_count> timing_names{{
+    {"stream_read_seconds", "Duration of one tcp_streambuf read()"},
+    {"stream_flush_seconds", "Duration of a tcp_streambuf flush"},
+}};
+
+// One thread's counters, on cache lines of their own. Only the owning
+// thread writes them, so an increment is a relaxed load and store rather
+// than a locked read-modify-write; take_snapshot() reads them from
+// anywhere.
+struct alignas(64) thread_metrics {
+  std::array<std::atomic<std::uint64_t>, counter_count> counters{};
+  std::array<histogram, timing_count> timings;
+  bool in_use = false; // Guarded by registry::mutex
+};
+
+// Every thread_metrics ever handed out. A block outlives its thread and is
+// reused by the next one, so totals never go backwards.
+struct registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<thread_metrics>> blocks;
+
+  static registry &instance() {
+    static registry r;
+    return r;
+  }
+
+  thread_metrics *acquire() {
+    std::lock_guard lock(mutex);
+    for (auto &block : blocks) {
+      if (!block->in_use) {
+        block->in_use = true;
+        return block.get();
+      }
+    }
+    auto &block = blocks.emplace_back(std::make_unique<thread_metrics>());
+    block->in_use = true;
+    return block.get();
+  }
+
+  void release(thread_metrics *block) {
+    std::lock_guard lock(mutex);
+    block->in_use = false;
+  }
+};
+
+struct thread_slot {
+  thread_metrics *block = registry::instance().acquire();
+  ~thread_slot() { registry::instance().release(block); }
+};
+
+inline thread_metrics &local() {
+  thread_local thread_slot slot;
+  return *slot.block;
+}
+
+} // namespace detail
+
+// Add to one of the current thread's counters
+inline void add(counter c, std::uint64_t n = 1) noexcept {
+  if constexpr (enabled) {
+    auto &value = detail::local().counters[static_cast<std::size_t>(c)];
+    value.store(value.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+  }
+}
+
+inline void record(timing t, std::chrono::nanoseconds elapsed) noexcept {
+  if constexpr (enabled) {
+    detail::local().timings[static_cast<std::size_t>(t)].record(
+        static_cast<std::uint64_t>(std::max<std::int64_t>(elapsed.count(), 0)));
+  }
+}
+
+// Sum of every thread's counters and timings; all zero when disabled
+inline snapshot take_snapshot() {
+  snapshot s;
+  if constexpr (enabled) {
+    auto &r = detail::registry::instance();
+    std::lock_guard lock(r.mutex);
+    for (auto &block : r.blocks) {
+      for (std::size_t i = 0; i < counter_count; ++i) {
+        s.counters[i] += block->counters[i].load(std::memory_order_relaxed);
+      }
+      for (std::size_t i = 0; i < timing_count; ++i) {
+        s.timings[i].merge(block->timings[i].read());
+      }
+    }
+  }
+  return s;
+}
+
+inline std::string snapshot::to_prometheus(std::string_view prefix) const {
+  std::string out;
+  for (std::size_t i = 0; i < counter_count; ++i) {
+    auto &info = detail::counter_names[i];
+    out += std::format("# HELP {}_{}_total {}\n", prefix, info.name,
+                       info.help);
+    out += std::format("# TYPE {}_{}_total counter\n", prefix, info.name);
+    out += std::format("{}_{}_total {}\n", prefix, info.name, counters[i]);
+  }
+
+  for (std::size_t i = 0; i < timing_count; ++i) {
+    auto &info = detail::timing_names[i];
+    auto &h = timings[i];
+    out += std::format("# HELP {}_{} {}\n", prefix, info.name, info.help);
+    out += std::format("# TYPE {}_{} histogram\n", prefix, info.name);
+    std::string bucket = std::format("{}_{}_bucket", prefix, info.name);
+    // Each power of two starts a histogram bucket, so everything below it
+    // is exactly what lies at or below the whole nanosecond before
+    for (unsigned bit = 10; bit <= 34; ++bit) {
+      std::uint64_t bound = std::uint64_t{1} << bit;
+      out += bucket + "{le=\"" +
+             std::format("{}", static_cast<double>(bound - 1) * 1e-9) +
+             "\"} " + std::to_string(h.count_below(bound)) + '\n';
+    }
+    out += bucket + "{le=\"+Inf\"} " + std::to_string(h.count) + '\n';
+    out += std::format("{}_{}_sum {}\n", prefix, info.name,
+                       static_cast<double>(h.sum) * 1e-9);
+    out += std::format("{}_{}_count {}\n", prefix, info.name, h.count);
+  }
+  return out;
+}
+
+// Measures a duration when metrics are enabled; otherwise never reads the
+// clock
+class stopwatch {
+public:
+#ifdef WU_NET_METRICS
+  static stopwatch start() noexcept {
+    stopwatch s;
+    s.start_ = std::chrono::steady_clock::now();
+    return s;
+  }
+
+  std::chrono::nanoseconds elapsed() const noexcept {
+    return std::chrono::steady_clock::now() - start_;
+  }
+
+private:
+  std::chrono::steady_clock::time_point start_;
+#else
+  static stopwatch start() noexcept { return {}; }
+
+  std::chrono::nanoseconds elapsed() const noexcept { return {}; }
+#endif
+};
+
+// Counts for one stream
+struct stream_stats {
+  std::uint64_t reads = 0;
+  std::uint64_t read_bytes = 0;
+  std::uint64_t writes = 0;
+  std::uint64_t write_bytes = 0;
+  std::uint64_t short_writes = 0;
+  std::uint64_t would_block = 0;
+  std::uint64_t errors = 0;
+  std::uint64_t flushes = 0;
+};
+
+// Counts for one listener
+struct listener_stats {
+  std::uint64_t accepts = 0;
+  std::uint64_t accept_failures = 0;
+};
+
+// Held by tcp_streambuf: counts its syscalls for the stream and for the
+// thread's totals. A stream is used from one thread at a time, so the
+// per-stream counts are plain integers.
+class stream_recorder {
+public:
+  stream_stats stats() const noexcept {
+#ifdef WU_NET_METRICS
+    return stats_;
+#else
+    return {};
+#endif
+  }
+
+  // read() returned `result`, with `error` the errno of a failure
+  void on_read(ssize_t result, int error, stopwatch started) noexcept {
+#ifdef WU_NET_METRICS
+    ++stats_.reads;
+    add(counter::stream_reads);
+    record(timing::stream_read, started.elapsed());
+    if (result > 0) {
+      stats_.read_bytes += static_cast<std::uint64_t>(result);
+      add(counter::stream_read_bytes, static_cast<std::uint64_t>(result));
+    } else if (result < 0) {
+      failed(error);
+    }
+#else
+    (void)result, (void)error, (void)started;
+#endif
+  }
+
+  // write() of `offered` bytes returned `result`
+  void on_write(std::size_t offered, ssize_t result, int error) noexcept {
+#ifdef WU_NET_METRICS
+    ++stats_.writes;
+    add(counter::stream_writes);
+    if (result >= 0) {
+      stats_.write_bytes += static_cast<std::uint64_t>(result);
+      add(counter::stream_write_bytes, static_cast<std::uint64_t>(result));
+      if (static_cast<std::size_t>(result) < offered) {
+        ++stats_.short_writes;
+        add(counter::stream_short_writes);
+      }
+    } else {
+      failed(error);
+    }
+#else
+    (void)offered, (void)result, (void)error;
+#endif
+  }
+
+  void on_flush(stopwatch started) noexcept {
+#ifdef WU_NET_METRICS
+    ++stats_.flushes;
+    add(counter::stream_flushes);
+    record(timing::stream_flush, started.elapsed());
+#else
+    (void)started;
+#endif
+  }
+
+private:
+#ifdef WU_NET_METRICS
+  void failed(int error) noexcept {
+    if (error == EAGAIN || error == EWOULDBLOCK) {
+      ++stats_.would_block;
+      add(counter::stream_would_block);
+    } else if (error != EINTR) {
+      ++stats_.errors;
+      add(counter::stream_errors);
+    }
+  }
+
+  stream_stats stats_;
+#endif
+};
+
+// Held by the listeners: counts accepts for the listener and the thread.
+// Atomic, since an accepting listener may be shared between threads.
+class listener_recorder {
+public:
+  listener_recorder() = default;
+
+  // Copies the counts (a moved listener keeps them)
+  listener_recorder(const listener_recorder &other) noexcept {
+    *this = other;
+  }
+
+  listener_recorder &operator=(const listener_recorder &other) noexcept {
+#ifdef WU_NET_METRICS
+    accepts_.store(other.accepts_.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    failures_.store(other.failures_.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+#else
+    (void)other;
+#endif
+    return *this;
+  }
+
+  listener_stats stats() const noexcept {
+#ifdef WU_NET_METRICS
+    return {accepts_.load(std::memory_order_relaxed),
+            failures_.load(std::memory_order_relaxed)};
+#else
+    return {};
+#endif
+  }
+
+  // accept() returned `result`, with `error` the errno of a failure
+  void on_accept(int result, int error) noexcept {
+#ifdef WU_NET_METRICS
+    if (result >= 0) {
+      accepts_.fetch_add(1, std::memory_order_relaxed);
+      add(counter::accepts);
+    } else if (error != EAGAIN && error != EWOULDBLOCK && error != EINTR) {
+      failures_.fetch_add(1, std::memory_order_relaxed);
+      add(counter::accept_failures);
+    }
+#else
+    (void)result, (void)error;
+#endif
+  }
+
+private:
+#ifdef WU_NET_METRICS
+  std::atomic<std::uint64_t> accepts_{0};
+  std::atomic<std::uint64_t> failures_{0};
+#endif
+};
+
+} // namespace net::metrics
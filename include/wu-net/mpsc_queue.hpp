@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace net {
+
+// Unbounded lock-free queue for many producer threads and one consumer
+// (Dmitry Vyukov's intrusive MPSC queue). push() is a single atomic
+// exchange and never waits for other producers or for the consumer; pop()
+// and empty() may only be called from the consumer thread.
+//
+// A push that has swapped itself in but not yet linked its node is not
+// visible to pop() until it finishes, so a consumer that finds the queue
+// empty must be told again (event_loop uses an eventfd) rather than assume
+// nothing is coming.
+//
+// Not movable: producers hold on to the queue's address.
+template <typename T> class mpsc_queue {
+public:
+  mpsc_queue() noexcept : head_(&stub_), tail_(&stub_) {}
+
+  mpsc_queue(const mpsc_queue &) = delete;
+  mpsc_queue &operator=(const mpsc_queue &) = delete;
+
+  ~mpsc_queue() {
+    while (pop()) {
+    }
+  }
+
+  // Any thread
+  void push(T value) { link(new node(std::move(value))); }
+
+  // Consumer only: the oldest value, or nullopt if none is fully pushed
+  std::optional<T> pop() {
+    node_base *tail = tail_;
+    node_base *next = tail->next.load(std::memory_order_acquire);
+
+    // Step over the stub; it is never handed out
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return std::nullopt;
+      }
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr) {
+      tail_ = next;
+      return take(tail);
+    }
+
+    // `tail` is the last node unless a producer is between its exchange and
+    // its link; then it will be reachable shortly
+    if (tail != head_.load(std::memory_order_acquire)) {
+      return std::nullopt;
+    }
+
+    // Put the stub back behind `tail` so `tail` can be taken off the end
+    stub_.next.store(nullptr, std::memory_order_relaxed);
+    link(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      tail_ = next;
+      return take(tail);
+    }
+    return std::nullopt;
+  }
+
+  // Consumer only
+  bool empty() const noexcept {
+    return tail_ == &stub_ &&
+           stub_.next.load(std::memory_order_acquire) == nullptr;
+  }
+
+private:
+  struct node_base {
+    std::atomic<node_base *> next{nullptr};
+  };
+
+  struct node : node_base {
+    explicit node(T v) : value(std::move(v)) {}
+    T value;
+  };
+
+  void link(node_base *n) noexcept {
+    node_base *previous = head_.exchange(n, std::memory_order_acq_rel);
+    previous->next.store(n, std::memory_order_release);
+  }
+
+  static std::optional<T> take(node_base *n) {
+    auto *full = static_cast<node *>(n);
+    std::optional<T> value(std::move(full->value));
+    delete full;
+    return value;
+  }
+
+  alignas(64) std::atomic<node_base *> head_; // Producers
+  alignas(64) node_base *tail_;               // Consumer
+  node_base stub_;
+};
+
+} // namespace net
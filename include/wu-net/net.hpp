@@ -1,6 +1,31 @@
 #pragma once
 
+#include "buffer_pool.hpp"
+#include "event_loop.hpp"
+#include "executor.hpp"
+#include "metrics.hpp"
+#include "mpsc_queue.hpp"
 #include "ipv4_address.hpp"
+#include "ipv4_network.hpp"
+#include "ipv4_prefix_table.hpp"
+#include "ipv6_address.hpp"
+#include "endpoint.hpp"
+#include "server.hpp"
 #include "tcp_stream.hpp"
 #include "tcp_listener.hpp"
+#include "connection_pool.hpp"
+#include "dns_resolver.hpp"
+#include "hpack.hpp"
+#include "http2.hpp"
+#include "http_body.hpp"
+#include "http_parser.hpp"
 #include "http_request.hpp"
+#include "http_response.hpp"
+#include "http_router.hpp"
+#include "http_server.hpp"
+#include "task.hpp"
+#include "timer_wheel.hpp"
+#include "udp_socket.hpp"
+#include "unix_stream.hpp"
+#include "unix_listener.hpp"
+#include "unix_datagram_socket.hpp"
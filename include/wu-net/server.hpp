@@ -0,0 +1,312 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+#include "event_loop.hpp"
+#include "task.hpp"
+#include "tcp_listener.hpp"
+#include "tcp_stream.hpp"
+
+namespace net {
+
+// Settings for server
+struct server_options {
+  std::string address = "*:8080";
+  unsigned threads = 0;     // Worker count; 0 means one per available CPU
+  bool pin_threads = true;  // Pin worker i to the i-th available CPU
+  bool cpu_steering = true; // Route each connection to its CPU's worker
+  int backlog = 1024;       // Per worker listener
+  std::chrono::milliseconds drain_timeout{5000};
+#ifdef WU_NET_IO_URING
+  bool io_uring = false; // Run the workers' loops on io_uring
+#endif
+};
+
+// Thread-per-core TCP server runtime.
+//
+// Every worker thread owns its own event loop and its own SO_REUSEPORT
+// listener bound to the same address, so the kernel spreads connections
+// across workers without a shared accept queue, and a connection never
+// leaves the thread that accepted it. With cpu_steering, a classic BPF
+// program on the reuseport group hands each connection to the worker pinned
+// to the CPU that received it.
+//
+// Each accepted connection is passed to the handler coroutine on its
+// worker's loop. stop() closes the listeners and lets in-flight connections
+// finish; those still open after drain_timeout are shut down.
+class server {
+public:
+  using handler = std::function<task<void>(tcp_stream)>;
+
+  explicit server(server_options options = {}) : options_(std::move(options)) {}
+
+  // No copy or move (workers refer back to the server)
+  server(const server &) = delete;
+  server &operator=(const server &) = delete;
+
+  // Destructor
+  ~server() {
+    stop();
+    wait();
+  }
+
+  // Bind the listeners and start the workers. Returns false if the address
+  // could not be bound or the server is already running.
+  bool start(handler on_connection) {
+    if (!workers_.empty() || !on_connection) {
+      return false;
+    }
+
+    std::vector<int> cpus = available_cpus();
+    unsigned count = options_.threads;
+    if (count == 0) {
+      count = cpus.empty() ? 1 : static_cast<unsigned>(cpus.size());
+    }
+
+    // Listeners are created in order so that worker i is socket i of the
+    // reuseport group, which is what the steering program indexes
+    std::string address = options_.address;
+    listen_options listen{.backlog = options_.backlog,
+                          .reuse_address = true,
+                          .reuse_port = true,
+                          .nonblocking = true};
+
+    std::vector<std::unique_ptr<worker>> workers;
+    for (unsigned i = 0; i < count; ++i) {
+      auto listener = tcp_listener::create(address, listen);
+      if (!listener) {
+        return false;
+      }
+
+      // An ephemeral port (":0") must be shared by the rest of the group
+      if (i == 0) {
+        local_address_ = listener->local_address().value_or(address);
+        address = with_port(address, local_address_);
+      }
+
+      auto loop = event_loop::create();
+      if (!loop) {
+        return false;
+      }
+
+      auto w = std::make_unique<worker>();
+      w->loop = std::move(*loop);
+      w->listener = std::move(*listener);
+      w->cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+      workers.push_back(std::move(w));
+    }
+
+    // Steer by the CPU each worker is pinned to; unpinned workers have no
+    // CPU to be local to
+    if (options_.cpu_steering && options_.pin_threads && !cpus.empty() &&
+        count > 1) {
+      std::vector<int> socket_for_cpu;
+      for (unsigned i = 0; i < count; ++i) {
+        auto cpu = static_cast<std::size_t>(workers[i]->cpu);
+        if (cpu >= socket_for_cpu.size()) {
+          socket_for_cpu.resize(cpu + 1, -1);
+        }
+        if (socket_for_cpu[cpu] < 0) {
+          socket_for_cpu[cpu] = static_cast<int>(i);
+        }
+      }
+      workers.front()->listener.attach_reuseport_cpu_steering(socket_for_cpu,
+                                                              count);
+    }
+
+    handler_ = std::move(on_connection);
+    stopping_ = false;
+    workers_ = std::move(workers);
+    for (auto &w : workers_) {
+      w->thread = std::thread([this, w = w.get()] { run(*w); });
+    }
+
+    return true;
+  }
+
+  // Stop accepting and begin draining; returns without waiting
+  void stop() noexcept {
+    stopping_ = true;
+    for (auto &w : workers_) {
+      w->loop.wake();
+    }
+  }
+
+  // Block until every worker has exited
+  void wait() {
+    for (auto &w : workers_) {
+      if (w->thread.joinable()) {
+        w->thread.join();
+      }
+    }
+    workers_.clear();
+  }
+
+  bool is_running() const noexcept { return !workers_.empty() && !stopping_; }
+
+  // Number of worker threads
+  std::size_t size() const noexcept { return workers_.size(); }
+
+  // Connections currently being handled across all workers
+  std::size_t active_connections() const noexcept {
+    std::size_t total = 0;
+    for (const auto &w : workers_) {
+      total += w->active.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  // The bound address, with the actual port if ":0" was requested
+  std::optional<std::string> local_address() const {
+    if (local_address_.empty()) {
+      return std::nullopt;
+    }
+    return local_address_;
+  }
+
+private:
+  // How long handlers get to unwind once their connections are shut down
+  static constexpr int unwind_ms = 100;
+  // Pause after an accept fails for lack of descriptors or memory
+  static constexpr int accept_backoff_ms = 10;
+
+  struct worker {
+    event_loop loop; // Created by start(), so stop() can wake it
+    tcp_listener listener;
+    std::thread thread;
+    int cpu = -1;
+    std::atomic<std::size_t> active{0};
+    bool accepting = false; // accept_loop still running; worker only
+    std::unordered_set<int> connections; // Touched by the worker only
+  };
+
+  static std::vector<int> available_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+          cpus.push_back(cpu);
+        }
+      }
+    }
+    return cpus;
+  }
+
+  // Replace the port in `address` with the one from `bound`
+  static std::string with_port(const std::string &address,
+                               const std::string &bound) {
+    size_t bound_colon = bound.rfind(':');
+    size_t colon = address.rfind(':');
+    if (bound_colon == std::string::npos || colon == std::string::npos) {
+      return address;
+    }
+    return address.substr(0, colon) + bound.substr(bound_colon);
+  }
+
+  void run(worker &w) {
+    if (options_.pin_threads && w.cpu >= 0) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(w.cpu, &set);
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    event_loop *loop = &w.loop;
+
+#ifdef WU_NET_IO_URING
+    if (options_.io_uring) {
+      loop->enable_io_uring();
+    }
+#endif
+
+    w.accepting = true;
+    loop->spawn(accept_loop(w));
+    // stop() wakes the loop after setting stopping_
+    while (!stopping_.load(std::memory_order_acquire)) {
+      loop->run_once();
+    }
+
+    // Closing the listener from inside the loop cancels the pending accept
+    loop->post([&w] { w.listener.close(); });
+    loop->run_once(0);
+
+    auto deadline = std::chrono::steady_clock::now() + options_.drain_timeout;
+    bool forced = false;
+    while (w.accepting || w.active.load(std::memory_order_relaxed) > 0) {
+      auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) {
+        if (forced) {
+          break; // Handlers ignored the shutdown; abandon them
+        }
+
+        // Wake stragglers with EOF so their handlers unwind
+        for (int fd : w.connections) {
+          ::shutdown(fd, SHUT_RDWR);
+        }
+        forced = true;
+        deadline = now + std::chrono::milliseconds(unwind_ms);
+      }
+
+      auto remaining =
+          std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+      loop->run_once(static_cast<int>(remaining.count()) + 1);
+    }
+  }
+
+  task<void> accept_loop(worker &w) {
+    while (!stopping_ && w.listener.is_open()) {
+      auto client = co_await w.listener.async_accept();
+      if (client) {
+        spawn(serve(w, std::move(*client)));
+        continue;
+      }
+      if (stopping_ || !w.listener.is_open()) {
+        break; // Listener closed, which cancels the accept
+      }
+
+      // EMFILE, ENOBUFS and the like pass once connections close; give
+      // them a moment rather than giving up on the listener
+      co_await sleep_for(std::chrono::milliseconds(accept_backoff_ms));
+    }
+    w.accepting = false;
+  }
+
+  task<void> serve(worker &w, tcp_stream client) {
+    int fd = client.native_handle();
+    w.connections.insert(fd);
+    w.active.fetch_add(1, std::memory_order_relaxed);
+
+    try {
+      co_await handler_(std::move(client));
+    } catch (...) {
+      // A failing handler only takes down its own connection
+    }
+
+    w.connections.erase(fd);
+    w.active.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  server_options options_;
+  handler handler_;
+  std::atomic<bool> stopping_{false};
+  std::string local_address_;
+  std::vector<std::unique_ptr<worker>> workers_;
+};
+
+} // namespace net
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace net {
+
+template <typename T = void> class task;
+
+namespace detail {
+
+// State shared by all task promises: the coroutine to resume when the task
+// finishes, and any exception it let escape
+class task_promise_base {
+public:
+  // Resumes whoever awaited the task (symmetric transfer, no stack growth)
+  struct final_awaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      return handle.promise().continuation_;
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  // Tasks are lazy: nothing runs until the task is awaited
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+
+  final_awaiter final_suspend() const noexcept { return {}; }
+
+  void unhandled_exception() noexcept { exception_ = std::current_exception(); }
+
+  void set_continuation(std::coroutine_handle<> continuation) noexcept {
+    continuation_ = continuation;
+  }
+
+protected:
+  void rethrow_if_exception() const {
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+  }
+
+private:
+  std::coroutine_handle<> continuation_ = std::noop_coroutine();
+  std::exception_ptr exception_;
+};
+
+template <typename T> class task_promise : public task_promise_base {
+public:
+  task<T> get_return_object() noexcept;
+
+  template <typename U>
+    requires std::is_convertible_v<U &&, T>
+  void return_value(U &&value) {
+    value_.emplace(std::forward<U>(value));
+  }
+
+  T result() {
+    rethrow_if_exception();
+    return std::move(*value_);
+  }
+
+private:
+  std::optional<T> value_;
+};
+
+template <> class task_promise<void> : public task_promise_base {
+public:
+  task<void> get_return_object() noexcept;
+
+  void return_void() noexcept {}
+
+  void result() { rethrow_if_exception(); }
+};
+
+// Fire-and-forget coroutine used by spawn(); frees itself when done
+struct detached_task {
+  struct promise_type {
+    detached_task get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+} // namespace detail
+
+// Lazily started coroutine producing a T. Awaiting a task starts it and
+// resumes the awaiting coroutine once it completes.
+template <typename T> class [[nodiscard]] task {
+public:
+  using promise_type = detail::task_promise<T>;
+  using value_type = T;
+
+  // Default constructor (empty task)
+  task() noexcept = default;
+
+  explicit task(std::coroutine_handle<promise_type> handle) noexcept
+      : handle_(handle) {}
+
+  // No copy
+  task(const task &) = delete;
+  task &operator=(const task &) = delete;
+
+  // Move
+  task(task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+  task &operator=(task &&other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+
+  // Destructor
+  ~task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  // Check if the task holds a coroutine
+  bool valid() const noexcept { return static_cast<bool>(handle_); }
+
+  // Check if the coroutine has run to completion
+  bool done() const noexcept { return !handle_ || handle_.done(); }
+
+  auto operator co_await() && noexcept {
+    struct awaiter {
+      std::coroutine_handle<promise_type> handle;
+
+      bool await_ready() const noexcept { return !handle || handle.done(); }
+
+      std::coroutine_handle<>
+      await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle.promise().set_continuation(continuation);
+        return handle;
+      }
+
+      T await_resume() { return handle.promise().result(); }
+    };
+
+    return awaiter{handle_};
+  }
+
+private:
+  std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+task<T> detail::task_promise<T>::get_return_object() noexcept {
+  return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline task<void> detail::task_promise<void>::get_return_object() noexcept {
+  return task<void>(
+      std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+
+// Start a task without awaiting it. It runs on the current thread until its
+// first suspension and cleans up after itself when it completes; exceptions
+// escaping it terminate the program.
+inline void spawn(task<void> t) {
+  [](task<void> t) -> detail::detached_task {
+    co_await std::move(t);
+  }(std::move(t));
+}
+
+} // namespace net
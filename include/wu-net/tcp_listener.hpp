@@ -1,14 +1,19 @@
 #pragma once
 
+#include <cerrno>
+#include <expected>
 #include <iostream>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 #include <generator>
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <linux/filter.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <poll.h>
@@ -16,15 +21,123 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "endpoint.hpp"
+#include "event_loop.hpp"
+#include "metrics.hpp"
 #include "tcp_stream.hpp"
 
 namespace net {
 
+// Socket options applied before a listener is bound
+struct listen_options {
+  int backlog = 5;
+  bool reuse_address = true; // SO_REUSEADDR
+  bool reuse_port = false;   // SO_REUSEPORT, to shard accepts across sockets
+  bool nonblocking = false;
+};
+
+namespace detail {
+
+// Accept one connection as a `Stream`, suspending while none are pending
+template <class Stream>
+class basic_accept_op
+    : public io_awaitable<std::expected<Stream, std::error_code>,
+                          io_event::readable> {
+  using base = io_awaitable<std::expected<Stream, std::error_code>,
+                            io_event::readable>;
+  using base::fd;
+  using base::result_;
+
+public:
+  explicit basic_accept_op(int socket_fd,
+                           metrics::listener_recorder *recorder) noexcept
+      : base(socket_fd), recorder_(recorder) {}
+
+  using base::complete;
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = std::unexpected(canceled_error());
+      return true;
+    }
+
+    for (;;) {
+      int client_fd =
+          ::accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      recorder_->on_accept(client_fd, errno);
+      if (client_fd >= 0) {
+        result_ = Stream(client_fd);
+        return true;
+      }
+
+      // Interrupted, or the client gave up before we got to it
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return false;
+      }
+
+      result_ = std::unexpected(last_error());
+      return true;
+    }
+  }
+
+#ifdef WU_NET_IO_URING
+  bool submit(io_uring_backend &ring) noexcept override {
+    ring.accept(*this);
+    return true;
+  }
+
+  bool on_completion(int result, std::uint32_t) noexcept override {
+    recorder_->on_accept(result, -result);
+    if (result >= 0) {
+      complete(Stream(result));
+    } else {
+      complete(std::unexpected(completion_error(result)));
+    }
+    return true;
+  }
+#endif
+
+private:
+  metrics::listener_recorder *recorder_;
+};
+
+// Wait up to `timeout_ms` for a connection on listening socket `fd`; why
+// there is none to accept, or an empty code once one is pending
+inline std::error_code wait_for_connection(int fd, int timeout_ms) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  int poll_result = ::poll(&pfd, 1, timeout_ms);
+  if (poll_result < 0) {
+    return last_error();
+  }
+  if (poll_result == 0) {
+    return std::make_error_code(std::errc::timed_out);
+  }
+  if (pfd.revents & POLLNVAL) {
+    return std::make_error_code(std::errc::bad_file_descriptor);
+  }
+  if (!(pfd.revents & POLLIN)) {
+    // POLLHUP: shut down, which accept() reports as EINVAL
+    return std::make_error_code(std::errc::invalid_argument);
+  }
+  return {};
+}
+
+using accept_op = basic_accept_op<tcp_stream>;
+
+} // namespace detail
+
 // tcp_listener class for accepting TCP connections
 class tcp_listener {
 public:
   // Default constructor
-  tcp_listener() : socket_fd_(-1) {}
+  tcp_listener() : socket_fd_(-1), nonblocking_(false) {}
 
   // No copy
   tcp_listener(const tcp_listener &) = delete;
@@ -32,12 +145,17 @@ public:
 
   // Move
   tcp_listener(tcp_listener &&other) noexcept
-      : socket_fd_(std::exchange(other.socket_fd_, -1)) {}
+      : socket_fd_(std::exchange(other.socket_fd_, -1)),
+        nonblocking_(std::exchange(other.nonblocking_, false)),
+        last_error_(other.last_error_), metrics_(other.metrics_) {}
 
   tcp_listener &operator=(tcp_listener &&other) noexcept {
     if (this != &other) {
       close();
       socket_fd_ = std::exchange(other.socket_fd_, -1);
+      nonblocking_ = std::exchange(other.nonblocking_, false);
+      last_error_ = other.last_error_;
+      metrics_ = other.metrics_;
     }
     return *this;
   }
@@ -51,24 +169,23 @@ public:
   // Close the listener
   void close() {
     if (is_open()) {
+      // Cancel a coroutine parked in async_accept()
+      event_loop::detach(socket_fd_);
+
       ::close(socket_fd_);
       socket_fd_ = -1;
+      nonblocking_ = false;
     }
   }
 
   // Accept a new connection (blocking)
   std::optional<tcp_stream> accept() {
     if (!is_open()) {
+      last_error_ = std::make_error_code(std::errc::bad_file_descriptor);
       return std::nullopt;
     }
 
-    // Accept a connection
-    int client_fd = ::accept(socket_fd_, nullptr, nullptr);
-    if (client_fd < 0) {
-      return std::nullopt;
-    }
-
-    return tcp_stream(client_fd);
+    return accept_now();
   }
 
   std::generator<tcp_stream> connections(const bool *should_stop = nullptr,
@@ -84,33 +201,38 @@ public:
   // Accept with timeout (in milliseconds, -1 for infinite)
   std::optional<tcp_stream> accept(int timeout_ms) {
     if (!is_open()) {
+      last_error_ = std::make_error_code(std::errc::bad_file_descriptor);
       return std::nullopt;
     }
 
-    // Set up for poll
-    struct pollfd pfd;
-    pfd.fd = socket_fd_;
-    pfd.events = POLLIN;
-    pfd.revents = 0;
-
     // Wait for a connection
-    int poll_result = poll(&pfd, 1, timeout_ms);
-
-    if (poll_result <= 0) {
-      return std::nullopt; // Timeout or error
+    last_error_ = detail::wait_for_connection(socket_fd_, timeout_ms);
+    if (last_error_) {
+      return std::nullopt;
     }
 
-    if (!(pfd.revents & POLLIN)) {
-      return std::nullopt; // Not ready for reading
-    }
+    return accept_now();
+  }
 
-    // Accept a connection
-    int client_fd = ::accept(socket_fd_, nullptr, nullptr);
-    if (client_fd < 0) {
-      return std::nullopt;
+  // Why the last accept() returned nullopt (EMFILE, ECONNABORTED,
+  // timed_out, ...); empty after one that succeeded
+  std::error_code last_error() const noexcept { return last_error_; }
+
+  // Accept counts; all zero unless built with WU_NET_METRICS
+  metrics::listener_stats stats() const noexcept { return metrics_.stats(); }
+
+  // Accept a connection without blocking the event loop. The listener is
+  // switched to non-blocking mode; accepted streams are non-blocking too.
+  detail::accept_op async_accept() {
+    detail::accept_op op(socket_fd_, &metrics_);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    } else if (!nonblocking_ && !set_nonblocking(true)) {
+      op.complete(std::unexpected(detail::last_error()));
     }
 
-    return tcp_stream(client_fd);
+    return op;
   }
 
   // Get the socket file descriptor
@@ -147,11 +269,79 @@ public:
     else
       flags &= ~O_NONBLOCK;
 
-    return fcntl(socket_fd_, F_SETFL, flags) == 0;
+    if (fcntl(socket_fd_, F_SETFL, flags) < 0)
+      return false;
+
+    nonblocking_ = enable;
+    return true;
+  }
+
+  // Attach a classic BPF program to this listener's SO_REUSEPORT group that
+  // hands each new connection to socket (cpu % group_size), where cpu is the
+  // CPU that processed the incoming SYN. Sockets are numbered in the order
+  // they joined the group.
+  bool attach_reuseport_cpu_steering(unsigned group_size) noexcept {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    if (group_size == 0) {
+      return false;
+    }
+
+    struct sock_filter code[] = {
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0,
+         static_cast<__u32>(SKF_AD_OFF + SKF_AD_CPU)},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, group_size},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    struct sock_fprog program = {3, code};
+    return setsockopt(socket_fd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                      &program, sizeof(program)) == 0;
+#else
+    return false;
+#endif
+  }
+
+  // Like attach_reuseport_cpu_steering(group_size), but hand a connection
+  // received on CPU c to socket socket_for_cpu[c], for groups whose sockets
+  // don't line up with CPU numbers (a restricted affinity mask, or more or
+  // fewer sockets than CPUs). CPUs outside the map or mapped to a negative
+  // index fall back to (cpu % group_size).
+  bool attach_reuseport_cpu_steering(std::span<const int> socket_for_cpu,
+                                     unsigned group_size) {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    if (group_size == 0) {
+      return false;
+    }
+
+    // A compare and return per mapped CPU
+    std::vector<struct sock_filter> code;
+    code.push_back({BPF_LD | BPF_W | BPF_ABS, 0, 0,
+                    static_cast<__u32>(SKF_AD_OFF + SKF_AD_CPU)});
+    for (std::size_t cpu = 0; cpu < socket_for_cpu.size(); ++cpu) {
+      int socket = socket_for_cpu[cpu];
+      if (socket < 0 || static_cast<unsigned>(socket) >= group_size) {
+        continue;
+      }
+      code.push_back({BPF_JMP | BPF_JEQ | BPF_K, 0, 1,
+                      static_cast<__u32>(cpu)});
+      code.push_back({BPF_RET | BPF_K, 0, 0, static_cast<__u32>(socket)});
+    }
+    code.push_back({BPF_ALU | BPF_MOD | BPF_K, 0, 0, group_size});
+    code.push_back({BPF_RET | BPF_A, 0, 0, 0});
+    if (code.size() > BPF_MAXINSNS) {
+      return false;
+    }
+
+    struct sock_fprog program = {static_cast<unsigned short>(code.size()),
+                                 code.data()};
+    return setsockopt(socket_fd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                      &program, sizeof(program)) == 0;
+#else
+    return false;
+#endif
   }
 
   // Get the local address
-  std::optional<std::string> local_address() const {
+  std::optional<endpoint> local_endpoint() const {
     if (!is_open()) {
       return std::nullopt;
     }
@@ -163,29 +353,41 @@ public:
       return std::nullopt;
     }
 
-    char host[NI_MAXHOST], service[NI_MAXSERV];
-    int res =
-        getnameinfo((struct sockaddr *)&addr, addr_len, host, sizeof(host),
-                    service, sizeof(service), NI_NUMERICHOST | NI_NUMERICSERV);
+    return endpoint::from_sockaddr((struct sockaddr *)&addr, addr_len);
+  }
 
-    if (res != 0) {
+  // The local address as text ("127.0.0.1:8080", "[::1]:8080")
+  std::optional<std::string> local_address() const {
+    auto local = local_endpoint();
+    if (!local) {
       return std::nullopt;
     }
-
-    return std::string(host) + ":" + service;
+    return local->to_string();
   }
 
   // Static factory method
   static std::optional<tcp_listener> create(std::string_view address,
                                             int backlog = 5) {
+    return create(address, listen_options{.backlog = backlog});
+  }
+
+  // Static factory method taking socket options (e.g. SO_REUSEPORT), which
+  // have to be set before the socket is bound
+  static std::optional<tcp_listener> create(std::string_view address,
+                                            const listen_options &options) {
+    // Numeric addresses are bound directly, without getaddrinfo
+    if (auto local = endpoint::from_str(address)) {
+      return create(*local, options);
+    }
+
     // Parse host:port format
-    size_t colon_pos = address.find(':');
-    if (colon_pos == std::string_view::npos) {
+    auto parts = detail::split_host_port(address);
+    if (!parts) {
       return std::nullopt;
     }
 
-    std::string host(address.substr(0, colon_pos));
-    std::string port(address.substr(colon_pos + 1));
+    std::string host(parts->first);
+    std::string port(parts->second);
 
     // Handle special case for wildcard address
     if (host == "*") {
@@ -214,51 +416,90 @@ public:
       }
     } cleaner{results};
 
-    tcp_listener listener;
-
     // Try each address until we succeed
     for (struct addrinfo *addr = results; addr != nullptr;
          addr = addr->ai_next) {
-      // Create socket
-      int sock_fd =
-          socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
-      if (sock_fd < 0) {
-        continue;
+      if (auto listener = open(addr->ai_family, addr->ai_socktype,
+                               addr->ai_protocol, addr->ai_addr,
+                               addr->ai_addrlen, options)) {
+        return listener;
       }
+    }
 
-      // Set SO_REUSEADDR by default
-      int reuse = 1;
-      if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) <
-          0) {
-        ::close(sock_fd);
-        continue;
-      }
+    return std::nullopt;
+  }
 
-      // Bind to the address
-      if (bind(sock_fd, addr->ai_addr, addr->ai_addrlen) < 0) {
-        ::close(sock_fd);
-        continue;
-      }
+  // Listen on a numeric endpoint
+  static std::optional<tcp_listener>
+  create(const endpoint &local, const listen_options &options = {}) {
+    sockaddr_storage storage;
+    socklen_t length = local.to_sockaddr(storage);
+    return open(local.family(), SOCK_STREAM, 0,
+                reinterpret_cast<const sockaddr *>(&storage), length, options);
+  }
 
-      // Start listening
-      if (listen(sock_fd, backlog) < 0) {
-        ::close(sock_fd);
-        continue;
-      }
+private:
+  std::optional<tcp_stream> accept_now() {
+    int client_fd = ::accept(socket_fd_, nullptr, nullptr);
+    metrics_.on_accept(client_fd, errno);
+    if (client_fd < 0) {
+      last_error_ = detail::last_error();
+      return std::nullopt;
+    }
+
+    last_error_ = {};
+    return tcp_stream(client_fd);
+  }
+
+  // Create, configure, bind and listen on one socket
+  static std::optional<tcp_listener> open(int family, int type, int protocol,
+                                          const sockaddr *address,
+                                          socklen_t address_len,
+                                          const listen_options &options) {
+    if (options.nonblocking) {
+      type |= SOCK_NONBLOCK;
+    }
 
-      listener.socket_fd_ = sock_fd;
-      break; // Successfully bound and listening
+    int sock_fd = socket(family, type, protocol);
+    if (sock_fd < 0) {
+      return std::nullopt;
     }
 
-    if (!listener.is_open()) {
+    // Set SO_REUSEADDR (on by default)
+    int reuse = 1;
+    if (options.reuse_address &&
+        setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) <
+            0) {
+      ::close(sock_fd);
       return std::nullopt;
     }
 
+#ifdef SO_REUSEPORT
+    if (options.reuse_port &&
+        setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) <
+            0) {
+      ::close(sock_fd);
+      return std::nullopt;
+    }
+#endif
+
+    // Bind to the address and start listening
+    if (bind(sock_fd, address, address_len) < 0 ||
+        listen(sock_fd, options.backlog) < 0) {
+      ::close(sock_fd);
+      return std::nullopt;
+    }
+
+    tcp_listener listener;
+    listener.socket_fd_ = sock_fd;
+    listener.nonblocking_ = options.nonblocking;
     return listener;
   }
 
-private:
   int socket_fd_;
+  bool nonblocking_;
+  std::error_code last_error_;
+  [[no_unique_address]] metrics::listener_recorder metrics_;
 };
 
 } // namespace net
\ No newline at end of file
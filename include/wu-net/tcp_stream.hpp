@@ -1,7 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
 #include <iostream>
 #include <optional>
+#include <span>
 #include <streambuf>
 #include <string>
 #include <string_view>
@@ -15,17 +25,28 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <poll.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include "buffer_pool.hpp"
+#include "dns_resolver.hpp"
+#include "endpoint.hpp"
+#include "event_loop.hpp"
+#include "metrics.hpp"
+#include "task.hpp"
+
 namespace net {
 
 // Custom error codes for tcp operations
 enum class tcp_error {
   invalid_address_format = 1,
   connection_failed,
-  not_connected
+  not_connected,
+  connection_closed,
+  pool_exhausted
 };
 
 // Define error category for tcp errors
@@ -41,6 +62,10 @@ public:
       return "Connection failed";
     case tcp_error::not_connected:
       return "Socket not connected";
+    case tcp_error::connection_closed:
+      return "Connection closed by peer";
+    case tcp_error::pool_exhausted:
+      return "Connection pool limit reached";
     default:
       return "Unknown tcp error";
     }
@@ -58,19 +83,24 @@ inline std::error_code make_error_code(tcp_error e) noexcept {
   return {static_cast<int>(e), tcp_category()};
 }
 
-// Streambuf implementation for TCP sockets
+// Streambuf implementation for TCP sockets.
+//
+// The get and put areas are borrowed from the thread's buffer_pool only
+// while they hold data: the input buffer goes back once a read finds
+// nothing (EOF, error or EAGAIN) and the output buffer once a flush has
+// sent everything, so an idle connection holds no buffer memory. Each
+// area adapts to the traffic between buffer_size() and
+// buffer_pool::max_block_size: reads that fill the whole buffer and
+// writes that overflow it double the next one, while mostly empty ones
+// halve it again.
 class tcp_streambuf : public std::streambuf {
 public:
-  explicit tcp_streambuf(int socket_fd, std::size_t buffer_size = 4096)
-      : socket_fd_(socket_fd), input_buffer_(buffer_size),
-        output_buffer_(buffer_size) {
-
-    // Initialize the get area pointers (empty buffer)
-    char *end = input_buffer_.data() + input_buffer_.size();
-    setg(end, end, end);
+  static constexpr std::size_t default_buffer_size = 4096;
 
-    // Initialize the put area
-    setp(output_buffer_.data(), output_buffer_.data() + output_buffer_.size());
+  explicit tcp_streambuf(int socket_fd,
+                         std::size_t buffer_size = default_buffer_size)
+      : socket_fd_(socket_fd) {
+    set_buffer_size(buffer_size);
   }
 
   // No copy
@@ -79,45 +109,15 @@ public:
 
   // Move constructor
   tcp_streambuf(tcp_streambuf &&other) noexcept
-      : socket_fd_(std::exchange(other.socket_fd_, -1)),
-        input_buffer_(std::move(other.input_buffer_)),
-        output_buffer_(std::move(other.output_buffer_)) {
-
-    // Preserve get area state
-    if (other.gptr()) {
-      setg(input_buffer_.data(),
-           input_buffer_.data() + (other.gptr() - other.eback()),
-           input_buffer_.data() + (other.egptr() - other.eback()));
-    }
-
-    // Preserve put area state
-    if (other.pptr()) {
-      setp(output_buffer_.data(),
-           output_buffer_.data() + output_buffer_.size());
-      pbump(other.pptr() - other.pbase());
-    }
+      : socket_fd_(std::exchange(other.socket_fd_, -1)) {
+    take(other);
   }
 
   // Move assignment
   tcp_streambuf &operator=(tcp_streambuf &&other) noexcept {
     if (this != &other) {
       socket_fd_ = std::exchange(other.socket_fd_, -1);
-      input_buffer_ = std::move(other.input_buffer_);
-      output_buffer_ = std::move(other.output_buffer_);
-
-      // Preserve get area state
-      if (other.gptr()) {
-        setg(input_buffer_.data(),
-             input_buffer_.data() + (other.gptr() - other.eback()),
-             input_buffer_.data() + (other.egptr() - other.eback()));
-      }
-
-      // Preserve put area state
-      if (other.pptr()) {
-        setp(output_buffer_.data(),
-             output_buffer_.data() + output_buffer_.size());
-        pbump(other.pptr() - other.pbase());
-      }
+      take(other);
     }
     return *this;
   }
@@ -128,6 +128,38 @@ public:
 
   bool is_open() const noexcept { return socket_fd_ >= 0; }
 
+  // True if the last read or flush stopped because a non-blocking socket
+  // returned EAGAIN rather than because of EOF or an error
+  bool would_block() const noexcept { return would_block_; }
+
+  // Smallest size of each buffer; takes effect the next time one is
+  // borrowed
+  std::size_t buffer_size() const noexcept { return base_size_; }
+
+  void set_buffer_size(std::size_t size) noexcept {
+    base_size_ = buffer_pool::block_size(
+        std::min(size, buffer_pool::max_block_size));
+    input_size_ = output_size_ = base_size_;
+  }
+
+  // Bytes of buffer memory currently borrowed
+  std::size_t buffer_memory() const noexcept {
+    return input_.size() + output_.size();
+  }
+
+  // Syscall counts for this stream; zero unless built with WU_NET_METRICS
+  metrics::stream_stats stats() const noexcept { return metrics_.stats(); }
+
+  // Return buffers that hold no data to the pool
+  void release_idle_buffers() noexcept {
+    if (gptr() == egptr()) {
+      release_input();
+    }
+    if (pptr() == pbase()) {
+      release_output();
+    }
+  }
+
 protected:
   // Called when we need more data for reading
   int_type underflow() override {
@@ -135,27 +167,59 @@ protected:
     if (gptr() < egptr())
       return traits_type::to_int_type(*gptr());
 
-    // Read new data
-    ssize_t bytes_read =
-        read(socket_fd_, input_buffer_.data(), input_buffer_.size());
+    // Everything was consumed, so the buffer can be swapped for one of the
+    // size the recent traffic asks for
+    if (input_.size() != input_size_) {
+      input_ = buffer_pool::acquire(input_size_);
+    }
 
-    // Handle errors or EOF
-    if (bytes_read <= 0)
+    // Read new data
+    auto started = metrics::stopwatch::start();
+    ssize_t bytes_read;
+    do {
+      bytes_read = read(socket_fd_, input_.data(), input_.size());
+    } while (bytes_read < 0 && errno == EINTR);
+    metrics_.on_read(bytes_read, errno, started);
+
+    // Non-blocking socket with nothing to read yet
+    would_block_ = bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+
+    // Handle errors or EOF; nothing is buffered, so give the memory back
+    if (bytes_read <= 0) {
+      release_input();
       return traits_type::eof();
+    }
+
+    // A full read means more is probably waiting
+    auto size = static_cast<std::size_t>(bytes_read);
+    if (size == input_.size()) {
+      input_size_ = std::min(input_size_ * 2, buffer_pool::max_block_size);
+    } else if (size < input_.size() / 4) {
+      input_size_ = std::max(input_size_ / 2, base_size_);
+    }
 
     // Update get area pointers
-    setg(input_buffer_.data(), input_buffer_.data(),
-         input_buffer_.data() + bytes_read);
+    setg(input_.data(), input_.data(), input_.data() + bytes_read);
 
     // Return the first character
     return traits_type::to_int_type(*gptr());
   }
 
-  // Called when the put buffer is full
+  // Called when the put buffer is full, or when there is none yet
   int_type overflow(int_type ch = traits_type::eof()) override {
-    // Flush the buffer
-    if (sync() < 0)
-      return traits_type::eof();
+    if (pbase() != nullptr && pptr() == epptr()) {
+      // Filling the buffer between flushes means it is too small
+      output_size_ = std::min(output_size_ * 2, buffer_pool::max_block_size);
+
+      // Flush the buffer; a non-blocking socket may only drain part of it
+      if (sync() < 0 && pptr() == epptr())
+        return traits_type::eof();
+    }
+
+    if (pbase() == nullptr) {
+      output_ = buffer_pool::acquire(output_size_);
+      setp(output_.data(), output_.data() + output_.size());
+    }
 
     // Add the character if it's not EOF
     if (!traits_type::eq_int_type(ch, traits_type::eof())) {
@@ -170,44 +234,533 @@ protected:
   int sync() override {
     // Calculate bytes to write
     std::ptrdiff_t bytes_to_write = pptr() - pbase();
-    if (bytes_to_write == 0)
+    if (bytes_to_write == 0) {
+      release_output();
       return 0;
+    }
 
     // Write to socket
+    auto started = metrics::stopwatch::start();
     ssize_t bytes_written = 0;
     ssize_t result = 0;
 
     while (bytes_written < bytes_to_write) {
       result = write(socket_fd_, pbase() + bytes_written,
                      bytes_to_write - bytes_written);
+      metrics_.on_write(
+          static_cast<std::size_t>(bytes_to_write - bytes_written), result,
+          errno);
 
       if (result < 0) {
         if (errno == EINTR) // Interrupted, try again
           continue;
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          // Socket buffer is full; keep the unsent tail for the next sync()
+          std::ptrdiff_t remaining = bytes_to_write - bytes_written;
+          std::memmove(output_.data(), pbase() + bytes_written, remaining);
+          setp(output_.data(), output_.data() + output_.size());
+          pbump(static_cast<int>(remaining));
+          would_block_ = true;
+        }
+        metrics_.on_flush(started);
         return -1; // Error
       }
 
       bytes_written += result;
     }
 
-    // Reset put pointers
-    setp(output_buffer_.data(), output_buffer_.data() + output_buffer_.size());
+    would_block_ = false;
+    metrics_.on_flush(started);
+
+    // Small flushes let the buffer shrink back towards the base size
+    if (static_cast<std::size_t>(bytes_to_write) < output_.size() / 4) {
+      output_size_ = std::max(output_size_ / 2, base_size_);
+    }
+
+    // Everything is sent; nothing to hold on to until the next write
+    release_output();
 
     return 0;
   }
 
 private:
+  void release_input() noexcept {
+    setg(nullptr, nullptr, nullptr);
+    input_.reset();
+  }
+
+  void release_output() noexcept {
+    setp(nullptr, nullptr);
+    output_.reset();
+  }
+
+  // Adopt other's buffers and their get/put positions
+  void take(tcp_streambuf &other) noexcept {
+    base_size_ = other.base_size_;
+    input_size_ = other.input_size_;
+    output_size_ = other.output_size_;
+    would_block_ = other.would_block_;
+    metrics_ = other.metrics_;
+
+    input_ = std::move(other.input_);
+    setg(other.eback(), other.gptr(), other.egptr());
+    other.setg(nullptr, nullptr, nullptr);
+
+    output_ = std::move(other.output_);
+    setp(other.pbase(), other.epptr());
+    pbump(static_cast<int>(other.pptr() - other.pbase()));
+    other.setp(nullptr, nullptr);
+  }
+
   int socket_fd_;
-  std::vector<char> input_buffer_;
-  std::vector<char> output_buffer_;
+  std::size_t base_size_ = default_buffer_size;
+  std::size_t input_size_ = default_buffer_size;
+  std::size_t output_size_ = default_buffer_size;
+  pooled_buffer input_;
+  pooled_buffer output_;
+  bool would_block_ = false;
+  [[no_unique_address]] metrics::stream_recorder metrics_;
+};
+
+namespace detail {
+
+inline std::error_code last_error() noexcept {
+  return {errno, std::system_category()};
+}
+
+inline std::error_code canceled_error() noexcept {
+  return std::make_error_code(std::errc::operation_canceled);
+}
+
+#ifdef WU_NET_IO_URING
+// Error from a negative io_uring completion result
+inline std::error_code completion_error(int result) noexcept {
+  return {-result, std::system_category()};
+}
+#endif
+
+// Receive whatever is available, suspending while nothing is
+class read_some_op
+    : public io_awaitable<std::expected<std::size_t, std::error_code>,
+                          io_event::readable> {
+public:
+  read_some_op(int socket_fd, std::span<std::byte> buffer) noexcept
+      : io_awaitable(socket_fd), buffer_(buffer) {}
+
+  using io_awaitable::complete;
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = std::unexpected(canceled_error());
+      return true;
+    }
+
+    ssize_t n;
+    do {
+      n = ::recv(fd, buffer_.data(), buffer_.size(), MSG_DONTWAIT);
+    } while (n < 0 && errno == EINTR);
+
+    if (n >= 0) {
+      result_ = static_cast<std::size_t>(n);
+      return true;
+    }
+
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return false;
+    }
+
+    result_ = std::unexpected(last_error());
+    return true;
+  }
+
+#ifdef WU_NET_IO_URING
+  bool submit(io_uring_backend &ring) noexcept override {
+    io_uring_sqe *sqe = ring.prepare(*this);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->addr = reinterpret_cast<std::uintptr_t>(buffer_.data());
+    sqe->len = static_cast<std::uint32_t>(buffer_.size());
+    return true;
+  }
+
+  bool on_completion(int result, std::uint32_t) noexcept override {
+    if (result >= 0) {
+      complete(static_cast<std::size_t>(result));
+    } else {
+      complete(std::unexpected(completion_error(result)));
+    }
+    return true;
+  }
+#endif
+
+private:
+  std::span<std::byte> buffer_;
+};
+
+// Send the whole buffer, suspending whenever the socket buffer is full
+class write_op
+    : public io_awaitable<std::expected<std::size_t, std::error_code>,
+                          io_event::writable> {
+public:
+  write_op(int socket_fd, std::span<const std::byte> data) noexcept
+      : io_awaitable(socket_fd), data_(data) {}
+
+  using io_awaitable::complete;
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = std::unexpected(canceled_error());
+      return true;
+    }
+
+    while (written_ < data_.size()) {
+      ssize_t n = ::send(fd, data_.data() + written_, data_.size() - written_,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return false;
+        }
+        result_ = std::unexpected(last_error());
+        return true;
+      }
+      written_ += static_cast<std::size_t>(n);
+    }
+
+    result_ = written_;
+    return true;
+  }
+
+#ifdef WU_NET_IO_URING
+  bool submit(io_uring_backend &ring) noexcept override {
+    ring_ = &ring;
+    io_uring_sqe *sqe = ring.prepare(*this);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->addr = reinterpret_cast<std::uintptr_t>(data_.data() + written_);
+    sqe->len = static_cast<std::uint32_t>(data_.size() - written_);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    return true;
+  }
+
+  bool on_completion(int result, std::uint32_t) noexcept override {
+    if (result < 0) {
+      complete(std::unexpected(completion_error(result)));
+      return true;
+    }
+
+    written_ += static_cast<std::size_t>(result);
+    if (written_ < data_.size() && result > 0) {
+      return !submit(*ring_); // Short send: queue the rest
+    }
+
+    complete(written_);
+    return true;
+  }
+#endif
+
+private:
+  std::span<const std::byte> data_;
+  std::size_t written_ = 0;
+#ifdef WU_NET_IO_URING
+  io_uring_backend *ring_ = nullptr;
+#endif
 };
 
+// Send a sequence of buffers with as few syscalls as possible, suspending
+// whenever the socket buffer is full. The iovecs are advanced in place as
+// data goes out.
+class writev_op
+    : public io_awaitable<std::expected<std::size_t, std::error_code>,
+                          io_event::writable> {
+public:
+  writev_op(int socket_fd, std::span<iovec> buffers) noexcept
+      : io_awaitable(socket_fd), buffers_(buffers) {
+    skip_empty();
+  }
+
+  using io_awaitable::complete;
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = std::unexpected(canceled_error());
+      return true;
+    }
+
+    while (next_ < buffers_.size()) {
+      msghdr msg = pending_message();
+      ssize_t n = ::sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return false;
+        }
+        result_ = std::unexpected(last_error());
+        return true;
+      }
+      advance(static_cast<std::size_t>(n));
+    }
+
+    result_ = written_;
+    return true;
+  }
+
+#ifdef WU_NET_IO_URING
+  bool submit(io_uring_backend &ring) noexcept override {
+    ring_ = &ring;
+    message_ = pending_message();
+    io_uring_sqe *sqe = ring.prepare(*this);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->addr = reinterpret_cast<std::uintptr_t>(&message_);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    return true;
+  }
+
+  bool on_completion(int result, std::uint32_t) noexcept override {
+    if (result < 0) {
+      complete(std::unexpected(completion_error(result)));
+      return true;
+    }
+
+    advance(static_cast<std::size_t>(result));
+    if (next_ < buffers_.size() && result > 0) {
+      return !submit(*ring_); // Short send: queue the rest
+    }
+
+    complete(written_);
+    return true;
+  }
+#endif
+
+private:
+  msghdr pending_message() noexcept {
+    msghdr msg{};
+    msg.msg_iov = buffers_.data() + next_;
+    msg.msg_iovlen = std::min<std::size_t>(buffers_.size() - next_, IOV_MAX);
+    return msg;
+  }
+
+  void advance(std::size_t sent) noexcept {
+    written_ += sent;
+    while (sent > 0) {
+      iovec &front = buffers_[next_];
+      std::size_t n = std::min(sent, front.iov_len);
+      front.iov_base = static_cast<char *>(front.iov_base) + n;
+      front.iov_len -= n;
+      sent -= n;
+      skip_empty();
+    }
+  }
+
+  void skip_empty() noexcept {
+    while (next_ < buffers_.size() && buffers_[next_].iov_len == 0) {
+      ++next_;
+    }
+  }
+
+  std::span<iovec> buffers_;
+  std::size_t next_ = 0;
+  std::size_t written_ = 0;
+#ifdef WU_NET_IO_URING
+  io_uring_backend *ring_ = nullptr;
+  msghdr message_{};
+#endif
+};
+
+#ifdef WU_NET_IO_URING
+// Receive into a buffer the kernel picks from the io_uring buffer ring
+class receive_op
+    : public io_awaitable<std::expected<uring_buffer, std::error_code>,
+                          io_event::readable> {
+public:
+  explicit receive_op(int socket_fd) noexcept : io_awaitable(socket_fd) {}
+
+  using io_awaitable::complete;
+
+  // Provided buffers only exist on the io_uring backend
+  bool perform() noexcept override {
+    result_ = std::unexpected(
+        fd < 0 ? canceled_error()
+               : std::make_error_code(std::errc::operation_not_supported));
+    return true;
+  }
+
+  bool submit(io_uring_backend &ring) noexcept override {
+    ring_ = &ring;
+    ring.receive(*this);
+    return true;
+  }
+
+  bool on_completion(int result, std::uint32_t flags) noexcept override {
+    if (result < 0) {
+      complete(std::unexpected(completion_error(result)));
+    } else {
+      complete(ring_->lease(result, flags));
+    }
+    return true;
+  }
+
+private:
+  io_uring_backend *ring_ = nullptr;
+};
+#endif
+
+// Send part of a file with sendfile(), suspending whenever the socket
+// buffer is full
+class send_file_op
+    : public io_awaitable<std::expected<std::size_t, std::error_code>,
+                          io_event::writable> {
+public:
+  send_file_op(int socket_fd, int file_fd, off_t offset,
+               std::size_t count) noexcept
+      : io_awaitable(socket_fd), file_fd_(file_fd), offset_(offset),
+        count_(count) {}
+
+  using io_awaitable::complete;
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = std::unexpected(canceled_error());
+      return true;
+    }
+
+    while (sent_ < count_) {
+      ssize_t n = ::sendfile(fd, file_fd_, &offset_, count_ - sent_);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return false;
+        }
+        if (sent_ > 0) {
+          break; // Report what did go out, as send_file() does
+        }
+        result_ = std::unexpected(last_error());
+        return true;
+      }
+      if (n == 0) {
+        break; // The file ended early
+      }
+      sent_ += static_cast<std::size_t>(n);
+    }
+
+    result_ = sent_;
+    return true;
+  }
+
+private:
+  int file_fd_;
+  off_t offset_;
+  std::size_t count_;
+  std::size_t sent_ = 0;
+};
+
+// Open a socket and connect it to one resolved address, giving up after
+// timeout_ms if it is not negative. Returns the blocking socket, or -1.
+inline int connect_socket(int family, int socktype, int protocol,
+                          const sockaddr *address, socklen_t address_len,
+                          int timeout_ms) noexcept {
+  // Create socket
+  int sock_fd = socket(family, socktype, protocol);
+  if (sock_fd < 0) {
+    return -1;
+  }
+
+  // Handle non-blocking connection with timeout
+  if (timeout_ms >= 0) {
+    // Set socket to non-blocking mode
+    int flags = fcntl(sock_fd, F_GETFL, 0);
+    fcntl(sock_fd, F_SETFL, flags | O_NONBLOCK);
+
+    // Initiate connection
+    int connect_res = ::connect(sock_fd, address, address_len);
+
+    if (connect_res < 0 && errno == EINPROGRESS) {
+      // Wait for connection to complete
+      struct pollfd pfd;
+      pfd.fd = sock_fd;
+      pfd.events = POLLOUT;
+
+      if (poll(&pfd, 1, timeout_ms) <= 0) {
+        // Timeout or error
+        ::close(sock_fd);
+        return -1;
+      }
+
+      // Check if connection succeeded
+      int error = 0;
+      socklen_t len = sizeof(error);
+      if (getsockopt(sock_fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 ||
+          error != 0) {
+        ::close(sock_fd);
+        return -1;
+      }
+    } else if (connect_res < 0) {
+      // Connection failed immediately
+      ::close(sock_fd);
+      return -1;
+    }
+
+    // Reset socket to blocking mode
+    fcntl(sock_fd, F_SETFL, flags);
+  } else {
+    // Blocking connection
+    if (::connect(sock_fd, address, address_len) < 0) {
+      ::close(sock_fd);
+      return -1;
+    }
+  }
+
+  return sock_fd;
+}
+
+// Wait for a non-blocking connect() to finish
+class connect_op : public io_awaitable<std::error_code, io_event::writable> {
+public:
+  explicit connect_op(int socket_fd) noexcept : io_awaitable(socket_fd) {}
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = canceled_error();
+      return true;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) <= 0) {
+      return false; // Still in progress
+    }
+
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0) {
+      error = errno;
+    }
+
+    result_ = error != 0 ? std::error_code(error, std::system_category())
+                         : std::error_code();
+    return true;
+  }
+};
+
+} // namespace detail
+
 // Main tcp_stream class
 class tcp_stream : public std::iostream {
 public:
   // Constructors
-  explicit tcp_stream(int socket_fd = -1)
-      : std::iostream(nullptr), socket_fd_(socket_fd), streambuf_(socket_fd) {
+  explicit tcp_stream(
+      int socket_fd = -1,
+      std::size_t buffer_size = tcp_streambuf::default_buffer_size)
+      : std::iostream(nullptr), socket_fd_(socket_fd),
+        streambuf_(socket_fd, buffer_size) {
     rdbuf(&streambuf_);
   }
 
@@ -246,6 +799,10 @@ public:
   void close() {
     if (is_open()) {
       flush(); // Ensure all data is sent
+
+      // Cancel any coroutine parked on this socket
+      event_loop::detach(socket_fd_);
+
       ::close(socket_fd_);
       socket_fd_ = -1;
     }
@@ -254,6 +811,74 @@ public:
   // Get the socket file descriptor
   int native_handle() const noexcept { return socket_fd_; }
 
+  // Give up ownership of the socket without closing it. Pending output is
+  // flushed and buffered input discarded. Returns the descriptor, or -1 if
+  // the stream was not open.
+  int release() {
+    if (!is_open()) {
+      return -1;
+    }
+
+    flush();
+    event_loop::detach(socket_fd_);
+
+    streambuf_ = tcp_streambuf(-1, streambuf_.buffer_size());
+    return std::exchange(socket_fd_, -1);
+  }
+
+  // Address this end of the connection is bound to
+  std::optional<endpoint> local_endpoint() const {
+    sockaddr_storage storage;
+    socklen_t length = sizeof(storage);
+    if (!is_open() || getsockname(socket_fd_,
+                                  reinterpret_cast<sockaddr *>(&storage),
+                                  &length) < 0) {
+      return std::nullopt;
+    }
+    return endpoint::from_sockaddr(reinterpret_cast<sockaddr *>(&storage),
+                                   length);
+  }
+
+  // Address of the peer
+  std::optional<endpoint> remote_endpoint() const {
+    sockaddr_storage storage;
+    socklen_t length = sizeof(storage);
+    if (!is_open() || getpeername(socket_fd_,
+                                  reinterpret_cast<sockaddr *>(&storage),
+                                  &length) < 0) {
+      return std::nullopt;
+    }
+    return endpoint::from_sockaddr(reinterpret_cast<sockaddr *>(&storage),
+                                   length);
+  }
+
+  // True if the last read or flush hit EAGAIN on a non-blocking socket.
+  // The stream's failbit/eofbit are set in that case too; call clear() and
+  // retry once the event loop reports the socket ready again.
+  bool would_block() const noexcept { return streambuf_.would_block(); }
+
+  // Buffering for the iostream interface
+
+  // Smallest read and write buffer size; buffers grow from here under load
+  std::size_t buffer_size() const noexcept { return streambuf_.buffer_size(); }
+
+  void set_buffer_size(std::size_t size) noexcept {
+    streambuf_.set_buffer_size(size);
+  }
+
+  // Bytes of pooled buffer memory the stream currently holds (zero while
+  // nothing is buffered)
+  std::size_t buffer_memory() const noexcept {
+    return streambuf_.buffer_memory();
+  }
+
+  // Give buffers that hold no data back to the pool right away
+  void release_idle_buffers() noexcept { streambuf_.release_idle_buffers(); }
+
+  // Reads, writes and flushes made by the iostream interface; all zero
+  // unless built with WU_NET_METRICS
+  metrics::stream_stats stats() const noexcept { return streambuf_.stats(); }
+
   // Socket options
 
   // Set TCP_NODELAY (disable Nagle's algorithm)
@@ -343,17 +968,413 @@ public:
     return poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLOUT);
   }
 
+  // Raw I/O
+  //
+  // Span-based reads and writes that move data directly between the
+  // caller's buffers and the socket, skipping the iostream layer. Data the
+  // iostream interface has already buffered is returned first, and pending
+  // iostream output is flushed before writing, so the two can be mixed.
+  // Meant for blocking sockets: on a non-blocking one an operation that
+  // would block fails with resource_unavailable_try_again.
+
+  // Read at most buffer.size() bytes; 0 means the peer closed the connection
+  std::expected<std::size_t, std::error_code>
+  read_some(std::span<std::byte> buffer) {
+    if (!is_open()) {
+      return std::unexpected(make_error_code(tcp_error::not_connected));
+    }
+    if (buffer.empty()) {
+      return 0;
+    }
+    if (std::size_t buffered = take_buffered(buffer); buffered > 0) {
+      return buffered;
+    }
+
+    ssize_t n;
+    do {
+      n = ::recv(socket_fd_, buffer.data(), buffer.size(), 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+      return std::unexpected(detail::last_error());
+    }
+    return static_cast<std::size_t>(n);
+  }
+
+  // Fill the whole buffer; fails with connection_closed if the peer closes
+  // the connection first
+  std::expected<std::size_t, std::error_code>
+  read_exact(std::span<std::byte> buffer) {
+    std::size_t total = 0;
+    while (total < buffer.size()) {
+      auto n = read_some(buffer.subspan(total));
+      if (!n) {
+        return n;
+      }
+      if (*n == 0) {
+        return std::unexpected(make_error_code(tcp_error::connection_closed));
+      }
+      total += *n;
+    }
+    return total;
+  }
+
+  // Write all of `data`
+  std::expected<std::size_t, std::error_code>
+  write_all(std::span<const std::byte> data) {
+    if (std::error_code error = flush_output()) {
+      return std::unexpected(error);
+    }
+
+    std::size_t total = 0;
+    while (total < data.size()) {
+      ssize_t n = ::send(socket_fd_, data.data() + total, data.size() - total,
+                         MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return std::unexpected(detail::last_error());
+      }
+      total += static_cast<std::size_t>(n);
+    }
+    return total;
+  }
+
+  // Scatter read: fill the buffers in order with whatever one receive
+  // returns; 0 means the peer closed the connection
+  std::expected<std::size_t, std::error_code>
+  readv(std::span<const iovec> buffers) {
+    if (!is_open()) {
+      return std::unexpected(make_error_code(tcp_error::not_connected));
+    }
+
+    // Hand out buffered data first, spread over as many buffers as it needs
+    std::size_t buffered = 0;
+    for (const iovec &buffer : buffers) {
+      std::size_t n = take_buffered(
+          {static_cast<std::byte *>(buffer.iov_base), buffer.iov_len});
+      buffered += n;
+      if (n < buffer.iov_len) {
+        break;
+      }
+    }
+    if (buffered > 0) {
+      return buffered;
+    }
+
+    msghdr msg{};
+    msg.msg_iov = const_cast<iovec *>(buffers.data());
+    msg.msg_iovlen = std::min<std::size_t>(buffers.size(), IOV_MAX);
+
+    ssize_t n;
+    do {
+      n = ::recvmsg(socket_fd_, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+      return std::unexpected(detail::last_error());
+    }
+    return static_cast<std::size_t>(n);
+  }
+
+  // Gather write: send every buffer in order, as few syscalls as possible
+  std::expected<std::size_t, std::error_code>
+  writev(std::span<const iovec> buffers) {
+    if (std::error_code error = flush_output()) {
+      return std::unexpected(error);
+    }
+
+    // The caller's iovecs are const, so partial sends are tracked in a
+    // small window copied from them
+    std::array<iovec, 64> window;
+    std::size_t next = 0;   // First buffer not fully sent
+    std::size_t offset = 0; // Bytes of it already sent
+    std::size_t total = 0;
+
+    while (next < buffers.size()) {
+      std::size_t count = std::min(window.size(), buffers.size() - next);
+      std::copy_n(buffers.begin() + next, count, window.begin());
+      window[0].iov_base = static_cast<char *>(window[0].iov_base) + offset;
+      window[0].iov_len -= offset;
+
+      msghdr msg{};
+      msg.msg_iov = window.data();
+      msg.msg_iovlen = count;
+      ssize_t n = ::sendmsg(socket_fd_, &msg, MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return std::unexpected(detail::last_error());
+      }
+
+      auto sent = static_cast<std::size_t>(n);
+      total += sent;
+      sent += offset;
+      while (next < buffers.size() && sent >= buffers[next].iov_len) {
+        sent -= buffers[next++].iov_len;
+      }
+      offset = sent;
+    }
+    return total;
+  }
+
+  // Zero-copy transfer
+
+  // Send `count` bytes of an open file, starting at `offset`, straight
+  // from the page cache with sendfile(2). Returns the bytes sent, which is
+  // fewer than `count` if the file ends first, or if an error (such as
+  // EAGAIN on a non-blocking socket) stops it after some were sent; it
+  // fails only when nothing was.
+  std::expected<std::size_t, std::error_code>
+  send_file(int file_fd, off_t offset, std::size_t count) {
+    if (std::error_code error = flush_output()) {
+      return std::unexpected(error);
+    }
+
+    std::size_t sent = 0;
+    while (sent < count) {
+      ssize_t n = ::sendfile(socket_fd_, file_fd, &offset, count - sent);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (sent > 0) {
+          break;
+        }
+        return std::unexpected(detail::last_error());
+      }
+      if (n == 0) {
+        break;
+      }
+      sent += static_cast<std::size_t>(n);
+    }
+    return sent;
+  }
+
+  // Asynchronous I/O
+  //
+  // These are awaitable from a coroutine and never block the thread while an
+  // event loop is running on it: they suspend on EAGAIN and are resumed by
+  // the loop once the socket is ready.
+
+  // Read at most buffer.size() bytes; 0 means the peer closed the connection
+  detail::read_some_op async_read_some(std::span<std::byte> buffer) {
+    detail::read_some_op op(socket_fd_, buffer);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    } else if (std::size_t buffered = take_buffered(buffer); buffered > 0) {
+      // Hand out data the iostream interface already pulled in first
+      op.complete(buffered);
+    }
+
+    return op;
+  }
+
+#ifdef WU_NET_IO_URING
+  // Receive into a buffer picked by the kernel from the io_uring backend's
+  // buffer ring, so no memory is committed to the socket while it waits.
+  // An empty buffer means the peer closed the connection. Fails with
+  // operation_not_supported when the loop is not using io_uring.
+  detail::receive_op async_receive() {
+    detail::receive_op op(socket_fd_);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+
+    return op;
+  }
+#endif
+
+  // Write all of `data`; pending iostream output should be flushed first
+  detail::write_op async_write(std::span<const std::byte> data) {
+    detail::write_op op(socket_fd_, data);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+
+    return op;
+  }
+
+  // Write every buffer in order with sendmsg(), coalescing them into as few
+  // segments as the socket allows. The iovecs are modified as data is sent.
+  detail::writev_op async_writev(std::span<iovec> buffers) {
+    detail::writev_op op(socket_fd_, buffers);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+
+    return op;
+  }
+
+  // sendfile(2) without blocking the loop; same result as send_file().
+  // Pending iostream output should be flushed first.
+  detail::send_file_op async_send_file(int file_fd, off_t offset,
+                                       std::size_t count) {
+    detail::send_file_op op(socket_fd_, file_fd, offset, count);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+
+    return op;
+  }
+
+  // Connect to a numeric endpoint without blocking the event loop
+  static task<std::expected<tcp_stream, std::error_code>>
+  async_connect(endpoint target) {
+    sockaddr_storage storage;
+    socklen_t length = target.to_sockaddr(storage);
+
+    int sock_fd =
+        socket(target.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock_fd < 0) {
+      co_return std::unexpected(detail::last_error());
+    }
+
+    if (::connect(sock_fd, reinterpret_cast<const sockaddr *>(&storage),
+                  length) == 0) {
+      co_return tcp_stream(sock_fd);
+    }
+
+    std::error_code error = detail::last_error();
+    if (errno == EINPROGRESS) {
+      error = co_await detail::connect_op(sock_fd);
+      if (!error) {
+        co_return tcp_stream(sock_fd);
+      }
+    }
+
+    ::close(sock_fd);
+    co_return std::unexpected(error);
+  }
+
+  // Connect without blocking the event loop while the handshake completes.
+  // Numeric addresses ("1.2.3.4:80", "[::1]:80") skip resolution; names
+  // still go through getaddrinfo, so pass a dns_resolver to resolve without
+  // blocking as well.
+  static task<std::expected<tcp_stream, std::error_code>>
+  async_connect(std::string address) {
+    if (auto target = endpoint::from_str(address)) {
+      auto stream = co_await async_connect(*target);
+      co_return stream;
+    }
+
+    auto parts = detail::split_host_port(address);
+    if (!parts) {
+      co_return std::unexpected(
+          make_error_code(tcp_error::invalid_address_format));
+    }
+
+    std::string host(parts->first);
+    std::string port(parts->second);
+
+    struct addrinfo hints = {}, *results = nullptr;
+    hints.ai_family = AF_UNSPEC;     // Allow IPv4 or IPv6
+    hints.ai_socktype = SOCK_STREAM; // TCP
+
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0) {
+      co_return std::unexpected(make_error_code(tcp_error::connection_failed));
+    }
+
+    struct _cleaner {
+      addrinfo *ptr;
+      ~_cleaner() {
+        if (ptr)
+          freeaddrinfo(ptr);
+      }
+    } cleaner{results};
+
+    for (struct addrinfo *addr = results; addr != nullptr;
+         addr = addr->ai_next) {
+      int sock_fd = socket(addr->ai_family,
+                           addr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                           addr->ai_protocol);
+      if (sock_fd < 0) {
+        continue;
+      }
+
+      if (::connect(sock_fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+        co_return tcp_stream(sock_fd);
+      }
+
+      if (errno == EINPROGRESS &&
+          !co_await detail::connect_op(sock_fd)) {
+        co_return tcp_stream(sock_fd);
+      }
+
+      ::close(sock_fd);
+    }
+
+    co_return std::unexpected(make_error_code(tcp_error::connection_failed));
+  }
+
+  // Connect to "host:port" with the host name looked up by `resolver`,
+  // which must belong to the current thread's event loop
+  static task<std::expected<tcp_stream, std::error_code>>
+  async_connect(std::string address, dns_resolver &resolver) {
+    if (auto target = endpoint::from_str(address)) {
+      auto stream = co_await async_connect(*target);
+      co_return stream;
+    }
+
+    auto parts = detail::split_host_port(address);
+    auto port = parts ? detail::parse_port(parts->second) : std::nullopt;
+    if (!port) {
+      co_return std::unexpected(
+          make_error_code(tcp_error::invalid_address_format));
+    }
+
+    auto addresses = co_await resolver.resolve(parts->first);
+    if (!addresses) {
+      co_return std::unexpected(addresses.error());
+    }
+
+    for (const ipv4_address &ip : *addresses) {
+      auto stream = co_await async_connect(endpoint(ip, *port));
+      if (stream) {
+        co_return std::move(*stream);
+      }
+    }
+
+    co_return std::unexpected(make_error_code(tcp_error::connection_failed));
+  }
+
+  // Connect to a numeric endpoint
+  static std::optional<tcp_stream> connect(const endpoint &target,
+                                           int timeout_ms = -1) {
+    sockaddr_storage storage;
+    socklen_t length = target.to_sockaddr(storage);
+    int sock_fd = detail::connect_socket(
+        target.family(), SOCK_STREAM, 0,
+        reinterpret_cast<const sockaddr *>(&storage), length, timeout_ms);
+    if (sock_fd < 0) {
+      return std::nullopt;
+    }
+    return tcp_stream(sock_fd);
+  }
+
   // Connection
   static std::optional<tcp_stream> connect(std::string_view address,
                                            int timeout_ms = -1) {
+    // Numeric addresses need no lookup
+    if (auto target = endpoint::from_str(address)) {
+      return connect(*target, timeout_ms);
+    }
+
     // Parse host:port format
-    size_t colon_pos = address.find(':');
-    if (colon_pos == std::string_view::npos) {
+    auto parts = detail::split_host_port(address);
+    if (!parts) {
       return std::nullopt;
     }
 
-    std::string host(address.substr(0, colon_pos));
-    std::string port(address.substr(colon_pos + 1));
+    std::string host(parts->first);
+    std::string port(parts->second);
 
     // Set up address hints
     struct addrinfo hints = {}, *results = nullptr;
@@ -378,67 +1399,134 @@ public:
     // Try each address until we succeed
     for (struct addrinfo *addr = results; addr != nullptr;
          addr = addr->ai_next) {
-      // Create socket
-      int sock_fd =
-          socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
-      if (sock_fd < 0) {
-        continue;
+      int sock_fd = detail::connect_socket(addr->ai_family, addr->ai_socktype,
+                                           addr->ai_protocol, addr->ai_addr,
+                                           addr->ai_addrlen, timeout_ms);
+      if (sock_fd >= 0) {
+        return tcp_stream(sock_fd);
       }
-
-      // Handle non-blocking connection with timeout
-      if (timeout_ms >= 0) {
-        // Set socket to non-blocking mode
-        int flags = fcntl(sock_fd, F_GETFL, 0);
-        fcntl(sock_fd, F_SETFL, flags | O_NONBLOCK);
-
-        // Initiate connection
-        int connect_res = ::connect(sock_fd, addr->ai_addr, addr->ai_addrlen);
-
-        if (connect_res < 0 && errno == EINPROGRESS) {
-          // Wait for connection to complete
-          struct pollfd pfd;
-          pfd.fd = sock_fd;
-          pfd.events = POLLOUT;
-
-          if (poll(&pfd, 1, timeout_ms) <= 0) {
-            // Timeout or error
-            ::close(sock_fd);
-            continue;
-          }
-
-          // Check if connection succeeded
-          int error = 0;
-          socklen_t len = sizeof(error);
-          if (getsockopt(sock_fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 ||
-              error != 0) {
-            ::close(sock_fd);
-            continue;
-          }
-
-          // Reset socket to blocking mode
-          fcntl(sock_fd, F_SETFL, flags);
-        } else if (connect_res < 0) {
-          // Connection failed immediately
-          ::close(sock_fd);
-          continue;
-        }
-      } else {
-        // Blocking connection
-        if (::connect(sock_fd, addr->ai_addr, addr->ai_addrlen) < 0) {
-          ::close(sock_fd);
-          continue;
-        }
-      }
-
-      return tcp_stream(sock_fd);
     }
 
     return std::nullopt;
   }
 
 private:
+  // Move up to buffer.size() bytes the iostream interface has already
+  // received into `buffer`
+  std::size_t take_buffered(std::span<std::byte> buffer) {
+    std::streamsize buffered = streambuf_.in_avail();
+    if (buffered <= 0 || buffer.empty()) {
+      return 0;
+    }
+    auto count = std::min<std::streamsize>(
+        buffered, static_cast<std::streamsize>(buffer.size()));
+    return static_cast<std::size_t>(
+        streambuf_.sgetn(reinterpret_cast<char *>(buffer.data()), count));
+  }
+
+  // Send anything written through the iostream interface
+  std::error_code flush_output() {
+    if (!is_open()) {
+      return make_error_code(tcp_error::not_connected);
+    }
+    if (streambuf_.pubsync() != 0) {
+      return detail::last_error();
+    }
+    return {};
+  }
+
   int socket_fd_;
   tcp_streambuf streambuf_;
 };
 
+// Forward everything `from` receives to `to` until `from` reaches EOF.
+// Data moves socket to pipe to socket with splice(2) and never enters user
+// space, except for anything the iostream interface had already buffered.
+// Non-blocking streams are waited on with poll() instead of failing on
+// EAGAIN, which would drop what is already in the pipe. Returns the bytes
+// relayed; whether to shut down `to` afterwards is up to the caller. Like
+// write(), splicing to a socket the peer has closed raises SIGPIPE unless
+// it is ignored.
+inline std::expected<std::size_t, std::error_code>
+relay(tcp_stream &from, tcp_stream &to, std::size_t chunk_size = 1 << 16) {
+  if (!from.is_open() || !to.is_open()) {
+    return std::unexpected(make_error_code(tcp_error::not_connected));
+  }
+
+  // Flush to's pending output, then pass on what from already buffered
+  auto flushed = to.write_all({});
+  if (!flushed) {
+    return flushed;
+  }
+
+  std::size_t total = 0;
+  std::array<std::byte, 4096> staged;
+  while (from.rdbuf()->in_avail() > 0) {
+    auto n = from.read_some(staged);
+    if (!n) {
+      return n;
+    }
+    auto written = to.write_all(std::span(staged).first(*n));
+    if (!written) {
+      return written;
+    }
+    total += *n;
+  }
+
+  int pipe_fds[2];
+  if (::pipe2(pipe_fds, O_CLOEXEC) < 0) {
+    return std::unexpected(detail::last_error());
+  }
+  struct _pipe_closer {
+    int *fds;
+    ~_pipe_closer() {
+      ::close(fds[0]);
+      ::close(fds[1]);
+    }
+  } closer{pipe_fds};
+
+  // A pipe as large as a chunk lets each splice move a whole chunk
+  ::fcntl(pipe_fds[1], F_SETPIPE_SZ, static_cast<int>(chunk_size));
+
+  // Wait for `fd` when a splice would block
+  auto wait = [](int fd, short events) {
+    struct pollfd pfd = {fd, events, 0};
+    return ::poll(&pfd, 1, -1) >= 0 || errno == EINTR;
+  };
+
+  for (;;) {
+    ssize_t in = ::splice(from.native_handle(), nullptr, pipe_fds[1], nullptr,
+                          chunk_size, SPLICE_F_MOVE);
+    if (in < 0) {
+      if (errno == EINTR ||
+          ((errno == EAGAIN || errno == EWOULDBLOCK) &&
+           wait(from.native_handle(), POLLIN))) {
+        continue;
+      }
+      return std::unexpected(detail::last_error());
+    }
+    if (in == 0) {
+      break; // EOF
+    }
+
+    auto pending = static_cast<std::size_t>(in);
+    while (pending > 0) {
+      ssize_t out = ::splice(pipe_fds[0], nullptr, to.native_handle(), nullptr,
+                             pending, SPLICE_F_MOVE);
+      if (out < 0) {
+        if (errno == EINTR ||
+            ((errno == EAGAIN || errno == EWOULDBLOCK) &&
+             wait(to.native_handle(), POLLOUT))) {
+          continue;
+        }
+        return std::unexpected(detail::last_error());
+      }
+      pending -= static_cast<std::size_t>(out);
+    }
+    total += static_cast<std::size_t>(in);
+  }
+
+  return total;
+}
+
 } // namespace net
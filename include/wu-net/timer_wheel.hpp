@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace net {
+
+// Hierarchical timer wheel (in the style of the Linux kernel's timer
+// wheel). Time advances in fixed ticks of at least a microsecond; eight
+// levels of 64 slots each cover 2^48 ticks, every level 64 times coarser
+// than the one below.
+// A timer is filed in the lowest level whose current rotation contains its
+// deadline and moves down a level each time its slot comes up, so adding,
+// canceling and expiring are all O(1), and the work per tick does not
+// depend on how many timers are pending.
+//
+// Pushing a deadline back (an idle timeout renewed on every read) only
+// records the new deadline; the timer is refiled once, when its old slot
+// comes up. Timers that share a tick fire together.
+//
+// Not thread-safe; event_loop owns one per loop.
+class timer_wheel {
+public:
+  using clock = std::chrono::steady_clock;
+  using timer_id = std::uint64_t;
+
+  explicit timer_wheel(clock::duration tick = std::chrono::milliseconds(1),
+                       clock::time_point start = clock::now())
+      : tick_(std::max<clock::duration>(tick, std::chrono::microseconds(1))),
+        start_(start) {
+    heads_.fill(none);
+  }
+
+  clock::duration tick() const noexcept { return tick_; }
+
+  // Number of pending timers
+  std::size_t size() const noexcept { return size_; }
+
+  bool empty() const noexcept { return size_ == 0; }
+
+  // Run `fn` from the first advance() at or after `deadline`. Deadlines are
+  // rounded up to a tick, and a deadline that has already passed fires on
+  // the next tick.
+  timer_id add(clock::time_point deadline, std::move_only_function<void()> fn) {
+    std::uint32_t index;
+    if (!free_.empty()) {
+      index = free_.back();
+      free_.pop_back();
+    } else {
+      index = static_cast<std::uint32_t>(nodes_.size());
+      nodes_.emplace_back();
+    }
+
+    node &n = nodes_[index];
+    n.expires = expiry(deadline);
+    n.fn = std::move(fn);
+    n.active = true;
+    link(index);
+    ++size_;
+    return make_id(index, n.generation);
+  }
+
+  // Cancel a timer that has not fired yet
+  bool cancel(timer_id id) {
+    node *n = find(id);
+    if (n == nullptr) {
+      return false;
+    }
+    auto fn = std::move(n->fn); // Destroyed after the wheel is consistent
+    unlink(index_of(id));
+    release(index_of(id));
+    return true;
+  }
+
+  // Move a pending timer to a new deadline. Later deadlines cost a single
+  // store; earlier ones refile the timer.
+  bool reschedule(timer_id id, clock::time_point deadline) {
+    node *n = find(id);
+    if (n == nullptr) {
+      return false;
+    }
+    std::uint64_t expires = expiry(deadline);
+    if (expires >= n->expires) {
+      n->expires = expires; // Refiled when its current slot comes up
+      return true;
+    }
+    unlink(index_of(id));
+    n->expires = expires;
+    link(index_of(id));
+    return true;
+  }
+
+  // When advance() next has work to do: a timer is due or must move down a
+  // level. No timer fires before this, though one may be refiled instead
+  // of firing if its deadline was pushed back.
+  std::optional<clock::time_point> next_deadline() const noexcept {
+    auto tick = next_tick();
+    if (!tick) {
+      return std::nullopt;
+    }
+    return start_ + tick_ * static_cast<clock::rep>(*tick);
+  }
+
+  // Fire every timer whose deadline is at or before `now`, in deadline
+  // order (ties in no particular order). Timers added by a callback wait
+  // at least until the next tick. Returns the number fired.
+  std::size_t advance(clock::time_point now) {
+    if (now < start_) {
+      return 0;
+    }
+    auto target = static_cast<std::uint64_t>((now - start_) / tick_);
+
+    std::vector<std::move_only_function<void()>> due;
+    while (auto tick = next_tick()) {
+      if (*tick > target) {
+        break;
+      }
+      now_ = *tick;
+
+      // Slots whose turn has come move down, highest level first so a
+      // timer can drop several levels in one tick
+      for (unsigned level = levels - 1; level > 0; --level) {
+        if ((now_ & ((std::uint64_t{1} << (level * slot_bits)) - 1)) == 0) {
+          for (std::uint32_t index = take(level, slot_of(now_, level));
+               index != none;) {
+            std::uint32_t next = nodes_[index].next;
+            link(index);
+            index = next;
+          }
+        }
+      }
+
+      for (std::uint32_t index = take(0, slot_of(now_, 0)); index != none;) {
+        node &n = nodes_[index];
+        std::uint32_t next = n.next;
+        if (n.expires > now_) {
+          link(index); // Pushed back since it was filed
+        } else {
+          due.push_back(std::move(n.fn));
+          release(index);
+        }
+        index = next;
+      }
+    }
+    now_ = std::max(now_, target);
+
+    for (auto &fn : due) {
+      fn();
+    }
+    return due.size();
+  }
+
+  // Drop every timer
+  void clear() {
+    nodes_.clear();
+    free_.clear();
+    heads_.fill(none);
+    occupied_.fill(0);
+    size_ = 0;
+  }
+
+private:
+  static constexpr unsigned slot_bits = 6;
+  static constexpr unsigned slots = 1u << slot_bits;
+  static constexpr unsigned levels = 8;
+  static constexpr std::uint64_t max_ticks = std::uint64_t{1}
+                                             << (levels * slot_bits);
+  static constexpr std::uint32_t none =
+      std::numeric_limits<std::uint32_t>::max();
+
+  struct node {
+    std::uint64_t expires = 0; // Tick
+    std::uint32_t prev = none;
+    std::uint32_t next = none;
+    std::uint32_t bucket = none; // level * slots + slot
+    std::uint32_t generation = 1;
+    bool active = false;
+    std::move_only_function<void()> fn;
+  };
+
+  static constexpr timer_id make_id(std::uint32_t index,
+                                    std::uint32_t generation) noexcept {
+    return timer_id{generation} << 32 | index;
+  }
+
+  static constexpr std::uint32_t index_of(timer_id id) noexcept {
+    return static_cast<std::uint32_t>(id);
+  }
+
+  static constexpr unsigned slot_of(std::uint64_t tick,
+                                    unsigned level) noexcept {
+    return static_cast<unsigned>(tick >> (level * slot_bits)) & (slots - 1);
+  }
+
+  node *find(timer_id id) noexcept {
+    std::uint32_t index = index_of(id);
+    if (index >= nodes_.size()) {
+      return nullptr;
+    }
+    node &n = nodes_[index];
+    if (!n.active || n.generation != static_cast<std::uint32_t>(id >> 32)) {
+      return nullptr;
+    }
+    return &n;
+  }
+
+  // First tick after now_ that a timer is due on, rounded up, and at
+  // least one tick away
+  std::uint64_t expiry(clock::time_point deadline) const noexcept {
+    auto offset = deadline - start_;
+    std::uint64_t tick = 0;
+    if (offset > clock::duration{}) {
+      auto ticks = (offset + tick_ - clock::duration{1}) / tick_;
+      tick = static_cast<std::uint64_t>(
+          std::min<decltype(ticks)>(ticks, max_ticks - 1));
+    }
+    return std::clamp(tick, now_ + 1, now_ + max_ticks - 1);
+  }
+
+  // File a node in the lowest level whose current rotation reaches its
+  // expiry; expiries at or before now_ go in the slot now_ is processing
+  void link(std::uint32_t index) {
+    node &n = nodes_[index];
+    std::uint64_t expires = std::max(n.expires, now_);
+    std::uint64_t differs = expires ^ now_;
+    unsigned level =
+        differs < slots ? 0
+                        : (static_cast<unsigned>(std::bit_width(differs)) - 1) /
+                              slot_bits;
+    level = std::min(level, levels - 1);
+    unsigned slot = slot_of(expires, level);
+
+    std::uint32_t bucket = level * slots + slot;
+    n.bucket = bucket;
+    n.prev = none;
+    n.next = heads_[bucket];
+    if (n.next != none) {
+      nodes_[n.next].prev = index;
+    }
+    heads_[bucket] = index;
+    occupied_[level] |= std::uint64_t{1} << slot;
+  }
+
+  void unlink(std::uint32_t index) {
+    node &n = nodes_[index];
+    if (n.prev != none) {
+      nodes_[n.prev].next = n.next;
+    } else {
+      heads_[n.bucket] = n.next;
+      if (n.next == none) {
+        occupied_[n.bucket / slots] &=
+            ~(std::uint64_t{1} << (n.bucket % slots));
+      }
+    }
+    if (n.next != none) {
+      nodes_[n.next].prev = n.prev;
+    }
+    n.bucket = n.prev = n.next = none;
+  }
+
+  // Empty a slot, returning the first of the nodes that were in it; they
+  // stay chained through `next` until each is linked or released
+  std::uint32_t take(unsigned level, unsigned slot) noexcept {
+    std::uint32_t bucket = level * slots + slot;
+    occupied_[level] &= ~(std::uint64_t{1} << slot);
+    return std::exchange(heads_[bucket], none);
+  }
+
+  void release(std::uint32_t index) {
+    node &n = nodes_[index];
+    n.active = false;
+    n.fn = nullptr;
+    ++n.generation; // Stale ids no longer match
+    free_.push_back(index);
+    --size_;
+  }
+
+  // Earliest tick after now_ at which a slot is due: a level 0 slot
+  // expires, or a higher slot moves down. Slots at or behind a level's
+  // current position are always empty, so each level needs one bit scan.
+  std::optional<std::uint64_t> next_tick() const noexcept {
+    std::optional<std::uint64_t> next;
+    for (unsigned level = 0; level < levels; ++level) {
+      unsigned shift = level * slot_bits;
+      unsigned current = slot_of(now_, level);
+      std::uint64_t ahead =
+          current == slots - 1
+              ? 0
+              : occupied_[level] & (~std::uint64_t{0} << (current + 1));
+      if (ahead == 0) {
+        continue;
+      }
+      unsigned rotation_shift = shift + slot_bits;
+      std::uint64_t tick = now_ >> rotation_shift << rotation_shift |
+                           std::uint64_t(std::countr_zero(ahead)) << shift;
+      if (!next || tick < *next) {
+        next = tick;
+      }
+    }
+    return next;
+  }
+
+  clock::duration tick_;
+  clock::time_point start_;
+  std::uint64_t now_ = 0; // Last tick processed
+  std::size_t size_ = 0;
+  std::vector<node> nodes_;
+  std::vector<std::uint32_t> free_;
+  std::array<std::uint32_t, levels * slots> heads_;
+  std::array<std::uint64_t, levels> occupied_{};
+};
+
+} // namespace net
@@ -0,0 +1,610 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "endpoint.hpp"
+#include "event_loop.hpp"
+#include "tcp_stream.hpp"
+
+namespace net {
+
+namespace detail {
+class receive_batch_op;
+class send_batch_op;
+} // namespace detail
+
+// Settings applied when a udp_socket is created
+struct udp_options {
+  bool nonblocking = false;
+  bool reuse_address = false; // SO_REUSEADDR
+  bool reuse_port = false;    // SO_REUSEPORT, to shard receives across sockets
+  bool gro = false;           // UDP_GRO, see udp_datagram::segment_size
+  int receive_buffer_size = 0; // SO_RCVBUF if nonzero
+  int send_buffer_size = 0;    // SO_SNDBUF if nonzero
+};
+
+// One datagram in a udp_batch
+struct udp_datagram {
+  endpoint peer;
+  std::span<const std::byte> data;
+  // With GRO, a received buffer can hold several datagrams from the same
+  // peer, each segment_size bytes long except possibly the last; 0 means
+  // data is a single datagram
+  std::uint16_t segment_size = 0;
+  bool truncated = false; // The datagram did not fit its buffer
+
+  std::size_t segment_count() const noexcept {
+    if (segment_size == 0 || data.empty()) {
+      return data.empty() ? 0 : 1;
+    }
+    return (data.size() + segment_size - 1) / segment_size;
+  }
+
+  std::span<const std::byte> segment(std::size_t index) const noexcept {
+    if (segment_size == 0) {
+      return data;
+    }
+    std::size_t offset = index * segment_size;
+    return data.subspan(offset, std::min<std::size_t>(segment_size,
+                                                      data.size() - offset));
+  }
+};
+
+// A fixed set of datagram buffers with the headers recvmmsg and sendmmsg
+// take, all allocated once up front, so moving a batch through the kernel
+// costs one syscall and no allocation. A batch is either filled by
+// udp_socket::receive_batch() or queued up with push()/commit() for
+// udp_socket::send_batch().
+class udp_batch {
+public:
+  static constexpr std::size_t default_count = 64;
+  static constexpr std::size_t default_buffer_size = 2048;
+
+  explicit udp_batch(std::size_t count = default_count,
+                     std::size_t buffer_size = default_buffer_size)
+      : buffer_size_(buffer_size), storage_(count * buffer_size),
+        headers_(count), iov_(count), names_(count), controls_(count),
+        slots_(count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      iov_[i] = {storage_.data() + i * buffer_size, buffer_size};
+      msghdr &h = headers_[i].msg_hdr;
+      h.msg_iov = &iov_[i];
+      h.msg_iovlen = 1;
+    }
+  }
+
+  // No copy (the headers point into the batch's own buffers)
+  udp_batch(const udp_batch &) = delete;
+  udp_batch &operator=(const udp_batch &) = delete;
+
+  udp_batch(udp_batch &&) noexcept = default;
+  udp_batch &operator=(udp_batch &&) noexcept = default;
+
+  std::size_t capacity() const noexcept { return slots_.size(); }
+
+  std::size_t buffer_size() const noexcept { return buffer_size_; }
+
+  // Datagrams received, or queued for sending
+  std::size_t size() const noexcept { return size_; }
+
+  bool empty() const noexcept { return size_ == 0; }
+
+  bool full() const noexcept { return size_ == capacity(); }
+
+  // Queued datagrams send_batch() has already sent
+  std::size_t sent() const noexcept { return sent_; }
+
+  udp_datagram operator[](std::size_t index) const noexcept {
+    const slot &s = slots_[index];
+    return {s.peer,
+            std::span<const std::byte>(storage_.data() + index * buffer_size_,
+                                       s.length),
+            s.segment_size, s.truncated};
+  }
+
+  void clear() noexcept { size_ = sent_ = 0; }
+
+  // The next free buffer, to be written in place and then commit()ted;
+  // empty when the batch is full
+  std::span<std::byte> prepare() noexcept {
+    if (full()) {
+      return {};
+    }
+    return {storage_.data() + size_ * buffer_size_, buffer_size_};
+  }
+
+  // Queue the first `length` bytes of the buffer prepare() returned, for
+  // `to` (or the connected peer). A nonzero segment_size has the kernel
+  // split the buffer into datagrams of that size (UDP GSO).
+  bool commit(std::size_t length, std::optional<endpoint> to = std::nullopt,
+              std::uint16_t segment_size = 0) noexcept {
+    if (full() || length > buffer_size_) {
+      return false;
+    }
+
+    std::size_t i = size_;
+    msghdr &h = headers_[i].msg_hdr;
+    iov_[i].iov_len = length;
+    slots_[i] = {length, to.value_or(endpoint()), segment_size, false};
+
+    if (to) {
+      h.msg_name = &names_[i];
+      h.msg_namelen = to->to_sockaddr(names_[i]);
+    } else {
+      h.msg_name = nullptr;
+      h.msg_namelen = 0;
+    }
+
+    if (segment_size > 0) {
+      h.msg_control = &controls_[i];
+      h.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+      cmsghdr *cmsg = CMSG_FIRSTHDR(&h);
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+      std::memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+    } else {
+      h.msg_control = nullptr;
+      h.msg_controllen = 0;
+    }
+
+    ++size_;
+    return true;
+  }
+
+  // Copy `data` into the next buffer and queue it for `to`
+  bool push(const endpoint &to, std::span<const std::byte> data,
+            std::uint16_t segment_size = 0) noexcept {
+    return push_impl(to, data, segment_size);
+  }
+
+  // Queue `data` for a connected socket's peer
+  bool push(std::span<const std::byte> data,
+            std::uint16_t segment_size = 0) noexcept {
+    return push_impl(std::nullopt, data, segment_size);
+  }
+
+private:
+  friend class udp_socket;
+  friend class detail::receive_batch_op;
+  friend class detail::send_batch_op;
+
+  struct slot {
+    std::size_t length = 0;
+    endpoint peer;
+    std::uint16_t segment_size = 0;
+    bool truncated = false;
+  };
+
+  // Room for a UDP_GRO or UDP_SEGMENT control message
+  struct alignas(cmsghdr) control {
+    unsigned char data[CMSG_SPACE(sizeof(int))];
+  };
+
+  bool push_impl(std::optional<endpoint> to, std::span<const std::byte> data,
+                 std::uint16_t segment_size) noexcept {
+    auto buffer = prepare();
+    if (data.size() > buffer.size()) {
+      return false;
+    }
+    if (!data.empty()) {
+      std::memcpy(buffer.data(), data.data(), data.size());
+    }
+    return commit(data.size(), to, segment_size);
+  }
+
+  // recvmmsg() into the whole batch; the count received
+  std::expected<std::size_t, std::error_code> receive(int fd,
+                                                      int flags) noexcept {
+    prepare_receive();
+    int n;
+    do {
+      n = ::recvmmsg(fd, headers_.data(), static_cast<unsigned>(capacity()),
+                     flags, nullptr);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+      return std::unexpected(detail::last_error());
+    }
+    finish_receive(static_cast<std::size_t>(n));
+    return static_cast<std::size_t>(n);
+  }
+
+  // sendmmsg() for the queued datagrams not yet sent; the count sent
+  std::expected<std::size_t, std::error_code> send(int fd, int flags) noexcept {
+    std::size_t total = 0;
+    while (sent_ < size_) {
+      int n = ::sendmmsg(fd, headers_.data() + sent_,
+                         static_cast<unsigned>(size_ - sent_),
+                         flags | MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (total > 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          break;
+        }
+        return std::unexpected(detail::last_error());
+      }
+      sent_ += static_cast<std::size_t>(n);
+      total += static_cast<std::size_t>(n);
+    }
+    return total;
+  }
+
+  // Point every header at its whole buffer for recvmmsg
+  void prepare_receive() noexcept {
+    clear();
+    for (std::size_t i = 0; i < capacity(); ++i) {
+      msghdr &h = headers_[i].msg_hdr;
+      iov_[i].iov_len = buffer_size_;
+      h.msg_name = &names_[i];
+      h.msg_namelen = sizeof(sockaddr_storage);
+      h.msg_control = &controls_[i];
+      h.msg_controllen = sizeof(control);
+      h.msg_flags = 0;
+    }
+  }
+
+  // Record what recvmmsg filled in
+  void finish_receive(std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; ++i) {
+      msghdr &h = headers_[i].msg_hdr;
+      slot &s = slots_[i];
+      s.length = std::min<std::size_t>(headers_[i].msg_len, buffer_size_);
+      s.peer = endpoint::from_sockaddr(reinterpret_cast<sockaddr *>(&names_[i]),
+                                       h.msg_namelen)
+                   .value_or(endpoint());
+      s.truncated = (h.msg_flags & MSG_TRUNC) != 0;
+      s.segment_size = 0;
+      for (cmsghdr *cmsg = CMSG_FIRSTHDR(&h); cmsg != nullptr;
+           cmsg = CMSG_NXTHDR(&h, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+          int size = 0;
+          std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+          s.segment_size = static_cast<std::uint16_t>(size);
+        }
+      }
+    }
+    size_ = count;
+  }
+
+  std::size_t buffer_size_;
+  std::vector<std::byte> storage_;
+  std::vector<mmsghdr> headers_;
+  std::vector<iovec> iov_;
+  std::vector<sockaddr_storage> names_;
+  std::vector<control> controls_;
+  std::vector<slot> slots_;
+  std::size_t size_ = 0;
+  std::size_t sent_ = 0;
+};
+
+namespace detail {
+
+inline bool would_block(std::error_code error) noexcept {
+  return error == std::errc::resource_unavailable_try_again ||
+         error == std::errc::operation_would_block;
+}
+
+// Receive a batch, suspending while nothing is queued on the socket
+class receive_batch_op
+    : public io_awaitable<std::expected<std::size_t, std::error_code>,
+                          io_event::readable> {
+public:
+  receive_batch_op(int socket_fd, udp_batch &batch) noexcept
+      : io_awaitable(socket_fd), batch_(batch) {}
+
+  using io_awaitable::complete;
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = std::unexpected(canceled_error());
+      return true;
+    }
+    result_ = batch_.receive(fd, MSG_DONTWAIT);
+    return result_ || !would_block(result_.error());
+  }
+
+private:
+  udp_batch &batch_;
+};
+
+// Send a batch, suspending while the socket's send buffer is full
+class send_batch_op
+    : public io_awaitable<std::expected<std::size_t, std::error_code>,
+                          io_event::writable> {
+public:
+  send_batch_op(int socket_fd, udp_batch &batch) noexcept
+      : io_awaitable(socket_fd), batch_(batch) {}
+
+  using io_awaitable::complete;
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = std::unexpected(canceled_error());
+      return true;
+    }
+    auto sent = batch_.send(fd, MSG_DONTWAIT);
+    if (!sent) {
+      if (would_block(sent.error())) {
+        return false;
+      }
+      result_ = std::unexpected(sent.error());
+      return true;
+    }
+    total_ += *sent;
+    if (batch_.sent() < batch_.size()) {
+      return false; // Wait for room for the rest
+    }
+    result_ = total_;
+    return true;
+  }
+
+private:
+  udp_batch &batch_;
+  std::size_t total_ = 0;
+};
+
+} // namespace detail
+
+// UDP socket for IPv4 or IPv6. Besides single datagrams it moves whole
+// udp_batches with one recvmmsg/sendmmsg call, and supports UDP GSO (one
+// large buffer the kernel splits into equal datagrams on send) and GRO
+// (consecutive datagrams from one peer coalesced into one buffer on
+// receive), so dozens of datagrams cost a single syscall.
+class udp_socket {
+public:
+  explicit udp_socket(int socket_fd = -1) noexcept : socket_fd_(socket_fd) {}
+
+  // No copy
+  udp_socket(const udp_socket &) = delete;
+  udp_socket &operator=(const udp_socket &) = delete;
+
+  udp_socket(udp_socket &&other) noexcept
+      : socket_fd_(std::exchange(other.socket_fd_, -1)) {}
+
+  udp_socket &operator=(udp_socket &&other) noexcept {
+    if (this != &other) {
+      close();
+      socket_fd_ = std::exchange(other.socket_fd_, -1);
+    }
+    return *this;
+  }
+
+  ~udp_socket() { close(); }
+
+  bool is_open() const noexcept { return socket_fd_ >= 0; }
+
+  int native_handle() const noexcept { return socket_fd_; }
+
+  void close() {
+    if (is_open()) {
+      // Cancel any coroutine parked on this socket
+      event_loop::detach(socket_fd_);
+      ::close(socket_fd_);
+      socket_fd_ = -1;
+    }
+  }
+
+  // Set the default peer for send() and filter received datagrams to it
+  bool connect(const endpoint &peer) noexcept {
+    sockaddr_storage storage;
+    socklen_t length = peer.to_sockaddr(storage);
+    return ::connect(socket_fd_, reinterpret_cast<sockaddr *>(&storage),
+                     length) == 0;
+  }
+
+  std::optional<endpoint> local_endpoint() const {
+    sockaddr_storage storage;
+    socklen_t length = sizeof(storage);
+    if (!is_open() || getsockname(socket_fd_,
+                                  reinterpret_cast<sockaddr *>(&storage),
+                                  &length) < 0) {
+      return std::nullopt;
+    }
+    return endpoint::from_sockaddr(reinterpret_cast<sockaddr *>(&storage),
+                                   length);
+  }
+
+  // Coalesce received datagrams (UDP_GRO); false if the kernel lacks it
+  bool set_gro(bool enabled) noexcept {
+    int value = enabled ? 1 : 0;
+    return setsockopt(socket_fd_, SOL_UDP, UDP_GRO, &value, sizeof(value)) ==
+           0;
+  }
+
+  std::expected<std::size_t, std::error_code>
+  send_to(std::span<const std::byte> data, const endpoint &to) noexcept {
+    sockaddr_storage storage;
+    socklen_t length = to.to_sockaddr(storage);
+    return check(::sendto(socket_fd_, data.data(), data.size(), MSG_NOSIGNAL,
+                          reinterpret_cast<sockaddr *>(&storage), length));
+  }
+
+  // Send to the connected peer
+  std::expected<std::size_t, std::error_code>
+  send(std::span<const std::byte> data) noexcept {
+    return check(::send(socket_fd_, data.data(), data.size(), MSG_NOSIGNAL));
+  }
+
+  // Receive one datagram and the address it came from
+  std::expected<std::size_t, std::error_code>
+  receive_from(std::span<std::byte> buffer, endpoint &from) noexcept {
+    sockaddr_storage storage;
+    socklen_t length = sizeof(storage);
+    auto received =
+        check(::recvfrom(socket_fd_, buffer.data(), buffer.size(), 0,
+                         reinterpret_cast<sockaddr *>(&storage), &length));
+    if (received) {
+      from = endpoint::from_sockaddr(reinterpret_cast<sockaddr *>(&storage),
+                                     length)
+                 .value_or(endpoint());
+    }
+    return received;
+  }
+
+  // Receive as many datagrams as are queued, up to the batch's capacity,
+  // replacing its contents. A blocking socket waits for the first one.
+  std::expected<std::size_t, std::error_code>
+  receive_batch(udp_batch &batch) noexcept {
+    return batch.receive(socket_fd_, MSG_WAITFORONE);
+  }
+
+  // Send the queued datagrams not yet sent. Returns how many this call
+  // sent, which is fewer than queued only if a non-blocking socket ran out
+  // of buffer space.
+  std::expected<std::size_t, std::error_code>
+  send_batch(udp_batch &batch) noexcept {
+    return batch.send(socket_fd_, 0);
+  }
+
+  // Send `data` as datagrams of segment_size bytes each (the last may be
+  // shorter) in one call with UDP GSO. At most 64 segments and 64 KiB.
+  std::expected<std::size_t, std::error_code>
+  send_segments(std::span<const std::byte> data, std::uint16_t segment_size,
+                std::optional<endpoint> to = std::nullopt) noexcept {
+    iovec iov = {const_cast<std::byte *>(data.data()), data.size()};
+    sockaddr_storage storage;
+    alignas(cmsghdr) unsigned char control[CMSG_SPACE(sizeof(std::uint16_t))];
+
+    msghdr h = {};
+    h.msg_iov = &iov;
+    h.msg_iovlen = 1;
+    if (to) {
+      h.msg_name = &storage;
+      h.msg_namelen = to->to_sockaddr(storage);
+    }
+    h.msg_control = control;
+    h.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&h);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(segment_size));
+    std::memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+
+    return check(::sendmsg(socket_fd_, &h, MSG_NOSIGNAL));
+  }
+
+  // receive_batch() without blocking the event loop
+  detail::receive_batch_op async_receive_batch(udp_batch &batch) {
+    detail::receive_batch_op op(socket_fd_, batch);
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+    return op;
+  }
+
+  // Send every queued datagram without blocking the event loop
+  detail::send_batch_op async_send_batch(udp_batch &batch) {
+    detail::send_batch_op op(socket_fd_, batch);
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+    return op;
+  }
+
+  // An unbound socket; the kernel picks a port on the first send
+  static std::optional<udp_socket> create(int family = AF_INET,
+                                          const udp_options &options = {}) {
+    int type = SOCK_DGRAM | SOCK_CLOEXEC;
+    if (options.nonblocking) {
+      type |= SOCK_NONBLOCK;
+    }
+
+    udp_socket socket(::socket(family, type, 0));
+    if (!socket.is_open() || !socket.apply(options)) {
+      return std::nullopt;
+    }
+    return socket;
+  }
+
+  // A socket bound to `local`
+  static std::optional<udp_socket> bind(const endpoint &local,
+                                        const udp_options &options = {}) {
+    auto socket = create(local.family(), options);
+    if (!socket) {
+      return std::nullopt;
+    }
+
+    sockaddr_storage storage;
+    socklen_t length = local.to_sockaddr(storage);
+    if (::bind(socket->socket_fd_, reinterpret_cast<sockaddr *>(&storage),
+               length) < 0) {
+      return std::nullopt;
+    }
+    return socket;
+  }
+
+  // Bind a numeric "a.b.c.d:port" or "[v6]:port"; "*:port" means every
+  // IPv4 address
+  static std::optional<udp_socket> bind(std::string_view address,
+                                        const udp_options &options = {}) {
+    auto parts = detail::split_host_port(address);
+    if (parts && parts->first == "*") {
+      auto port = detail::parse_port(parts->second);
+      return port ? bind(endpoint(ipv4_address::any, *port), options)
+                  : std::nullopt;
+    }
+
+    auto local = endpoint::from_str(address);
+    return local ? bind(*local, options) : std::nullopt;
+  }
+
+private:
+  static std::expected<std::size_t, std::error_code>
+  check(ssize_t result) noexcept {
+    if (result < 0) {
+      return std::unexpected(detail::last_error());
+    }
+    return static_cast<std::size_t>(result);
+  }
+
+  bool apply(const udp_options &options) noexcept {
+    int one = 1;
+    if (options.reuse_address &&
+        setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) <
+            0) {
+      return false;
+    }
+#ifdef SO_REUSEPORT
+    if (options.reuse_port &&
+        setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) <
+            0) {
+      return false;
+    }
+#endif
+    if (options.receive_buffer_size > 0 &&
+        setsockopt(socket_fd_, SOL_SOCKET, SO_RCVBUF,
+                   &options.receive_buffer_size,
+                   sizeof(options.receive_buffer_size)) < 0) {
+      return false;
+    }
+    if (options.send_buffer_size > 0 &&
+        setsockopt(socket_fd_, SOL_SOCKET, SO_SNDBUF, &options.send_buffer_size,
+                   sizeof(options.send_buffer_size)) < 0) {
+      return false;
+    }
+    return !options.gro || set_gro(true);
+  }
+
+  int socket_fd_;
+};
+
+} // namespace net
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "event_loop.hpp"
+#include "tcp_stream.hpp"
+#include "unix_stream.hpp"
+
+namespace net {
+
+// Unix domain datagram socket. Unlike UDP, delivery is reliable and
+// ordered, and a sender blocks (or async_send() suspends) while the
+// receiver's queue is full. Descriptors can ride along with any datagram.
+// A socket bound to a filesystem path removes the file when closed; paths
+// starting with '@' are in the abstract namespace.
+class unix_datagram_socket {
+public:
+  explicit unix_datagram_socket(int socket_fd = -1) noexcept
+      : socket_fd_(socket_fd) {}
+
+  unix_datagram_socket(const unix_datagram_socket &) = delete;
+  unix_datagram_socket &operator=(const unix_datagram_socket &) = delete;
+
+  unix_datagram_socket(unix_datagram_socket &&other) noexcept
+      : socket_fd_(std::exchange(other.socket_fd_, -1)),
+        path_(std::move(other.path_)) {
+    other.path_.clear();
+  }
+
+  unix_datagram_socket &operator=(unix_datagram_socket &&other) noexcept {
+    if (this != &other) {
+      close();
+      socket_fd_ = std::exchange(other.socket_fd_, -1);
+      path_ = std::move(other.path_);
+      other.path_.clear();
+    }
+    return *this;
+  }
+
+  ~unix_datagram_socket() { close(); }
+
+  bool is_open() const noexcept { return socket_fd_ >= 0; }
+
+  int native_handle() const noexcept { return socket_fd_; }
+
+  void close() {
+    if (is_open()) {
+      event_loop::detach(socket_fd_);
+      ::close(socket_fd_);
+      socket_fd_ = -1;
+
+      if (!path_.empty() && path_.front() != '@') {
+        ::unlink(path_.c_str());
+      }
+      path_.clear();
+    }
+  }
+
+  // Send to `path` by default and receive only from it
+  bool connect(std::string_view path) noexcept {
+    sockaddr_un address;
+    socklen_t length = detail::unix_address(path, address);
+    return length != 0 &&
+           ::connect(socket_fd_, reinterpret_cast<sockaddr *>(&address),
+                     length) == 0;
+  }
+
+  // Path this socket is bound to; empty if unbound
+  std::optional<std::string> local_path() const {
+    return is_open() ? detail::socket_path(socket_fd_, false) : std::nullopt;
+  }
+
+  std::expected<std::size_t, std::error_code>
+  send_to(std::span<const std::byte> data, std::string_view path) noexcept {
+    sockaddr_un address;
+    socklen_t length = detail::unix_address(path, address);
+    if (length == 0) {
+      return std::unexpected(
+          make_error_code(tcp_error::invalid_address_format));
+    }
+    return check(::sendto(socket_fd_, data.data(), data.size(), MSG_NOSIGNAL,
+                          reinterpret_cast<sockaddr *>(&address), length));
+  }
+
+  // Send to the connected peer
+  std::expected<std::size_t, std::error_code>
+  send(std::span<const std::byte> data) noexcept {
+    return check(::send(socket_fd_, data.data(), data.size(), MSG_NOSIGNAL));
+  }
+
+  // Receive one datagram; a datagram longer than `buffer` is cut short
+  std::expected<std::size_t, std::error_code>
+  receive(std::span<std::byte> buffer) noexcept {
+    return check(::recv(socket_fd_, buffer.data(), buffer.size(), 0));
+  }
+
+  // Receive one datagram and the path it was sent from (empty if the
+  // sender is unbound)
+  std::expected<std::size_t, std::error_code>
+  receive_from(std::span<std::byte> buffer, std::string &from) {
+    sockaddr_un address;
+    socklen_t length = sizeof(address);
+    auto n = check(::recvfrom(socket_fd_, buffer.data(), buffer.size(), 0,
+                              reinterpret_cast<sockaddr *>(&address),
+                              &length));
+    if (n) {
+      from = detail::unix_path(address, length);
+    }
+    return n;
+  }
+
+  // One datagram (a NUL byte if `data` is empty) to the connected peer
+  // with `fds` attached
+  std::expected<std::size_t, std::error_code>
+  send_fds(std::span<const int> fds, std::span<const std::byte> data = {}) {
+    return detail::send_with_fds(socket_fd_, data, fds, 0);
+  }
+
+  // Receive one datagram, appending the descriptors that came with it
+  std::expected<receive_fds_result, std::error_code>
+  receive_fds(std::span<std::byte> buffer, std::vector<int> &fds) {
+    return detail::receive_with_fds(socket_fd_, buffer, fds, 0);
+  }
+
+  // Receive one datagram without blocking the event loop
+  detail::read_some_op async_receive(std::span<std::byte> buffer) {
+    detail::read_some_op op(socket_fd_, buffer);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+
+    return op;
+  }
+
+  // Send one datagram to the connected peer, suspending while its queue is
+  // full
+  detail::write_op async_send(std::span<const std::byte> data) {
+    detail::write_op op(socket_fd_, data);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+
+    return op;
+  }
+
+  // An unbound socket: it can send, but nothing can be sent back to it
+  static std::optional<unix_datagram_socket> create() {
+    int sock_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock_fd < 0) {
+      return std::nullopt;
+    }
+    return unix_datagram_socket(sock_fd);
+  }
+
+  static std::optional<unix_datagram_socket> bind(std::string_view path) {
+    sockaddr_un address;
+    socklen_t length = detail::unix_address(path, address);
+    if (length == 0) {
+      return std::nullopt;
+    }
+
+    auto socket = create();
+    if (!socket || ::bind(socket->socket_fd_,
+                          reinterpret_cast<sockaddr *>(&address), length) < 0) {
+      return std::nullopt;
+    }
+    socket->path_ = path;
+    return socket;
+  }
+
+  // Two connected sockets (socketpair)
+  static std::optional<std::pair<unix_datagram_socket, unix_datagram_socket>>
+  pair() {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) < 0) {
+      return std::nullopt;
+    }
+    return std::pair{unix_datagram_socket(fds[0]),
+                     unix_datagram_socket(fds[1])};
+  }
+
+private:
+  static std::expected<std::size_t, std::error_code>
+  check(ssize_t result) noexcept {
+    if (result < 0) {
+      return std::unexpected(detail::last_error());
+    }
+    return static_cast<std::size_t>(result);
+  }
+
+  int socket_fd_;
+  std::string path_; // Bound path, removed on close
+};
+
+} // namespace net
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cerrno>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "event_loop.hpp"
+#include "metrics.hpp"
+#include "tcp_listener.hpp"
+#include "unix_stream.hpp"
+
+namespace net {
+
+namespace detail {
+
+using unix_accept_op = basic_accept_op<unix_stream>;
+
+} // namespace detail
+
+// Listener for Unix domain stream connections, with the same accept
+// interface as tcp_listener. A filesystem socket left behind by a process
+// that exited is replaced; one that still accepts connections is not. The
+// listener removes its own socket file when closed. Paths starting with
+// '@' are in the abstract namespace and leave no file.
+//
+// Only `backlog` and `nonblocking` of the listen_options apply.
+class unix_listener {
+public:
+  unix_listener() : socket_fd_(-1), nonblocking_(false) {}
+
+  // No copy
+  unix_listener(const unix_listener &) = delete;
+  unix_listener &operator=(const unix_listener &) = delete;
+
+  // Move
+  unix_listener(unix_listener &&other) noexcept
+      : socket_fd_(std::exchange(other.socket_fd_, -1)),
+        nonblocking_(std::exchange(other.nonblocking_, false)),
+        path_(std::move(other.path_)), last_error_(other.last_error_),
+        metrics_(other.metrics_) {
+    other.path_.clear();
+  }
+
+  unix_listener &operator=(unix_listener &&other) noexcept {
+    if (this != &other) {
+      close();
+      socket_fd_ = std::exchange(other.socket_fd_, -1);
+      nonblocking_ = std::exchange(other.nonblocking_, false);
+      path_ = std::move(other.path_);
+      other.path_.clear();
+      last_error_ = other.last_error_;
+      metrics_ = other.metrics_;
+    }
+    return *this;
+  }
+
+  ~unix_listener() { close(); }
+
+  bool is_open() const noexcept { return socket_fd_ >= 0; }
+
+  // Stop listening and remove the socket file
+  void close() {
+    if (is_open()) {
+      // Cancel a coroutine parked in async_accept()
+      event_loop::detach(socket_fd_);
+
+      ::close(socket_fd_);
+      socket_fd_ = -1;
+      nonblocking_ = false;
+
+      if (!path_.empty() && path_.front() != '@') {
+        ::unlink(path_.c_str());
+      }
+      path_.clear();
+    }
+  }
+
+  // Accept a new connection (blocking)
+  std::optional<unix_stream> accept() { return accept(-1); }
+
+  // Accept with timeout (in milliseconds, -1 for infinite)
+  std::optional<unix_stream> accept(int timeout_ms) {
+    if (!is_open()) {
+      last_error_ = std::make_error_code(std::errc::bad_file_descriptor);
+      return std::nullopt;
+    }
+
+    if (timeout_ms >= 0) {
+      last_error_ = detail::wait_for_connection(socket_fd_, timeout_ms);
+      if (last_error_) {
+        return std::nullopt;
+      }
+    }
+
+    int client_fd = ::accept4(socket_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    metrics_.on_accept(client_fd, errno);
+    if (client_fd < 0) {
+      last_error_ = detail::last_error();
+      return std::nullopt;
+    }
+    last_error_ = {};
+    return unix_stream(client_fd);
+  }
+
+  // Why the last accept() returned nullopt; empty after one that succeeded
+  std::error_code last_error() const noexcept { return last_error_; }
+
+  // Accept counts; all zero unless built with WU_NET_METRICS
+  metrics::listener_stats stats() const noexcept { return metrics_.stats(); }
+
+  // Accept a connection without blocking the event loop. The listener is
+  // switched to non-blocking mode; accepted streams are non-blocking too.
+  detail::unix_accept_op async_accept() {
+    detail::unix_accept_op op(socket_fd_, &metrics_);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    } else if (!nonblocking_ && !set_nonblocking(true)) {
+      op.complete(std::unexpected(detail::last_error()));
+    }
+
+    return op;
+  }
+
+  int native_handle() const noexcept { return socket_fd_; }
+
+  // Set non-blocking mode
+  bool set_nonblocking(bool enable) noexcept {
+    int flags = fcntl(socket_fd_, F_GETFL, 0);
+    if (flags < 0)
+      return false;
+
+    if (enable)
+      flags |= O_NONBLOCK;
+    else
+      flags &= ~O_NONBLOCK;
+
+    if (fcntl(socket_fd_, F_SETFL, flags) < 0)
+      return false;
+
+    nonblocking_ = enable;
+    return true;
+  }
+
+  // The path being listened on
+  std::optional<std::string> local_path() const {
+    if (!is_open()) {
+      return std::nullopt;
+    }
+    return path_;
+  }
+
+  static std::optional<unix_listener>
+  create(std::string_view path, const listen_options &options = {}) {
+    sockaddr_un address;
+    socklen_t length = detail::unix_address(path, address);
+    if (length == 0) {
+      return std::nullopt;
+    }
+
+    int type = SOCK_STREAM | SOCK_CLOEXEC;
+    if (options.nonblocking) {
+      type |= SOCK_NONBLOCK;
+    }
+    int sock_fd = socket(AF_UNIX, type, 0);
+    if (sock_fd < 0) {
+      return std::nullopt;
+    }
+
+    auto *name = reinterpret_cast<const sockaddr *>(&address);
+    int bound = ::bind(sock_fd, name, length);
+    if (bound < 0 && errno == EADDRINUSE && path.front() != '@' &&
+        is_stale(address.sun_path, name, length)) {
+      ::unlink(address.sun_path);
+      bound = ::bind(sock_fd, name, length);
+    }
+    if (bound < 0 || listen(sock_fd, options.backlog) < 0) {
+      ::close(sock_fd);
+      return std::nullopt;
+    }
+
+    unix_listener listener;
+    listener.socket_fd_ = sock_fd;
+    listener.nonblocking_ = options.nonblocking;
+    listener.path_ = path;
+    return listener;
+  }
+
+private:
+  // Whether `file` is a socket nobody is listening on any more
+  static bool is_stale(const char *file, const sockaddr *address,
+                       socklen_t length) noexcept {
+    struct stat info;
+    if (::lstat(file, &info) < 0 || !S_ISSOCK(info.st_mode)) {
+      return false;
+    }
+
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+      return false;
+    }
+    bool refused = ::connect(probe, address, length) < 0 &&
+                   errno == ECONNREFUSED;
+    ::close(probe);
+    return refused;
+  }
+
+  int socket_fd_;
+  bool nonblocking_;
+  std::string path_;
+  std::error_code last_error_;
+  [[no_unique_address]] metrics::listener_recorder metrics_;
+};
+
+} // namespace net
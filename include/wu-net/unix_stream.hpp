@@ -0,0 +1,415 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "event_loop.hpp"
+#include "task.hpp"
+#include "tcp_stream.hpp"
+
+namespace net {
+
+// What one receive_fds() call read
+struct receive_fds_result {
+  std::size_t size = 0;       // Bytes read; 0 means the peer closed
+  bool fds_truncated = false; // Descriptors were sent but had to be dropped
+};
+
+namespace detail {
+
+// Most descriptors one message can carry (the kernel's SCM_MAX_FD)
+inline constexpr std::size_t max_passed_fds = 253;
+
+// Fill a sockaddr_un for `path`; a leading '@' names a socket in the
+// abstract namespace, which has no file and goes away with its last
+// descriptor. Returns the address length, or 0 if the path does not fit.
+inline socklen_t unix_address(std::string_view path,
+                              sockaddr_un &address) noexcept {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+
+  bool abstract = !path.empty() && path.front() == '@';
+  // A filesystem path needs room for its terminating NUL
+  if (path.empty() || path.size() + (abstract ? 0 : 1) >
+                          sizeof(address.sun_path)) {
+    return 0;
+  }
+
+  std::memcpy(address.sun_path, path.data(), path.size());
+  if (abstract) {
+    address.sun_path[0] = '\0';
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) +
+                                  path.size());
+  }
+  return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) +
+                                path.size() + 1);
+}
+
+// The path of a sockaddr_un filled by the kernel, with abstract names
+// written with a leading '@'; empty for an unnamed socket
+inline std::string unix_path(const sockaddr_un &address,
+                             socklen_t length) {
+  auto offset = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path));
+  if (length <= offset) {
+    return {};
+  }
+
+  std::size_t size = length - offset;
+  if (address.sun_path[0] == '\0') {
+    return '@' + std::string(address.sun_path + 1, size - 1);
+  }
+  return std::string(address.sun_path, strnlen(address.sun_path, size));
+}
+
+inline std::optional<std::string> socket_path(int socket_fd, bool peer) {
+  sockaddr_un address;
+  socklen_t length = sizeof(address);
+  auto *name = reinterpret_cast<sockaddr *>(&address);
+  int result = peer ? getpeername(socket_fd, name, &length)
+                    : getsockname(socket_fd, name, &length);
+  if (result < 0) {
+    return std::nullopt;
+  }
+  return unix_path(address, length);
+}
+
+// Control buffer for up to max_passed_fds descriptors
+struct alignas(cmsghdr) fd_control {
+  unsigned char data[CMSG_SPACE(sizeof(int) * max_passed_fds)];
+};
+
+// sendmsg() `data` with `fds` attached as SCM_RIGHTS. Sockets need at least
+// one byte to carry ancillary data, so an empty `data` sends a single NUL.
+inline std::expected<std::size_t, std::error_code>
+send_with_fds(int socket_fd, std::span<const std::byte> data,
+              std::span<const int> fds, int flags) noexcept {
+  if (fds.size() > max_passed_fds) {
+    return std::unexpected(std::make_error_code(std::errc::invalid_argument));
+  }
+
+  static constexpr std::byte nul{0};
+  iovec iov{const_cast<std::byte *>(data.empty() ? &nul : data.data()),
+            data.empty() ? 1 : data.size()};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+
+  fd_control control;
+  if (!fds.empty()) {
+    message.msg_control = control.data;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+  }
+
+  ssize_t n;
+  do {
+    n = ::sendmsg(socket_fd, &message, flags | MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    return std::unexpected(last_error());
+  }
+  return data.empty() ? 0 : static_cast<std::size_t>(n);
+}
+
+// recvmsg() into `buffer`, appending any descriptors that came with it to
+// `fds` (close-on-exec). If they did not all fit (more than
+// max_passed_fds, or other control data took the room), the kernel drops
+// the rest and the ones that arrived are closed too: the bytes are still
+// returned, with fds_truncated set and nothing appended.
+inline std::expected<receive_fds_result, std::error_code>
+receive_with_fds(int socket_fd, std::span<std::byte> buffer,
+                 std::vector<int> &fds, int flags) {
+  iovec iov{buffer.data(), buffer.size()};
+  msghdr message{};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  fd_control control;
+  message.msg_control = control.data;
+  message.msg_controllen = sizeof(control.data);
+
+  ssize_t n;
+  do {
+    n = ::recvmsg(socket_fd, &message, flags | MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    return std::unexpected(last_error());
+  }
+
+  receive_fds_result result{static_cast<std::size_t>(n),
+                            (message.msg_flags & MSG_CTRUNC) != 0};
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&message, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    std::size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    std::size_t first = fds.size();
+    fds.resize(first + count);
+    std::memcpy(fds.data() + first, CMSG_DATA(cmsg), count * sizeof(int));
+    if (result.fds_truncated) {
+      for (std::size_t i = first; i < fds.size(); ++i) {
+        ::close(fds[i]);
+      }
+      fds.resize(first);
+    }
+  }
+  return result;
+}
+
+// Send data with descriptors attached, suspending while the socket buffer
+// is full. The descriptors go with the first byte.
+class send_fds_op
+    : public io_awaitable<std::expected<std::size_t, std::error_code>,
+                          io_event::writable> {
+public:
+  send_fds_op(int socket_fd, std::span<const std::byte> data,
+              std::span<const int> fds) noexcept
+      : io_awaitable(socket_fd), data_(data), fds_(fds) {}
+
+  using io_awaitable::complete;
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = std::unexpected(canceled_error());
+      return true;
+    }
+
+    do {
+      auto n = send_with_fds(fd, data_.subspan(sent_), fds_, MSG_DONTWAIT);
+      if (!n) {
+        if (n.error() == std::errc::resource_unavailable_try_again) {
+          return false;
+        }
+        result_ = n;
+        return true;
+      }
+      fds_ = {}; // Attached to what was just sent
+      sent_ += *n;
+    } while (sent_ < data_.size());
+
+    result_ = sent_;
+    return true;
+  }
+
+private:
+  std::span<const std::byte> data_;
+  std::span<const int> fds_;
+  std::size_t sent_ = 0;
+};
+
+// Receive data and any descriptors sent with it, suspending while nothing
+// is available
+class receive_fds_op
+    : public io_awaitable<std::expected<receive_fds_result, std::error_code>,
+                          io_event::readable> {
+public:
+  receive_fds_op(int socket_fd, std::span<std::byte> buffer,
+                 std::vector<int> &fds) noexcept
+      : io_awaitable(socket_fd), buffer_(buffer), fds_(fds) {}
+
+  using io_awaitable::complete;
+
+  bool perform() noexcept override {
+    if (fd < 0) {
+      result_ = std::unexpected(canceled_error());
+      return true;
+    }
+
+    result_ = receive_with_fds(fd, buffer_, fds_, MSG_DONTWAIT);
+    return result_ ||
+           result_.error() != std::errc::resource_unavailable_try_again;
+  }
+
+private:
+  std::span<std::byte> buffer_;
+  std::vector<int> &fds_;
+};
+
+} // namespace detail
+
+// Stream over a Unix domain socket, for same-host peers that do not need
+// the TCP stack. The iostream buffering, raw and asynchronous I/O are
+// tcp_stream's, which only rely on a connected stream socket, and a
+// unix_stream adds no state of its own: it can be passed (or moved) to
+// anything that takes a tcp_stream. TCP-only options like set_nodelay()
+// return false.
+//
+// Paths starting with '@' are in the abstract namespace.
+class unix_stream : public tcp_stream {
+public:
+  using tcp_stream::tcp_stream;
+
+  // Spelled out: the implicit ones would copy the virtual std::basic_ios
+  unix_stream(unix_stream &&other) noexcept : tcp_stream(std::move(other)) {}
+
+  unix_stream &operator=(unix_stream &&other) noexcept {
+    tcp_stream::operator=(std::move(other));
+    return *this;
+  }
+
+  // Path this end is bound to; empty for an unnamed (client) socket
+  std::optional<std::string> local_path() const {
+    return is_open() ? detail::socket_path(native_handle(), false)
+                     : std::nullopt;
+  }
+
+  // Path the peer is bound to (the listener's path, seen from a client)
+  std::optional<std::string> remote_path() const {
+    return is_open() ? detail::socket_path(native_handle(), true)
+                     : std::nullopt;
+  }
+
+  // Process, user and group of the peer when it connected (SO_PEERCRED)
+  std::optional<ucred> peer_credentials() const noexcept {
+    ucred credentials;
+    socklen_t length = sizeof(credentials);
+    if (!is_open() || getsockopt(native_handle(), SOL_SOCKET, SO_PEERCRED,
+                                 &credentials, &length) < 0) {
+      return std::nullopt;
+    }
+    return credentials;
+  }
+
+  // Descriptor passing
+  //
+  // Open descriptors sent with SCM_RIGHTS arrive as new descriptors for the
+  // same files in the receiving process; the sender keeps (and still has to
+  // close) its own. They travel with a byte of the stream, so a reader has
+  // to use receive_fds(): read() and read_some() drop any that arrive.
+
+  // Send all of `data` with `fds` attached (at most 253). Pending iostream
+  // output goes first. An empty `data` sends a single NUL byte.
+  std::expected<std::size_t, std::error_code>
+  send_fds(std::span<const int> fds, std::span<const std::byte> data = {}) {
+    auto flushed = write_all({});
+    if (!flushed) {
+      return flushed;
+    }
+
+    auto sent = detail::send_with_fds(native_handle(), data, fds, 0);
+    if (!sent || *sent >= data.size()) {
+      return sent;
+    }
+    auto rest = write_all(data.subspan(*sent));
+    if (!rest) {
+      return rest;
+    }
+    return data.size();
+  }
+
+  // Read at most buffer.size() bytes, appending descriptors that came with
+  // them to `fds`; 0 bytes means the peer closed the connection. Must not
+  // be mixed with iostream reads, whose buffered bytes carried no
+  // descriptors.
+  std::expected<receive_fds_result, std::error_code>
+  receive_fds(std::span<std::byte> buffer, std::vector<int> &fds) {
+    if (!is_open()) {
+      return std::unexpected(make_error_code(tcp_error::not_connected));
+    }
+    return detail::receive_with_fds(native_handle(), buffer, fds, 0);
+  }
+
+  // send_fds() without blocking the loop; pending iostream output should
+  // be flushed first
+  detail::send_fds_op async_send_fds(std::span<const int> fds,
+                                     std::span<const std::byte> data = {}) {
+    detail::send_fds_op op(native_handle(), data, fds);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+
+    return op;
+  }
+
+  // receive_fds() without blocking the loop
+  detail::receive_fds_op async_receive_fds(std::span<std::byte> buffer,
+                                           std::vector<int> &fds) {
+    detail::receive_fds_op op(native_handle(), buffer, fds);
+
+    if (!is_open()) {
+      op.complete(std::unexpected(make_error_code(tcp_error::not_connected)));
+    }
+
+    return op;
+  }
+
+  // Connection
+
+  // Two connected streams (socketpair), e.g. for a child process
+  static std::optional<std::pair<unix_stream, unix_stream>> pair() {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+      return std::nullopt;
+    }
+    return std::pair{unix_stream(fds[0]), unix_stream(fds[1])};
+  }
+
+  // Connect to the listener at `path`
+  static std::optional<unix_stream> connect(std::string_view path,
+                                            int timeout_ms = -1) {
+    sockaddr_un address;
+    socklen_t length = detail::unix_address(path, address);
+    if (length == 0) {
+      return std::nullopt;
+    }
+
+    int sock_fd = detail::connect_socket(
+        AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0,
+        reinterpret_cast<const sockaddr *>(&address), length, timeout_ms);
+    if (sock_fd < 0) {
+      return std::nullopt;
+    }
+    return unix_stream(sock_fd);
+  }
+
+  // Connect from a coroutine. A Unix domain connect() completes at once, so
+  // this never suspends; it fails with resource_unavailable_try_again when
+  // the listener's backlog is full rather than blocking the loop.
+  static task<std::expected<unix_stream, std::error_code>>
+  async_connect(std::string path) {
+    sockaddr_un address;
+    socklen_t length = detail::unix_address(path, address);
+    if (length == 0) {
+      co_return std::unexpected(
+          make_error_code(tcp_error::invalid_address_format));
+    }
+
+    int sock_fd =
+        socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock_fd < 0) {
+      co_return std::unexpected(detail::last_error());
+    }
+
+    if (::connect(sock_fd, reinterpret_cast<const sockaddr *>(&address),
+                  length) == 0) {
+      co_return unix_stream(sock_fd);
+    }
+
+    std::error_code error = detail::last_error();
+    ::close(sock_fd);
+    co_return std::unexpected(error);
+  }
+};
+
+} // namespace net
@@ -0,0 +1,219 @@
+#include <wu-net/net.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Reuse, health checks, idle eviction and the per-host cap, against a
+// blocking line echo server that counts the connections it accepts
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+class echo_server {
+public:
+  echo_server() : listener_(net::tcp_listener::create("127.0.0.1:0")) {
+    address_ = listener_->local_address().value_or("");
+    acceptor_ = std::thread([this] {
+      for (;;) {
+        auto client = listener_->accept();
+        if (stopping_ || !client) {
+          return;
+        }
+        ++accepted_;
+        std::lock_guard lock(mutex_);
+        clients_.emplace_back(
+            [stream = std::move(*client)]() mutable { echo(stream); });
+      }
+    });
+  }
+
+  ~echo_server() {
+    stopping_ = true;
+    net::tcp_stream::connect(address_); // Wake the acceptor
+    acceptor_.join();
+    for (auto &client : clients_) {
+      client.join();
+    }
+  }
+
+  const std::string &address() const noexcept { return address_; }
+
+  std::size_t accepted() const noexcept { return accepted_; }
+
+private:
+  // Echo lines until the client closes or says "bye"
+  static void echo(net::tcp_stream &stream) {
+    std::string line;
+    while (std::getline(stream, line) && line != "bye") {
+      stream << line << '\n' << std::flush;
+    }
+  }
+
+  std::optional<net::tcp_listener> listener_;
+  std::string address_;
+  std::atomic<bool> stopping_ = false;
+  std::atomic<std::size_t> accepted_ = 0;
+  std::thread acceptor_;
+  std::mutex mutex_;
+  std::vector<std::thread> clients_;
+};
+
+bool round_trip(net::pooled_connection &connection, std::string_view text) {
+  std::string reply;
+  *connection << text << '\n' << std::flush;
+  return std::getline(*connection, reply) && reply == text;
+}
+
+} // namespace
+
+int main() {
+  echo_server server;
+  const std::string &address = server.address();
+
+  {
+    net::connection_pool pool;
+
+    // Sequential requests share one connection
+    for (int i = 0; i < 100; ++i) {
+      auto connection = pool.acquire(address);
+      check(connection.has_value(), "acquire");
+      check(round_trip(*connection, "ping " + std::to_string(i)),
+            "echo on pooled connection");
+      check(i == 0 || connection->reused(), "connection reused");
+    }
+    check(server.accepted() == 1, "one connection for sequential use");
+    check(pool.idle_count(address) == 1, "connection returned idle");
+
+    // A connection the server closed is noticed before it is handed out
+    {
+      auto connection = pool.acquire(address);
+      **connection << "bye\n" << std::flush;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    {
+      auto connection = pool.acquire(address);
+      check(connection && !connection->reused(), "closed connection dropped");
+      check(connection && round_trip(*connection, "fresh"), "fresh echo");
+    }
+    check(server.accepted() == 2, "reconnected once");
+
+    // Unread input makes a connection unfit for reuse
+    {
+      auto connection = pool.acquire(address);
+      **connection << "unread\n" << std::flush;
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      (*connection)->peek();
+    }
+    check(pool.idle_count(address) == 0, "dirty connection closed");
+    check(pool.connection_count(address) == 0, "dirty connection released");
+
+    // Worker threads share the pool
+    std::atomic<int> echoed = 0;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 8; ++t) {
+      workers.emplace_back([&, t] {
+        for (int i = 0; i < 200; ++i) {
+          auto connection = pool.acquire(address);
+          if (connection &&
+              round_trip(*connection, std::to_string(t * 1000 + i))) {
+            ++echoed;
+          }
+        }
+      });
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    check(echoed == 1600, "concurrent echoes");
+    check(server.accepted() <= 3 + 8, "at most one connection per thread");
+    check(pool.connection_count(address) == pool.idle_count(address),
+          "every connection returned");
+
+    // Discarded connections are closed, not pooled
+    std::size_t idle = pool.idle_count(address);
+    {
+      auto connection = pool.acquire(address);
+      connection->discard();
+    }
+    check(pool.idle_count(address) == idle - 1, "discarded connection closed");
+  }
+
+  // Idle timeout and the per-host cap
+  {
+    net::connection_pool pool({.max_connections_per_host = 2,
+                               .idle_timeout = std::chrono::milliseconds(20)});
+
+    auto first = pool.acquire(address);
+    auto second = pool.acquire(address);
+    auto third = pool.acquire(address);
+    check(first && second, "acquire under cap");
+    check(!third && third.error() ==
+                        make_error_code(net::tcp_error::pool_exhausted),
+          "cap enforced");
+
+    first->release();
+    second->release();
+    check(pool.idle_count(address) == 2, "both idle");
+    check(pool.evict_idle() == 0, "fresh connections kept");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    check(pool.evict_idle() == 2, "expired connections evicted");
+    check(pool.connection_count(address) == 0, "nothing left open");
+  }
+
+  // The idle limit is exact, and 0 turns pooling off
+  for (std::size_t limit : {0, 3}) {
+    net::connection_pool pool({.max_idle_per_host = limit});
+    std::vector<net::pooled_connection> held;
+    for (int i = 0; i < 4; ++i) {
+      if (auto connection = pool.acquire(address)) {
+        held.push_back(std::move(*connection));
+      }
+    }
+    held.clear();
+    check(pool.idle_count(address) == limit, "idle limit kept");
+    check(pool.connection_count(address) == limit, "extra connections closed");
+  }
+
+  // Unresolvable and malformed addresses
+  {
+    net::connection_pool pool;
+    check(!pool.acquire("no-port"), "address without port");
+    check(!pool.acquire("127.0.0.1:1"), "refused connection");
+    check(pool.connection_count("127.0.0.1:1") == 0, "failed connect released");
+  }
+
+  // Names are looked up again once their addresses expire
+  {
+    net::connection_pool pool({.dns_ttl = std::chrono::milliseconds(0)});
+    std::string named = "localhost" + address.substr(address.rfind(':'));
+    for (int i = 0; i < 3; ++i) {
+      auto connection = pool.acquire(named);
+      check(connection && round_trip(*connection, "named"),
+            "named host re-resolved");
+      if (connection) {
+        connection->discard();
+      }
+    }
+  }
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,143 @@
+#include <wu-net/net.hpp>
+
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Echo server and clients written as coroutines, all on one event loop
+namespace {
+
+constexpr int client_count = 32;
+int finished = 0;
+int failures = 0;
+
+net::task<void> echo(net::tcp_stream client) {
+  std::array<std::byte, 1024> buffer;
+  for (;;) {
+    auto n = co_await client.async_read_some(buffer);
+    if (!n || *n == 0) {
+      co_return;
+    }
+    if (!co_await client.async_write(std::span(buffer).first(*n))) {
+      co_return;
+    }
+  }
+}
+
+net::task<void> serve(net::tcp_listener &listener) {
+  for (;;) {
+    auto client = co_await listener.async_accept();
+    if (!client) {
+      co_return; // Listener closed
+    }
+    net::spawn(echo(std::move(*client)));
+  }
+}
+
+net::task<void> client(std::string address, int id, net::event_loop &loop,
+                       net::tcp_listener &listener) {
+  auto stream = co_await net::tcp_stream::async_connect(address);
+  if (stream) {
+    std::string message = "hello " + std::to_string(id);
+    co_await stream->async_write(std::as_bytes(std::span(message)));
+
+    std::string reply;
+    std::array<std::byte, 64> buffer;
+    while (reply.size() < message.size()) {
+      auto n = co_await stream->async_read_some(buffer);
+      if (!n || *n == 0) {
+        break;
+      }
+      reply.append(reinterpret_cast<const char *>(buffer.data()), *n);
+    }
+
+    if (reply != message) {
+      ++failures;
+    }
+  } else {
+    ++failures;
+  }
+
+  if (++finished == client_count) {
+    listener.close();
+    loop.stop();
+  }
+}
+
+bool run(bool uring) {
+  finished = 0;
+  failures = 0;
+
+  auto loop = net::event_loop::create();
+  auto listener = net::tcp_listener::create("127.0.0.1:0", 128);
+  if (!loop || !listener) {
+    std::cerr << "Failed to set up loop or listener\n";
+    return false;
+  }
+
+#ifdef WU_NET_IO_URING
+  if (uring && !loop->enable_io_uring()) {
+    std::cerr << "io_uring unavailable, skipping\n";
+    return true;
+  }
+#endif
+  (void)uring;
+
+  auto address = listener->local_address().value_or("");
+
+  loop->spawn(serve(*listener));
+  for (int i = 0; i < client_count; ++i) {
+    loop->spawn(client(address, i, *loop, *listener));
+  }
+
+  loop->run();
+
+  if (failures != 0 || finished != client_count) {
+    std::cerr << failures << " clients failed\n";
+    return false;
+  }
+  return true;
+}
+
+// A listener closed outside the loop's callbacks still leaves the loop it
+// was parked on, and the parked accept ends
+bool close_outside_loop() {
+  auto loop = net::event_loop::create();
+  auto listener = net::tcp_listener::create("127.0.0.1:0", 128);
+  if (!loop || !listener) {
+    return false;
+  }
+
+  loop->spawn(serve(*listener));
+  loop->run_once(0);
+  int fd = listener->native_handle();
+  bool registered =
+      loop->size() == 1 && net::event_loop::owner(fd) == &*loop;
+
+  listener->close();
+  bool removed = loop->size() == 0 && net::event_loop::owner(fd) == nullptr;
+  loop->run_once(0);
+  return registered && removed;
+}
+
+} // namespace
+
+int main() {
+  if (!run(false)) {
+    return 1;
+  }
+  if (!close_outside_loop()) {
+    std::cerr << "Listener closed outside the loop left a registration\n";
+    return 1;
+  }
+
+#ifdef WU_NET_IO_URING
+  if (!run(true)) {
+    return 1;
+  }
+#endif
+
+  std::cout << "passed\n";
+  return 0;
+}
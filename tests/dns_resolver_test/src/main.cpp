@@ -0,0 +1,400 @@
+#include <wu-net/net.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Resolver against a stub DNS server on loopback: answers, CNAME chains,
+// NXDOMAIN, timeouts, forged replies, truncation, coalescing and stale
+// answers
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+using addresses = std::vector<net::ipv4_address>;
+
+// Answers A queries from a fixed zone on background threads, over UDP
+// and, on the same port, TCP
+class stub_server {
+public:
+  stub_server() {
+    fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    ::getsockname(fd_, reinterpret_cast<sockaddr *>(&address), &length);
+    port_ = ntohs(address.sin_port);
+
+    tcp_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    ::bind(tcp_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    ::listen(tcp_fd_, 4);
+
+    thread_ = std::thread([this] { serve(); });
+    tcp_thread_ = std::thread([this] { serve_tcp(); });
+  }
+
+  ~stub_server() {
+    stopping_ = true;
+    ::shutdown(fd_, SHUT_RDWR);
+    ::shutdown(tcp_fd_, SHUT_RDWR);
+    thread_.join();
+    tcp_thread_.join();
+    ::close(fd_);
+    ::close(tcp_fd_);
+  }
+
+  // Source ports UDP queries came from
+  std::size_t ports() {
+    std::lock_guard lock(mutex_);
+    return ports_.size();
+  }
+
+  std::string address() const { return "127.0.0.1:" + std::to_string(port_); }
+
+  int queries(const std::string &name) {
+    std::lock_guard lock(mutex_);
+    return counts_[name];
+  }
+
+private:
+  using packet = std::vector<std::uint8_t>;
+
+  static void put16(packet &p, std::uint16_t v) {
+    p.push_back(static_cast<std::uint8_t>(v >> 8));
+    p.push_back(static_cast<std::uint8_t>(v));
+  }
+
+  static void put_name(packet &p, std::string_view name) {
+    while (!name.empty()) {
+      std::size_t dot = std::min(name.find('.'), name.size());
+      p.push_back(static_cast<std::uint8_t>(dot));
+      p.insert(p.end(), name.begin(), name.begin() + dot);
+      name.remove_prefix(std::min(dot + 1, name.size()));
+    }
+    p.push_back(0);
+  }
+
+  static void put_a(packet &p, std::uint32_t ttl, std::uint8_t last) {
+    put16(p, 0xc00c); // Points at the question name
+    put16(p, 1);
+    put16(p, 1);
+    put16(p, static_cast<std::uint16_t>(ttl >> 16));
+    put16(p, static_cast<std::uint16_t>(ttl));
+    put16(p, 4);
+    p.insert(p.end(), {10, 0, 0, last});
+  }
+
+  // Header and question copied from the query, with the answers to come
+  static packet reply(const std::uint8_t *query, std::size_t question_end,
+                      std::uint16_t rcode, std::uint16_t answers) {
+    packet p(query, query + question_end);
+    p[2] = 0x81;
+    p[3] = static_cast<std::uint8_t>(0x80 | rcode);
+    p[6] = 0;
+    p[7] = static_cast<std::uint8_t>(answers);
+    return p;
+  }
+
+  void serve() {
+    std::array<std::uint8_t, 512> query;
+    while (!stopping_) {
+      sockaddr_in client = {};
+      socklen_t length = sizeof(client);
+      ssize_t size = ::recvfrom(fd_, query.data(), query.size(), 0,
+                                reinterpret_cast<sockaddr *>(&client), &length);
+      if (size < 12) {
+        continue;
+      }
+
+      std::string name;
+      std::size_t pos = 12;
+      while (pos < static_cast<std::size_t>(size) && query[pos] != 0) {
+        if (!name.empty()) {
+          name += '.';
+        }
+        name.append(reinterpret_cast<const char *>(&query[pos + 1]),
+                    query[pos]);
+        pos += query[pos] + 1;
+      }
+      std::size_t question_end = pos + 5;
+
+      int count;
+      {
+        std::lock_guard lock(mutex_);
+        count = ++counts_[name];
+        ports_.insert(ntohs(client.sin_port));
+      }
+
+      packet p;
+      if (name == "www.example.test") {
+        p = reply(query.data(), question_end, 0, 2);
+        put_a(p, 300, 1);
+        put_a(p, 60, 2);
+      } else if (name == "alias.example.test") {
+        p = reply(query.data(), question_end, 0, 2);
+        put16(p, 0xc00c);
+        put16(p, 5); // CNAME to target.test
+        put16(p, 1);
+        put16(p, 0);
+        put16(p, 300);
+        put16(p, 13);
+        put_name(p, "target.test");
+        put16(p, static_cast<std::uint16_t>(0xc000 | (p.size() - 13)));
+        put16(p, 1);
+        put16(p, 1);
+        put16(p, 0);
+        put16(p, 300);
+        put16(p, 4);
+        p.insert(p.end(), {10, 0, 0, 9});
+      } else if (name == "slow.test") {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        p = reply(query.data(), question_end, 0, 1);
+        put_a(p, 300, 3);
+      } else if (name == "forged.test") {
+        packet forged = reply(query.data(), question_end, 0, 1);
+        forged[1] ^= 1; // Wrong id
+        put_a(forged, 300, 66);
+        ::sendto(fd_, forged.data(), forged.size(), 0,
+                 reinterpret_cast<sockaddr *>(&client), length);
+        p = reply(query.data(), question_end, 0, 1);
+        put_a(p, 300, 4);
+      } else if (name == "rotating.test") {
+        p = reply(query.data(), question_end, 0, 1);
+        put_a(p, 0, static_cast<std::uint8_t>(count));
+      } else if (name == "big.test") {
+        p = reply(query.data(), question_end, 0, 0);
+        p[2] |= 0x02; // TC: ask again over TCP
+      } else if (name == "silent.test") {
+        continue;
+      } else {
+        p = reply(query.data(), question_end, 3, 0); // NXDOMAIN
+      }
+
+      ::sendto(fd_, p.data(), p.size(), 0,
+               reinterpret_cast<sockaddr *>(&client), length);
+    }
+  }
+
+  // Answer one length-prefixed query per connection with more records
+  // than fit in a UDP reply
+  void serve_tcp() {
+    while (!stopping_) {
+      int client = ::accept(tcp_fd_, nullptr, nullptr);
+      if (client < 0) {
+        continue;
+      }
+      std::array<std::uint8_t, 514> query;
+      std::size_t size = 0;
+      while (size < 2 || size < 2 + std::size_t{query[0]} * 256 + query[1]) {
+        ssize_t n = ::recv(client, query.data() + size, query.size() - size, 0);
+        if (n <= 0) {
+          break;
+        }
+        size += static_cast<std::size_t>(n);
+      }
+      if (size > 2 + 12) {
+        std::size_t pos = 2 + 12;
+        while (pos < size && query[pos] != 0) {
+          pos += query[pos] + 1;
+        }
+        packet p = reply(query.data() + 2, pos + 5 - 2, 0, 40);
+        for (int i = 0; i < 40; ++i) {
+          put_a(p, 300, static_cast<std::uint8_t>(100 + i));
+        }
+        packet framed;
+        put16(framed, static_cast<std::uint16_t>(p.size()));
+        framed.insert(framed.end(), p.begin(), p.end());
+        ::send(client, framed.data(), framed.size(), MSG_NOSIGNAL);
+      }
+      ::close(client);
+    }
+  }
+
+  int fd_;
+  int tcp_fd_;
+  std::uint16_t port_;
+  std::atomic<bool> stopping_ = false;
+  std::thread thread_;
+  std::thread tcp_thread_;
+  std::mutex mutex_;
+  std::map<std::string, int> counts_;
+  std::set<std::uint16_t> ports_;
+};
+
+bool has(const net::dns_lookup::result_type &result, addresses expected) {
+  return result && *result == expected;
+}
+
+net::task<void> run(net::event_loop &loop, stub_server &server,
+                    std::string hosts) {
+  net::dns_resolver resolver(
+      loop, {.hosts = hosts,
+             .nameservers = {server.address()},
+             .timeout = std::chrono::milliseconds(200),
+             .attempts = 1});
+
+  // Numeric names and the hosts file never reach the server
+  net::dns_lookup::result_type result;
+  result = co_await resolver.resolve("192.0.2.1");
+  check(has(result, {{192, 0, 2, 1}}), "numeric address");
+  result = co_await resolver.resolve("Gateway.Lan.");
+  check(has(result, {{192, 0, 2, 7}}), "hosts file entry");
+  result = co_await resolver.resolve("router");
+  check(has(result, {{192, 0, 2, 7}}), "hosts file alias");
+
+  result = co_await resolver.resolve("bad..name");
+  check(!result && result.error() == make_error_code(net::dns_error::bad_name),
+        "invalid name");
+
+  // Answers are cached for their TTL
+  result = co_await resolver.resolve("www.example.test");
+  check(has(result, {{10, 0, 0, 1}, {10, 0, 0, 2}}), "A records");
+  result = co_await resolver.resolve("WWW.example.test");
+  check(has(result, {{10, 0, 0, 1}, {10, 0, 0, 2}}), "cached answer");
+  check(server.queries("www.example.test") == 1, "one query while fresh");
+
+  result = co_await resolver.resolve("alias.example.test");
+  check(has(result, {{10, 0, 0, 9}}), "CNAME chain");
+  result = co_await resolver.resolve("forged.test");
+  check(has(result, {{10, 0, 0, 4}}), "forged reply ignored");
+
+  result = co_await resolver.resolve("big.test");
+  check(result && result->size() == 40 &&
+            (*result)[39] == net::ipv4_address(10, 0, 0, 139),
+        "truncated answer retried over TCP");
+  check(server.ports() > 1, "queries from different ports");
+
+  result = co_await resolver.resolve("missing.test");
+  check(!result && result.error() == make_error_code(net::dns_error::not_found),
+        "NXDOMAIN");
+  result = co_await resolver.resolve("missing.test");
+  check(!result && server.queries("missing.test") == 1,
+        "negative answer cached");
+
+  auto start = std::chrono::steady_clock::now();
+  result = co_await resolver.resolve("silent.test");
+  check(!result && result.error() == make_error_code(net::dns_error::timeout),
+        "timeout");
+  check(std::chrono::steady_clock::now() - start >=
+            std::chrono::milliseconds(200),
+        "timeout waits for the server");
+
+  // Concurrent lookups of one name share a query
+  int answered = 0;
+  auto lookup = [&]() -> net::task<void> {
+    auto slow = co_await resolver.resolve("slow.test");
+    if (has(slow, {{10, 0, 0, 3}})) {
+      ++answered;
+    }
+  };
+  for (int i = 0; i < 10; ++i) {
+    loop.spawn(lookup());
+  }
+  for (int i = 0; i < 100 && answered < 10; ++i) {
+    co_await net::sleep_for(std::chrono::milliseconds(10));
+  }
+  check(answered == 10, "coalesced lookups answered");
+  check(server.queries("slow.test") == 1, "lookups coalesced");
+
+  // An expired answer is served while a background query refreshes it
+  net::dns_resolver stale(loop, {.hosts = "",
+                                 .nameservers = {server.address()},
+                                 .max_stale = std::chrono::seconds(60)});
+  result = co_await stale.resolve("rotating.test");
+  check(has(result, {{10, 0, 0, 1}}), "first answer");
+  result = co_await stale.resolve("rotating.test");
+  check(has(result, {{10, 0, 0, 1}}), "stale answer served");
+  co_await net::sleep_for(std::chrono::milliseconds(50));
+  check(server.queries("rotating.test") == 2, "one refresh query");
+  result = co_await stale.resolve("rotating.test");
+  check(has(result, {{10, 0, 0, 2}}), "refreshed answer");
+
+  // A full cache evicts an older answer to make room for a new name
+  net::dns_resolver small(loop, {.hosts = "",
+                                 .nameservers = {server.address()},
+                                 .max_entries = 1});
+  int queried = server.queries("www.example.test");
+  result = co_await small.resolve("www.example.test");
+  check(has(result, {{10, 0, 0, 1}, {10, 0, 0, 2}}), "first of a full cache");
+  result = co_await small.resolve("alias.example.test");
+  check(has(result, {{10, 0, 0, 9}}), "answer evicting another");
+  result = co_await small.resolve("www.example.test");
+  check(has(result, {{10, 0, 0, 1}, {10, 0, 0, 2}}) &&
+            server.queries("www.example.test") == queried + 2,
+        "evicted name queried again");
+
+  loop.stop();
+}
+
+} // namespace
+
+int main() {
+  char path[] = "/tmp/wu-net-hosts-XXXXXX";
+  int hosts = ::mkstemp(path);
+  std::string text = "# comment\n192.0.2.7\tgateway.lan router # trailing\n"
+                     "::1 localhost6\n";
+  check(::write(hosts, text.data(), text.size()) ==
+            static_cast<ssize_t>(text.size()),
+        "hosts file written");
+  ::close(hosts);
+
+  {
+    stub_server server;
+    auto loop = net::event_loop::create();
+    loop->spawn(run(*loop, server, std::string(path)));
+    loop->run();
+  }
+  ::unlink(path);
+
+  // Nameservers and options from resolv.conf
+  char conf[] = "/tmp/wu-net-resolv-XXXXXX";
+  int file = ::mkstemp(conf);
+  text = "search example.test\nnameserver 127.0.0.53\nnameserver ::1\n"
+         "options ndots:1 timeout:3 attempts:4\n";
+  check(::write(file, text.data(), text.size()) ==
+            static_cast<ssize_t>(text.size()),
+        "resolv.conf written");
+  ::close(file);
+  {
+    auto loop = net::event_loop::create();
+    net::dns_resolver resolver(*loop, {.resolv_conf = conf});
+    const auto &servers = resolver.nameservers();
+    check(servers.size() == 1 &&
+              servers[0].sin_addr.s_addr == inet_addr("127.0.0.53") &&
+              ntohs(servers[0].sin_port) == 53,
+          "resolv.conf nameserver");
+  }
+  ::unlink(conf);
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,211 @@
+#include <wu-net/net.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Loopback echo benchmark comparing the server-side I/O paths:
+//   blocking  - one thread per connection, tcp_stream iostream read/write
+//   epoll     - coroutines on an event_loop, async_read_some/async_write
+//   io_uring  - same coroutines with the io_uring backend and provided
+//               buffers (only when built with WU_NET_IO_URING)
+//
+// Usage: echo_bench [connections] [round_trips_per_connection]
+namespace {
+
+constexpr std::size_t message_size = 64;
+
+// Blocking server: thread per connection through the iostream interface
+void blocking_server(net::tcp_listener &listener, int connections) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < connections; ++i) {
+    auto client = listener.accept();
+    if (!client) {
+      break;
+    }
+
+    threads.emplace_back([client = std::move(*client)]() mutable {
+      client.set_nodelay(true);
+      std::array<char, message_size> buffer;
+      while (client.read(buffer.data(), buffer.size())) {
+        client.write(buffer.data(), buffer.size());
+        client.flush();
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+// Connections still open on the async server; the loop stops at zero
+struct server_state {
+  net::event_loop &loop;
+  int open = 0;
+  bool accepting = true;
+
+  void finished() {
+    if (--open == 0 && !accepting) {
+      loop.stop();
+    }
+  }
+};
+
+net::task<void> echo_connection(net::tcp_stream client, server_state &state) {
+  client.set_nodelay(true);
+  std::array<std::byte, 4096> buffer;
+  for (;;) {
+    auto n = co_await client.async_read_some(buffer);
+    if (!n || *n == 0 ||
+        !co_await client.async_write(std::span(buffer).first(*n))) {
+      break;
+    }
+  }
+  state.finished();
+}
+
+#ifdef WU_NET_IO_URING
+net::task<void> echo_connection_uring(net::tcp_stream client,
+                                      server_state &state) {
+  client.set_nodelay(true);
+  for (;;) {
+    auto received = co_await client.async_receive();
+    if (!received || received->empty() ||
+        !co_await client.async_write(received->data())) {
+      break;
+    }
+  }
+  state.finished();
+}
+#endif
+
+net::task<void> accept_loop(server_state &state, net::tcp_listener &listener,
+                            int connections, bool uring) {
+  for (int i = 0; i < connections; ++i) {
+    auto client = co_await listener.async_accept();
+    if (!client) {
+      break;
+    }
+
+    ++state.open;
+#ifdef WU_NET_IO_URING
+    if (uring) {
+      net::spawn(echo_connection_uring(std::move(*client), state));
+      continue;
+    }
+#endif
+    net::spawn(echo_connection(std::move(*client), state));
+  }
+  (void)uring;
+
+  state.accepting = false;
+  if (state.open == 0) {
+    state.loop.stop();
+  }
+}
+
+bool async_server(net::tcp_listener &listener, int connections, bool uring) {
+  auto loop = net::event_loop::create();
+  if (!loop) {
+    return false;
+  }
+
+#ifdef WU_NET_IO_URING
+  if (uring && !loop->enable_io_uring()) {
+    std::cerr << "io_uring is not available on this kernel\n";
+    return false;
+  }
+#endif
+
+  server_state state{*loop};
+  loop->spawn(accept_loop(state, listener, connections, uring));
+  loop->run();
+  return true;
+}
+
+// Each client connection sends `round_trips` fixed-size messages, one at a
+// time, and waits for each echo
+void run_clients(const std::string &address, int connections, int round_trips,
+                 std::atomic<bool> &ok) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < connections; ++i) {
+    threads.emplace_back([&, i] {
+      auto stream = net::tcp_stream::connect(address);
+      if (!stream) {
+        ok = false;
+        return;
+      }
+      stream->set_nodelay(true);
+
+      std::array<char, message_size> out, in;
+      for (int r = 0; r < round_trips; ++r) {
+        std::memset(out.data(), 'a' + (i + r) % 26, out.size());
+        stream->write(out.data(), out.size());
+        stream->flush();
+        if (!stream->read(in.data(), in.size()) || in != out) {
+          ok = false;
+          return;
+        }
+      }
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+void bench(std::string_view mode, int connections, int round_trips) {
+  auto listener = net::tcp_listener::create("127.0.0.1:0", 1024);
+  if (!listener) {
+    std::cerr << "Failed to create listener\n";
+    return;
+  }
+  auto address = listener->local_address().value_or("");
+
+  std::atomic<bool> ok = true;
+  auto start = std::chrono::steady_clock::now();
+
+  std::thread server([&] {
+    if (mode == "blocking") {
+      blocking_server(*listener, connections);
+    } else if (!async_server(*listener, connections, mode == "io_uring")) {
+      ok = false;
+    }
+  });
+
+  run_clients(address, connections, round_trips, ok);
+  server.join();
+
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double total = static_cast<double>(connections) * round_trips;
+
+  std::cout << mode << ": " << connections << " connections, "
+            << round_trips << " round trips each, " << elapsed.count()
+            << " s, " << static_cast<long long>(total / elapsed.count())
+            << " round trips/s" << (ok ? "" : " (ERRORS)") << '\n';
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int connections = argc > 1 ? std::atoi(argv[1]) : 64;
+  int round_trips = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+  bench("blocking", connections, round_trips);
+  bench("epoll", connections, round_trips);
+#ifdef WU_NET_IO_URING
+  bench("io_uring", connections, round_trips);
+#endif
+
+  return 0;
+}
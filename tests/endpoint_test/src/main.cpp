@@ -0,0 +1,217 @@
+#include <wu-net/net.hpp>
+
+#include <array>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// IPv6 text forms (RFC 4291 parsing, RFC 5952 output), endpoints and their
+// sockaddr conversions, and listening and connecting without resolution
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+// Parse `text` and format it back
+std::string canonical(std::string_view text) {
+  auto address = net::ipv6_address::from_str(text);
+  return address ? address->to_string() : "invalid";
+}
+
+bool ipv6_available() {
+  int fd = ::socket(AF_INET6, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+  sockaddr_in6 local = {};
+  local.sin6_family = AF_INET6;
+  local.sin6_addr = in6addr_loopback;
+  bool bound = ::bind(fd, reinterpret_cast<sockaddr *>(&local),
+                      sizeof(local)) == 0;
+  ::close(fd);
+  return bound;
+}
+
+// Listen on `address`, then connect to the port it was given both
+// blocking and through the event loop
+void connect_roundtrip(std::string_view address) {
+  auto listener = net::tcp_listener::create(address);
+  check(listener.has_value(), std::format("listen on {}", address));
+  if (!listener) {
+    return;
+  }
+
+  auto local = listener->local_endpoint();
+  check(local && local->port() != 0, "local_endpoint");
+  if (!local) {
+    return;
+  }
+  std::string target = local->to_string();
+  check(listener->local_address() == target, "local_address");
+
+  auto client = net::tcp_stream::connect(target, 1000);
+  auto server = listener->accept();
+  check(client && server, std::format("connect to {}", target));
+  if (client && server) {
+    check(client->remote_endpoint() == local, "remote_endpoint");
+    check(server->remote_endpoint() == client->local_endpoint(),
+          "peer endpoints match");
+  }
+
+  auto loop = net::event_loop::create();
+  bool connected = false;
+  auto run = [&](std::string text) -> net::task<void> {
+    auto stream = co_await net::tcp_stream::async_connect(std::move(text));
+    connected = stream && stream->remote_endpoint() == local;
+    loop->stop();
+  };
+  loop->spawn(run(target));
+  loop->run();
+  check(connected, std::format("async_connect to {}", target));
+  listener->accept();
+}
+
+} // namespace
+
+int main() {
+  // RFC 5952 section 4 output rules
+  check(canonical("2001:0db8:0000:0000:0000:0000:0000:0001") == "2001:db8::1",
+        "leading zeros dropped");
+  check(canonical("2001:DB8::AbCd") == "2001:db8::abcd", "lowercase");
+  check(canonical("2001:db8:0:1:1:1:1:1") == "2001:db8:0:1:1:1:1:1",
+        "single zero group not compressed");
+  check(canonical("2001:0:0:1:0:0:0:1") == "2001:0:0:1::1",
+        "longest run compressed");
+  check(canonical("2001:db8:0:0:1:0:0:1") == "2001:db8::1:0:0:1",
+        "first of equal runs compressed");
+  check(canonical("0:0:0:0:0:0:0:0") == "::", "unspecified");
+  check(canonical("0:0:0:0:0:0:0:1") == "::1", "loopback");
+  check(canonical("1:0:0:0:0:0:0:0") == "1::", "trailing run");
+  check(canonical("1::") == "1::", "trailing ::");
+  check(canonical("::ffff:c000:0280") == "::ffff:192.0.2.128",
+        "v4-mapped written dotted");
+  check(canonical("::192.0.2.128") == "::c000:280", "v4-compatible in hex");
+  check(canonical("1:2:3:4:5:6:1.2.3.4") == "1:2:3:4:5:6:102:304",
+        "full form with a dotted tail");
+  check(canonical("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff").size() ==
+            net::ipv6_address::max_string_size,
+        "max_string_size");
+  check(canonical(std::string_view("::1\0", 4)) == "::1", "trailing NUL");
+
+  // Malformed input
+  for (std::string_view bad :
+       {"", ":", ":::", "1:::2", "::1::", "1::2::3", "1:2:3:4:5:6:7",
+        "1:2:3:4:5:6:7:8:9", "1:2:3:4:5:6:7:8::", "::1:2:3:4:5:6:7:8",
+        "12345::", "g::", "1:", ":1", "1.2.3.4", "::1.2.3", "::1.2.3.256",
+        "1:2:3:4:5:6:7:1.2.3.4", "::1.2.3.4:5", "[::1]", "::1%eth0",
+        " ::1"}) {
+    check(!net::ipv6_address::from_str(bad),
+          std::format("rejects \"{}\"", bad));
+  }
+  check(net::ipv6_address::from_str("1:2:3:4:5:6:7::").has_value(),
+        ":: standing for one group");
+
+  // Random addresses survive a round trip, with runs of zeros likely
+  std::mt19937 rng(14);
+  for (int i = 0; i < 20000; ++i) {
+    std::array<std::uint16_t, 8> groups;
+    for (auto &group : groups) {
+      group = rng() % 3 == 0 ? 0 : static_cast<std::uint16_t>(rng());
+    }
+    net::ipv6_address address(groups);
+    if (net::ipv6_address::from_str(address.to_string()) != address) {
+      check(false, std::format("round trip of {}", address));
+      break;
+    }
+  }
+
+  auto mapped = net::ipv6_address::v4_mapped(net::ipv4_address(10, 1, 2, 3));
+  check(mapped.is_v4_mapped() &&
+            mapped.to_v4() == net::ipv4_address(10, 1, 2, 3),
+        "v4_mapped");
+  check(!net::ipv6_address::loopback.to_v4(), "to_v4 of a native address");
+  check(std::format("{}", net::ipv6_address::loopback) == "::1", "formatter");
+
+  char small[8];
+  auto result = mapped.to_chars(small, small + sizeof(small));
+  check(result.ec == std::errc::value_too_large, "to_chars overflow");
+
+  // Endpoints
+  auto v4 = net::endpoint::from_str("192.0.2.1:80");
+  check(v4 && v4->is_v4() && v4->port() == 80 &&
+            v4->v4() == net::ipv4_address(192, 0, 2, 1),
+        "v4 endpoint");
+  auto v6 = net::endpoint::from_str("[2001:db8::1]:443");
+  check(v6 && v6->is_v6() && v6->port() == 443 && v6->family() == AF_INET6,
+        "v6 endpoint");
+  check(v6 && v6->to_string() == "[2001:db8::1]:443", "v6 endpoint text");
+  check(std::format("{}", net::endpoint(net::ipv4_address::loopback, 8080)) ==
+            "127.0.0.1:8080",
+        "endpoint formatter");
+  check(net::endpoint().to_string() == "0.0.0.0:0", "default endpoint");
+  check(net::endpoint(net::ipv6_address(std::array<std::uint16_t, 8>{
+                          0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff,
+                          0xffff, 0xffff}),
+                      65535)
+                .to_string()
+                .size() == net::endpoint::max_string_size,
+        "endpoint max_string_size");
+  for (std::string_view bad :
+       {"192.0.2.1", "192.0.2.1:", "192.0.2.1:65536", "192.0.2.1:-1",
+        "192.0.2.1:80x", "::1:80", "[::1]80", "[::1]:", "[1.2.3.4]:80",
+        "localhost:80", "[::1:80"}) {
+    check(!net::endpoint::from_str(bad), std::format("rejects \"{}\"", bad));
+  }
+
+  for (const auto &ep : {*v4, *v6}) {
+    sockaddr_storage storage;
+    socklen_t length = ep.to_sockaddr(storage);
+    check(storage.ss_family == ep.family(), "sockaddr family");
+    check(net::endpoint::from_sockaddr(reinterpret_cast<sockaddr *>(&storage),
+                                       length) == ep,
+          std::format("sockaddr round trip of {}", ep));
+    check(!net::endpoint::from_sockaddr(
+              reinterpret_cast<sockaddr *>(&storage), length - 1),
+          "short sockaddr rejected");
+  }
+
+  // host:port splitting for names and literals
+  auto parts = net::detail::split_host_port("[fe80::1]:22");
+  check(parts && parts->first == "fe80::1" && parts->second == "22",
+        "split bracketed");
+  parts = net::detail::split_host_port("example.com:http");
+  check(parts && parts->first == "example.com" && parts->second == "http",
+        "split name");
+  check(!net::detail::split_host_port("fe80::1:22"), "unbracketed v6 refused");
+
+  connect_roundtrip("127.0.0.1:0");
+  check(net::tcp_listener::create(net::endpoint(net::ipv4_address::loopback,
+                                                0))
+            .has_value(),
+        "listen on an endpoint");
+  if (ipv6_available()) {
+    connect_roundtrip("[::1]:0");
+  } else {
+    std::cout << "IPv6 unavailable, skipping [::1]\n";
+  }
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include <wu-net/net.hpp>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Serves many echo clients from a single thread using the event loop
+int main() {
+  constexpr int client_count = 64;
+
+  auto loop = net::event_loop::create();
+  if (!loop) {
+    std::cerr << "Failed to create event loop\n";
+    return 1;
+  }
+
+  auto listener = net::tcp_listener::create("127.0.0.1:0", 128);
+  if (!listener || !listener->set_nonblocking(true)) {
+    std::cerr << "Failed to create listener\n";
+    return 1;
+  }
+
+  auto address = listener->local_address();
+  if (!address) {
+    std::cerr << "Failed to get listener address\n";
+    return 1;
+  }
+
+  std::unordered_map<int, net::tcp_stream> clients;
+  int closed = 0;
+
+  auto on_readable = [&](int fd, net::io_event events) {
+    auto &client = clients.at(fd);
+    std::string line;
+
+    // Drain everything the socket has before waiting for the next edge
+    while (std::getline(client, line)) {
+      client << line << '\n';
+    }
+
+    bool pending = client.would_block();
+    client.clear();
+    client.flush();
+
+    if (!pending || net::has_event(events, net::io_event::error)) {
+      loop->remove(fd);
+      clients.erase(fd);
+      if (++closed == client_count) {
+        loop->stop();
+      }
+    }
+  };
+
+  loop->add(*listener, net::io_event::readable, [&](net::io_event) {
+    while (auto client = listener->accept()) {
+      int fd = client->native_handle();
+      client->set_nonblocking(true);
+      clients.emplace(fd, std::move(*client));
+      loop->add(fd, net::io_event::readable | net::io_event::hangup,
+                [&, fd](net::io_event events) { on_readable(fd, events); });
+    }
+  });
+
+  bool client_ok = true;
+  std::thread client_thread([&] {
+    std::vector<net::tcp_stream> streams;
+    for (int i = 0; i < client_count; ++i) {
+      auto stream = net::tcp_stream::connect(*address);
+      if (!stream) {
+        client_ok = false;
+        return;
+      }
+      streams.push_back(std::move(*stream));
+    }
+
+    for (int i = 0; i < client_count; ++i) {
+      streams[i] << "hello " << i << '\n' << std::flush;
+    }
+
+    for (int i = 0; i < client_count; ++i) {
+      std::string line;
+      if (!std::getline(streams[i], line) ||
+          line != "hello " + std::to_string(i)) {
+        client_ok = false;
+      }
+    }
+  });
+
+  loop->run();
+  client_thread.join();
+
+  if (!client_ok || closed != client_count) {
+    std::cerr << "Echo mismatch\n";
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
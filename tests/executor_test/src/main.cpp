@@ -0,0 +1,227 @@
+#include <wu-net/net.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// The Chase-Lev deque under concurrent thieves, then executor posts,
+// nested work, and coroutines moving between an event loop and the pool
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+void deque_owner() {
+  net::detail::chase_lev_deque<std::uintptr_t> deque(4);
+  check(deque.empty() && !deque.pop() && !deque.steal(), "starts empty");
+
+  // Grows past its initial capacity
+  for (std::uintptr_t i = 1; i <= 100; ++i) {
+    deque.push(i);
+  }
+  check(deque.steal() == 1u, "steal takes the oldest");
+  check(deque.pop() == 100u, "pop takes the newest");
+
+  std::uintptr_t sum = 0;
+  while (auto value = deque.pop()) {
+    sum += *value;
+  }
+  check(sum == 5050 - 1 - 100, "everything else popped");
+  check(deque.empty(), "drained");
+}
+
+// Every item is taken exactly once while the owner pushes and pops and
+// thieves steal
+void deque_thieves() {
+  constexpr std::uintptr_t items = 200000;
+  constexpr int thieves = 3;
+  net::detail::chase_lev_deque<std::uintptr_t> deque(16);
+  std::vector<std::atomic<int>> taken(items + 1);
+  std::atomic<std::uintptr_t> total{0};
+  std::atomic<bool> done{false};
+
+  auto take = [&](std::uintptr_t value) {
+    taken[value].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < thieves; ++i) {
+    threads.emplace_back([&] {
+      while (!done.load()) {
+        if (auto value = deque.steal()) {
+          take(*value);
+        }
+      }
+    });
+  }
+
+  for (std::uintptr_t i = 1; i <= items; ++i) {
+    deque.push(i);
+    if (i % 3 == 0) {
+      if (auto value = deque.pop()) {
+        take(*value);
+      }
+    }
+  }
+  while (auto value = deque.pop()) {
+    take(*value);
+  }
+  while (total.load() < items) {
+    std::this_thread::yield();
+  }
+  done = true;
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  bool once = true;
+  for (std::uintptr_t i = 1; i <= items; ++i) {
+    once &= taken[i].load() == 1;
+  }
+  check(once, "each item taken once");
+}
+
+void posts() {
+  std::atomic<int> count{0};
+  {
+    net::executor pool({.threads = 3});
+    check(pool.size() == 3, "size");
+    for (int i = 0; i < 10000; ++i) {
+      pool.post([&] { count.fetch_add(1, std::memory_order_relaxed); });
+    }
+  } // Runs what is queued before joining
+  check(count == 10000, "every post ran");
+}
+
+// Posts from outside the pool are spread over the workers' inboxes; an
+// idle worker empties the inbox of a busy one
+void inboxes() {
+  net::executor pool({.threads = 2});
+  std::atomic<bool> busy{false};
+  std::atomic<bool> release{false};
+  std::atomic<int> count{0};
+  pool.post([&] {
+    busy = true;
+    while (!release.load()) {
+      std::this_thread::yield();
+    }
+  });
+  while (!busy.load()) {
+    std::this_thread::yield();
+  }
+
+  for (int i = 0; i < 100; ++i) {
+    pool.post([&] { ++count; });
+  }
+  auto until = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (count.load() < 100 && std::chrono::steady_clock::now() < until) {
+    std::this_thread::yield();
+  }
+  check(count == 100, "posts ran while a worker was busy");
+  release = true;
+}
+
+// Work posted from a worker lands on its own deque and gets stolen
+void nested() {
+  std::atomic<int> count{0};
+  {
+    net::executor pool({.threads = 4, .spin = std::chrono::nanoseconds(0)});
+    for (int i = 0; i < 10; ++i) {
+      pool.post([&] {
+        check(net::executor::current() != nullptr, "on a worker");
+        for (int j = 0; j < 1000; ++j) {
+          net::executor::current()->post([&] { ++count; });
+        }
+      });
+    }
+  }
+  check(count == 10000, "nested posts ran");
+}
+
+net::task<void> hop(net::executor &pool, net::event_loop &loop,
+                    std::thread::id loop_thread, bool &ok) {
+  auto result = co_await pool.run([&] {
+    return std::this_thread::get_id() != loop_thread ? 42 : -1;
+  });
+  bool back_on_loop = std::this_thread::get_id() == loop_thread &&
+                      net::event_loop::current() == &loop;
+
+  bool threw = false;
+  try {
+    co_await pool.run([] { throw std::runtime_error("compress failed"); });
+  } catch (const std::runtime_error &) {
+    threw = std::this_thread::get_id() == loop_thread;
+  }
+
+  co_await pool.schedule();
+  bool on_pool = net::executor::current() == &pool;
+  co_await loop.schedule();
+  bool returned = net::event_loop::current() == &loop;
+
+  ok = result == 42 && back_on_loop && threw && on_pool && returned;
+  loop.stop();
+}
+
+void coroutines() {
+  net::executor pool({.threads = 2});
+  auto loop = net::event_loop::create();
+  bool ok = false;
+
+  // Keeps run() going while the coroutine is off the loop
+  auto guard = loop->add_timer(std::chrono::seconds(10), [] {});
+  loop->spawn(hop(pool, *loop, std::this_thread::get_id(), ok));
+  loop->run();
+  loop->cancel_timer(guard);
+  check(ok, "run on the pool and resume on the loop");
+}
+
+// A loop stays responsive while the pool is busy
+void responsive() {
+  net::executor pool({.threads = 1});
+  auto loop = net::event_loop::create();
+  std::atomic<bool> release{false};
+  bool ticked = false;
+
+  pool.post([&] {
+    while (!release.load()) {
+      std::this_thread::yield();
+    }
+  });
+  loop->add_timer(std::chrono::milliseconds(5), [&] {
+    ticked = true;
+    release = true;
+  });
+  loop->run();
+  check(ticked, "loop ran while the pool was busy");
+}
+
+} // namespace
+
+int main() {
+  deque_owner();
+  deque_thieves();
+  posts();
+  inboxes();
+  nested();
+  coroutines();
+  responsive();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
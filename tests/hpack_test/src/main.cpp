@@ -0,0 +1,274 @@
+#include <wu-net/net.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// HPACK against the examples of RFC 7541 Appendix C, Huffman coding of
+// every octet, encoder round trips, and malformed blocks
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+std::string from_hex(std::string_view hex) {
+  std::string out;
+  int high = -1;
+  for (char c : hex) {
+    int digit = c >= '0' && c <= '9'   ? c - '0'
+                : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                                       : -1;
+    if (digit < 0) {
+      continue;
+    }
+    if (high < 0) {
+      high = digit;
+    } else {
+      out.push_back(static_cast<char>(high * 16 + digit));
+      high = -1;
+    }
+  }
+  return out;
+}
+
+std::span<const std::byte> bytes(std::string_view text) {
+  return std::as_bytes(std::span(text.data(), text.size()));
+}
+
+using fields = std::vector<std::pair<std::string_view, std::string_view>>;
+
+// Decode one block and compare it with `expected` and the table size
+void expect_block(net::hpack_decoder &decoder, std::string_view hex,
+                  const fields &expected, std::size_t table_size,
+                  std::string_view what) {
+  net::hpack_header_list list;
+  std::string block = from_hex(hex);
+  auto decoded = decoder.decode(bytes(block), list);
+  bool same = decoded.has_value() && list.size() == expected.size();
+  for (std::size_t i = 0; same && i < list.size(); ++i) {
+    same = list[i].name == expected[i].first &&
+           list[i].value == expected[i].second;
+  }
+  check(same, what);
+  check(decoder.table().size() == table_size, what);
+}
+
+void requests() {
+  for (bool huffman : {false, true}) {
+    net::hpack_decoder decoder;
+    expect_block(decoder,
+                 huffman ? "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"
+                         : "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 "
+                           "6f6d",
+                 {{":method", "GET"},
+                  {":scheme", "http"},
+                  {":path", "/"},
+                  {":authority", "www.example.com"}},
+                 57, "first request");
+    expect_block(decoder,
+                 huffman ? "8286 84be 5886 a8eb 1064 9cbf"
+                         : "8286 84be 5808 6e6f 2d63 6163 6865",
+                 {{":method", "GET"},
+                  {":scheme", "http"},
+                  {":path", "/"},
+                  {":authority", "www.example.com"},
+                  {"cache-control", "no-cache"}},
+                 110, "second request");
+    expect_block(decoder,
+                 huffman ? "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 "
+                           "e95b b8e8 b4bf"
+                         : "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 "
+                           "7573 746f 6d2d 7661 6c75 65",
+                 {{":method", "GET"},
+                  {":scheme", "https"},
+                  {":path", "/index.html"},
+                  {":authority", "www.example.com"},
+                  {"custom-key", "custom-value"}},
+                 164, "third request");
+  }
+}
+
+// Eviction with a 256 octet table
+void responses() {
+  for (bool huffman : {false, true}) {
+    net::hpack_decoder decoder(256);
+    expect_block(
+        decoder,
+        huffman ? "4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 "
+                  "2005 9504 0b81 66e0 82a6 2d1b ff6e 919d 29ad 1718 63c7 "
+                  "8f0b 97c8 e9ae 82ae 43d3"
+                : "4803 3330 3258 0770 7269 7661 7465 611d 4d6f 6e2c 2032 "
+                  "3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3120 474d "
+                  "546e 1768 7474 7073 3a2f 2f77 7777 2e65 7861 6d70 6c65 "
+                  "2e63 6f6d",
+        {{":status", "302"},
+         {"cache-control", "private"},
+         {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+         {"location", "https://www.example.com"}},
+        222, "first response");
+    expect_block(decoder,
+                 huffman ? "4883 640e ffc1 c0bf" : "4803 3330 37c1 c0bf",
+                 {{":status", "307"},
+                  {"cache-control", "private"},
+                  {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+                  {"location", "https://www.example.com"}},
+                 222, "second response");
+    expect_block(
+        decoder,
+        huffman ? "88c1 6196 d07a be94 1054 d444 a820 0595 040b 8166 e084 "
+                  "a62d 1bff c05a 839b d9ab 77ad 94e7 821d d7f2 e6c7 b335 "
+                  "dfdf cd5b 3960 d5af 2708 7f36 72c1 ab27 0fb5 291f 9587 "
+                  "3160 65c0 03ed 4ee5 b106 3d50 07"
+                : "88c1 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 "
+                  "303a 3133 3a32 3220 474d 54c0 5a04 677a 6970 7738 666f "
+                  "6f3d 4153 444a 4b48 514b 425a 584f 5157 454f 5049 5541 "
+                  "5851 5745 4f49 553b 206d 6178 2d61 6765 3d33 3630 303b "
+                  "2076 6572 7369 6f6e 3d31",
+        {{":status", "200"},
+         {"cache-control", "private"},
+         {"date", "Mon, 21 Oct 2013 20:13:22 GMT"},
+         {"location", "https://www.example.com"},
+         {"content-encoding", "gzip"},
+         {"set-cookie",
+          "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}},
+        215, "third response");
+  }
+}
+
+void huffman() {
+  std::string all;
+  for (int c = 0; c < 256; ++c) {
+    all.push_back(static_cast<char>(c));
+  }
+  std::string coded;
+  net::detail::huffman_encode(all, coded);
+  check(coded.size() == net::detail::huffman_size(all), "coded size");
+
+  std::string decoded;
+  auto data = std::span(reinterpret_cast<const std::uint8_t *>(coded.data()),
+                        coded.size());
+  check(net::detail::huffman_decode(data, decoded) && decoded == all,
+        "every octet round trips");
+
+  // Padding must be a prefix of EOS no longer than seven bits
+  std::string text;
+  const std::uint8_t zero_padding[] = {0x00}; // "0" then 000 padding
+  check(!net::detail::huffman_decode(zero_padding, text), "zero padding");
+  const std::uint8_t long_padding[] = {0x1f, 0xff}; // "0" then 11 ones
+  text.clear();
+  check(!net::detail::huffman_decode(long_padding, text), "long padding");
+  const std::uint8_t eos[] = {0xff, 0xff, 0xff, 0xff};
+  text.clear();
+  check(!net::detail::huffman_decode(eos, text), "EOS");
+}
+
+void encoder() {
+  net::hpack_encoder encoder;
+  net::hpack_decoder decoder;
+  fields sent = {{":status", "200"},
+                 {"content-type", "application/grpc"},
+                 {"x-trace", "abc123"},
+                 {"set-cookie", "secret=1"},
+                 {"content-length", "42"}};
+
+  std::size_t second_size = 0;
+  for (int round = 0; round < 2; ++round) {
+    std::string block;
+    encoder.begin_block(block);
+    for (auto &[name, value] : sent) {
+      encoder.encode(name, value, block);
+    }
+    if (round == 1) {
+      second_size = block.size();
+    }
+
+    net::hpack_header_list list;
+    bool same = decoder.decode(bytes(block), list).has_value() &&
+                list.size() == sent.size();
+    for (std::size_t i = 0; same && i < list.size(); ++i) {
+      same = list[i].name == sent[i].first && list[i].value == sent[i].second;
+    }
+    check(same, "encoder round trip");
+  }
+  // Everything but the never-indexed cookie is one octet the second time
+  check(second_size < 16, "repeated fields indexed");
+
+  // A smaller table from the peer is announced in the next block
+  encoder.set_max_table_size(0);
+  std::string block;
+  encoder.begin_block(block);
+  encoder.encode("x-trace", "abc123", block);
+  net::hpack_header_list list;
+  check(decoder.decode(bytes(block), list).has_value() &&
+            decoder.table().max_size() == 0 && decoder.table().count() == 0,
+        "table size update");
+}
+
+void malformed() {
+  const char *blocks[] = {
+      "80",             // Index 0
+      "be",             // Dynamic entry that does not exist
+      "3fe21f",         // Size update beyond the limit
+      "82 20",          // Size update after a field
+      "ff",             // Truncated integer
+      "ffffffffff0f",   // Integer overflow
+      "0085 f2b2 4a87", // Name longer than the block
+      "4081 ff81 00",   // Huffman padding longer than 7 bits
+  };
+  for (const char *hex : blocks) {
+    net::hpack_decoder decoder;
+    net::hpack_header_list list;
+    std::string block = from_hex(hex);
+    auto result = decoder.decode(bytes(block), list);
+    check(!result && result.error() == net::make_error_code(
+                                           net::http2_error::compression_error),
+          hex);
+    check(list.empty(), "nothing left from a failed block");
+  }
+}
+
+// Indexed references to a large dynamic entry expand a block a thousand
+// times over; decoding stops at the list size limit
+void bomb() {
+  net::hpack_decoder decoder;
+  net::hpack_header_list list;
+  std::string block = from_hex("4001787fa11e") + std::string(4000, 'a');
+  check(decoder.decode(bytes(block), list, 65536).has_value() &&
+            list.size() == 1 && list[0].value.size() == 4000,
+        "large entry indexed");
+
+  block.assign(16384, '\xbe');
+  auto result = decoder.decode(bytes(block), list, 65536);
+  check(!result && result.error() == net::make_error_code(
+                                         net::http2_error::compression_error),
+        "list size limit");
+  check(list.size() == 1 && list[0].value.size() == 4000,
+        "expansion dropped");
+}
+
+} // namespace
+
+int main() {
+  requests();
+  responses();
+  huffman();
+  encoder();
+  malformed();
+  bomb();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
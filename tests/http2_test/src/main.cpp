@@ -0,0 +1,568 @@
+#include <wu-net/net.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+
+// http2_connection driven frame by frame (requests, CONTINUATION, flow
+// control, priorities and errors), then h2c against http_server by prior
+// knowledge and by Upgrade
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+using net::http2_flags;
+using net::http2_frame_type;
+
+void handle(const net::http_request &request, net::http_response &response) {
+  if (request.path() == "/hello") {
+    response.add_header("Content-Type", "text/plain");
+    response.add_header("Connection", "keep-alive"); // Dropped for h2
+    response.set_body_view("Hello, World!");
+  } else if (request.path() == "/echo") {
+    response.set_body(std::string(request.body()));
+  } else if (request.path() == "/big") {
+    response.set_body(std::string(100000, 'x'));
+  } else if (request.path() == "/host") {
+    response.set_body(std::string(request.host()));
+  } else {
+    response.set_status(404);
+  }
+}
+
+std::string frame(http2_frame_type type, std::uint8_t flags, std::uint32_t id,
+                  std::string_view payload) {
+  std::string out(net::http2_frame_header::size, '\0');
+  net::http2_frame_header{static_cast<std::uint32_t>(payload.size()), type,
+                          flags, id}
+      .serialize(out.data());
+  out += payload;
+  return out;
+}
+
+std::string u32(std::uint32_t value) {
+  std::string out;
+  net::detail::put_u32(out, value);
+  return out;
+}
+
+std::string setting(net::http2_setting id, std::uint32_t value) {
+  return std::string(1, '\0') + static_cast<char>(id) + u32(value);
+}
+
+std::string request_block(net::hpack_encoder &encoder, std::string_view method,
+                          std::string_view path) {
+  std::string block;
+  encoder.begin_block(block);
+  encoder.encode(":method", method, block);
+  encoder.encode(":scheme", "http", block);
+  encoder.encode(":path", path, block);
+  encoder.encode(":authority", "example.com", block);
+  return block;
+}
+
+struct frame_view {
+  net::http2_frame_header header;
+  std::string payload;
+  std::vector<std::pair<std::string, std::string>> fields; // HEADERS
+};
+
+std::string field(const frame_view *f, std::string_view name) {
+  if (f != nullptr) {
+    for (const auto &[n, value] : f->fields) {
+      if (n == name) {
+        return value;
+      }
+    }
+  }
+  return {};
+}
+
+// A client's view of the connection: what it sent, and the frames back
+class peer {
+public:
+  explicit peer(net::http2_options options = {})
+      : connection(handler, options, 1 << 16) {}
+
+  void send(std::string_view bytes) {
+    pending += bytes;
+    std::size_t used = connection.receive(pending);
+    pending.erase(0, used);
+  }
+
+  // Flush and parse everything the server has to send
+  std::vector<frame_view> collect() {
+    std::vector<frame_view> frames;
+    std::vector<iovec> iov;
+    while (connection.flush(iov)) {
+      for (const iovec &v : iov) {
+        output.append(static_cast<const char *>(v.iov_base), v.iov_len);
+      }
+      iov.clear();
+      connection.written();
+    }
+    while (output.size() >= net::http2_frame_header::size) {
+      auto header = net::http2_frame_header::parse(output.data());
+      if (output.size() < net::http2_frame_header::size + header.length) {
+        break;
+      }
+      frame_view f{header,
+                   output.substr(net::http2_frame_header::size, header.length),
+                   {}};
+      output.erase(0, net::http2_frame_header::size + header.length);
+
+      // Every block, in order, to keep the table in step
+      if (header.type == http2_frame_type::headers) {
+        net::hpack_header_list list;
+        auto block = std::as_bytes(std::span(f.payload));
+        if (decoder.decode(block, list)) {
+          for (std::size_t i = 0; i < list.size(); ++i) {
+            f.fields.emplace_back(list[i].name, list[i].value);
+          }
+        }
+      }
+      frames.push_back(std::move(f));
+    }
+    return frames;
+  }
+
+  net::http2_connection::handler handler = handle;
+  net::http2_connection connection;
+  net::hpack_encoder encoder;
+  net::hpack_decoder decoder;
+  std::string pending;
+  std::string output;
+};
+
+std::string preface_and_settings(std::string settings = {}) {
+  return std::string(net::http2_preface) +
+         frame(http2_frame_type::settings, 0, 0, settings);
+}
+
+const frame_view *find(const std::vector<frame_view> &frames,
+                       http2_frame_type type, std::uint32_t id = 0) {
+  for (const auto &f : frames) {
+    if (f.header.type == type && f.header.stream_id == id) {
+      return &f;
+    }
+  }
+  return nullptr;
+}
+
+std::string body_of(const std::vector<frame_view> &frames, std::uint32_t id) {
+  std::string body;
+  for (const auto &f : frames) {
+    if (f.header.type == http2_frame_type::data && f.header.stream_id == id) {
+      body += f.payload;
+    }
+  }
+  return body;
+}
+
+void frame_header() {
+  char bytes[9];
+  net::http2_frame_header{0x123456, http2_frame_type::headers, 0x25,
+                          0x7fffffff}
+      .serialize(bytes);
+  auto parsed = net::http2_frame_header::parse(bytes);
+  check(parsed.length == 0x123456 &&
+            parsed.type == http2_frame_type::headers && parsed.flags == 0x25 &&
+            parsed.stream_id == 0x7fffffff,
+        "frame header round trip");
+
+  std::string decoded;
+  check(net::detail::base64url_decode("AAMAAABkAAQAAP__", decoded) &&
+            decoded == std::string("\0\3\0\0\0\x64\0\4\0\0\xff\xff", 12),
+        "base64url");
+}
+
+void requests() {
+  peer client;
+  client.send(preface_and_settings());
+  auto frames = client.collect();
+  check(!frames.empty() && frames[0].header.type == http2_frame_type::settings,
+        "server preface");
+  check(find(frames, http2_frame_type::window_update) != nullptr,
+        "connection window raised");
+  bool acked = false;
+  for (const auto &f : frames) {
+    acked |= f.header.type == http2_frame_type::settings &&
+             f.header.flags == http2_flags::ack;
+  }
+  check(acked, "settings acknowledged");
+
+  // GET in one HEADERS frame
+  client.send(frame(http2_frame_type::headers,
+                    http2_flags::end_headers | http2_flags::end_stream, 1,
+                    request_block(client.encoder, "GET", "/hello")));
+  frames = client.collect();
+  const frame_view *headers = find(frames, http2_frame_type::headers, 1);
+  check(field(headers, ":status") == "200", "status");
+  check(body_of(frames, 1) == "Hello, World!", "body");
+  check(!frames.empty() &&
+            (frames.back().header.flags & http2_flags::end_stream),
+        "stream ended");
+
+  // Header block split over CONTINUATION, body over two DATA frames, and
+  // the stream 3 request interleaved with stream 5
+  std::string block = request_block(client.encoder, "POST", "/echo");
+  client.send(frame(http2_frame_type::headers, 0, 3, block.substr(0, 4)));
+  client.send(frame(http2_frame_type::continuation, http2_flags::end_headers,
+                    3, block.substr(4)));
+  client.send(frame(http2_frame_type::data, 0, 3, "hello "));
+  client.send(frame(http2_frame_type::headers,
+                    http2_flags::end_headers | http2_flags::end_stream, 5,
+                    request_block(client.encoder, "GET", "/host")));
+  // Padded, with five octets of padding
+  client.send(frame(http2_frame_type::data,
+                    http2_flags::end_stream | http2_flags::padded, 3,
+                    std::string("\5world") + std::string(5, '\0')));
+  frames = client.collect();
+  check(body_of(frames, 3) == "hello world", "echoed body");
+  check(body_of(frames, 5) == "example.com", ":authority as host");
+  check(client.connection.open_streams() == 0, "streams closed");
+
+  // HEAD gets the headers only, and unknown paths their status
+  client.send(frame(http2_frame_type::headers,
+                    http2_flags::end_headers | http2_flags::end_stream, 7,
+                    request_block(client.encoder, "HEAD", "/hello")));
+  client.send(frame(http2_frame_type::headers,
+                    http2_flags::end_headers | http2_flags::end_stream, 9,
+                    request_block(client.encoder, "GET", "/missing")));
+  frames = client.collect();
+  headers = find(frames, http2_frame_type::headers, 7);
+  check(headers && (headers->header.flags & http2_flags::end_stream) &&
+            field(headers, "content-length") == "13" &&
+            body_of(frames, 7).empty(),
+        "HEAD");
+  headers = find(frames, http2_frame_type::headers, 9);
+  check(field(headers, ":status") == "404", "404");
+
+  // PING is answered; a GOAWAY closes once nothing is left
+  client.send(frame(http2_frame_type::ping, 0, 0, "12345678"));
+  frames = client.collect();
+  const frame_view *ping = find(frames, http2_frame_type::ping);
+  check(ping && ping->header.flags == http2_flags::ack &&
+            ping->payload == "12345678",
+        "ping");
+  client.send(frame(http2_frame_type::goaway, 0, 0, u32(9) + u32(0)));
+  check(client.connection.closed(), "closed after GOAWAY");
+}
+
+// The HPACK table size is advertised, and holds once acknowledged
+void header_table() {
+  peer client({.header_table_size = 256});
+  client.send(preface_and_settings());
+  auto frames = client.collect();
+  check(!frames.empty() &&
+            frames[0].payload.find(setting(
+                net::http2_setting::header_table_size, 256)) !=
+                std::string::npos,
+        "table size advertised");
+
+  // Before the ACK the peer may still use the default size
+  client.send(frame(http2_frame_type::headers,
+                    http2_flags::end_headers | http2_flags::end_stream, 1,
+                    request_block(client.encoder, "GET", "/hello")));
+  frames = client.collect();
+  check(body_of(frames, 1) == "Hello, World!", "default table before ACK");
+
+  // After it, the next block has to shrink the table
+  client.send(frame(http2_frame_type::settings, http2_flags::ack, 0, {}));
+  client.encoder.set_max_table_size(256);
+  client.send(frame(http2_frame_type::headers,
+                    http2_flags::end_headers | http2_flags::end_stream, 3,
+                    request_block(client.encoder, "GET", "/hello")));
+  frames = client.collect();
+  check(body_of(frames, 3) == "Hello, World!", "table shrunk");
+
+  peer stale({.header_table_size = 256});
+  stale.send(preface_and_settings() +
+             frame(http2_frame_type::settings, http2_flags::ack, 0, {}) +
+             frame(http2_frame_type::headers,
+                   http2_flags::end_headers | http2_flags::end_stream, 1,
+                   request_block(stale.encoder, "GET", "/hello")));
+  frames = stale.collect();
+  check(find(frames, http2_frame_type::goaway) != nullptr &&
+            stale.connection.closed(),
+        "size update required");
+}
+
+// A table larger than 4096 is only used once the peer allows it
+void large_header_table() {
+  peer client({.header_table_size = 65536});
+  client.send(preface_and_settings());
+  client.collect();
+
+  // Enough distinct content-lengths to overflow a 4096 octet table, then
+  // the same again, which the server must not refer back to
+  bool decoded = true;
+  std::uint32_t id = 1;
+  for (int round = 0; round < 2; ++round) {
+    for (std::size_t size = 1; size <= 150; ++size, id += 2) {
+      client.send(frame(http2_frame_type::headers, http2_flags::end_headers,
+                        id, request_block(client.encoder, "POST", "/echo")));
+      client.send(frame(http2_frame_type::data, http2_flags::end_stream, id,
+                        std::string(size, 'x')));
+      auto frames = client.collect();
+      decoded &= field(find(frames, http2_frame_type::headers, id),
+                       "content-length") == std::to_string(size);
+    }
+  }
+  check(decoded, "default table size until the peer sets one");
+}
+
+// The response is held to the windows the client grants
+void flow_control() {
+  peer client;
+  client.send(preface_and_settings(
+      setting(net::http2_setting::initial_window_size, 1000)));
+  client.send(frame(http2_frame_type::headers,
+                    http2_flags::end_headers | http2_flags::end_stream, 1,
+                    request_block(client.encoder, "GET", "/big")));
+  auto frames = client.collect();
+  check(body_of(frames, 1).size() == 1000, "stream window");
+
+  // More stream window, but the connection window is 65535
+  client.send(frame(http2_frame_type::window_update, 0, 1, u32(200000)));
+  frames = client.collect();
+  check(body_of(frames, 1).size() == 65535 - 1000, "connection window");
+
+  client.send(frame(http2_frame_type::window_update, 0, 0, u32(200000)));
+  frames = client.collect();
+  check(body_of(frames, 1).size() == 100000 - 65535, "rest of the body");
+  check(client.connection.open_streams() == 0, "stream finished");
+
+  // Growing a window past 2^31 - 1
+  client.send(frame(http2_frame_type::window_update, 0, 0, u32(0x7fffffff)));
+  frames = client.collect();
+  const frame_view *goaway = find(frames, http2_frame_type::goaway);
+  check(goaway && goaway->payload.substr(4) == u32(3), "flow control error");
+}
+
+// A stream of weight 256 gets most of the window over one of weight 1
+void priorities() {
+  peer client;
+  client.send(preface_and_settings(
+      setting(net::http2_setting::initial_window_size, 200000)));
+  client.send(frame(http2_frame_type::window_update, 0, 0,
+                    u32(150000 - 65535)));
+  client.collect();
+
+  auto request = [&](std::uint32_t id, int weight) {
+    std::string payload = u32(0) + static_cast<char>(weight - 1) +
+                          request_block(client.encoder, "GET", "/big");
+    client.send(frame(http2_frame_type::headers,
+                      http2_flags::end_headers | http2_flags::end_stream |
+                          http2_flags::priority,
+                      id, payload));
+  };
+  request(1, 1);
+  request(3, 256);
+
+  auto frames = client.collect();
+  std::size_t light = body_of(frames, 1).size();
+  std::size_t heavy = body_of(frames, 3).size();
+  check(light + heavy == 150000, "connection window used");
+  check(heavy == 100000 && light == 50000, "weighted by priority");
+}
+
+std::string error_after(std::string_view bytes) {
+  peer client;
+  client.send(preface_and_settings());
+  client.collect();
+  client.send(bytes);
+  auto frames = client.collect();
+  const frame_view *goaway = find(frames, http2_frame_type::goaway);
+  if (goaway == nullptr || !client.connection.closed()) {
+    const frame_view *reset = nullptr;
+    for (const auto &f : frames) {
+      if (f.header.type == http2_frame_type::rst_stream) {
+        reset = &f;
+      }
+    }
+    return reset ? "reset " + std::to_string(net::detail::get_u32(
+                                  reset->payload.data()))
+                 : "none";
+  }
+  return "goaway " +
+         std::to_string(net::detail::get_u32(goaway->payload.data() + 4));
+}
+
+void errors() {
+  {
+    peer client;
+    client.send("GET / HTTP/1.1\r\n\r\n");
+    auto frames = client.collect();
+    check(find(frames, http2_frame_type::goaway) != nullptr &&
+              client.connection.closed(),
+          "bad preface");
+  }
+
+  net::hpack_encoder encoder;
+  std::string get = request_block(encoder, "GET", "/hello");
+  auto headers = [&](std::uint32_t id, std::uint8_t flags) {
+    return frame(http2_frame_type::headers,
+                 flags | http2_flags::end_headers | http2_flags::end_stream,
+                 id, get);
+  };
+
+  check(error_after(frame(http2_frame_type::data, 0, 0, "x")) == "goaway 1",
+        "DATA on stream 0");
+  check(error_after(headers(2, 0)) == "goaway 1", "even stream");
+  check(error_after(frame(http2_frame_type::push_promise, 0, 1, u32(2))) ==
+            "goaway 1",
+        "PUSH_PROMISE");
+  check(error_after(frame(http2_frame_type::ping, 0, 0, "1234")) == "goaway 6",
+        "short PING");
+  check(error_after(frame(http2_frame_type::headers, 0, 1, "\x82") +
+                    frame(http2_frame_type::ping, 0, 0, "12345678")) ==
+            "goaway 1",
+        "frame between HEADERS and CONTINUATION");
+  check(error_after(frame(http2_frame_type::headers,
+                          http2_flags::end_headers, 1, "\xbf")) == "goaway 9",
+        "bad header block");
+  check(error_after(frame(http2_frame_type::settings, 0, 0,
+                          setting(net::http2_setting::max_frame_size, 100))) ==
+            "goaway 1",
+        "bad max frame size");
+  check(error_after(std::string(9, '\xff')) == "goaway 6", "oversized frame");
+
+  // Stream errors
+  check(error_after(frame(http2_frame_type::priority, 0, 1,
+                          u32(1) + std::string(1, '\0'))) == "reset 1",
+        "self-dependent stream");
+  std::string uppercase;
+  encoder.begin_block(uppercase);
+  encoder.encode(":method", "GET", uppercase);
+  encoder.encode(":scheme", "http", uppercase);
+  encoder.encode(":path", "/", uppercase);
+  encoder.encode("X-Upper", "1", uppercase);
+  check(error_after(frame(http2_frame_type::headers,
+                          http2_flags::end_headers | http2_flags::end_stream,
+                          1, uppercase)) == "reset 1",
+        "uppercase field name");
+
+  // Streams past the limit are refused
+  peer client({.max_concurrent_streams = 1});
+  client.send(preface_and_settings());
+  client.send(frame(http2_frame_type::headers, http2_flags::end_headers, 1,
+                    request_block(client.encoder, "POST", "/echo")));
+  client.send(frame(http2_frame_type::headers, http2_flags::end_headers, 3,
+                    request_block(client.encoder, "POST", "/echo")));
+  auto frames = client.collect();
+  const frame_view *reset = find(frames, http2_frame_type::rst_stream, 3);
+  check(reset && net::detail::get_u32(reset->payload.data()) == 7, "refused");
+}
+
+// Send `bytes` and read until the server closes
+std::string round_trip(const std::string &address, std::string_view bytes) {
+  auto stream = net::tcp_stream::connect(address);
+  if (!stream) {
+    return {};
+  }
+  stream->write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  stream->flush();
+
+  std::string reply;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = ::recv(stream->native_handle(), buffer, sizeof(buffer), 0)) > 0) {
+    reply.append(buffer, static_cast<std::size_t>(n));
+  }
+  return reply;
+}
+
+std::vector<frame_view> parse_frames(std::string_view bytes) {
+  std::vector<frame_view> frames;
+  while (bytes.size() >= net::http2_frame_header::size) {
+    auto header = net::http2_frame_header::parse(bytes.data());
+    if (bytes.size() < net::http2_frame_header::size + header.length) {
+      break;
+    }
+    frames.push_back(
+        {header, std::string(bytes.substr(net::http2_frame_header::size,
+                                          header.length))});
+    bytes.remove_prefix(net::http2_frame_header::size + header.length);
+  }
+  return frames;
+}
+
+void server() {
+  net::http_server server({.server = {.address = "127.0.0.1:0", .threads = 2}});
+  if (!server.start(handle)) {
+    check(false, "server started");
+    return;
+  }
+  std::string address = server.local_address().value_or("");
+  std::string goaway = frame(http2_frame_type::goaway, 0, 0, u32(0) + u32(0));
+
+  // Prior knowledge
+  net::hpack_encoder encoder;
+  std::string reply = round_trip(
+      address, preface_and_settings() +
+                   frame(http2_frame_type::headers,
+                         http2_flags::end_headers | http2_flags::end_stream, 1,
+                         request_block(encoder, "GET", "/hello")) +
+                   goaway);
+  auto frames = parse_frames(reply);
+  check(body_of(frames, 1) == "Hello, World!", "prior knowledge");
+
+  // Upgrade; the request is answered on stream 1
+  reply = round_trip(address,
+                   "GET /hello HTTP/1.1\r\nHost: x\r\n"
+                   "Connection: Upgrade, HTTP2-Settings\r\n"
+                   "Upgrade: h2c\r\nHTTP2-Settings: AAMAAABkAAQAAP__\r\n\r\n" +
+                       preface_and_settings() + goaway);
+  std::string_view switching =
+      "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\n"
+      "Upgrade: h2c\r\n\r\n";
+  check(reply.starts_with(switching), "101");
+  if (reply.starts_with(switching)) {
+    frames = parse_frames(std::string_view(reply).substr(switching.size()));
+    check(body_of(frames, 1) == "Hello, World!", "upgraded request");
+  }
+
+  // HTTP/1.1 is unchanged
+  reply = round_trip(address, "GET /hello HTTP/1.1\r\nHost: x\r\n"
+                            "Connection: close\r\n\r\n");
+  check(reply.starts_with("HTTP/1.1 200 OK") &&
+            reply.ends_with("Hello, World!"),
+        "HTTP/1.1");
+
+  server.stop();
+  server.wait();
+}
+
+} // namespace
+
+int main() {
+  frame_header();
+  requests();
+  header_table();
+  large_header_table();
+  flow_control();
+  priorities();
+  errors();
+  server();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
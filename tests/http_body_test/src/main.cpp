@@ -0,0 +1,389 @@
+#include <wu-net/net.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+
+// The chunked decoder on its own, chunked bodies for buffered handlers,
+// then streaming handlers: large uploads, chunked responses, 100-continue
+// and backpressure on a slow consumer
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+// Decode `text` fed in pieces of `step` octets the way http_server does:
+// in place, resuming where the previous piece stopped
+bool dechunk(std::string text, std::size_t step, std::string &body,
+             std::size_t *used = nullptr) {
+  net::http_chunked_decoder decoder;
+  std::size_t in = 0;
+  std::size_t out = 0;
+  for (std::size_t available = 0; !decoder.done() && in < text.size();) {
+    available = std::min(text.size(), available + step);
+    auto n = decoder.decode(text.data() + in, available - in, text.data(),
+                            out);
+    if (!n) {
+      return false;
+    }
+    in += *n;
+  }
+  body.assign(text.data(), out);
+  if (used != nullptr) {
+    *used = in;
+  }
+  return decoder.done();
+}
+
+void decoder() {
+  const std::string text = "5\r\nhello\r\n"
+                           "1;name=value\r\n \r\n"
+                           "A \r\n0123456789\r\n"
+                           "0\r\n"
+                           "Trailer: x\r\n"
+                           "\r\n"
+                           "GET /next";
+  for (std::size_t step : {text.size(), std::size_t{1}, std::size_t{7}}) {
+    std::string body;
+    std::size_t used = 0;
+    check(dechunk(text, step, body, &used) && body == "hello 0123456789" &&
+              used == text.size() - 9,
+          "decoded in place");
+  }
+
+  std::string body;
+  check(dechunk("3\nabc\n0\n\n", 1, body) && body == "abc", "bare LF");
+  check(!dechunk("x\r\n", 1, body), "not a size");
+  check(!dechunk("3\r\nabcd\r\n", 1, body), "data overruns chunk");
+  check(!dechunk("10000000000000000\r\n", 4, body), "size overflow");
+  check(!dechunk("1;" + std::string(5000, 'e') + "\r\n", 64, body),
+        "extension too long");
+  check(!dechunk("0\r\n" + std::string(5000, 't') + "\r\n\r\n", 64, body),
+        "trailer too long");
+
+  std::array<char, 20> header;
+  check(net::detail::chunk_header(0x1f40, header) == "1f40\r\n",
+        "chunk header");
+}
+
+// Send `bytes` and read until the server closes
+std::string round_trip(const std::string &address, std::string_view bytes) {
+  auto stream = net::tcp_stream::connect(address);
+  if (!stream) {
+    return {};
+  }
+  stream->write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  stream->flush();
+
+  std::string reply;
+  char buffer[65536];
+  ssize_t n;
+  while ((n = ::recv(stream->native_handle(), buffer, sizeof(buffer), 0)) > 0) {
+    reply.append(buffer, static_cast<std::size_t>(n));
+  }
+  return reply;
+}
+
+void echo(const net::http_request &request, net::http_response &response) {
+  response.set_body(std::string(request.body()));
+}
+
+void buffered() {
+  net::http_server server({.server = {.address = "127.0.0.1:0", .threads = 1},
+                           .max_body_size = 1024,
+                           .buffer_size = 64});
+  if (!server.start(echo)) {
+    check(false, "buffered server started");
+    return;
+  }
+  std::string address = server.local_address().value_or("");
+
+  // Two chunked requests in one write, the first spanning several reads
+  // of the small buffer
+  std::string reply = round_trip(
+      address, "POST / HTTP/1.1\r\nHost: x\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n"
+               "20\r\n" + std::string(32, 'a') + "\r\n"
+               "40\r\n" + std::string(64, 'b') + "\r\n0\r\n\r\n"
+               "POST / HTTP/1.1\r\nHost: x\r\nConnection: close\r\n"
+               "Transfer-Encoding: chunked\r\n\r\n"
+               "3\r\nxyz\r\n0\r\n\r\n");
+  check(reply.find("Content-Length: 96\r\n\r\n" + std::string(32, 'a') +
+                   std::string(64, 'b')) != std::string::npos,
+        "chunked body");
+  check(reply.ends_with("Content-Length: 3\r\nConnection: close\r\n\r\nxyz"),
+        "pipelined after a chunked body");
+
+  // Framing is dropped as it is decoded, so only the body counts against
+  // max_body_size however much extension text surrounds it
+  std::string padded = "POST / HTTP/1.1\r\nHost: x\r\nConnection: close\r\n"
+                       "Transfer-Encoding: chunked\r\n\r\n";
+  for (int i = 0; i < 500; ++i) {
+    padded += "1;" + std::string(4000, 'e') + "\r\nx\r\n";
+  }
+  padded += "0\r\n\r\n";
+  reply = round_trip(address, padded);
+  check(reply.ends_with("Content-Length: 500\r\nConnection: close\r\n\r\n" +
+                        std::string(500, 'x')),
+        "chunk extensions");
+
+  reply = round_trip(address, "POST / HTTP/1.1\r\nHost: x\r\n"
+                              "Transfer-Encoding: chunked\r\n\r\n"
+                              "zz\r\n");
+  check(reply.starts_with("HTTP/1.1 400"), "malformed chunk");
+
+  reply = round_trip(address, "POST / HTTP/1.1\r\nHost: x\r\n"
+                              "Transfer-Encoding: chunked\r\n\r\n"
+                              "401\r\n" + std::string(1025, 'c') + "\r\n");
+  check(reply.starts_with("HTTP/1.1 413"), "chunked body too large");
+
+  server.stop();
+  server.wait();
+}
+
+// Counts the body, or streams it back upper-cased as a chunked response,
+// pausing first on /slow
+net::task<void> stream_handle(const net::http_request &request,
+                              net::http_body_reader &body,
+                              net::http_body_writer &out) {
+  if (request.path() == "/ignore") {
+    out.response().set_status(204);
+    co_return;
+  }
+
+  if (request.path() == "/upper") {
+    auto started = co_await out.start();
+    if (!started) {
+      co_return;
+    }
+    std::string upper;
+    for (;;) {
+      auto data = co_await body.read();
+      if (!data || data->empty()) {
+        break;
+      }
+      upper.assign(data->begin(), data->end());
+      for (char &c : upper) {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+      }
+      auto written = co_await out.write(upper);
+      if (!written) {
+        co_return;
+      }
+    }
+    co_return;
+  }
+
+  if (request.path() == "/implicit") {
+    auto written = co_await out.write(std::string_view("implicit"));
+    check(written.has_value(), "write before start");
+    co_return;
+  }
+
+  if (request.path() == "/slow") {
+    co_await net::sleep_for(std::chrono::milliseconds(300));
+  }
+  std::size_t sum = 0;
+  for (;;) {
+    auto data = co_await body.read();
+    if (!data) {
+      out.response().set_status(400);
+      co_return;
+    }
+    if (data->empty()) {
+      break;
+    }
+    for (char c : *data) {
+      sum += static_cast<unsigned char>(c);
+    }
+  }
+  out.response().set_body(std::to_string(body.size()) + " " +
+                          std::to_string(sum));
+}
+
+// Decode a chunked response body
+std::string response_body(std::string_view reply) {
+  auto head_end = reply.find("\r\n\r\n");
+  if (head_end == std::string_view::npos) {
+    return "no head";
+  }
+  std::string body;
+  return dechunk(std::string(reply.substr(head_end + 4)), 4096, body)
+             ? body
+             : "bad chunks";
+}
+
+void streaming() {
+  net::http_server server({.server = {.address = "127.0.0.1:0", .threads = 1},
+                           .buffer_size = 4096});
+  net::http_server::streaming_handler handler = stream_handle;
+  if (!server.start(handler)) {
+    check(false, "streaming server started");
+    return;
+  }
+  std::string address = server.local_address().value_or("");
+
+  // A body 2000 times the buffer, never held in memory at once
+  std::string upload(8 << 20, '\0');
+  std::size_t sum = 0;
+  for (std::size_t i = 0; i < upload.size(); ++i) {
+    upload[i] = static_cast<char>(i * 7);
+    sum += static_cast<unsigned char>(upload[i]);
+  }
+  std::string reply = round_trip(
+      address, "POST /count HTTP/1.1\r\nHost: x\r\nConnection: close\r\n"
+               "Content-Length: " + std::to_string(upload.size()) +
+                   "\r\n\r\n" + upload);
+  check(reply.ends_with(std::to_string(upload.size()) + " " +
+                        std::to_string(sum)),
+        "content-length upload");
+
+  // Chunked in, chunked out, then a second request on the connection
+  reply = round_trip(address, "POST /upper HTTP/1.1\r\nHost: x\r\n"
+                              "Transfer-Encoding: chunked\r\n\r\n"
+                              "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n"
+                              "GET /count HTTP/1.1\r\nHost: x\r\n"
+                              "Connection: close\r\n\r\n");
+  auto second = reply.find("HTTP/1.1 200", 1);
+  check(reply.starts_with("HTTP/1.1 200") &&
+            reply.find("Transfer-Encoding: chunked\r\n") < second &&
+            response_body(reply.substr(0, second)) == "HELLO WORLD",
+        "chunked response");
+  check(second != std::string::npos && reply.ends_with("0 0"),
+        "keep-alive after a streamed response");
+
+  // HTTP/1.0 has no chunked coding: the body ends with the connection
+  reply = round_trip(address, "POST /upper HTTP/1.0\r\n"
+                              "Connection: keep-alive\r\n"
+                              "Content-Length: 5\r\n\r\nhello");
+  check(reply.starts_with("HTTP/1.1 200") &&
+            reply.find("Transfer-Encoding") == std::string::npos &&
+            reply.find("Connection: close\r\n") != std::string::npos &&
+            reply.ends_with("\r\n\r\nHELLO"),
+        "close-delimited HTTP/1.0 response");
+
+  // A head that exactly fills the buffer still leaves room for the body
+  std::string head = "POST /count HTTP/1.1\r\nHost: x\r\n"
+                     "Connection: close\r\nContent-Length: 3\r\nX-Pad: ";
+  head += std::string(4096 - head.size() - 4, 'p') + "\r\n\r\n";
+  reply = round_trip(address, head + "abc");
+  check(reply.starts_with("HTTP/1.1 200") && reply.ends_with("3 294"),
+        "head filling the buffer");
+
+  // Writing without start() sends the head first
+  reply = round_trip(address, "GET /implicit HTTP/1.1\r\nHost: x\r\n"
+                              "Connection: close\r\n\r\n");
+  check(reply.starts_with("HTTP/1.1 200") &&
+            response_body(reply) == "implicit",
+        "write starts the response");
+
+  // A body the handler never reads closes the connection after the reply
+  reply = round_trip(address, "POST /ignore HTTP/1.1\r\nHost: x\r\n"
+                              "Content-Length: 5\r\n\r\nhello"
+                              "GET /count HTTP/1.1\r\nHost: x\r\n\r\n");
+  check(reply.starts_with("HTTP/1.1 204") &&
+            reply.find("Connection: close") != std::string::npos &&
+            reply.find("HTTP/1.1", 1) == std::string::npos,
+        "unread body");
+
+  // 100-continue is sent when the handler first reads
+  {
+    auto client = net::tcp_stream::connect(address);
+    std::string head = "POST /count HTTP/1.1\r\nHost: x\r\n"
+                       "Expect: 100-continue\r\nConnection: close\r\n"
+                       "Content-Length: 3\r\n\r\n";
+    client->write(head.data(), static_cast<std::streamsize>(head.size()));
+    client->flush();
+    char buffer[256];
+    ssize_t n = ::recv(client->native_handle(), buffer, sizeof(buffer), 0);
+    check(n > 0 && std::string_view(buffer, static_cast<std::size_t>(n)) ==
+                       "HTTP/1.1 100 Continue\r\n\r\n",
+          "100-continue");
+    client->write("abc", 3);
+    client->flush();
+    std::string rest;
+    while ((n = ::recv(client->native_handle(), buffer, sizeof(buffer), 0)) >
+           0) {
+      rest.append(buffer, static_cast<std::size_t>(n));
+    }
+    check(rest.ends_with("3 294"), "body after 100-continue");
+  }
+
+  // While the handler sleeps, the server reads nothing, so the client can
+  // only get as far as the socket buffers let it
+  {
+    auto client = net::tcp_stream::connect(address);
+    int fd = client->native_handle();
+    std::string head = "POST /slow HTTP/1.1\r\nHost: x\r\n"
+                       "Connection: close\r\n"
+                       "Content-Length: " +
+                       std::to_string(upload.size() * 8) + "\r\n\r\n";
+    ::send(fd, head.data(), head.size(), MSG_NOSIGNAL);
+
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    std::size_t sent = 0;
+    auto until = std::chrono::steady_clock::now() +
+                 std::chrono::milliseconds(150);
+    while (std::chrono::steady_clock::now() < until) {
+      std::size_t offset = sent % upload.size();
+      ssize_t n = ::send(fd, upload.data() + offset, upload.size() - offset,
+                         MSG_NOSIGNAL);
+      if (n > 0) {
+        sent += static_cast<std::size_t>(n);
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    check(sent < upload.size() * 8, "sender held back");
+
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    for (std::size_t at = sent; at < upload.size() * 8;) {
+      std::size_t offset = at % upload.size();
+      ssize_t n = ::send(fd, upload.data() + offset, upload.size() - offset,
+                         MSG_NOSIGNAL);
+      if (n <= 0) {
+        break;
+      }
+      at += static_cast<std::size_t>(n);
+    }
+    char buffer[256];
+    std::string rest;
+    ssize_t n;
+    while ((n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      rest.append(buffer, static_cast<std::size_t>(n));
+    }
+    check(rest.find(std::to_string(upload.size() * 8) + " ") !=
+              std::string::npos,
+          "slow upload finished");
+  }
+
+  server.stop();
+  server.wait();
+}
+
+} // namespace
+
+int main() {
+  decoder();
+  buffered();
+  streaming();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
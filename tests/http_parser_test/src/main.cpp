@@ -0,0 +1,247 @@
+#include <wu-net/net.hpp>
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+std::error_code parse_error(std::string_view text) {
+  net::http_parser parser;
+  net::http_request request;
+  auto result = parser.parse(text, request);
+  return result ? std::error_code{} : result.error();
+}
+
+void complete_request() {
+  constexpr std::string_view text = "GET /index.html?lang=en HTTP/1.1\r\n"
+                                    "Host: example.com\r\n"
+                                    "User-Agent:  test/1.0  \r\n"
+                                    "X-Token|~: a|b\r\n"
+                                    "\r\n"
+                                    "trailing";
+  net::http_parser parser;
+  net::http_request request;
+  auto result = parser.parse(text, request);
+
+  check(result && *result == text.size() - 8, "complete head size");
+  check(request.method() == net::http_method::GET, "method");
+  check(request.target() == "/index.html?lang=en", "target");
+  check(request.path() == "/index.html", "path");
+  check(request.version() == net::http_version::HTTP_1_1, "version");
+  check(request.host() == "example.com", "host");
+  check(request.headers().size() == 3, "header count");
+  check(request.header("user-agent") == "test/1.0", "trimmed header value");
+  check(request.header("x-token|~") == "a|b", "token punctuation");
+  check(!request.header("accept"), "missing header");
+  check(request.keep_alive(), "HTTP/1.1 defaults to keep-alive");
+
+  // Views point into the caller's buffer
+  check(request.target().data() == text.data() + 4, "zero copy target");
+}
+
+// Feed one byte at a time, growing (and reallocating) the buffer as a
+// receive loop would
+void incremental_request() {
+  const std::string text =
+      "POST /submit HTTP/1.1\r\n"
+      "Host: localhost:8080\r\n"
+      "Content-Type: application/x-www-form-urlencoded; charset=utf-8\r\n"
+      "X-Long-Header-To-Cover-The-Wide-Scanning-Paths: " +
+      std::string(100, 'v') +
+      "\r\n"
+      "Content-Length: 11\r\n"
+      "\r\n";
+
+  net::http_parser parser;
+  net::http_request request;
+  std::string buffer;
+  std::size_t head_size = 0;
+  for (char c : text) {
+    buffer.push_back(c);
+    buffer.shrink_to_fit();
+    auto result = parser.parse(buffer, request);
+    if (!result) {
+      check(false, "incremental parse error");
+      return;
+    }
+    if (*result != 0) {
+      head_size = *result;
+      break;
+    }
+  }
+
+  check(head_size == text.size(), "incremental head size");
+  check(request.method() == net::http_method::POST, "incremental method");
+  check(request.content_length() == 11, "content length");
+  check(!request.chunked(), "not chunked");
+  check(request.header("x-long-header-to-cover-the-wide-scanning-paths") ==
+            std::string(100, 'v'),
+        "long header value");
+}
+
+void pipelined_requests() {
+  std::string_view text = "\r\nGET /a HTTP/1.1\nHost: x\n\n"
+                          "HEAD /b HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"
+                          "DELETE /c HTTP/1.1\r\nHost: x\r\n"
+                          "Connection: Upgrade, close\r\n\r\n";
+  net::http_parser parser;
+  net::http_request request;
+
+  auto first = parser.parse(text, request);
+  check(first && request.target() == "/a" && request.host() == "x",
+        "first pipelined request (bare LF, leading blank line)");
+  text.remove_prefix(first.value_or(0));
+
+  auto second = parser.parse(text, request);
+  check(second && request.method() == net::http_method::HEAD &&
+            request.version() == net::http_version::HTTP_1_0 &&
+            request.keep_alive(),
+        "HTTP/1.0 keep-alive");
+  text.remove_prefix(second.value_or(0));
+
+  auto third = parser.parse(text, request);
+  check(third && *third == text.size() && !request.keep_alive() &&
+            request.method() == net::http_method::DELETE,
+        "Connection: close");
+}
+
+// Well-known names resolve to their slot in any case; others are scanned
+void well_known_fields() {
+  bool all = true;
+  for (std::size_t i = 0; i < net::detail::http_field_names.size(); ++i) {
+    auto field = net::detail::find_http_field(net::detail::http_field_names[i]);
+    all &= field && static_cast<std::size_t>(*field) == i;
+  }
+  check(all, "every name has its slot");
+  static_assert(net::detail::find_http_field("Content-Length") ==
+                net::http_field::content_length);
+  check(net::detail::find_http_field("X-FORWARDED-FOR") ==
+            net::http_field::x_forwarded_for,
+        "case-insensitive");
+  check(!net::detail::find_http_field("x-token") &&
+            !net::detail::find_http_field("hosts") &&
+            !net::detail::find_http_field(""),
+        "unknown names");
+
+  constexpr std::string_view first = "GET / HTTP/1.1\r\n"
+                                     "host: example.com\r\n"
+                                     "ACCEPT: text/html\r\n"
+                                     "Accept: text/plain\r\n"
+                                     "X-Custom: 1\r\n"
+                                     "\r\n";
+  net::http_parser parser;
+  net::http_request request;
+  check(parser.parse(first, request).has_value(), "parsed");
+  check(request.header(net::http_field::host) == "example.com", "by field");
+  check(request.header("Accept") == "text/html", "first occurrence wins");
+  check(request.header("x-custom") == "1", "custom header");
+  check(!request.header(net::http_field::user_agent), "absent field");
+
+  // Slots from the previous request are cleared
+  constexpr std::string_view second = "GET / HTTP/1.1\r\n"
+                                      "Host: example.org\r\n"
+                                      "\r\n";
+  check(parser.parse(second, request).has_value(), "parsed again");
+  check(request.host() == "example.org" && !request.header("accept"),
+        "slots reset");
+}
+
+void chunked_request() {
+  net::http_parser parser;
+  net::http_request request;
+  auto result = parser.parse("PUT /x HTTP/1.1\r\nHost: x\r\n"
+                             "Transfer-Encoding: gzip, chunked\r\n\r\n",
+                             request);
+  check(result && request.chunked() && !request.content_length(), "chunked");
+}
+
+void rejected_requests() {
+  using net::http_error;
+  check(parse_error("GET / HTTP/1.1\r\nHost: x\r\n\r\n") == std::error_code{},
+        "baseline request accepted");
+  check(parse_error("BREW / HTTP/1.1\r\nHost: x\r\n\r\n") ==
+            make_error_code(http_error::unsupported_method),
+        "unknown method");
+  check(parse_error("get / HTTP/1.1\r\nHost: x\r\n\r\n") ==
+            make_error_code(http_error::unsupported_method),
+        "methods are case-sensitive");
+  check(parse_error("GET /a b HTTP/1.1\r\nHost: x\r\n\r\n") ==
+            make_error_code(http_error::bad_request_line),
+        "space in target");
+  check(parse_error("GET / HTTP/2.0\r\nHost: x\r\n\r\n") ==
+            make_error_code(http_error::unsupported_version),
+        "HTTP/2.0 request line");
+  check(parse_error("GET / HTTP/1.1\r\n\r\n") ==
+            make_error_code(http_error::missing_host),
+        "missing host");
+  check(parse_error("GET / HTTP/1.1\r\nHost: x\r\nHost: y\r\n\r\n") ==
+            make_error_code(http_error::bad_header),
+        "duplicate host");
+  check(parse_error("GET / HTTP/1.1\r\nHost: x\r\n folded\r\n\r\n") ==
+            make_error_code(http_error::bad_header),
+        "obs-fold");
+  check(parse_error("GET / HTTP/1.1\r\nHost : x\r\n\r\n") ==
+            make_error_code(http_error::bad_header),
+        "space before colon");
+  check(parse_error("GET / HTTP/1.1\r\nHost: x\x01y\r\n\r\n") ==
+            make_error_code(http_error::bad_header),
+        "control character in value");
+  check(parse_error("POST / HTTP/1.1\r\nHost: x\r\nContent-Length: 1\r\n"
+                    "Content-Length: 2\r\n\r\n") ==
+            make_error_code(http_error::bad_content_length),
+        "conflicting content lengths");
+  check(parse_error("POST / HTTP/1.1\r\nHost: x\r\n"
+                    "Content-Length: -1\r\n\r\n") ==
+            make_error_code(http_error::bad_content_length),
+        "negative content length");
+  check(parse_error("POST / HTTP/1.1\r\nHost: x\r\nContent-Length: 3\r\n"
+                    "Transfer-Encoding: chunked\r\n\r\n") ==
+            make_error_code(http_error::bad_transfer_encoding),
+        "content length with chunked");
+  check(parse_error("POST / HTTP/1.1\r\nHost: x\r\n"
+                    "Transfer-Encoding: chunked, gzip\r\n\r\n") ==
+            make_error_code(http_error::bad_transfer_encoding),
+        "chunked not final");
+
+  std::string many = "GET / HTTP/1.1\r\nHost: x\r\n";
+  for (std::size_t i = 0; i < net::http_request::max_headers; ++i) {
+    many += "X-" + std::to_string(i) + ": y\r\n";
+  }
+  check(parse_error(many + "\r\n") ==
+            make_error_code(http_error::too_many_headers),
+        "too many headers");
+
+  // No blank line in sight and already over the limit
+  std::string huge = "GET / HTTP/1.1\r\nX: " +
+                     std::string(net::http_parser::default_max_head_size, 'a');
+  check(parse_error(huge) == make_error_code(http_error::head_too_large),
+        "head too large");
+}
+
+} // namespace
+
+int main() {
+  complete_request();
+  incremental_request();
+  pipelined_requests();
+  well_known_fields();
+  chunked_request();
+  rejected_requests();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
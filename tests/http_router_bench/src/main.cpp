@@ -0,0 +1,102 @@
+#include <wu-net/net.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Route lookup cost as the route count grows. Each table is an API-shaped
+// mix of literal, parameter and wildcard routes; the lookups hit routes of
+// every kind plus a share of paths that match nothing.
+//
+// Usage: http_router_bench [millions of lookups per table]
+namespace {
+
+// Routes for `resources` resources: a collection, an item, a nested
+// collection and item under it, and a wildcard for static files
+void add_routes(net::http_router<std::uint32_t> &router,
+                std::size_t resources) {
+  std::uint32_t id = 0;
+  for (std::size_t i = 0; i < resources; ++i) {
+    std::string base = "/api/v" + std::to_string(i % 4) + "/resource" +
+                       std::to_string(i);
+    router.insert(net::http_method::GET, base, id++);
+    router.insert(net::http_method::GET, base + "/:id", id++);
+    router.insert(net::http_method::GET, base + "/:id/children", id++);
+    router.insert(net::http_method::GET, base + "/:id/children/:child",
+                  id++);
+    router.insert(net::http_method::GET, "/assets/" + std::to_string(i) +
+                                             "/*path",
+                  id++);
+  }
+}
+
+std::vector<std::string> make_paths(std::size_t resources, std::size_t count) {
+  std::mt19937 random(1);
+  std::vector<std::string> paths;
+  paths.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    std::size_t r = random() % resources;
+    std::string base = "/api/v" + std::to_string(r % 4) + "/resource" +
+                       std::to_string(r);
+    switch (random() % 6) {
+    case 0:
+      paths.push_back(base);
+      break;
+    case 1:
+      paths.push_back(base + "/" + std::to_string(random()));
+      break;
+    case 2:
+      paths.push_back(base + "/" + std::to_string(random()) +
+                      "/children/" + std::to_string(random()));
+      break;
+    case 3:
+      paths.push_back("/assets/" + std::to_string(r) + "/js/app.js");
+      break;
+    case 4:
+      paths.push_back(base + "/" + std::to_string(random()) + "/missing");
+      break;
+    default:
+      paths.push_back("/api/v9/resource" + std::to_string(r));
+      break;
+    }
+  }
+  return paths;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t lookups =
+      (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5) * 1000000;
+
+  for (std::size_t resources : {2, 20, 200, 2000, 20000}) {
+    net::http_router<std::uint32_t> router;
+    add_routes(router, resources);
+
+    // Cycle through a fixed set so building paths isn't measured
+    auto paths = make_paths(resources, 4096);
+    std::vector<std::string_view> views(paths.begin(), paths.end());
+
+    net::http_route_params params;
+    std::uint64_t matched = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < lookups; ++i) {
+      const std::uint32_t *value = router.match(
+          net::http_method::GET, views[i % views.size()], params);
+      matched += value != nullptr;
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    std::cout << router.size() << " routes (" << router.node_count()
+              << " nodes): "
+              << elapsed.count() * 1e9 / static_cast<double>(lookups)
+              << " ns/lookup (" << matched << " matched)\n";
+  }
+  return 0;
+}
@@ -0,0 +1,178 @@
+#include <wu-net/net.hpp>
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+
+// Counts allocations so lookups can be shown not to make any
+namespace {
+std::size_t allocations = 0;
+} // namespace
+
+void *operator new(std::size_t size) {
+  ++allocations;
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+// Route insertion and errors, literal, parameter and wildcard matching with
+// backtracking between them, per-method trees, and allocation-free lookups
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+using router = net::http_router<int>;
+
+// Value matched for GET `path`, or -1
+int get(const router &r, std::string_view path,
+        net::http_route_params &params) {
+  const int *value = r.match(net::http_method::GET, path, params);
+  return value != nullptr ? *value : -1;
+}
+
+void insert_errors() {
+  router r;
+  check(r.insert(net::http_method::GET, "/users/:id", 1).has_value(),
+        "insert");
+  check(r.insert(net::http_method::GET, "/users/:name", 2).error() ==
+            net::make_error_code(net::http_route_error::duplicate_route),
+        "same shape twice");
+  check(r.insert(net::http_method::POST, "/users/:id", 3).has_value(),
+        "same pattern, other method");
+
+  for (std::string_view bad : {"", "users", "/a/:", "/a/*rest/b"}) {
+    check(r.insert(net::http_method::GET, bad, 0).error() ==
+              net::make_error_code(net::http_route_error::bad_pattern),
+          "malformed pattern");
+  }
+
+  std::string many;
+  for (std::size_t i = 0; i <= net::http_route_params::max_params; ++i) {
+    many += "/:p" + std::to_string(i);
+  }
+  check(r.insert(net::http_method::GET, many, 0).error() ==
+            net::make_error_code(net::http_route_error::too_many_params),
+        "too many parameters");
+  check(r.size() == 2, "only valid routes added");
+}
+
+void matching() {
+  router r;
+  r.insert(net::http_method::GET, "/", 0);
+  r.insert(net::http_method::GET, "/users", 1);
+  r.insert(net::http_method::GET, "/users/:id", 2);
+  r.insert(net::http_method::GET, "/users/me", 3);
+  r.insert(net::http_method::GET, "/users/:id/posts/:post", 4);
+  r.insert(net::http_method::GET, "/useful", 5);
+  r.insert(net::http_method::GET, "/static/*path", 6);
+  r.insert(net::http_method::GET, "/a/b/d", 7);
+  r.insert(net::http_method::GET, "/a/:x/c", 8);
+  r.insert(net::http_method::GET, "/files/v1.:ext", 9);
+  r.insert(net::http_method::POST, "/users", 10);
+
+  net::http_route_params params;
+  check(get(r, "/", params) == 0 && params.empty(), "root");
+  check(get(r, "/users", params) == 1, "literal");
+  check(get(r, "/useful", params) == 5, "split edge");
+  check(get(r, "/use", params) == -1, "prefix of a literal");
+  check(get(r, "/users/me", params) == 3, "literal beats parameter");
+
+  check(get(r, "/users/42", params) == 2 && params.size() == 1 &&
+            params.get("id") == "42",
+        "parameter");
+  check(get(r, "/users/42/posts/7", params) == 4 && params.size() == 2 &&
+            params[0].name == "id" && params[0].value == "42" &&
+            params.get("post") == "7",
+        "two parameters");
+  check(get(r, "/users/", params) == -1, "parameter needs a segment");
+  check(get(r, "/users/42/posts", params) == -1, "partial route");
+
+  check(get(r, "/static/css/site.css", params) == 6 &&
+            params.get("path") == "css/site.css",
+        "wildcard");
+  check(get(r, "/static/", params) == 6 && params.get("path") == "",
+        "empty wildcard");
+
+  check(get(r, "/a/b/d", params) == 7 && params.empty(), "literal path");
+  check(get(r, "/a/b/c", params) == 8 && params.get("x") == "b",
+        "backtrack to the parameter");
+
+  check(get(r, "/files/v1.:ext", params) == 9, "colon inside a segment");
+  check(get(r, "/files/v1.json", params) == -1, "only whole segments");
+
+  check(r.match(net::http_method::POST, "/users", params) != nullptr &&
+            *r.match(net::http_method::POST, "/users", params) == 10,
+        "per method");
+  check(r.match(net::http_method::DELETE, "/users", params) == nullptr,
+        "no route for the method");
+  check(r.matches_any("/users/1") && !r.matches_any("/nothing"),
+        "matches_any");
+}
+
+void request() {
+  router r;
+  r.insert(net::http_method::GET, "/items/:id", 1);
+
+  net::http_parser parser;
+  net::http_request request;
+  std::string head = "GET /items/abc?full=1 HTTP/1.1\r\nHost: x\r\n\r\n";
+  auto parsed = parser.parse(head, request);
+  net::http_route_params params;
+  const int *value = parsed ? r.match(request, params) : nullptr;
+  check(value != nullptr && *value == 1 && params.get("id") == "abc" &&
+            params.get("id")->data() == head.data() + 11,
+        "captures point into the request");
+}
+
+void allocation_free() {
+  router r;
+  for (int i = 0; i < 1000; ++i) {
+    std::string base = "/api/v" + std::to_string(i % 3) + "/res" +
+                       std::to_string(i);
+    r.insert(net::http_method::GET, base, i);
+    r.insert(net::http_method::GET, base + "/:id/sub/:sub", i);
+    r.insert(net::http_method::GET, base + "/:id/*rest", i);
+  }
+
+  net::http_route_params params;
+  std::size_t before = allocations;
+  int found = 0;
+  found += get(r, "/api/v1/res100/17/sub/3", params) == 100;
+  found += get(r, "/api/v0/res999/17/a/b/c", params) == 999;
+  found += get(r, "/api/v2/res5", params) == 5;
+  found += get(r, "/api/v2/missing", params) == -1;
+  check(allocations == before, "lookups don't allocate");
+  check(found == 4, "large router");
+}
+
+} // namespace
+
+int main() {
+  insert_errors();
+  matching();
+  request();
+  allocation_free();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,231 @@
+#include <wu-net/net.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <sys/socket.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+void handle(const net::http_request &request, net::http_response &response) {
+  if (request.path() == "/plaintext") {
+    response.add_header("Content-Type", "text/plain");
+    response.set_body_view("Hello, World!");
+  } else if (request.path() == "/echo") {
+    response.set_body(std::string(request.body()));
+  } else if (request.path() == "/empty") {
+    response.set_status(204);
+  } else if (request.path() == "/throw") {
+    throw std::runtime_error("handler failure");
+  } else {
+    response.set_status(404);
+  }
+}
+
+// Send `requests` in a single write and read until the server closes
+std::string send_requests(const std::string &address,
+                          std::string_view requests) {
+  auto stream = net::tcp_stream::connect(address);
+  if (!stream) {
+    return {};
+  }
+
+  stream->write(requests.data(), static_cast<std::streamsize>(requests.size()));
+  stream->flush();
+
+  std::string reply;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = ::recv(stream->native_handle(), buffer, sizeof(buffer), 0)) > 0) {
+    reply.append(buffer, static_cast<std::size_t>(n));
+  }
+  return reply;
+}
+
+std::size_t count(std::string_view text, std::string_view needle) {
+  std::size_t found = 0;
+  for (auto pos = text.find(needle); pos != std::string_view::npos;
+       pos = text.find(needle, pos + 1)) {
+    ++found;
+  }
+  return found;
+}
+
+} // namespace
+
+int main() {
+  net::http_server server({.server = {.address = "127.0.0.1:0", .threads = 2}});
+  if (!server.start(handle)) {
+    std::cerr << "Failed to start server\n";
+    return 1;
+  }
+  std::string address = server.local_address().value_or("");
+
+  // Pipelined batch; the last request closes the connection
+  std::string reply =
+      send_requests(address, "GET /plaintext HTTP/1.1\r\nHost: x\r\n\r\n"
+                        "POST /echo HTTP/1.1\r\nHost: x\r\n"
+                        "Content-Length: 5\r\n\r\nhello"
+                        "HEAD /plaintext HTTP/1.1\r\nHost: x\r\n\r\n"
+                        "GET /missing HTTP/1.1\r\nHost: x\r\n"
+                        "Connection: close\r\n\r\n");
+  check(count(reply, "HTTP/1.1 200 OK\r\n") == 3, "three successful responses");
+  check(count(reply, "HTTP/1.1 404 Not Found\r\n") == 1, "not found response");
+  check(count(reply, "Hello, World!") == 1, "HEAD response has no body");
+  check(count(reply, "Content-Length: 13\r\n") == 2, "HEAD keeps the length");
+  check(reply.find("\r\n\r\nhello") != std::string::npos, "echoed body");
+  check(count(reply, "Date: ") == 4, "date header");
+  check(count(reply, "Connection: close\r\n") == 1, "close on request");
+
+  // Many requests in one write exceed a single response batch
+  std::string many;
+  for (int i = 0; i < 100; ++i) {
+    many += "GET /plaintext HTTP/1.1\r\nHost: x\r\n\r\n";
+  }
+  many += "GET /plaintext HTTP/1.0\r\n\r\n";
+  reply = send_requests(address, many);
+  check(count(reply, "Hello, World!") == 101, "large pipeline");
+
+  // Body split across writes, then an HTTP/1.0 request closes the connection
+  {
+    auto stream = net::tcp_stream::connect(address);
+    check(stream.has_value(), "connect");
+    if (stream) {
+      *stream << "POST /echo HTTP/1.1\r\nHost: x\r\nContent-Length: 10\r\n\r\n"
+                 "01234"
+              << std::flush;
+      *stream << "56789GET /plaintext HTTP/1.0\r\n\r\n" << std::flush;
+      std::string all((std::istreambuf_iterator<char>(*stream)),
+                      std::istreambuf_iterator<char>());
+      check(all.find("\r\n\r\n0123456789") != std::string::npos,
+            "split body");
+      check(all.ends_with("Hello, World!"), "HTTP/1.0 closes");
+    }
+  }
+
+  // HTTP/1.0 keep-alive is confirmed; 204 carries no framing
+  reply = send_requests(address, "GET /empty HTTP/1.0\r\n"
+                                 "Connection: keep-alive\r\n\r\n"
+                                 "GET /plaintext HTTP/1.0\r\n\r\n");
+  check(count(reply, "Connection: keep-alive\r\n") == 1,
+        "HTTP/1.0 keep-alive confirmed");
+  check(reply.starts_with("HTTP/1.1 204 No Content\r\n") &&
+            count(reply, "Content-Length") == 1,
+        "204 has no length");
+  check(reply.ends_with("Hello, World!"), "HTTP/1.0 connection kept");
+
+  // A client expecting 100-continue is told to send the body
+  {
+    auto stream = net::tcp_stream::connect(address);
+    check(stream.has_value(), "connect");
+    if (stream) {
+      *stream << "POST /echo HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\n"
+                 "Expect: 100-continue\r\nConnection: close\r\n\r\n"
+              << std::flush;
+      std::string interim;
+      char buffer[4096];
+      while (!interim.ends_with("\r\n\r\n")) {
+        ssize_t n = ::recv(stream->native_handle(), buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+          break;
+        }
+        interim.append(buffer, static_cast<std::size_t>(n));
+      }
+      check(interim == "HTTP/1.1 100 Continue\r\n\r\n", "100 continue");
+      *stream << "hello" << std::flush;
+      std::string all((std::istreambuf_iterator<char>(*stream)),
+                      std::istreambuf_iterator<char>());
+      check(all.starts_with("HTTP/1.1 200 OK\r\n") &&
+                all.ends_with("\r\n\r\nhello"),
+            "body after 100 continue");
+    }
+  }
+
+  // Malformed request, handler exception
+  reply = send_requests(address, "GET / HTTP/1.1\r\n\r\n");
+  check(reply.starts_with("HTTP/1.1 400 Bad Request\r\n"), "bad request");
+  reply = send_requests(address, "BREW /pot HTTP/1.1\r\nHost: x\r\n\r\n");
+  check(reply.starts_with("HTTP/1.1 501 Not Implemented\r\n"),
+        "unknown method");
+  reply = send_requests(address, "GET /throw HTTP/1.1\r\nHost: x\r\n\r\n");
+  check(reply.starts_with("HTTP/1.1 500 Internal Server Error\r\n"),
+        "handler exception");
+
+  server.stop();
+  server.wait();
+
+  // Idle connections and slowly sent requests are shut down
+  using std::chrono::milliseconds;
+  net::http_server strict({.server = {.address = "127.0.0.1:0", .threads = 1},
+                           .idle_timeout = milliseconds(100),
+                           .request_timeout = milliseconds(300)});
+  if (strict.start(handle)) {
+    address = strict.local_address().value_or("");
+    auto start = std::chrono::steady_clock::now();
+    reply = send_requests(address, "");
+    auto waited = std::chrono::steady_clock::now() - start;
+    check(reply.empty() && waited >= milliseconds(100) &&
+              waited < milliseconds(5000),
+          "idle connection closed");
+
+    auto stream = net::tcp_stream::connect(address);
+    check(stream.has_value(), "connect");
+    if (stream) {
+      // Each byte pushes the idle timeout back, but not the request timeout
+      start = std::chrono::steady_clock::now();
+      std::string_view head = "GET /plaintext HTTP/1.1\r\nHost: x\r\n\r\n";
+      bool refused = false;
+      for (char c : head.substr(0, head.size() - 1)) {
+        if (::send(stream->native_handle(), &c, 1, MSG_NOSIGNAL) != 1) {
+          refused = true;
+          break;
+        }
+        std::this_thread::sleep_for(milliseconds(50));
+      }
+      char byte;
+      check(refused || ::recv(stream->native_handle(), &byte, 1, 0) <= 0,
+            "slow request closed");
+      check(std::chrono::steady_clock::now() - start >= milliseconds(300),
+            "request timeout waits");
+    }
+
+    // A keep-alive connection stays open while requests keep coming
+    stream = net::tcp_stream::connect(address);
+    int answered = 0;
+    for (int i = 0; stream && i < 4; ++i) {
+      *stream << "GET /plaintext HTTP/1.1\r\nHost: x\r\n\r\n" << std::flush;
+      char buffer[4096];
+      if (::recv(stream->native_handle(), buffer, sizeof(buffer), 0) > 0) {
+        ++answered;
+      }
+      std::this_thread::sleep_for(milliseconds(60));
+    }
+    check(answered == 4, "requests renew the idle timeout");
+
+    strict.stop();
+    strict.wait();
+  } else {
+    check(false, "start server with timeouts");
+  }
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
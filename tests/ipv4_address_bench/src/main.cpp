@@ -0,0 +1,162 @@
+#include <wu-net/net.hpp>
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Dotted quad parsing and formatting throughput:
+//   parse:  std::from_chars per octet  vs  scalar  vs  from_str  vs  parse_many
+//   format: std::format                vs  to_chars  vs  format_many
+//
+// Usage: ipv4_address_bench [millions of addresses]
+namespace {
+
+// The previous from_str: std::from_chars once per octet
+bool parse_from_chars(std::string_view text,
+                      std::array<std::uint8_t, 4> &octets) {
+  const char *current = text.data();
+  const char *end = current + text.size();
+  for (std::size_t i = 0; i < 4; ++i) {
+    unsigned value = 0;
+    auto result = std::from_chars(current, end, value);
+    if (result.ec != std::errc{} || value > 255) {
+      return false;
+    }
+    octets[i] = static_cast<std::uint8_t>(value);
+    current = result.ptr;
+    if (i < 3) {
+      if (current == end || *current != '.') {
+        return false;
+      }
+      ++current;
+    }
+  }
+  return current == end;
+}
+
+template <typename Fn>
+void run(std::string_view name, std::size_t count, std::uint64_t check,
+         Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  std::uint64_t result = fn();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << std::format("{:<22} {:7.2f} ns/address {:8.1f} M/s{}\n", name,
+                           elapsed.count() * 1e9 / static_cast<double>(count),
+                           static_cast<double>(count) / elapsed.count() / 1e6,
+                           result == check ? "" : " (MISMATCH)");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t millions = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10;
+  std::size_t count = std::max<std::size_t>(millions, 1) * 1000000;
+
+  // Random addresses, stored back to back as log lines would be
+  std::mt19937 random(42);
+  std::vector<net::ipv4_address> addresses;
+  addresses.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    std::uint32_t bits = random();
+    addresses.emplace_back(bits >> 24, bits >> 16 & 0xff, bits >> 8 & 0xff,
+                           bits & 0xff);
+  }
+
+  std::string text;
+  net::ipv4_address::format_many(addresses, text);
+  std::vector<std::string_view> lines;
+  lines.reserve(count);
+  for (std::size_t begin = 0; begin < text.size();) {
+    std::size_t end = text.find('\n', begin);
+    lines.emplace_back(text.data() + begin, end - begin);
+    begin = end + 1;
+  }
+
+  std::uint64_t expected = 0;
+  for (const auto &address : addresses) {
+    expected += address.octets()[0] + address.octets()[3];
+  }
+
+  std::cout << "parse (" << count << " addresses)\n";
+  run("std::from_chars", count, expected, [&] {
+    std::uint64_t sum = 0;
+    std::array<std::uint8_t, 4> octets;
+    for (auto line : lines) {
+      if (parse_from_chars(line, octets)) {
+        sum += octets[0] + octets[3];
+      }
+    }
+    return sum;
+  });
+  run("scalar", count, expected, [&] {
+    std::uint64_t sum = 0;
+    std::array<std::uint8_t, 4> octets;
+    for (auto line : lines) {
+      if (net::detail::parse_ipv4_scalar(line.data(), line.size(), octets)) {
+        sum += octets[0] + octets[3];
+      }
+    }
+    return sum;
+  });
+  run("from_str", count, expected, [&] {
+    std::uint64_t sum = 0;
+    for (auto line : lines) {
+      if (auto address = net::ipv4_address::from_str(line)) {
+        sum += address->octets()[0] + address->octets()[3];
+      }
+    }
+    return sum;
+  });
+  std::vector<net::ipv4_address> parsed(count);
+  run("parse_many", count, expected, [&] {
+    std::size_t n = net::ipv4_address::parse_many(lines, parsed);
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      sum += parsed[i].octets()[0] + parsed[i].octets()[3];
+    }
+    return sum;
+  });
+
+  std::cout << "format\n";
+  run("std::format", count, text.size(), [&] {
+    std::string out;
+    out.reserve(text.size());
+    for (const auto &address : addresses) {
+      const auto &o = address.octets();
+      std::format_to(std::back_inserter(out), "{}.{}.{}.{}\n", o[0], o[1],
+                     o[2], o[3]);
+    }
+    return out.size();
+  });
+  run("to_chars", count, text.size(), [&] {
+    std::string out(count * 16, '\0');
+    char *p = out.data();
+    char *end = p + out.size();
+    for (const auto &address : addresses) {
+      p = address.to_chars(p, end).ptr;
+      *p++ = '\n';
+    }
+    return static_cast<std::size_t>(p - out.data());
+  });
+  run("format_many", count, text.size(), [&] {
+    std::string out;
+    net::ipv4_address::format_many(addresses, out);
+    return out.size();
+  });
+
+#if defined(__SSE4_1__) && defined(__x86_64__)
+  std::cout << "(SSE4.1 parser)\n";
+#else
+  std::cout << "(scalar parser)\n";
+#endif
+  return 0;
+}
@@ -1,70 +1,130 @@
-// #include <iostream>
-// #include <generator>
-
-// #include <wu-net/ipv4_address.hpp>
-
-// int main(int argc, char **args) {
-//   auto test_addr = net::ipv4_address(73, 196, 6, 173);
-//   if (test_addr.to_string() != "73.196.6.173") {
-//     return 1;
-//   }
-
-//   test_addr =
-//       net::ipv4_address::from_str("127.0.0.1").value_or(net::ipv4_address());
-//   if (test_addr.to_string() != "127.0.0.1") {
-//     return 1;
-//   }
-
-//   auto resolved = net::ipv4_address::resolve_host("www.youtube.com");
-//   if (!resolved) {
-//     std::cout << "Failed to resolve host\n";
-//     return 1;
-//   }
-
-//   std::cout << resolved->to_string() << '\n';
-//   std::cout << "passed\n";
-//   return 0;
-// }
-
 #include <wu-net/net.hpp>
 
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <format>
 #include <iostream>
-#include <thread>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Parsing and formatting of dotted quads, including the SIMD parser
+// against the scalar one on random and malformed input
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+bool parses(std::string_view text) {
+  return net::ipv4_address::from_str(text).has_value();
+}
+
+// Every parser this build has must agree with the scalar one
+bool parsers_agree(std::string_view text) {
+  std::array<std::uint8_t, 4> expected{}, actual{};
+  bool valid =
+      net::detail::parse_ipv4_scalar(text.data(), text.size(), expected);
+  if (net::detail::parse_ipv4(text.data(), text.size(), actual) != valid) {
+    return false;
+  }
+  return !valid || actual == expected;
+}
+
+} // namespace
 
 int main() {
-    // Create a listener on port 8080
-    auto listener = net::tcp_listener::create("*:8080");
-    if (!listener) {
-        std::cerr << "Failed to create listener\n";
-        return 1;
+  auto test_addr = net::ipv4_address(73, 196, 6, 173);
+  check(test_addr.to_string() == "73.196.6.173", "to_string");
+  check(std::format("{}", test_addr) == "73.196.6.173", "formatter");
+
+  test_addr =
+      net::ipv4_address::from_str("127.0.0.1").value_or(net::ipv4_address());
+  check(test_addr == net::ipv4_address::loopback, "from_str");
+  check(net::ipv4_address::from_str(std::string_view("10.0.0.1\0", 9)) ==
+            net::ipv4_address(10, 0, 0, 1),
+        "trailing NUL");
+  check(net::ipv4_address::from_str("255.255.255.255") ==
+            net::ipv4_address::broadcast,
+        "broadcast");
+  check(net::ipv4_address::from_str("010.001.0.00") ==
+            net::ipv4_address(10, 1, 0, 0),
+        "leading zeros");
+
+  for (std::string_view bad :
+       {"", "1.2.3", "1.2.3.4.5", "256.0.0.1", "1.2.3.256", "1..2.3",
+        ".1.2.3", "1.2.3.", "1.2.3.4 ", " 1.2.3.4", "1.2.3.-4", "+1.2.3.4",
+        "1.2.3.0004", "1234.1.1.1", "a.b.c.d", "1.2.3.4x", "999.999.999.999",
+        "1.2.3.4.", "1:2.3.4", "0x1.2.3.4", "1.2.3.4\n"}) {
+    check(!parses(bad), std::format("rejects \"{}\"", bad));
+    check(parsers_agree(bad), std::format("parsers agree on \"{}\"", bad));
+  }
+
+  // Every octet value in every position round trips
+  for (int value = 0; value < 256; ++value) {
+    auto octet = static_cast<std::uint8_t>(value);
+    for (int position = 0; position < 4; ++position) {
+      std::array<std::uint8_t, 4> octets = {1, 22, 133, 4};
+      octets[position] = octet;
+      net::ipv4_address address(octets);
+      std::string text = address.to_string();
+      check(net::ipv4_address::from_str(text) == address,
+            std::format("round trip {}", text));
     }
-    
-    std::cout << "Listening on " << listener->local_address().value_or("unknown") << std::endl;
-    
-    // Flag to stop accepting connections
-    bool should_stop = false;
-    
-    // In another thread or signal handler, you could set should_stop = true
-    
-    // Iterate over incoming connections using the generator
-    for (auto client : listener->connections(&should_stop)) {
-        std::cout << "Client connected\n";
-        
-        // Use the tcp_stream object
-        std::string line;
-        while (std::getline(client, line)) {
-            std::cout << "Received: " << line << std::endl;
-            
-            // Echo back
-            client << "Echo: " << line << std::endl;
-            
-            if (line == "quit") {
-                break;
-            }
-        }
-        
-        std::cout << "Client disconnected\n";
+  }
+
+  // Random addresses, and random strings over the dotted quad alphabet
+  std::mt19937 random(12345);
+  for (int i = 0; i < 200000; ++i) {
+    std::string text;
+    if (i % 2 == 0) {
+      text = std::format("{}.{}.{}.{}", random() % 300, random() % 256,
+                         random() % 1000, random() % 256);
+    } else {
+      std::size_t size = random() % 17;
+      for (std::size_t j = 0; j < size; ++j) {
+        text += "0123456789..x"[random() % 13];
+      }
     }
-    
-    return 0;
-}
\ No newline at end of file
+    check(parsers_agree(text), std::format("parsers agree on \"{}\"", text));
+  }
+
+  // to_chars reports a buffer that is too small
+  char small[8];
+  auto result = net::ipv4_address::broadcast.to_chars(small, small + 8);
+  check(result.ec == std::errc::value_too_large, "to_chars overflow");
+  char exact[15];
+  result = net::ipv4_address::broadcast.to_chars(exact, exact + 15);
+  check(result.ec == std::errc{} &&
+            std::string_view(exact, result.ptr) == "255.255.255.255",
+        "to_chars exact fit");
+
+  // Batches
+  std::vector<std::string_view> input = {"1.2.3.4", "10.0.0.255", "8.8.8.8",
+                                         "bad", "9.9.9.9"};
+  std::vector<net::ipv4_address> output(input.size());
+  check(net::ipv4_address::parse_many(input, output) == 3,
+        "parse_many stops at the first invalid entry");
+  check(output[1] == net::ipv4_address(10, 0, 0, 255), "parse_many values");
+  check(net::ipv4_address::parse_many(std::span(input).first(3),
+                                      std::span(output).first(2)) == 2,
+        "parse_many stops when output is full");
+
+  std::string text = "addresses:";
+  net::ipv4_address::format_many(std::span(output).first(3), text, ' ');
+  check(text == "addresses:1.2.3.4 10.0.0.255 8.8.8.8 ", "format_many");
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include <wu-net/net.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+// Longest-prefix-match throughput on a large table, one lookup at a time
+// and in batches with prefetching.
+//
+// Usage: ipv4_prefix_table_bench [prefixes] [millions of lookups]
+namespace {
+
+template <typename Fn>
+void run(std::string_view name, std::size_t count, Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  std::uint64_t matched = fn();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << name << ": "
+            << static_cast<double>(count) / elapsed.count() / 1e6
+            << " M lookups/s, "
+            << elapsed.count() * 1e9 / static_cast<double>(count)
+            << " ns/lookup (" << matched << " matched)\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t prefixes =
+      argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  std::size_t lookups =
+      (argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20) * 1000000;
+
+  // A routing table shape: mostly /16-/24, with a tail of longer prefixes
+  std::mt19937 random(1);
+  net::ipv4_prefix_table<std::uint32_t> table;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < prefixes; ++i) {
+    unsigned roll = random() % 100;
+    auto length = static_cast<std::uint8_t>(roll < 60   ? 24
+                                            : roll < 90 ? 16 + random() % 8
+                                                        : 25 + random() % 8);
+    table.insert({net::ipv4_address::from_uint32(random()), length},
+                 static_cast<std::uint32_t>(i));
+  }
+  std::chrono::duration<double> built =
+      std::chrono::steady_clock::now() - start;
+  std::cout << table.size() << " prefixes, " << table.group_count()
+            << " groups, built in " << built.count() << " s\n";
+
+  std::vector<net::ipv4_address> addresses;
+  addresses.reserve(lookups);
+  for (std::size_t i = 0; i < lookups; ++i) {
+    addresses.push_back(net::ipv4_address::from_uint32(random()));
+  }
+
+  run("lookup", lookups, [&] {
+    std::uint64_t matched = 0;
+    for (const auto &address : addresses) {
+      matched += table.lookup(address) != nullptr;
+    }
+    return matched;
+  });
+
+  std::vector<const std::uint32_t *> results(4096);
+  run("lookup_many", lookups, [&] {
+    std::uint64_t matched = 0;
+    for (std::size_t i = 0; i < addresses.size(); i += results.size()) {
+      auto batch = std::span(addresses).subspan(
+          i, std::min(results.size(), addresses.size() - i));
+      table.lookup_many(batch, results);
+      for (std::size_t j = 0; j < batch.size(); ++j) {
+        matched += results[j] != nullptr;
+      }
+    }
+    return matched;
+  });
+  return 0;
+}
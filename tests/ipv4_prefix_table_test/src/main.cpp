@@ -0,0 +1,201 @@
+#include <wu-net/net.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// CIDR networks, and longest-prefix match against a brute force reference
+// through inserts, replacements, erases and concurrent updates
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+net::ipv4_network network(std::string_view text) {
+  return net::ipv4_network::from_str(text).value_or(net::ipv4_network());
+}
+
+// Every prefix by length, searched from /32 down
+class reference {
+public:
+  void insert(const net::ipv4_network &n, int value) {
+    _prefixes[n.prefix_length()][n.address().to_uint32()] = value;
+  }
+
+  void erase(const net::ipv4_network &n) {
+    _prefixes[n.prefix_length()].erase(n.address().to_uint32());
+  }
+
+  const int *lookup(net::ipv4_address address) const {
+    for (int length = 32; length >= 0; --length) {
+      auto n = net::ipv4_network(address, static_cast<std::uint8_t>(length));
+      auto &prefixes = _prefixes[length];
+      if (auto it = prefixes.find(n.address().to_uint32());
+          it != prefixes.end()) {
+        return &it->second;
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  std::array<std::unordered_map<std::uint32_t, int>, 33> _prefixes;
+};
+
+bool same(const int *a, const int *b) { return a ? b && *a == *b : !b; }
+
+void networks() {
+  auto n = network("192.168.10.77/20");
+  check(n.to_string() == "192.168.0.0/20", "host bits cleared");
+  check(std::format("{}", n) == "192.168.0.0/20", "formatter");
+  check(n.netmask() == net::ipv4_address(255, 255, 240, 0), "netmask");
+  check(n.last() == net::ipv4_address(192, 168, 15, 255), "last address");
+  check(n.contains(net::ipv4_address(192, 168, 15, 1)), "contains address");
+  check(!n.contains(net::ipv4_address(192, 168, 16, 0)), "outside address");
+  check(n.contains(network("192.168.4.0/24")), "contains subnet");
+  check(!n.contains(network("192.168.0.0/16")), "supernet not contained");
+  check(network("10.1.2.3") == network("10.1.2.3/32"), "bare address");
+  check(network("1.2.3.4/0").to_string() == "0.0.0.0/0", "default route");
+
+  for (std::string_view bad : {"10.0.0.0/33", "10.0.0.0/", "10.0.0.0/-1",
+                               "10.0.0/8", "10.0.0.0/8x", "10.0.0.0/008"}) {
+    check(!net::ipv4_network::from_str(bad), std::format("rejects {}", bad));
+  }
+}
+
+void compare(const net::ipv4_prefix_table<int> &table, const reference &ref,
+             const std::vector<net::ipv4_address> &queries,
+             std::string_view stage) {
+  std::vector<const int *> results(queries.size());
+  table.lookup_many(queries, results);
+
+  int mismatches = 0;
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    const int *expected = ref.lookup(queries[i]);
+    if (!same(table.lookup(queries[i]), expected) ||
+        !same(results[i], expected)) {
+      ++mismatches;
+    }
+  }
+  check(mismatches == 0, std::format("{}: {} mismatches", stage, mismatches));
+}
+
+void random_prefixes() {
+  std::mt19937 random(7);
+  net::ipv4_prefix_table<int> table;
+  reference ref;
+
+  // Prefixes clustered in 10.0.0.0/12 so they nest and overlap often
+  std::vector<net::ipv4_network> inserted;
+  for (int i = 0; i < 10000; ++i) {
+    std::uint32_t bits = 0x0a000000 | (random() & 0x000fffff);
+    auto length = static_cast<std::uint8_t>(12 + random() % 21);
+    net::ipv4_network n(net::ipv4_address::from_uint32(bits), length);
+    table.insert(n, i);
+    ref.insert(n, i);
+    inserted.push_back(n);
+  }
+  table.insert(network("0.0.0.0/0"), -1);
+  ref.insert(network("0.0.0.0/0"), -1);
+
+  std::vector<net::ipv4_address> queries;
+  for (int i = 0; i < 100000; ++i) {
+    queries.push_back(net::ipv4_address::from_uint32(
+        i % 4 == 0 ? random() : 0x0a000000 | (random() & 0x000fffff)));
+  }
+  for (const auto &n : inserted) {
+    queries.push_back(n.first());
+    queries.push_back(n.last());
+  }
+  compare(table, ref, queries, "after insert");
+
+  // Replace some values, erase half of the prefixes
+  for (std::size_t i = 0; i < inserted.size(); i += 7) {
+    table.insert(inserted[i], -2);
+    ref.insert(inserted[i], -2);
+  }
+  for (std::size_t i = 0; i < inserted.size(); i += 2) {
+    table.erase(inserted[i]);
+    ref.erase(inserted[i]);
+  }
+  compare(table, ref, queries, "after erase");
+  check(!table.erase(network("203.0.113.0/24")), "erase unknown prefix");
+
+  // With every prefix longer than /24 gone, all groups fold back
+  for (const auto &n : inserted) {
+    if (n.prefix_length() > 24) {
+      table.erase(n);
+      ref.erase(n);
+    }
+  }
+  table.reclaim();
+  compare(table, ref, queries, "after erasing long prefixes");
+  check(table.group_count() == 0, "groups folded back");
+
+  // Reclaimed slots are reused
+  table.insert(network("10.0.0.128/25"), 42);
+  ref.insert(network("10.0.0.128/25"), 42);
+  compare(table, ref, queries, "after reuse");
+  check(table.find(network("10.0.0.128/25")) &&
+            *table.find(network("10.0.0.128/25")) == 42,
+        "exact find");
+}
+
+// A reader must always see the covering /16 or the /28 being toggled
+void concurrent_updates() {
+  net::ipv4_prefix_table<int> table;
+  table.insert(network("172.16.0.0/16"), 1);
+
+  std::atomic<bool> done = false;
+  std::atomic<int> bad = 0;
+  std::thread reader([&] {
+    std::uint32_t bits = 0xac100000;
+    while (!done.load(std::memory_order_relaxed)) {
+      for (std::uint32_t i = 0; i < 65536; i += 3) {
+        const int *value =
+            table.lookup(net::ipv4_address::from_uint32(bits | i));
+        if (!value || (*value != 1 && *value != 2)) {
+          ++bad;
+        }
+      }
+    }
+  });
+
+  for (int round = 0; round < 2000; ++round) {
+    auto n = net::ipv4_network(
+        net::ipv4_address::from_uint32(0xac100000 | (round * 16 & 0xffff)), 28);
+    table.insert(n, 2);
+    table.erase(n);
+  }
+  done = true;
+  reader.join();
+  check(bad == 0, "concurrent lookups see old or new values");
+}
+
+} // namespace
+
+int main() {
+  networks();
+  random_prefixes();
+  concurrent_updates();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,214 @@
+#include <wu-net/net.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <sys/socket.h>
+
+// Histogram buckets, per-stream and per-listener counts, thread totals and
+// the Prometheus export, with WU_NET_METRICS defined for this target
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+using net::metrics::counter;
+using net::metrics::histogram;
+
+void histograms() {
+  bool bounded = true;
+  for (std::uint64_t value = 0; value < (std::uint64_t{1} << 40);
+       value = value * 3 / 2 + 1) {
+    std::size_t index = histogram::index_of(value);
+    std::uint64_t low = histogram::lower_bound(index);
+    std::uint64_t high = histogram::lower_bound(index + 1);
+    bounded &= low <= value && value < high &&
+               (high - low) * 16 <= std::max<std::uint64_t>(high, 16);
+  }
+  check(bounded, "bucket bounds within 1/16");
+  check(histogram::index_of(~std::uint64_t{0}) == histogram::bucket_count - 1,
+        "huge values in the last bucket");
+
+  histogram h;
+  for (std::uint64_t v = 1; v <= 10000; ++v) {
+    h.record(v);
+  }
+  auto s = h.read();
+  check(s.count == 10000 && s.sum == 50005000, "count and sum");
+  auto p50 = s.percentile(0.5);
+  auto p99 = s.percentile(0.99);
+  check(p50 >= 5000 && p50 <= 5000 + 5000 / 16, "p50");
+  check(p99 >= 9900 && p99 <= 9900 + 9900 / 16, "p99");
+  check(s.count_below(1 << 10) == 1023, "count below a power of two");
+}
+
+void streams() {
+  auto before = net::metrics::take_snapshot();
+
+  auto listener = net::tcp_listener::create("127.0.0.1:0");
+  auto client = net::tcp_stream::connect(listener->local_address().value());
+  auto server = listener->accept();
+  check(client && server, "connect");
+  if (!client || !server) {
+    return;
+  }
+  check(listener->stats().accepts == 1, "listener accepts");
+
+  *client << "hello" << std::flush;
+  std::string word(5, '\0');
+  server->read(word.data(), 5);
+  check(word == "hello", "transfer");
+
+  auto sent = client->stats();
+  check(sent.writes == 1 && sent.write_bytes == 5 && sent.flushes == 1,
+        "writer stats");
+  auto received = server->stats();
+  check(received.reads >= 1 && received.read_bytes == 5, "reader stats");
+
+  // EAGAIN on a non-blocking read
+  server->clear();
+  server->set_nonblocking(true);
+  server->peek();
+  check(server->would_block() && server->stats().would_block == 1,
+        "would block counted");
+
+  // Moving a stream keeps its counts
+  net::tcp_stream moved = std::move(*client);
+  check(moved.stats().write_bytes == 5, "stats survive a move");
+
+  auto after = net::metrics::take_snapshot();
+  check(after[counter::stream_write_bytes] -
+                before[counter::stream_write_bytes] ==
+            5,
+        "thread write bytes");
+  check(after[counter::stream_would_block] -
+                before[counter::stream_would_block] ==
+            1,
+        "thread would block");
+  check(after[counter::accepts] - before[counter::accepts] == 1,
+        "thread accepts");
+  check(after[net::metrics::timing::stream_flush].count >
+            before[net::metrics::timing::stream_flush].count,
+        "flush timed");
+}
+
+void listener_failures() {
+  auto listener = net::tcp_listener::create(
+      "127.0.0.1:0", net::listen_options{.nonblocking = true});
+  check(listener.has_value(), "listener");
+  if (!listener) {
+    return;
+  }
+
+  // Nothing pending: EAGAIN is reported but not counted as a failure
+  check(!listener->accept(), "nothing to accept");
+  check(listener->last_error() == std::errc::resource_unavailable_try_again,
+        "EAGAIN kept");
+  check(listener->stats().accept_failures == 0, "EAGAIN not a failure");
+
+  // Polling that times out says so, and a later accept clears it
+  check(!listener->accept(10), "accept timed out");
+  check(listener->last_error() == std::errc::timed_out, "timeout kept");
+  auto client =
+      net::tcp_stream::connect(listener->local_address().value());
+  check(listener->accept(1000).has_value() && !listener->last_error(),
+        "error cleared on success");
+
+  // A listener that has been shut down fails with EINVAL
+  ::shutdown(listener->native_handle(), SHUT_RDWR);
+  check(!listener->accept(), "accept after shutdown");
+  check(listener->last_error() == std::errc::invalid_argument, "EINVAL kept");
+  check(listener->stats().accept_failures == 1, "failure counted");
+
+  listener->close();
+  check(!listener->accept(10) &&
+            listener->last_error() == std::errc::bad_file_descriptor,
+        "closed listener");
+}
+
+net::task<void> accept_one(net::tcp_listener &listener, bool &accepted) {
+  auto client = co_await listener.async_accept();
+  accepted = client.has_value();
+  net::event_loop::current()->stop();
+}
+
+void async_accepts() {
+  auto loop = net::event_loop::create();
+  auto listener = net::tcp_listener::create("127.0.0.1:0");
+  bool accepted = false;
+  loop->spawn(accept_one(*listener, accepted));
+  auto address = listener->local_address().value();
+  std::thread client([&] { net::tcp_stream::connect(address); });
+  loop->run();
+  client.join();
+  check(accepted && listener->stats().accepts == 1, "async accept counted");
+}
+
+void threads() {
+  auto before = net::metrics::take_snapshot();
+  std::thread([] { net::metrics::add(counter::accept_failures, 7); }).join();
+  std::thread([] { net::metrics::add(counter::accept_failures, 3); }).join();
+  auto after = net::metrics::take_snapshot();
+  check(after[counter::accept_failures] - before[counter::accept_failures] ==
+            10,
+        "counts of exited threads kept");
+}
+
+void prometheus() {
+  std::string text = net::metrics::take_snapshot().to_prometheus();
+  check(text.find("# TYPE wu_net_accepts_total counter\n") !=
+            std::string::npos,
+        "counter type");
+  check(text.find("\nwu_net_stream_write_bytes_total ") != std::string::npos,
+        "counter sample");
+  check(text.find("# TYPE wu_net_stream_flush_seconds histogram\n") !=
+            std::string::npos,
+        "histogram type");
+  check(text.find("wu_net_stream_flush_seconds_bucket{le=\"+Inf\"} ") !=
+            std::string::npos,
+        "histogram buckets");
+  check(text.find("wu_net_stream_read_seconds_count ") != std::string::npos,
+        "histogram count");
+
+  // Bucket bounds sit on histogram bucket edges, so the counts are exact
+  net::metrics::snapshot edges;
+  net::metrics::histogram h;
+  h.record(1023);
+  h.record(1024);
+  edges.timings[0] = h.read();
+  text = edges.to_prometheus();
+  check(text.find("_bucket{le=\"1.023e-06\"} 1\n") != std::string::npos &&
+            text.find("_bucket{le=\"2.047e-06\"} 2\n") != std::string::npos,
+        "exact le buckets");
+  check(net::metrics::take_snapshot().to_prometheus("svc").starts_with(
+            "# HELP svc_"),
+        "prefix");
+}
+
+} // namespace
+
+int main() {
+  histograms();
+  streams();
+  listener_failures();
+  async_accepts();
+  threads();
+  prometheus();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,227 @@
+#include <wu-net/net.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// The MPSC queue under concurrent producers, then event_loop::post() from
+// other threads: wakeups, batching and handing a tcp_stream to a loop
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+void single_thread() {
+  net::mpsc_queue<std::unique_ptr<int>> queue;
+  check(queue.empty() && !queue.pop(), "starts empty");
+
+  for (int i = 0; i < 3; ++i) {
+    queue.push(std::make_unique<int>(i));
+  }
+  check(!queue.empty(), "not empty");
+  bool ordered = true;
+  for (int i = 0; i < 3; ++i) {
+    auto value = queue.pop();
+    ordered &= value && **value == i;
+  }
+  check(ordered, "fifo");
+  check(queue.empty() && !queue.pop(), "drained");
+
+  // Leftovers are destroyed with the queue (checked by sanitizers)
+  queue.push(std::make_unique<int>(7));
+}
+
+// Each producer's values must come out in the order it pushed them
+void producers() {
+  constexpr int threads = 4;
+  constexpr int per_thread = 100000;
+  net::mpsc_queue<std::pair<int, int>> queue;
+  std::atomic<bool> go{false};
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      while (!go.load()) {
+      }
+      for (int i = 0; i < per_thread; ++i) {
+        queue.push({t, i});
+      }
+    });
+  }
+  go = true;
+
+  std::vector<int> next(threads, 0);
+  int received = 0;
+  bool ordered = true;
+  while (received < threads * per_thread) {
+    if (auto value = queue.pop()) {
+      ordered &= value->second == next[value->first]++;
+      ++received;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+  check(ordered, "per-producer order");
+  check(queue.empty(), "all consumed");
+}
+
+// A loop blocked in run_once() without a timeout is woken by a post
+void wakes_blocked_loop() {
+  auto loop = net::event_loop::create();
+  std::atomic<bool> ran{false};
+
+  std::thread poster([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    loop->post([&] { ran = true; });
+  });
+  auto start = std::chrono::steady_clock::now();
+  while (!ran && std::chrono::steady_clock::now() - start <
+                     std::chrono::seconds(5)) {
+    loop->run_once();
+  }
+  poster.join();
+  check(ran, "woken by a post");
+
+  // A closed loop has nowhere to queue posts from other threads
+  loop->close();
+  bool accepted = true;
+  std::thread([&] { accepted = loop->post([] {}); }).join();
+  check(!accepted, "post to a closed loop fails");
+
+  // ...so schedule() on it resumes at once rather than never
+  bool resumed = false;
+  std::thread([&] {
+    net::spawn([](net::event_loop &closed, bool &done) -> net::task<void> {
+      co_await closed.schedule();
+      done = true;
+    }(*loop, resumed));
+  }).join();
+  check(resumed, "schedule() on a closed loop resumes inline");
+}
+
+// Posts that arrive before the loop looks are run together
+void batches_posts() {
+  auto loop = net::event_loop::create();
+  int count = 0;
+  std::thread([&] {
+    for (int i = 0; i < 1000; ++i) {
+      loop->post([&] { ++count; });
+    }
+  }).join();
+
+  check(loop->run_once(0) == 1000 && count == 1000, "one batch");
+  check(loop->run_once(0) == 0, "nothing left");
+}
+
+// Many threads posting at once, while run() keeps going until the last
+// one stops it
+void many_posters() {
+  auto loop = net::event_loop::create();
+  constexpr int threads = 4;
+  constexpr int per_thread = 10000;
+  int count = 0;
+  std::atomic<int> finished{0};
+
+  // Something to wait on, so run() does not return early
+  auto guard = loop->add_timer(std::chrono::seconds(10), [] {});
+
+  std::vector<std::thread> posters;
+  for (int t = 0; t < threads; ++t) {
+    posters.emplace_back([&] {
+      for (int i = 0; i < per_thread; ++i) {
+        loop->post([&] { ++count; });
+      }
+      if (++finished == threads) {
+        loop->post([&] { loop->stop(); });
+      }
+    });
+  }
+  loop->run();
+  for (auto &p : posters) {
+    p.join();
+  }
+  loop->cancel_timer(guard);
+  loop->run_once(0);
+  check(count == threads * per_thread, "every post ran");
+}
+
+net::task<void> echo(net::tcp_stream stream, std::atomic<bool> &done) {
+  std::byte byte;
+  auto n = co_await stream.async_read_some(std::span(&byte, 1));
+  if (n && *n == 1) {
+    auto sent = co_await stream.async_write(std::span(&byte, 1));
+    (void)sent;
+  }
+  done = true;
+}
+
+// An acceptor thread hands its connections to another thread's loop
+void stream_handoff() {
+  auto loop = net::event_loop::create();
+  auto listener = net::tcp_listener::create("127.0.0.1:0");
+  auto address = listener->local_address().value();
+  std::atomic<bool> done{false};
+
+  std::thread acceptor([&] {
+    auto stream = listener->accept();
+    if (!stream) {
+      done = true;
+      return;
+    }
+    stream->set_nonblocking(true);
+    loop->post([&, s = std::move(*stream)]() mutable {
+      net::spawn(echo(std::move(s), done));
+    });
+  });
+
+  std::thread client_thread([&] {
+    auto client = net::tcp_stream::connect(address);
+    if (client) {
+      *client << 'x' << std::flush;
+      client->get();
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  while (!done && std::chrono::steady_clock::now() - start <
+                      std::chrono::seconds(5)) {
+    loop->run_once(100);
+  }
+  acceptor.join();
+  client_thread.join();
+  check(done, "handed off stream served");
+}
+
+} // namespace
+
+int main() {
+  single_thread();
+  producers();
+  wakes_blocked_loop();
+  batches_posts();
+  many_posters();
+  stream_handoff();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,522 @@
+#include <wu-net/net.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <ctime>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Loopback benchmark suite; needs no external services.
+//   connect     - sequential blocking connects against an accepting thread
+//   accept      - concurrent clients against an event loop's async_accept
+//   latency     - ping-pong round trips on one connection (p50/p99/p99.9),
+//                 over TCP and Unix domain sockets
+//   throughput  - bulk transfer through the iostream interface vs raw I/O
+//   scaling     - echo round trips/s as concurrent connections grow
+// Results are written as JSON to stdout (or --output FILE) for comparing
+// releases; progress goes to stderr.
+//
+// Usage: wu-net-bench [--quick] [--output FILE]
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t message_size = 64;
+
+// Scaled down by --quick
+struct sizes {
+  int connects = 5000;
+  int accepts = 5000;
+  int round_trips = 20000;
+  std::size_t bulk_bytes = std::size_t{256} << 20;
+  int scaling_round_trips = 100000;
+  std::vector<int> scaling_connections{1, 10, 100, 1000};
+};
+
+// One benchmark result: a name and JSON-encoded fields
+struct result {
+  std::string name;
+  std::vector<std::pair<std::string, std::string>> fields;
+
+  template <class T>
+    requires std::is_arithmetic_v<T>
+  result &add(std::string_view key, T value) {
+    if constexpr (std::is_integral_v<T>) {
+      fields.emplace_back(key, std::to_string(value));
+    } else if (!std::isfinite(value)) {
+      fields.emplace_back(key, "null"); // e.g. a rate over no time at all
+    } else {
+      fields.emplace_back(key, std::format("{:.6g}", value));
+    }
+    return *this;
+  }
+
+  result &add(std::string_view key, std::string_view value) {
+    fields.emplace_back(key, std::format("\"{}\"", value));
+    return *this;
+  }
+};
+
+std::vector<result> results;
+
+result &record(std::string_view name) {
+  std::cerr << name << '\n';
+  return results.emplace_back(result{std::string(name), {}});
+}
+
+double seconds_since(clock_type::time_point start) {
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+std::string json() {
+  std::string out = "{\n  \"library\": \"wu-net\",\n";
+  out += std::format("  \"timestamp\": {},\n", std::time(nullptr));
+  out += std::format("  \"hardware_concurrency\": {},\n",
+                     std::thread::hardware_concurrency());
+#ifdef WU_NET_IO_URING
+  out += "  \"io_uring\": true,\n";
+#else
+  out += "  \"io_uring\": false,\n";
+#endif
+  out += "  \"results\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    out += i == 0 ? "\n" : ",\n";
+    out += "    {\"name\": \"" + results[i].name + '"';
+    for (auto &[key, value] : results[i].fields) {
+      out += ", \"" + key + "\": " + value;
+    }
+    out += '}';
+  }
+  out += "\n  ]\n}\n";
+  return out;
+}
+
+// Event loop echo server for `connections` connections; returns once all
+// of them have closed
+struct echo_state {
+  net::event_loop &loop;
+  int open = 0;
+  bool accepting = true;
+
+  void finished() {
+    if (--open == 0 && !accepting) {
+      loop.stop();
+    }
+  }
+};
+
+template <class Stream>
+net::task<void> echo_connection(Stream client, echo_state &state) {
+  std::array<std::byte, 4096> buffer;
+  for (;;) {
+    auto n = co_await client.async_read_some(buffer);
+    if (!n || *n == 0) {
+      break;
+    }
+    auto written = co_await client.async_write(std::span(buffer).first(*n));
+    if (!written) {
+      break;
+    }
+  }
+  state.finished();
+}
+
+template <class Listener>
+net::task<void> echo_accept(Listener &listener, echo_state &state,
+                            int connections) {
+  for (int i = 0; i < connections; ++i) {
+    auto client = co_await listener.async_accept();
+    if (!client) {
+      break;
+    }
+    client->set_nodelay(true); // No-op on Unix sockets
+    ++state.open;
+    net::spawn(echo_connection(std::move(*client), state));
+  }
+
+  state.accepting = false;
+  if (state.open == 0) {
+    state.loop.stop();
+  }
+}
+
+template <class Listener>
+std::thread echo_server(Listener &listener, int connections) {
+  return std::thread([&listener, connections] {
+    auto loop = net::event_loop::create();
+    if (!loop) {
+      return;
+    }
+#ifdef WU_NET_IO_URING
+    loop->enable_io_uring();
+#endif
+    echo_state state{*loop};
+    loop->spawn(echo_accept(listener, state, connections));
+    loop->run();
+  });
+}
+
+void connect_rate(int connects) {
+  auto listener = net::tcp_listener::create("127.0.0.1:0", 1024);
+  if (!listener) {
+    return;
+  }
+  auto target = listener->local_endpoint().value_or(net::endpoint());
+
+  // Accept until the clients are done and nothing is left pending, so a
+  // failed connect can't leave this thread waiting forever
+  std::atomic<bool> done = false;
+  std::thread server([&] {
+    for (int i = 0; i < connects;) {
+      if (listener->accept(100)) {
+        ++i;
+      } else if (done) {
+        break;
+      }
+    }
+  });
+
+  auto start = clock_type::now();
+  int connected = 0;
+  for (int i = 0; i < connects; ++i) {
+    connected += net::tcp_stream::connect(target).has_value();
+  }
+  double elapsed = seconds_since(start);
+  done = true;
+  server.join();
+
+  record("connect")
+      .add("connections", connected)
+      .add("seconds", elapsed)
+      .add("connections_per_s", connected / elapsed);
+}
+
+// Accepts seen so far out of those expected; `expected` drops to the
+// number of clients that connected once they have all finished
+struct accept_count {
+  int expected;
+  int accepted = 0;
+  clock_type::time_point last;
+};
+
+net::task<void> count_accepts(net::tcp_listener &listener,
+                              accept_count &count) {
+  while (count.accepted < count.expected) {
+    auto client = co_await listener.async_accept();
+    if (!client) {
+      break;
+    }
+    ++count.accepted;
+    count.last = clock_type::now();
+  }
+  net::event_loop::current()->stop();
+}
+
+void accept_rate(int accepts) {
+  auto listener = net::tcp_listener::create("127.0.0.1:0", 4096);
+  auto loop = net::event_loop::create();
+  if (!listener || !loop) {
+    return;
+  }
+  auto target = listener->local_endpoint().value_or(net::endpoint());
+
+  constexpr int client_threads = 4;
+  accept_count count{accepts, 0, {}};
+  std::vector<std::thread> clients;
+  std::atomic<bool> go = false;
+  std::atomic<int> failed = 0;
+  std::atomic<int> running = client_threads;
+  for (int t = 0; t < client_threads; ++t) {
+    clients.emplace_back([&, t] {
+      while (!go) {
+        std::this_thread::yield();
+      }
+      for (int i = t; i < accepts; i += client_threads) {
+        failed += !net::tcp_stream::connect(target).has_value();
+      }
+      // The last client out tells the loop how many accepts to wait for
+      if (--running == 0) {
+        loop->post([&] {
+          count.expected = accepts - failed;
+          if (count.accepted >= count.expected) {
+            loop->stop();
+          }
+        });
+      }
+    });
+  }
+
+  auto start = clock_type::now();
+  count.last = start;
+  loop->spawn(count_accepts(*listener, count));
+  go = true;
+  loop->run();
+  for (auto &client : clients) {
+    client.join();
+  }
+
+  double elapsed = std::chrono::duration<double>(count.last - start).count();
+  record("accept")
+      .add("connections", count.accepted)
+      .add("client_threads", client_threads)
+      .add("seconds", elapsed)
+      .add("accepts_per_s", count.accepted / elapsed);
+}
+
+// Blocking ping-pong of fixed-size messages, timing every round trip
+template <class Stream>
+void measure_latency(std::string_view transport, Stream &stream,
+                     int round_trips) {
+  std::array<std::byte, message_size> out, in;
+  out.fill(std::byte{'x'});
+
+  auto round_trip = [&] {
+    return stream.write_all(out) && stream.read_exact(in);
+  };
+  for (int i = 0; i < std::min(round_trips, 1000); ++i) {
+    round_trip(); // Warm up
+  }
+
+  std::vector<double> samples;
+  samples.reserve(static_cast<std::size_t>(round_trips));
+  for (int i = 0; i < round_trips; ++i) {
+    auto start = clock_type::now();
+    if (!round_trip()) {
+      break;
+    }
+    samples.push_back(seconds_since(start) * 1e6);
+  }
+  if (samples.empty()) {
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+
+  auto percentile = [&](double p) {
+    auto index = static_cast<std::size_t>(p * (samples.size() - 1));
+    return samples[index];
+  };
+  record("latency")
+      .add("transport", transport)
+      .add("message_bytes", message_size)
+      .add("round_trips", samples.size())
+      .add("p50_us", percentile(0.50))
+      .add("p99_us", percentile(0.99))
+      .add("p999_us", percentile(0.999))
+      .add("max_us", samples.back());
+}
+
+void latency(int round_trips) {
+  if (auto listener = net::tcp_listener::create("127.0.0.1:0")) {
+    std::thread server = echo_server(*listener, 1);
+    if (auto stream = net::tcp_stream::connect(
+            listener->local_endpoint().value_or(net::endpoint()))) {
+      stream->set_nodelay(true);
+      measure_latency("tcp", *stream, round_trips);
+    }
+    server.join();
+  }
+
+  std::string path = std::format("@wu-net-bench-{}", ::getpid());
+  if (auto listener = net::unix_listener::create(path)) {
+    std::thread server = echo_server(*listener, 1);
+    if (auto stream = net::unix_stream::connect(path)) {
+      measure_latency("unix", *stream, round_trips);
+    }
+    server.join();
+  }
+}
+
+// Send `bytes` in 16 KiB writes and read it back on another thread, either
+// through the iostream interface on both ends or with raw I/O
+void throughput(bool iostream, std::size_t bytes) {
+  auto listener = net::tcp_listener::create("127.0.0.1:0");
+  if (!listener) {
+    return;
+  }
+
+  constexpr std::size_t chunk = 16384;
+  std::size_t received = 0;
+  std::thread server([&] {
+    auto client = listener->accept();
+    if (!client) {
+      return;
+    }
+    std::vector<std::byte> buffer(chunk);
+    if (iostream) {
+      auto *data = reinterpret_cast<char *>(buffer.data());
+      while (client->read(data, chunk) || client->gcount() > 0) {
+        received += static_cast<std::size_t>(client->gcount());
+      }
+    } else {
+      while (auto n = client->read_some(buffer)) {
+        if (*n == 0) {
+          break;
+        }
+        received += *n;
+      }
+    }
+  });
+
+  auto stream = net::tcp_stream::connect(
+      listener->local_endpoint().value_or(net::endpoint()));
+  auto start = clock_type::now();
+  if (stream) {
+    std::vector<std::byte> buffer(chunk, std::byte{'x'});
+    for (std::size_t sent = 0; sent < bytes; sent += chunk) {
+      if (iostream) {
+        stream->write(reinterpret_cast<const char *>(buffer.data()), chunk);
+      } else if (!stream->write_all(buffer)) {
+        break;
+      }
+    }
+    stream->close();
+  }
+  server.join();
+  double elapsed = seconds_since(start);
+
+  record("throughput")
+      .add("interface", iostream ? "iostream" : "raw")
+      .add("bytes", received)
+      .add("seconds", elapsed)
+      .add("mib_per_s", static_cast<double>(received) / elapsed / (1 << 20));
+}
+
+// Client side of the scaling run: every connection does its share of
+// round trips, one at a time
+struct scaling_state {
+  int remaining;
+  int completed = 0;
+};
+
+net::task<void> scaling_client(net::endpoint target, int round_trips,
+                               scaling_state &state) {
+  auto stream = co_await net::tcp_stream::async_connect(target);
+  if (stream) {
+    stream->set_nodelay(true);
+    std::array<std::byte, message_size> out, in;
+    out.fill(std::byte{'x'});
+    for (int i = 0; i < round_trips; ++i) {
+      auto written = co_await stream->async_write(out);
+      if (!written) {
+        break;
+      }
+      std::size_t got = 0;
+      while (got < in.size()) {
+        auto n = co_await stream->async_read_some(std::span(in).subspan(got));
+        if (!n || *n == 0) {
+          break;
+        }
+        got += *n;
+      }
+      if (got < in.size()) {
+        break;
+      }
+      ++state.completed;
+    }
+  }
+  if (--state.remaining == 0) {
+    net::event_loop::current()->stop();
+  }
+}
+
+void scaling(int connections, int total_round_trips) {
+  auto listener = net::tcp_listener::create("127.0.0.1:0", 4096);
+  auto loop = net::event_loop::create();
+  if (!listener || !loop) {
+    return;
+  }
+  auto target = listener->local_endpoint().value_or(net::endpoint());
+  std::thread server = echo_server(*listener, connections);
+
+  int per_connection = std::max(1, total_round_trips / connections);
+  scaling_state state{connections};
+  auto start = clock_type::now();
+  for (int i = 0; i < connections; ++i) {
+    loop->spawn(scaling_client(target, per_connection, state));
+  }
+  loop->run();
+  double elapsed = seconds_since(start);
+  loop.reset();
+  server.join();
+
+  record("scaling")
+      .add("connections", connections)
+      .add("round_trips", state.completed)
+      .add("seconds", elapsed)
+      .add("round_trips_per_s", state.completed / elapsed);
+}
+
+// Room for both ends of the largest scaling run
+int raise_fd_limit() {
+  rlimit limit;
+  if (::getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+    return 1024;
+  }
+  limit.rlim_cur = limit.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &limit);
+  ::getrlimit(RLIMIT_NOFILE, &limit);
+  return static_cast<int>(std::min<rlim_t>(limit.rlim_cur, 1 << 20));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  sizes run;
+  std::string output;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "--quick") {
+      run = {500, 500, 2000, std::size_t{16} << 20, 10000, {1, 10, 100}};
+    } else if (arg == "--output" && i + 1 < argc) {
+      output = argv[++i];
+    } else {
+      std::cerr << "Usage: wu-net-bench [--quick] [--output FILE]\n";
+      return 2;
+    }
+  }
+
+  int max_fds = raise_fd_limit();
+
+  connect_rate(run.connects);
+  accept_rate(run.accepts);
+  latency(run.round_trips);
+  throughput(true, run.bulk_bytes);
+  throughput(false, run.bulk_bytes);
+  for (int connections : run.scaling_connections) {
+    if (2 * connections + 64 > max_fds) {
+      std::cerr << "scaling: skipping " << connections
+                << " connections (descriptor limit " << max_fds << ")\n";
+      continue;
+    }
+    scaling(connections, run.scaling_round_trips);
+  }
+
+  std::string text = json();
+  if (output.empty()) {
+    std::cout << text;
+  } else {
+    std::ofstream file(output);
+    file << text;
+    if (!file) {
+      std::cerr << "Failed to write " << output << '\n';
+      return 1;
+    }
+  }
+  return 0;
+}
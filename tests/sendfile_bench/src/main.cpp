@@ -0,0 +1,180 @@
+#include <wu-net/net.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Loopback bulk transfer benchmark comparing user-space copies through the
+// iostream interface with the zero-copy paths:
+//   file -> socket:   ifstream + tcp_stream::write   vs  send_file()
+//   socket -> socket: tcp_stream read/write proxy    vs  relay() (splice)
+//
+// Usage: sendfile_bench [total_gib] [file_mib]
+namespace {
+
+constexpr std::size_t mib = 1024 * 1024;
+
+// Count bytes until the sender closes
+std::size_t drain(net::tcp_stream &stream) {
+  std::size_t total = 0;
+  std::vector<std::byte> buffer(1 * mib);
+  for (;;) {
+    auto n = stream.read_some(buffer);
+    if (!n || *n == 0) {
+      return total;
+    }
+    total += *n;
+  }
+}
+
+// Temporary file of `size` bytes, already unlinked
+int make_file(const std::string &path, std::size_t size) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    return -1;
+  }
+
+  std::vector<char> block(mib);
+  for (std::size_t i = 0; i < block.size(); ++i) {
+    block[i] = static_cast<char>('a' + i % 26);
+  }
+  for (std::size_t written = 0; written < size; written += block.size()) {
+    if (::write(fd, block.data(), block.size()) < 0) {
+      ::close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+// Send the file `rounds` times over `out`
+void send_iostream(net::tcp_stream &out, const std::string &path,
+                   std::size_t rounds) {
+  std::vector<char> buffer(64 * 1024);
+  for (std::size_t r = 0; r < rounds; ++r) {
+    std::ifstream file(path, std::ios::binary);
+    while (file.read(buffer.data(),
+                     static_cast<std::streamsize>(buffer.size())) ||
+           file.gcount() > 0) {
+      out.write(buffer.data(), file.gcount());
+    }
+  }
+  out.flush();
+}
+
+void send_zero_copy(net::tcp_stream &out, int fd, std::size_t file_size,
+                    std::size_t rounds) {
+  for (std::size_t r = 0; r < rounds; ++r) {
+    out.send_file(fd, 0, file_size);
+  }
+}
+
+// Proxy through the iostream interface: every byte is copied into the
+// streambuf, out to user space and back
+void proxy_iostream(net::tcp_stream &from, net::tcp_stream &to) {
+  std::vector<char> buffer(64 * 1024);
+  while (from.read(buffer.data(),
+                   static_cast<std::streamsize>(buffer.size())) ||
+         from.gcount() > 0) {
+    to.write(buffer.data(), from.gcount());
+  }
+  to.flush();
+}
+
+void report(std::string_view name, std::size_t bytes,
+            std::chrono::steady_clock::time_point start, bool ok) {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double gib = static_cast<double>(bytes) / (1024.0 * mib);
+  std::cout << name << ": " << gib << " GiB in " << elapsed.count() << " s, "
+            << gib / elapsed.count() << " GiB/s" << (ok ? "" : " (ERRORS)")
+            << '\n';
+}
+
+// file -> socket
+void bench_file(std::string_view name, bool zero_copy, const std::string &path,
+                int fd, std::size_t file_size, std::size_t rounds) {
+  auto listener = net::tcp_listener::create("127.0.0.1:0");
+  auto address = listener->local_address().value_or("");
+  auto start = std::chrono::steady_clock::now();
+
+  std::thread sender([&] {
+    auto out = listener->accept();
+    if (zero_copy) {
+      send_zero_copy(*out, fd, file_size, rounds);
+    } else {
+      send_iostream(*out, path, rounds);
+    }
+  });
+
+  auto in = net::tcp_stream::connect(address);
+  std::size_t received = in ? drain(*in) : 0;
+  sender.join();
+  report(name, received, start, received == file_size * rounds);
+}
+
+// file -> proxy -> sink
+void bench_proxy(std::string_view name, bool zero_copy, int fd,
+                 std::size_t file_size, std::size_t rounds) {
+  auto front = net::tcp_listener::create("127.0.0.1:0");
+  auto back = net::tcp_listener::create("127.0.0.1:0");
+  auto front_address = front->local_address().value_or("");
+  auto back_address = back->local_address().value_or("");
+  auto start = std::chrono::steady_clock::now();
+
+  std::thread source([&] {
+    auto out = front->accept();
+    send_zero_copy(*out, fd, file_size, rounds);
+  });
+
+  std::thread proxy([&] {
+    auto from = net::tcp_stream::connect(front_address);
+    auto to = net::tcp_stream::connect(back_address);
+    if (zero_copy) {
+      net::relay(*from, *to, 1 * mib);
+    } else {
+      proxy_iostream(*from, *to);
+    }
+  });
+
+  auto sink = back->accept();
+  std::size_t received = drain(*sink);
+  source.join();
+  proxy.join();
+  report(name, received, start, received == file_size * rounds);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t total_gib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4;
+  std::size_t file_mib = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256;
+
+  std::size_t file_size = file_mib * mib;
+  std::size_t rounds = std::max<std::size_t>(total_gib * 1024 / file_mib, 1);
+
+  std::string path = "/tmp/wu-net-sendfile-bench";
+  int fd = make_file(path, file_size);
+  if (fd < 0) {
+    std::cerr << "Failed to create " << path << '\n';
+    return 1;
+  }
+
+  bench_file("file iostream", false, path, fd, file_size, rounds);
+  bench_file("file send_file", true, path, fd, file_size, rounds);
+  bench_proxy("proxy iostream", false, fd, file_size, rounds);
+  bench_proxy("proxy splice", true, fd, file_size, rounds);
+
+  ::close(fd);
+  ::unlink(path.c_str());
+  return 0;
+}
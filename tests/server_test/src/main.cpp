@@ -0,0 +1,178 @@
+#include <wu-net/net.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Sharded echo server: several workers, then a graceful drain on stop().
+// First, CPU steering on a reuseport group.
+namespace {
+
+net::task<void> echo(net::tcp_stream client) {
+  std::array<std::byte, 1024> buffer;
+  for (;;) {
+    auto n = co_await client.async_read_some(buffer);
+    if (!n || *n == 0 ||
+        !co_await client.async_write(std::span(buffer).first(*n))) {
+      co_return;
+    }
+  }
+}
+
+bool round_trip(net::tcp_stream &stream, const std::string &message) {
+  stream << message << '\n' << std::flush;
+  std::string reply;
+  return std::getline(stream, reply) && reply == message;
+}
+
+bool run(bool uring) {
+  net::server_options options{.address = "127.0.0.1:0", .threads = 4};
+#ifdef WU_NET_IO_URING
+  options.io_uring = uring;
+#endif
+  (void)uring;
+
+  net::server server(options);
+  if (!server.start(echo)) {
+    std::cerr << "Failed to start server\n";
+    return false;
+  }
+
+  auto address = server.local_address();
+  if (!address || server.size() != 4) {
+    std::cerr << "Unexpected server state\n";
+    return false;
+  }
+
+  for (int i = 0; i < 32; ++i) {
+    auto stream = net::tcp_stream::connect(*address);
+    if (!stream || !round_trip(*stream, "hello " + std::to_string(i))) {
+      std::cerr << "Echo failed on connection " << i << '\n';
+      return false;
+    }
+  }
+
+  // A connection that is still open when stop() is called keeps working
+  // until the client closes it
+  auto lingering = net::tcp_stream::connect(*address);
+  if (!lingering || !round_trip(*lingering, "before stop")) {
+    std::cerr << "Echo failed before stop\n";
+    return false;
+  }
+
+  server.stop();
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+  if (!round_trip(*lingering, "while draining")) {
+    std::cerr << "Connection was not drained gracefully\n";
+    return false;
+  }
+
+  // New connections are refused once the listeners are closed
+  if (net::tcp_stream::connect(*address)) {
+    std::cerr << "Listener still accepting after stop\n";
+    return false;
+  }
+
+  lingering->close();
+  server.wait();
+  return true;
+}
+
+// A worker that runs out of descriptors keeps accepting once some are
+// freed
+bool descriptor_exhaustion() {
+  net::server server({.address = "127.0.0.1:0", .threads = 1});
+  if (!server.start(echo)) {
+    std::cerr << "Failed to start server\n";
+    return false;
+  }
+  auto address = server.local_address();
+
+  rlimit saved;
+  ::getrlimit(RLIMIT_NOFILE, &saved);
+  rlimit low = saved;
+  low.rlim_cur = std::min<rlim_t>(saved.rlim_cur, 1024);
+  ::setrlimit(RLIMIT_NOFILE, &low);
+
+  // Use up every descriptor but the one the client needs
+  std::vector<int> spare;
+  for (int fd; (fd = ::dup(0)) >= 0;) {
+    spare.push_back(fd);
+  }
+  ::close(spare.back());
+  spare.pop_back();
+  auto stream = net::tcp_stream::connect(*address);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  for (int fd : spare) {
+    ::close(fd);
+  }
+  ::setrlimit(RLIMIT_NOFILE, &saved);
+
+  bool echoed = stream && round_trip(*stream, "after EMFILE");
+  if (!echoed) {
+    std::cerr << "Worker stopped accepting after EMFILE\n";
+  }
+  server.stop();
+  stream.reset();
+  server.wait();
+  return echoed;
+}
+
+// A CPU map that sends every CPU to the second socket of a group
+bool steering() {
+  net::listen_options listen{
+      .backlog = 16, .reuse_port = true, .nonblocking = true};
+  auto first = net::tcp_listener::create("127.0.0.1:0", listen);
+  std::string address = first->local_address().value_or("");
+  auto second = net::tcp_listener::create(address, listen);
+
+  std::vector<int> socket_for_cpu(std::thread::hardware_concurrency(), 1);
+  if (!second || !first->attach_reuseport_cpu_steering(socket_for_cpu, 2)) {
+    std::cerr << "Steering program not attached\n";
+    return false;
+  }
+
+  std::vector<net::tcp_stream> clients;
+  for (int i = 0; i < 8; ++i) {
+    if (auto client = net::tcp_stream::connect(address)) {
+      clients.push_back(std::move(*client));
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  int accepted = 0;
+  while (second->accept()) {
+    ++accepted;
+  }
+  if (accepted != 8 || first->accept()) {
+    std::cerr << "Connections not steered by the CPU map\n";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  if (!steering() || !descriptor_exhaustion() || !run(false)) {
+    return 1;
+  }
+
+#ifdef WU_NET_IO_URING
+  if (!run(true)) {
+    return 1;
+  }
+#endif
+
+  std::cout << "passed\n";
+  return 0;
+}
@@ -0,0 +1,254 @@
+#include <wu-net/net.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Span-based raw I/O, mixed with the iostream interface on the same stream
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+std::span<const std::byte> bytes(std::string_view text) {
+  return std::as_bytes(std::span(text));
+}
+
+iovec iov(std::string_view text) {
+  return {const_cast<char *>(text.data()), text.size()};
+}
+
+// Read until the peer closes
+std::vector<std::byte> read_all(net::tcp_stream &stream) {
+  std::vector<std::byte> data;
+  std::array<std::byte, 65536> chunk;
+  for (;;) {
+    auto n = stream.read_some(chunk);
+    if (!n || *n == 0) {
+      return data;
+    }
+    data.insert(data.end(), chunk.begin(), chunk.begin() + *n);
+  }
+}
+
+// sendfile from a temporary file, then a splice relay between two sockets
+void zero_copy(const std::vector<std::byte> &pattern) {
+  char path[] = "/tmp/wu-net-tcp-stream-XXXXXX";
+  int file = ::mkstemp(path);
+  if (file < 0 ||
+      ::write(file, pattern.data(), pattern.size()) !=
+          static_cast<ssize_t>(pattern.size())) {
+    check(false, "temporary file");
+    return;
+  }
+  ::unlink(path);
+
+  auto listener = net::tcp_listener::create("127.0.0.1:0");
+  auto address = listener->local_address().value_or("");
+
+  std::thread sender([&] {
+    auto client = listener->accept();
+    auto sent = client->send_file(file, 1000, 500000);
+    check(sent && *sent == 500000, "send_file");
+    sent = client->send_file(file, static_cast<off_t>(pattern.size() - 10),
+                             100);
+    check(sent && *sent == 10, "send_file stops at end of file");
+  });
+
+  auto stream = net::tcp_stream::connect(address);
+  auto received = read_all(*stream);
+  sender.join();
+
+  std::vector<std::byte> expected(pattern.begin() + 1000,
+                                  pattern.begin() + 501000);
+  expected.insert(expected.end(), pattern.end() - 10, pattern.end());
+  check(received == expected, "send_file content");
+
+  // A non-blocking socket that fills up reports what it did send, and
+  // fails only once nothing more goes
+  {
+    auto idle = net::tcp_stream::connect(address);
+    auto client = listener->accept();
+    client->set_nonblocking(true);
+    bool partial = false;
+    auto sent = client->send_file(file, 0, pattern.size());
+    while (sent) {
+      partial |= *sent > 0 && *sent < pattern.size();
+      sent = client->send_file(file, 0, pattern.size());
+    }
+    check(partial, "partial send_file counted");
+    check(sent.error() == std::errc::resource_unavailable_try_again,
+          "full socket fails");
+  }
+  ::close(file);
+
+  // source -> proxy (relay) -> sink
+  auto sink_listener = net::tcp_listener::create("127.0.0.1:0");
+  auto sink_address = sink_listener->local_address().value_or("");
+
+  std::thread proxy([&] {
+    auto upstream = listener->accept();
+    auto downstream = net::tcp_stream::connect(sink_address);
+
+    // Read the header through iostream, which buffers part of the payload
+    std::string header;
+    std::getline(*upstream, header);
+    check(header == "header", "relay header");
+
+    auto relayed = net::relay(*upstream, *downstream);
+    check(relayed && *relayed == pattern.size(), "relay byte count");
+  });
+
+  std::thread source([&] {
+    auto out = net::tcp_stream::connect(address);
+    *out << "header\n";
+    out->write_all(pattern);
+  });
+
+  auto sink = sink_listener->accept();
+  auto relayed = read_all(*sink);
+  source.join();
+  proxy.join();
+  check(relayed == pattern, "relay content");
+}
+
+} // namespace
+
+int main() {
+  auto listener = net::tcp_listener::create("127.0.0.1:0");
+  if (!listener) {
+    std::cerr << "Failed to create listener\n";
+    return 1;
+  }
+  auto address = listener->local_address().value_or("");
+
+  // Large enough that a single send cannot take it all
+  std::vector<std::byte> bulk(4 << 20);
+  for (std::size_t i = 0; i < bulk.size(); ++i) {
+    bulk[i] = static_cast<std::byte>(i * 31);
+  }
+
+  std::thread server([&] {
+    auto client = listener->accept();
+    if (!client) {
+      return;
+    }
+
+    // Line through iostream, then raw bytes of the same stream
+    std::string line;
+    std::getline(*client, line);
+    check(line == "hello", "iostream line");
+
+    std::array<std::byte, 5> word;
+    auto n = client->read_exact(word);
+    check(n && *n == 5 &&
+              std::string_view(reinterpret_cast<char *>(word.data()), 5) ==
+                  "world",
+          "read_exact after getline");
+
+    std::vector<std::byte> received(bulk.size());
+    n = client->read_exact(received);
+    check(n && received == bulk, "bulk read_exact");
+
+    std::array<char, 4> first;
+    std::array<char, 8> second;
+    std::array<iovec, 2> scatter = {iovec{first.data(), first.size()},
+                                    iovec{second.data(), second.size()}};
+    std::size_t total = 0;
+    while (total < 12) {
+      // Shift the iovecs past what was already filled
+      std::array<iovec, 2> rest = scatter;
+      std::size_t skip = total;
+      for (auto &v : rest) {
+        std::size_t k = std::min(skip, v.iov_len);
+        v.iov_base = static_cast<char *>(v.iov_base) + k;
+        v.iov_len -= k;
+        skip -= k;
+      }
+      auto got = client->readv(rest);
+      if (!got || *got == 0) {
+        break;
+      }
+      total += *got;
+    }
+    check(total == 12 && std::string_view(first.data(), 4) == "abcd" &&
+              std::string_view(second.data(), 8) == "efghijkl",
+          "readv");
+
+    // Reply: iostream output first, then raw, in order
+    *client << "reply:";
+    auto sent = client->write_all(bytes("done\n"));
+    check(sent && *sent == 5, "write_all");
+    check(client->write_all(bulk).value_or(0) == bulk.size(),
+          "bulk write_all back");
+
+    // Peer closes before the buffer fills
+    std::array<std::byte, 16> more;
+    auto closed = client->read_exact(more);
+    check(!closed && closed.error() ==
+                         make_error_code(net::tcp_error::connection_closed),
+          "read_exact reports early close");
+  });
+
+  auto stream = net::tcp_stream::connect(address);
+  if (!stream) {
+    std::cerr << "Failed to connect\n";
+    server.join();
+    return 1;
+  }
+
+  check(stream->buffer_memory() == 0, "no buffers before first use");
+  *stream << "hello\n";
+  check(stream->buffer_memory() == stream->buffer_size(), "output borrowed");
+  check(stream->write_all(bytes("world")).has_value(), "write_all after <<");
+  check(stream->buffer_memory() == 0, "flush returns the output buffer");
+  check(stream->write_all(bulk).value_or(0) == bulk.size(), "bulk write_all");
+
+  std::array<iovec, 3> gather = {iov("abcd"), iov(""), iov("efghijkl")};
+  check(stream->writev(gather).value_or(0) == 12, "writev");
+
+  std::string reply;
+  std::getline(*stream, reply);
+  check(reply == "reply:done", "ordered reply");
+
+  // Bulk reads through the iostream interface grow the input buffer
+  std::vector<std::byte> received(bulk.size());
+  std::size_t largest = 0;
+  for (std::size_t offset = 0; offset < received.size(); offset += 65536) {
+    stream->read(reinterpret_cast<char *>(received.data() + offset), 65536);
+    largest = std::max(largest, stream->buffer_memory());
+  }
+  check(*stream && received == bulk, "bulk iostream read");
+  check(largest > stream->buffer_size(), "input buffer grows under load");
+  stream->release_idle_buffers();
+  check(stream->buffer_memory() == 0, "idle stream holds no buffers");
+
+  stream->close();
+  server.join();
+
+  std::array<std::byte, 1> unused;
+  check(!stream->read_some(unused), "read_some on closed stream");
+
+  zero_copy(bulk);
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
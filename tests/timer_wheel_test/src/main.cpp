@@ -0,0 +1,236 @@
+#include <wu-net/net.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string_view>
+#include <vector>
+
+// Timer wheel expiry order, cancel and reschedule against a reference on a
+// simulated clock, then timers and sleep_for on a real event loop
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+using clock_type = net::timer_wheel::clock;
+using std::chrono::milliseconds;
+
+// Random adds, cancels and reschedules with delays spanning every level;
+// each timer must fire on the first advance() at or after its deadline
+void compare_with_reference() {
+  const auto start = clock_type::time_point{};
+  net::timer_wheel wheel(milliseconds(1), start);
+  std::mt19937_64 rng(15);
+
+  std::map<net::timer_wheel::timer_id, std::int64_t> pending; // -> deadline
+  std::vector<net::timer_wheel::timer_id> ids;
+  std::vector<std::pair<int, std::int64_t>> fired; // key, time fired
+  std::map<int, std::int64_t> deadlines;
+  std::int64_t now = 0;
+  int next_key = 0;
+
+  auto random_delay = [&] {
+    switch (rng() % 4) {
+    case 0:
+      return std::int64_t(rng() % 64);
+    case 1:
+      return std::int64_t(rng() % 5000);
+    case 2:
+      return std::int64_t(rng() % 1000000);
+    default:
+      return std::int64_t(rng() % 100000000);
+    }
+  };
+
+  std::map<net::timer_wheel::timer_id, int> keys;
+  for (int step = 0; step < 20000; ++step) {
+    switch (rng() % 6) {
+    case 0:
+    case 1: {
+      // A deadline that has already passed fires on the next tick
+      std::int64_t deadline = now + std::max<std::int64_t>(random_delay(), 1);
+      int key = next_key++;
+      auto id = wheel.add(start + milliseconds(deadline),
+                          [&, key] { fired.push_back({key, now}); });
+      pending[id] = deadline;
+      keys[id] = key;
+      deadlines[key] = deadline;
+      ids.push_back(id);
+      break;
+    }
+    case 2:
+      if (!ids.empty()) {
+        auto id = ids[rng() % ids.size()];
+        bool was_pending = pending.erase(id) > 0;
+        if (wheel.cancel(id) != was_pending) {
+          check(false, "cancel result");
+          return;
+        }
+        deadlines.erase(keys[id]);
+      }
+      break;
+    case 3:
+      if (!ids.empty()) {
+        auto id = ids[rng() % ids.size()];
+        std::int64_t deadline =
+            now + std::max<std::int64_t>(random_delay(), 1);
+        bool was_pending = pending.contains(id);
+        if (wheel.reschedule(id, start + milliseconds(deadline)) !=
+            was_pending) {
+          check(false, "reschedule result");
+          return;
+        }
+        if (was_pending) {
+          pending[id] = deadline;
+          deadlines[keys[id]] = deadline;
+        }
+      }
+      break;
+    default: {
+      // Jump ahead by a random amount, sometimes to the next deadline
+      auto next = wheel.next_deadline();
+      if (next && rng() % 2 == 0) {
+        now = std::max(now, (*next - start) / milliseconds(1));
+      } else {
+        now += random_delay() / (1 + std::int64_t(rng() % 100));
+      }
+      fired.clear();
+      wheel.advance(start + milliseconds(now));
+
+      for (auto [key, when] : fired) {
+        if (deadlines[key] > now) {
+          check(false, std::format("timer {} fired early", key));
+          return;
+        }
+        deadlines.erase(key);
+      }
+      for (auto it = pending.begin(); it != pending.end();) {
+        if (!deadlines.contains(keys[it->first])) {
+          it = pending.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      for (const auto &[id, deadline] : pending) {
+        if (deadline <= now) {
+          check(false, std::format("timer due at {} missed at {}", deadline,
+                                   now));
+          return;
+        }
+      }
+      if (wheel.size() != pending.size()) {
+        check(false, "size");
+        return;
+      }
+    }
+    }
+  }
+}
+
+void basics() {
+  const auto start = clock_type::time_point{};
+  net::timer_wheel wheel(milliseconds(10), start);
+  std::vector<int> order;
+
+  wheel.add(start + milliseconds(250), [&] { order.push_back(3); });
+  wheel.add(start + milliseconds(15), [&] { order.push_back(1); });
+  auto canceled =
+      wheel.add(start + milliseconds(20), [&] { order.push_back(9); });
+  auto moved = wheel.add(start + milliseconds(900000), [&] {
+    order.push_back(2);
+    // Added while firing: waits for a later advance()
+    wheel.add(start, [&] { order.push_back(4); });
+  });
+  check(wheel.size() == 4, "size");
+  check(wheel.cancel(canceled) && !wheel.cancel(canceled), "cancel once");
+  check(wheel.reschedule(moved, start + milliseconds(100)), "reschedule");
+  check(wheel.next_deadline() == start + milliseconds(20),
+        "next deadline rounded up to a tick");
+
+  check(wheel.advance(start + milliseconds(19)) == 0, "nothing due");
+  check(wheel.advance(start + milliseconds(20)) == 1, "first due");
+  check(wheel.advance(start + milliseconds(1000)) == 2, "batch due");
+  check(order == std::vector<int>{1, 2, 3}, "deadline order");
+  check(wheel.advance(start + milliseconds(1010)) == 1 && order.back() == 4,
+        "added while firing");
+  check(!wheel.reschedule(moved, start) && !wheel.cancel(moved),
+        "fired id is stale");
+  check(wheel.empty() && !wheel.next_deadline(), "empty");
+
+  // Pushing a deadline back is lazy, but it still must not fire early
+  int fired = 0;
+  auto renewed = wheel.add(start + milliseconds(1100), [&] { ++fired; });
+  for (int t = 1050; t < 3000; t += 50) {
+    wheel.reschedule(renewed, start + milliseconds(t + 100));
+    wheel.advance(start + milliseconds(t));
+  }
+  check(fired == 0, "renewed timer not fired");
+  wheel.advance(start + milliseconds(3100));
+  check(fired == 1, "renewed timer fires once renewals stop");
+
+  // A far deadline travels down every level
+  fired = 0;
+  wheel.add(start + std::chrono::hours(24 * 365), [&] { ++fired; });
+  while (auto next = wheel.next_deadline()) {
+    wheel.advance(*next);
+  }
+  check(fired == 1, "a year away");
+}
+
+net::task<void> sleeper(net::event_loop &loop, bool &done) {
+  auto begin = clock_type::now();
+  co_await net::sleep_for(milliseconds(30));
+  done = clock_type::now() - begin >= milliseconds(30);
+  loop.stop();
+}
+
+void event_loop_timers() {
+  auto loop = net::event_loop::create();
+  check(loop.has_value(), "create loop");
+  if (!loop) {
+    return;
+  }
+
+  int fired = 0;
+  auto begin = clock_type::now();
+  auto id = loop->add_timer(milliseconds(10), [&] { ++fired; });
+  check(loop->reschedule_timer(id, milliseconds(40)), "reschedule_timer");
+  loop->add_timer(milliseconds(5), [&] { ++fired; });
+  auto canceled = loop->add_timer(milliseconds(1), [&] { fired += 100; });
+  check(loop->cancel_timer(canceled), "cancel_timer");
+  check(loop->timer_count() == 2, "timer_count");
+  loop->run(); // Returns once no timers are left
+  check(fired == 2 && clock_type::now() - begin >= milliseconds(40),
+        "loop timers fire");
+
+  bool done = false;
+  loop->spawn(sleeper(*loop, done));
+  loop->run();
+  check(done, "sleep_for");
+}
+
+} // namespace
+
+int main() {
+  basics();
+  compare_with_reference();
+  event_loop_timers();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
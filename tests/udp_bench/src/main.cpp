@@ -0,0 +1,147 @@
+#include <wu-net/net.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+
+// Loopback UDP throughput, one sending and one receiving thread:
+//   single   - one sendto()/recvfrom() per datagram
+//   batched  - sendmmsg()/recvmmsg() with udp_batch
+//   gso      - UDP_SEGMENT sends of a batch's worth of datagrams at once,
+//              received with UDP_GRO
+// Datagrams dropped by a full receive buffer are reported, not retried.
+//
+// Usage: udp_bench [datagrams] [datagram_size]
+namespace {
+
+constexpr std::size_t batch_size = 64;
+
+// Count datagrams until `expected` arrive or the sender has gone quiet
+std::size_t receive_all(net::udp_socket &socket, std::string_view mode,
+                        std::size_t expected, std::size_t size) {
+  timeval timeout{0, 200000};
+  ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout,
+               sizeof(timeout));
+
+  std::size_t received = 0;
+  if (mode == "single") {
+    std::vector<std::byte> buffer(size);
+    net::endpoint from;
+    while (received < expected && socket.receive_from(buffer, from)) {
+      ++received;
+    }
+    return received;
+  }
+
+  net::udp_batch batch(batch_size,
+                       mode == "gso" ? std::size_t{65536} : size);
+  while (received < expected) {
+    auto n = socket.receive_batch(batch);
+    if (!n) {
+      break;
+    }
+    for (std::size_t i = 0; i < *n; ++i) {
+      received += batch[i].segment_count();
+    }
+  }
+  return received;
+}
+
+void send_all(net::udp_socket &socket, std::string_view mode,
+              std::size_t count, std::size_t size) {
+  std::vector<std::byte> payload(size * batch_size, std::byte{'x'});
+
+  if (mode == "single") {
+    std::span<const std::byte> datagram(payload.data(), size);
+    for (std::size_t i = 0; i < count; ++i) {
+      socket.send(datagram);
+    }
+    return;
+  }
+
+  if (mode == "gso") {
+    // A GSO send is at most 64 segments and one maximum-size datagram
+    std::size_t per_send = std::min(batch_size, std::size_t{65507} / size);
+    for (std::size_t i = 0; i < count; i += per_send) {
+      std::size_t n = std::min(per_send, count - i);
+      socket.send_segments(std::span(payload.data(), n * size),
+                           static_cast<std::uint16_t>(size));
+    }
+    return;
+  }
+
+  net::udp_batch batch(batch_size, size);
+  std::span<const std::byte> datagram(payload.data(), size);
+  for (std::size_t i = 0; i < count; i += batch_size) {
+    batch.clear();
+    for (std::size_t j = i; j < count && !batch.full(); ++j) {
+      batch.push(datagram);
+    }
+    socket.send_batch(batch);
+  }
+}
+
+void bench(std::string_view mode, std::size_t count, std::size_t size) {
+  auto receiver = net::udp_socket::bind(
+      "127.0.0.1:0",
+      {.gro = mode == "gso", .receive_buffer_size = 8 * 1024 * 1024});
+  auto sender = net::udp_socket::create();
+  if (!receiver || !sender ||
+      !sender->connect(receiver->local_endpoint().value_or(net::endpoint()))) {
+    std::cerr << mode << ": failed to create sockets\n";
+    return;
+  }
+  if (mode == "gso") {
+    std::byte probe[2]{};
+    if (!sender->send_segments(probe, 1)) {
+      std::cout << mode << ": not supported by the kernel\n";
+      return;
+    }
+    receive_all(*receiver, mode, 2, size);
+  }
+
+  std::atomic<std::size_t> received = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::thread thread(
+      [&] { received = receive_all(*receiver, mode, count, size); });
+  send_all(*sender, mode, count, size);
+  thread.join();
+
+  // Leave out the idle wait that ended an incomplete run
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (received < count) {
+    elapsed -= std::chrono::milliseconds(200);
+  }
+
+  std::cout << mode << ": " << count << " datagrams of " << size
+            << " bytes, " << elapsed.count() << " s, "
+            << static_cast<long long>(received / elapsed.count())
+            << " datagrams/s";
+  if (received < count) {
+    std::cout << " (" << count - received << " dropped)";
+  }
+  std::cout << '\n';
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  std::size_t size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 512;
+  size = std::clamp<std::size_t>(size, 1, 1472);
+
+  bench("single", count, size);
+  bench("batched", count, size);
+  bench("gso", count, size);
+
+  return 0;
+}
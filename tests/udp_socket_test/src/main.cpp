@@ -0,0 +1,244 @@
+#include <wu-net/net.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Single and batched datagrams over loopback, GSO/GRO where the kernel
+// supports them, truncation, and batches through the event loop
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+std::span<const std::byte> bytes(std::string_view text) {
+  return std::as_bytes(std::span(text));
+}
+
+std::string_view text(std::span<const std::byte> data) {
+  return {reinterpret_cast<const char *>(data.data()), data.size()};
+}
+
+// Receive batches until `count` datagrams have arrived or a receive fails
+std::vector<std::string> receive(net::udp_socket &socket, std::size_t count,
+                                 net::endpoint *from = nullptr) {
+  std::vector<std::string> received;
+  net::udp_batch batch(8);
+  while (received.size() < count) {
+    auto n = socket.receive_batch(batch);
+    if (!n) {
+      break;
+    }
+    for (std::size_t i = 0; i < *n; ++i) {
+      for (std::size_t s = 0; s < batch[i].segment_count(); ++s) {
+        received.emplace_back(text(batch[i].segment(s)));
+      }
+      if (from) {
+        *from = batch[i].peer;
+      }
+    }
+  }
+  return received;
+}
+
+void roundtrip(std::string_view address) {
+  auto server = net::udp_socket::bind(address);
+  auto client = net::udp_socket::bind(address);
+  check(server && client, std::format("bind {}", address));
+  if (!server || !client) {
+    return;
+  }
+  auto server_address = server->local_endpoint().value_or(net::endpoint());
+  auto client_address = client->local_endpoint().value_or(net::endpoint());
+  check(server_address.port() != 0, "bound port");
+
+  // One datagram at a time
+  check(client->send_to(bytes("ping"), server_address) == 4, "send_to");
+  char buffer[64];
+  net::endpoint from;
+  auto n = server->receive_from(std::as_writable_bytes(std::span(buffer)),
+                                from);
+  check(n && std::string_view(buffer, *n) == "ping", "receive_from");
+  check(from == client_address, "sender address");
+
+  // A batch in one sendmmsg
+  net::udp_batch out(16);
+  for (int i = 0; i < 10; ++i) {
+    std::string message = std::format("message {}", i);
+    check(out.push(server_address, bytes(message)), "push");
+  }
+  check(client->send_batch(out) == 10 && out.sent() == 10, "send_batch");
+  auto received = receive(*server, 10, &from);
+  check(received.size() == 10 && received.front() == "message 0" &&
+            received.back() == "message 9",
+        "receive_batch");
+  check(from == client_address, "batch peer");
+
+  // Connected socket, written in place
+  check(client->connect(server_address), "connect");
+  out.clear();
+  auto space = out.prepare();
+  std::memcpy(space.data(), "in place", 8);
+  check(out.commit(8), "commit");
+  check(client->send_batch(out) == 1, "connected send_batch");
+  check(client->send(bytes("connected")) == 9, "send");
+  received = receive(*server, 2);
+  check(received.size() == 2 && received[0] == "in place" &&
+            received[1] == "connected",
+        "connected datagrams");
+
+  // Too big for the buffer
+  check(client->send(bytes(std::string(100, 'x'))) == 100, "send large");
+  net::udp_batch small(4, 16);
+  auto got = server->receive_batch(small);
+  check(got == 1 && small[0].truncated && small[0].data.size() == 16,
+        "truncated");
+}
+
+void segmentation() {
+  auto server = net::udp_socket::bind("127.0.0.1:0", {.gro = true});
+  if (!server) {
+    std::cout << "UDP_GRO unavailable, skipping GSO/GRO\n";
+    return;
+  }
+  auto client = net::udp_socket::create();
+  auto to = server->local_endpoint().value_or(net::endpoint());
+
+  std::string payload;
+  for (char c : std::string_view("abcd")) {
+    payload += std::string(1000, c);
+  }
+  payload += "tail";
+  auto sent = client->send_segments(bytes(payload), 1000, to);
+  if (!sent) {
+    std::cout << "UDP_SEGMENT unavailable (" << sent.error().message()
+              << "), skipping GSO/GRO\n";
+    return;
+  }
+  check(*sent == payload.size(), "send_segments");
+
+  // However the kernel coalesced them, five datagrams arrive in order
+  net::udp_batch in(8, 65536);
+  std::string joined;
+  std::size_t datagrams = 0;
+  while (datagrams < 5) {
+    auto n = server->receive_batch(in);
+    if (!n) {
+      break;
+    }
+    for (std::size_t i = 0; i < *n; ++i) {
+      for (std::size_t s = 0; s < in[i].segment_count(); ++s) {
+        joined += text(in[i].segment(s));
+        ++datagrams;
+      }
+    }
+  }
+  check(datagrams == 5 && joined == payload, "GRO segments");
+
+  // GSO through a batch entry
+  net::udp_batch out(2, 4096);
+  check(out.push(to, bytes(std::string(3000, 'z')), 1500), "push segmented");
+  check(client->send_batch(out) == 1, "send segmented batch");
+  joined.clear();
+  datagrams = 0;
+  while (datagrams < 2) {
+    auto n = server->receive_batch(in);
+    if (!n) {
+      break;
+    }
+    for (std::size_t i = 0; i < *n; ++i) {
+      datagrams += in[i].segment_count();
+      joined += text(in[i].data);
+    }
+  }
+  check(datagrams == 2 && joined == std::string(3000, 'z'),
+        "segmented batch");
+}
+
+net::task<void> async_echo(net::event_loop &loop, net::udp_socket &socket,
+                           std::size_t expected, std::size_t &echoed) {
+  net::udp_batch batch(16);
+  while (echoed < expected) {
+    auto n = co_await socket.async_receive_batch(batch);
+    if (!n) {
+      break;
+    }
+    // Reply to each datagram from the same buffers
+    net::udp_batch replies(16);
+    for (std::size_t i = 0; i < *n; ++i) {
+      replies.push(batch[i].peer, batch[i].data);
+    }
+    auto sent = co_await socket.async_send_batch(replies);
+    if (!sent) {
+      break;
+    }
+    echoed += *sent;
+  }
+  loop.stop();
+}
+
+void event_loop_batches() {
+  auto loop = net::event_loop::create();
+  auto server = net::udp_socket::bind("127.0.0.1:0", {.nonblocking = true});
+  auto client = net::udp_socket::bind("127.0.0.1:0");
+  check(loop && server && client, "setup");
+  if (!loop || !server || !client) {
+    return;
+  }
+  auto to = server->local_endpoint().value_or(net::endpoint());
+
+  std::size_t echoed = 0;
+  loop->spawn(async_echo(*loop, *server, 20, echoed));
+  loop->add_timer(std::chrono::milliseconds(10), [&] {
+    net::udp_batch batch(20);
+    for (int i = 0; i < 20; ++i) {
+      batch.push(to, bytes(std::format("{:02}", i)));
+    }
+    client->send_batch(batch);
+  });
+  loop->add_timer(std::chrono::seconds(5), [&] { loop->stop(); });
+  loop->run();
+
+  check(echoed == 20, "async echo");
+  auto replies = receive(*client, 20);
+  check(replies.size() == 20 && replies[19] == "19", "echo replies");
+}
+
+bool ipv6_available() {
+  return net::udp_socket::bind("[::1]:0").has_value();
+}
+
+} // namespace
+
+int main() {
+  roundtrip("127.0.0.1:0");
+  if (ipv6_available()) {
+    roundtrip("[::1]:0");
+  } else {
+    std::cout << "IPv6 unavailable, skipping [::1]\n";
+  }
+  check(net::udp_socket::bind("*:0").has_value(), "bind wildcard");
+  check(!net::udp_socket::bind("localhost:0"), "names are not resolved");
+
+  segmentation();
+  event_loop_batches();
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}
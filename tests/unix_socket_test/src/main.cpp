@@ -0,0 +1,292 @@
+#include <wu-net/net.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Unix domain streams and datagrams: filesystem and abstract names, stale
+// socket files, descriptor passing, and the event loop integration
+namespace {
+
+int failures = 0;
+
+void check(bool condition, std::string_view what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+  }
+}
+
+std::span<const std::byte> bytes(std::string_view text) {
+  return std::as_bytes(std::span(text));
+}
+
+std::string text(std::span<const std::byte> data) {
+  return {reinterpret_cast<const char *>(data.data()), data.size()};
+}
+
+bool exists(const std::string &path) {
+  return ::access(path.c_str(), F_OK) == 0;
+}
+
+// Code written against tcp_stream works on a unix_stream unchanged
+std::string echo_line(net::tcp_stream &stream, std::string_view line) {
+  stream << line << '\n' << std::flush;
+  std::string reply;
+  std::getline(stream, reply);
+  return reply;
+}
+
+void streams(const std::string &path) {
+  auto listener = net::unix_listener::create(path);
+  check(listener.has_value(), std::format("listen on {}", path));
+  if (!listener) {
+    return;
+  }
+  check(listener->local_path() == path, "listener path");
+
+  std::thread server([&] {
+    auto client = listener->accept();
+    check(client.has_value(), "accept");
+    std::string line;
+    while (client && std::getline(*client, line)) {
+      *client << line << '\n' << std::flush;
+    }
+  });
+
+  auto stream = net::unix_stream::connect(path);
+  check(stream.has_value(), "connect");
+  if (stream) {
+    check(echo_line(*stream, "hello") == "hello", "iostream echo");
+    check(stream->remote_path() == path, "remote path");
+    check(stream->local_path() == "", "client is unnamed");
+    auto credentials = stream->peer_credentials();
+    check(credentials && credentials->pid == ::getpid(), "peer credentials");
+    check(!stream->local_endpoint(), "no IP endpoint");
+    stream->close();
+  }
+  server.join();
+
+  check(!net::unix_listener::create(path), "live socket is not replaced");
+  listener->close();
+  if (path.front() != '@') {
+    check(!exists(path), "socket file removed on close");
+  }
+  check(!net::unix_stream::connect(path), "nothing listening");
+}
+
+// A socket file left behind by a process that did not clean up
+void stale_socket(const std::string &path) {
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address;
+  socklen_t length = net::detail::unix_address(path, address);
+  check(::bind(fd, reinterpret_cast<sockaddr *>(&address), length) == 0,
+        "bind stale socket");
+  ::close(fd);
+  check(exists(path), "stale socket file");
+
+  auto listener = net::unix_listener::create(path);
+  check(listener.has_value(), "stale socket replaced");
+
+  // Regular files are never removed
+  listener.reset();
+  ::close(::open(path.c_str(), O_CREAT | O_WRONLY, 0600));
+  check(!net::unix_listener::create(path), "regular file kept");
+  check(exists(path), "regular file still there");
+  ::unlink(path.c_str());
+}
+
+// Pass the read end of a pipe and read through the received descriptor
+void pass_descriptors() {
+  auto pair = net::unix_stream::pair();
+  check(pair.has_value(), "socketpair");
+  if (!pair) {
+    return;
+  }
+  auto &[a, b] = *pair;
+
+  int pipe_fds[2];
+  check(::pipe(pipe_fds) == 0, "pipe");
+  std::array<int, 1> fds{pipe_fds[0]};
+  check(a.send_fds(fds, bytes("pipe")) == 4, "send_fds");
+  check(a.send_fds({}) == 0, "empty send");
+  ::close(pipe_fds[0]);
+
+  std::array<std::byte, 16> buffer;
+  std::vector<int> received;
+  auto n = b.receive_fds(buffer, received);
+  check(n && n->size == 4 && !n->fds_truncated &&
+            text(std::span(buffer).first(4)) == "pipe",
+        "data with descriptors");
+  check(received.size() == 1, "one descriptor");
+  if (received.size() == 1) {
+    ::write(pipe_fds[1], "through", 7);
+    char out[8] = {};
+    check(::read(received[0], out, 7) == 7 &&
+              std::string_view(out) == "through",
+          "read through passed descriptor");
+    check((::fcntl(received[0], F_GETFD) & FD_CLOEXEC) != 0, "close on exec");
+    ::close(received[0]);
+  }
+  ::close(pipe_fds[1]);
+
+  received.clear();
+  n = b.receive_fds(buffer, received);
+  check(n && n->size == 1 && received.empty(),
+        "NUL byte without descriptors");
+}
+
+std::size_t open_descriptors() {
+  return static_cast<std::size_t>(std::distance(
+      std::filesystem::directory_iterator("/proc/self/fd"),
+      std::filesystem::directory_iterator()));
+}
+
+// Credentials passed ahead of a full set of descriptors leave no room for
+// all of them: the data still arrives and the partial set is closed
+void truncated_descriptors() {
+  auto pair = net::unix_stream::pair();
+  check(pair.has_value(), "socketpair");
+  if (!pair) {
+    return;
+  }
+  auto &[a, b] = *pair;
+  int on = 1;
+  ::setsockopt(b.native_handle(), SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+
+  std::vector<int> fds(net::detail::max_passed_fds, 0);
+  check(a.send_fds(fds, bytes("many")) == 4, "send many descriptors");
+
+  std::size_t before = open_descriptors();
+  std::array<std::byte, 16> buffer;
+  std::vector<int> received;
+  auto n = b.receive_fds(buffer, received);
+  check(n && n->size == 4 && n->fds_truncated &&
+            text(std::span(buffer).first(4)) == "many",
+        "data kept when descriptors are truncated");
+  check(received.empty() && open_descriptors() == before,
+        "truncated descriptors closed");
+}
+
+net::task<void> serve_fds(net::unix_listener &listener, int &count) {
+  auto client = co_await listener.async_accept();
+  if (!client) {
+    co_return;
+  }
+  std::array<std::byte, 64> buffer;
+  std::vector<int> fds;
+  for (;;) {
+    auto n = co_await client->async_receive_fds(buffer, fds);
+    if (!n || n->size == 0) {
+      break;
+    }
+  }
+  count = static_cast<int>(fds.size());
+  for (int fd : fds) {
+    ::close(fd);
+  }
+}
+
+net::task<void> send_fds(const std::string &path, bool &sent) {
+  auto stream = co_await net::unix_stream::async_connect(path);
+  if (!stream) {
+    co_return;
+  }
+  std::array<int, 3> fds{0, 1, 2};
+  auto first = co_await stream->async_send_fds(fds, bytes("stdio"));
+  auto second = co_await stream->async_send_fds(std::span(fds).first(1));
+  sent = first == 5 && second == 0;
+}
+
+void event_loop(const std::string &path) {
+  auto loop = net::event_loop::create();
+  auto listener = net::unix_listener::create(path);
+  check(loop && listener, "loop and listener");
+  if (!loop || !listener) {
+    return;
+  }
+
+  int count = 0;
+  bool sent = false;
+  loop->spawn(serve_fds(*listener, count));
+  loop->spawn(send_fds(path, sent));
+  loop->add_timer(std::chrono::milliseconds(50), [&] { loop->stop(); });
+  loop->run();
+
+  check(sent, "async_send_fds");
+  check(count == 4, "async_receive_fds");
+}
+
+void datagrams(const std::string &path) {
+  auto server = net::unix_datagram_socket::bind(path);
+  auto client = net::unix_datagram_socket::bind(path + "-client");
+  check(server && client, "bind datagram sockets");
+  if (!server || !client) {
+    return;
+  }
+  check(server->local_path() == path, "datagram path");
+
+  check(client->send_to(bytes("one"), path) == 3, "send_to");
+  std::array<std::byte, 64> buffer;
+  std::string from;
+  auto n = server->receive_from(buffer, from);
+  check(n == 3 && from == path + "-client", "receive_from");
+
+  check(client->connect(path) && client->send(bytes("two")) == 3, "send");
+  n = server->receive(buffer);
+  check(n == 3 && text(std::span(buffer).first(3)) == "two", "receive");
+
+  server.reset();
+  check(!exists(path), "datagram socket file removed");
+
+  auto pair = net::unix_datagram_socket::pair();
+  check(pair.has_value(), "datagram pair");
+  if (pair) {
+    std::array<int, 1> fds{0};
+    check(pair->first.send_fds(fds, bytes("fd")) == 2, "datagram send_fds");
+    std::vector<int> received;
+    auto got = pair->second.receive_fds(buffer, received);
+    check(got && got->size == 2 && received.size() == 1,
+          "datagram receive_fds");
+    for (int fd : received) {
+      ::close(fd);
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  std::string dir = std::format("/tmp/wu-net-unix-{}", ::getpid());
+
+  streams(dir + "-stream");
+  streams(std::format("@wu-net-unix-{}", ::getpid()));
+  stale_socket(dir + "-stale");
+  pass_descriptors();
+  truncated_descriptors();
+  event_loop(dir + "-loop");
+  datagrams(dir + "-dgram");
+
+  check(!net::unix_listener::create(std::string(200, 'x')), "path too long");
+
+  if (failures != 0) {
+    return 1;
+  }
+
+  std::cout << "passed\n";
+  return 0;
+}